@@ -0,0 +1,48 @@
+#pragma once
+#include "Data/Defs.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <string>
+
+namespace Haboob
+{
+  // A directory of content-addressed files, one per 64 bit key, bounded in size by evicting the least recently used
+  // Owners define the file format, this only names, publishes, ages and removes entries
+  class FileCache
+  {
+    public:
+    typedef std::function<void(std::ostream&)> Writer;
+
+    FileCache(const std::filesystem::path& directory, Literal extension, uint64_t capacity);
+
+    std::filesystem::path getPath(uint64_t key) const;
+
+    // Writes an entry aside under a name unique to this call and renames it into place, so a reader never opens a partial file
+    // Then evicts other entries over capacity, returns false (leaving nothing behind) if the stream failed
+    bool write(uint64_t key, const Writer& writer) const;
+
+    void touch(uint64_t key) const; // Marks an entry as recently used
+    void remove(uint64_t key) const; // Drops an entry found corrupt or stale, so it is rebuilt next time
+
+    void evict() const; // Removes least recently used entries until within capacity
+    void clear() const; // Removes every entry
+
+    inline void setDirectory(const std::filesystem::path& path) { directory = path; }
+    inline const std::filesystem::path& getDirectory() const { return directory; }
+    inline bool isEnabled() const { return !directory.empty(); }
+
+    inline void setCapacity(uint64_t bytes) { capacity = bytes; }
+    inline uint64_t getCapacity() const { return capacity; }
+    uint64_t getUsage() const; // Bytes currently cached
+
+    private:
+    void evict(const std::filesystem::path& keep) const;
+
+    std::filesystem::path directory;
+    std::string extension;
+    uint64_t capacity;
+  };
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "Data/Defs.h"
+#include "Data/MathCore.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+namespace Haboob
+{
+  // A linear float RGBA image, row-major from the top left
+  class HDRImage
+  {
+    public:
+    HDRImage() : width{ 0 }, height{ 0 } {}
+
+    inline void resize(UInt newWidth, UInt newHeight)
+    {
+      width = newWidth;
+      height = newHeight;
+      pixels.assign(size_t(width) * size_t(height), { .0f, .0f, .0f, .0f });
+    }
+
+    inline void fill(const XMFLOAT4& value) { std::fill(pixels.begin(), pixels.end(), value); }
+
+    inline XMFLOAT4& at(UInt x, UInt y) { return pixels[size_t(x) + size_t(width) * size_t(y)]; }
+    inline const XMFLOAT4& at(UInt x, UInt y) const { return pixels[size_t(x) + size_t(width) * size_t(y)]; }
+
+    inline UInt getWidth() const { return width; }
+    inline UInt getHeight() const { return height; }
+    inline const XMFLOAT4* getData() const { return pixels.data(); }
+
+    // Blends a frame of the same size into the running average of count frames before it (replacing it when count is 0)
+    void accumulate(const HDRImage& frame, UInt count);
+
+    // Writes an uncompressed R32G32B32A32_FLOAT DDS, as the app exports and texconv reads
+    bool writeDDS(const std::filesystem::path& path) const;
+
+    private:
+    UInt width;
+    UInt height;
+    std::vector<XMFLOAT4> pixels;
+  };
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Data/Defs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace Haboob
+{
+  // Incremental 64 bit FNV-1a, stable across runs and platforms (for caching and change tracking)
+  // Add structures field by field, padding bytes are undefined
+  class Hasher
+  {
+    public:
+    static constexpr uint64_t OFFSET_BASIS = 0xcbf29ce484222325ULL;
+    static constexpr uint64_t PRIME = 0x100000001b3ULL;
+
+    Hasher() : value{ OFFSET_BASIS } {}
+
+    inline Hasher& addBytes(const void* data, size_t size)
+    {
+      const Byte* bytes = static_cast<const Byte*>(data);
+      for (size_t i = 0; i < size; ++i)
+      {
+        value = (value ^ bytes[i]) * PRIME;
+      }
+
+      return *this;
+    }
+
+    template<typename T> inline Hasher& add(const T& field)
+    {
+      static_assert(std::is_arithmetic<T>::value, "Hash structures field by field");
+      return addBytes(&field, sizeof(T));
+    }
+
+    // Length prefixed, so neighbouring strings cannot run into each other
+    // Widened a character at a time, so wide strings hash alike whatever the platform's wchar_t
+    template<typename C> inline Hasher& addString(const std::basic_string<C>& string)
+    {
+      add(uint64_t(string.size()));
+      for (C character : string)
+      {
+        add(uint32_t(character));
+      }
+
+      return *this;
+    }
+
+    inline uint64_t get() const { return value; }
+
+    private:
+    uint64_t value;
+  };
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "Data/Defs.h"
+
+#include <cstddef>
+#include <filesystem>
+
+namespace Haboob
+{
+  // A whole file mapped read-only into memory
+  class MappedFile
+  {
+    public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::filesystem::path& path); // Replaces any current mapping
+    void close();
+
+    inline bool isOpen() const { return data != nullptr; }
+    inline const Byte* getData() const { return data; }
+    inline size_t getSize() const { return size; }
+
+    private:
+    const Byte* data;
+    size_t size;
+
+    #ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+    #endif
+  };
+}
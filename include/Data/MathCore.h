@@ -0,0 +1,10 @@
+#pragma once
+
+#ifndef MATHCORE_H
+#define MATHCORE_H
+
+// Maths/data (header only, no D3D dependency so CPU code can build anywhere)
+#include <DirectXMath.h>
+using namespace DirectX;
+
+#endif
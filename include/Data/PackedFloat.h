@@ -0,0 +1,104 @@
+#pragma once
+#include "Data/Defs.h"
+
+#include <cstring>
+
+// DXGI_FORMAT_R11G11B10_FLOAT texels, following the D3D conversion rules as DirectXMath's XMStoreFloat3PK/XMLoadFloat3PK do
+// (positive only, round to nearest even, negatives and underflow become 0, overflow becomes the largest finite value)
+// Unlike XMStoreFloat3PK, bits shifted out while denormalising are kept as a sticky bit so denormals round correctly too
+namespace Haboob
+{
+  namespace PackedFloat
+  {
+    inline UInt floatBits(float value)
+    {
+      UInt bits;
+      std::memcpy(&bits, &value, sizeof(UInt));
+      return bits;
+    }
+
+    inline float bitsFloat(UInt bits)
+    {
+      float value;
+      std::memcpy(&value, &bits, sizeof(float));
+      return value;
+    }
+
+    // Converts to an unsigned float with a 5 bit exponent and the given mantissa width (6 or 5)
+    template<UInt MantissaBits> inline UInt toSmallFloat(float value)
+    {
+      constexpr UInt shift = 23 - MantissaBits;
+      constexpr UInt infinity = 0x1FU << MantissaBits;
+      constexpr UInt largest = infinity - 1;
+      constexpr UInt overflowBits = (142U << 23) | (((1U << MantissaBits) - 1) << shift); // Largest finite value, rounded up from here
+      constexpr UInt underflowBits = (112U - MantissaBits) << 23; // Half the smallest denormal, anything below is flushed
+
+      UInt bits = floatBits(value);
+      UInt sign = bits & 0x80000000U;
+      UInt magnitude = bits & 0x7FFFFFFFU;
+
+      if ((magnitude & 0x7F800000U) == 0x7F800000U)
+      {
+        // NaN stays NaN, -INF is clamped to 0 as the format is positive only
+        if (magnitude & 0x7FFFFFU) { return infinity | largest; }
+        return sign ? 0 : infinity;
+      }
+
+      if (sign || magnitude < underflowBits) { return 0; }
+      if (magnitude > overflowBits) { return largest; }
+
+      if (magnitude < 0x38800000U)
+      {
+        // Too small for a normalised value, denormalise
+        UInt denormalShift = 113U - (magnitude >> 23U);
+        UInt mantissa = 0x800000U | (magnitude & 0x7FFFFFU);
+        magnitude = (mantissa >> denormalShift) | ((mantissa & ((1U << denormalShift) - 1)) != 0);
+      }
+      else
+      {
+        // Rebias the exponent
+        magnitude += 0xC8000000U;
+      }
+
+      return ((magnitude + ((1U << (shift - 1)) - 1) + ((magnitude >> shift) & 1U)) >> shift) & ((1U << (MantissaBits + 5)) - 1);
+    }
+
+    template<UInt MantissaBits> inline float fromSmallFloat(UInt packed)
+    {
+      constexpr UInt mantissaMask = (1U << MantissaBits) - 1;
+
+      UInt mantissa = packed & mantissaMask;
+      UInt exponent = packed >> MantissaBits;
+
+      if (exponent == 0x1F) { return bitsFloat(0x7F800000U | (mantissa << (23 - MantissaBits))); }
+
+      if (exponent == 0)
+      {
+        if (mantissa == 0) { return .0f; }
+
+        // Normalise the denormal
+        exponent = 1;
+        do
+        {
+          --exponent;
+          mantissa <<= 1;
+        } while ((mantissa & (1U << MantissaBits)) == 0);
+        mantissa &= mantissaMask;
+      }
+
+      return bitsFloat(((exponent + 112U) << 23) | (mantissa << (23 - MantissaBits)));
+    }
+
+    inline UInt packR11G11B10(float r, float g, float b)
+    {
+      return toSmallFloat<6>(r) | (toSmallFloat<6>(g) << 11) | (toSmallFloat<5>(b) << 22);
+    }
+
+    inline void unpackR11G11B10(UInt packed, float rgb[3])
+    {
+      rgb[0] = fromSmallFloat<6>(packed & 0x7FFU);
+      rgb[1] = fromSmallFloat<6>((packed >> 11) & 0x7FFU);
+      rgb[2] = fromSmallFloat<5>(packed >> 22);
+    }
+  }
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include "Data/PackedFloatKernels.h"
+
+// Width-agnostic body of the vector R11G11B10 kernels, mirroring PackedFloat.h
+// Only included by the per instruction set sources, which provide a lane type L (Float, Int, Mask and operations)
+// Everything here has internal linkage so no copy built for a wider instruction set leaks into other objects
+namespace Haboob
+{
+  namespace PackedFloat
+  {
+    namespace
+    {
+      template<typename L> struct Codec
+      {
+        typedef typename L::Float Float;
+        typedef typename L::Int Int;
+        typedef typename L::Mask Mask;
+
+        // PackedFloat::toSmallFloat, every case is evaluated and the first matching one selected
+        template<UInt MantissaBits> static inline Int toSmallFloat(Float value)
+        {
+          constexpr UInt shift = 23 - MantissaBits;
+          constexpr UInt infinity = 0x1FU << MantissaBits;
+          constexpr UInt largest = infinity - 1;
+          constexpr UInt overflowBits = (142U << 23) | (((1U << MantissaBits) - 1) << shift);
+          constexpr UInt underflowBits = (112U - MantissaBits) << 23;
+
+          // Magnitudes fit in 31 bits so signed comparisons are safe
+          Int bits = L::asInt(value);
+          Int magnitude = L::andInt(bits, L::setInt(0x7FFFFFFFU));
+          Mask negative = L::greaterInt(L::setInt(0), bits);
+          Mask special = L::greaterInt(magnitude, L::setInt(0x7F7FFFFFU));
+          Mask nan = L::greaterInt(magnitude, L::setInt(0x7F800000U));
+          Mask underflow = L::maskOr(negative, L::greaterInt(L::setInt(underflowBits), magnitude));
+          Mask overflow = L::greaterInt(magnitude, L::setInt(overflowBits));
+          Mask denormal = L::greaterInt(L::setInt(0x38800000U), magnitude);
+
+          // Denormalise by scaling the 24 bit mantissa by 2^-(113 - exponent), which is exact, so truncating matches the shift
+          // Any bits shifted out leave the truncated value short of the scaled one, which sets the sticky bit
+          Int mantissa = L::orInt(L::andInt(magnitude, L::setInt(0x7FFFFFU)), L::setInt(0x800000U));
+          Float scale = L::asFloat(L::template shiftLeft<23>(L::addInt(L::template shiftRight<23>(magnitude), L::setInt(14))));
+          Float scaled = L::mul(L::toFloat(mantissa), scale);
+          Int truncated = L::toInt(scaled);
+          Int sticky = L::selectInt(L::equalInt(L::asInt(L::toFloat(truncated)), L::asInt(scaled)), L::setInt(0), L::setInt(1));
+          Int denormalised = L::orInt(truncated, sticky);
+          Int rebiased = L::addInt(magnitude, L::setInt(0xC8000000U));
+          Int unrounded = L::selectInt(denormal, denormalised, rebiased);
+
+          // Round to nearest even
+          Int odd = L::andInt(L::template shiftRight<shift>(unrounded), L::setInt(1));
+          Int rounded = L::template shiftRight<shift>(L::addInt(L::addInt(unrounded, L::setInt((1U << (shift - 1)) - 1)), odd));
+          rounded = L::andInt(rounded, L::setInt((1U << (MantissaBits + 5)) - 1));
+
+          Int result = L::selectInt(overflow, L::setInt(largest), rounded);
+          result = L::selectInt(underflow, L::setInt(0), result);
+          Int specialResult = L::selectInt(nan, L::setInt(infinity | largest), L::selectInt(negative, L::setInt(0), L::setInt(infinity)));
+          return L::selectInt(special, specialResult, result);
+        }
+
+        // PackedFloat::fromSmallFloat, packed holds just the one channel
+        template<UInt MantissaBits> static inline Float fromSmallFloat(Int packed)
+        {
+          Int mantissa = L::andInt(packed, L::setInt((1U << MantissaBits) - 1));
+          Int exponent = L::template shiftRight<MantissaBits>(packed);
+          Int shiftedMantissa = L::template shiftLeft<23 - MantissaBits>(mantissa);
+
+          Int normal = L::orInt(L::template shiftLeft<23>(L::addInt(exponent, L::setInt(112))), shiftedMantissa);
+          Int special = L::orInt(L::setInt(0x7F800000U), shiftedMantissa);
+
+          // Denormals (and zero) are the mantissa times the smallest denormal, exactly representable as a normal float
+          Float denormal = L::mul(L::toFloat(mantissa), L::set(bitsFloat((127U - 14U - MantissaBits) << 23)));
+
+          Int result = L::selectInt(L::equalInt(exponent, L::setInt(0x1F)), special, normal);
+          result = L::selectInt(L::equalInt(exponent, L::setInt(0)), L::asInt(denormal), result);
+          return L::asFloat(result);
+        }
+
+        static inline Int pack(const Float rgb[3])
+        {
+          Int packed = toSmallFloat<6>(rgb[0]);
+          packed = L::orInt(packed, L::template shiftLeft<11>(toSmallFloat<6>(rgb[1])));
+          return L::orInt(packed, L::template shiftLeft<22>(toSmallFloat<5>(rgb[2])));
+        }
+
+        static inline void unpack(Int packed, Float rgb[3])
+        {
+          rgb[0] = fromSmallFloat<6>(L::andInt(packed, L::setInt(0x7FFU)));
+          rgb[1] = fromSmallFloat<6>(L::andInt(L::template shiftRight<11>(packed), L::setInt(0x7FFU)));
+          rgb[2] = fromSmallFloat<5>(L::template shiftRight<22>(packed));
+        }
+      };
+
+      template<typename L> void packBatchLanes(const float* rgb, UInt* out, size_t count)
+      {
+        constexpr UInt W = L::WIDTH;
+
+        typename L::Float channels[3];
+        size_t i = 0;
+        for (; i + W <= count; i += W)
+        {
+          L::loadRGB(rgb + 3 * i, channels);
+          L::storeInt(out + i, Codec<L>::pack(channels));
+        }
+
+        // Remainder through a zero padded copy
+        if (i < count)
+        {
+          float tail[3 * W] = {};
+          UInt packedTail[W];
+          std::memcpy(tail, rgb + 3 * i, (count - i) * 3 * sizeof(float));
+
+          L::loadRGB(tail, channels);
+          L::storeInt(packedTail, Codec<L>::pack(channels));
+          std::memcpy(out + i, packedTail, (count - i) * sizeof(UInt));
+        }
+      }
+
+      template<typename L> void unpackBatchLanes(const UInt* packed, float* rgb, size_t count)
+      {
+        constexpr UInt W = L::WIDTH;
+
+        typename L::Float channels[3];
+        size_t i = 0;
+        for (; i + W <= count; i += W)
+        {
+          Codec<L>::unpack(L::loadInt(packed + i), channels);
+          L::storeRGB(rgb + 3 * i, channels);
+        }
+
+        if (i < count)
+        {
+          UInt packedTail[W] = {};
+          float tail[3 * W];
+          std::memcpy(packedTail, packed + i, (count - i) * sizeof(UInt));
+
+          Codec<L>::unpack(L::loadInt(packedTail), channels);
+          L::storeRGB(tail, channels);
+          std::memcpy(rgb + 3 * i, tail, (count - i) * 3 * sizeof(float));
+        }
+      }
+    }
+  }
+}
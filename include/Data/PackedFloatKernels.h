@@ -0,0 +1,33 @@
+#pragma once
+#include "Data/PackedFloat.h"
+#include "Data/SIMD.h"
+
+#include <cstddef>
+
+// Batched R11G11B10 conversion, one kernel per instruction set
+// Every kernel is bit-identical to PackedFloat::packR11G11B10/unpackR11G11B10 for every input, NaNs and denormals included
+namespace Haboob
+{
+  namespace PackedFloat
+  {
+    // Packs count interleaved rgb triples (such as VolumeElements) into R11G11B10 texels
+    typedef void (*PackBatch)(const float* rgb, UInt* out, size_t count);
+
+    void packBatchScalar(const float* rgb, UInt* out, size_t count);
+    void packBatchSSE4(const float* rgb, UInt* out, size_t count);
+    void packBatchAVX2(const float* rgb, UInt* out, size_t count);
+    void packBatchAVX512(const float* rgb, UInt* out, size_t count);
+
+    // Unpacks count R11G11B10 texels into interleaved rgb triples
+    typedef void (*UnpackBatch)(const UInt* packed, float* rgb, size_t count);
+
+    void unpackBatchScalar(const UInt* packed, float* rgb, size_t count);
+    void unpackBatchSSE4(const UInt* packed, float* rgb, size_t count);
+    void unpackBatchAVX2(const UInt* packed, float* rgb, size_t count);
+    void unpackBatchAVX512(const UInt* packed, float* rgb, size_t count);
+
+    // Returns the kernels for a level (which must be supported by the CPU)
+    PackBatch getPackBatch(SIMD::Level level);
+    UnpackBatch getUnpackBatch(SIMD::Level level);
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "Data/Defs.h"
+
+// Vector kernels are only built for x86, other targets always use the scalar path
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HABOOB_SIMD_X86 1
+#endif
+
+namespace Haboob
+{
+  namespace SIMD
+  {
+    // Instruction sets with CPU kernels, ordered by width
+    enum Level : Byte
+    {
+      LEVEL_SCALAR = 0,
+      LEVEL_SSE4, // SSE4.1, 4 lanes
+      LEVEL_AVX2, // 8 lanes
+      LEVEL_AVX512, // AVX-512F, 16 lanes
+      LEVEL_COUNT
+    };
+
+    // Returns the widest level supported by both this CPU and OS
+    Level detectLevel();
+
+    CString getLevelName(Level level);
+    UInt getLevelWidth(Level level);
+  }
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "Data/Defs.h"
+
+#include <vector>
+
+namespace Haboob
+{
+  // A tileable blue noise threshold map, used to decorrelate per pixel offsets (such as ray start jitter) between neighbours
+  namespace BlueNoise
+  {
+    static constexpr UInt TILE_SIZE = 64; // Texels per side, a power of 2 so pixel coordinates wrap with a mask
+    static constexpr float GOLDEN_RATIO_FRACTION = .618034f; // Per frame shift, which keeps successive frames of a texel well spread
+
+    // Ranks every texel of a TILE_SIZE^2 tile by void-and-cluster (Ulichney 1993) on a torus, as values uniform over (0, 1)
+    // Deterministic, built once on first use
+    const std::vector<float>& getTile();
+
+    // The tile's value at a pixel, shifted along (0, 1) for a frame
+    inline float sample(UInt x, UInt y, UInt frame)
+    {
+      float value = getTile()[(x & (TILE_SIZE - 1)) + TILE_SIZE * (y & (TILE_SIZE - 1))] + float(frame) * GOLDEN_RATIO_FRACTION;
+      return value - float(UInt(value));
+    }
+  }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "Procedural/NoiseKernels.h"
+#include "Threading/ThreadPool.h"
+
+namespace Haboob
+{
+  // Perlin gradients of one fBM octave, precomputed for every lattice corner touched by a grid of positions
+  // The grid must be separable (each axis position depends on only that axis' index), which makes the
+  // touched corners the product of a small sorted set per axis. Noise is then lookups plus interpolation,
+  // bit-identical to the direct path as each entry is the same getGradient call the direct path makes
+  class GradientLattice
+  {
+    public:
+    // Returns the corner count this lattice would need, without building it
+    static size_t measure(const fBMOctave& octave, const std::vector<float> positions[3], const float absoluteOffset[3]);
+
+    // Computes every touched gradient, splitting rows of the table across the pool (if any)
+    void build(const fBMOctave& octave, const WorldSpace& space, const std::vector<float> positions[3], const float absoluteOffset[3], ThreadPool* pool, SIMD::Level level);
+    void clear();
+
+    // Perlin noise of this octave at grid index (x, y, z)
+    inline float perlinNoise(UInt x, UInt y, UInt z) const
+    {
+      const AxisMap& mapX = axes[0];
+      const AxisMap& mapY = axes[1];
+      const AxisMap& mapZ = axes[2];
+
+      float uvw[3] = { mapX.uvw[x], mapY.uvw[y], mapZ.uvw[z] };
+
+      // Corner bits follow Perlin::Corner, the next lattice value along an axis is always the next slot
+      size_t strideY = mapX.lattice.size(), strideZ = strideY * mapY.lattice.size();
+      size_t base = mapX.slot[x] + strideY * mapY.slot[y] + strideZ * mapZ.slot[z];
+      float gradients[Perlin::CORNER_COUNT][3];
+      for (UInt corner = 0; corner < Perlin::CORNER_COUNT; ++corner)
+      {
+        const float* gradient = &table[3 * (base + (corner & 1) + ((corner >> 1) & 1) * strideY + ((corner >> 2) & 1) * strideZ)];
+        gradients[corner][0] = gradient[0];
+        gradients[corner][1] = gradient[1];
+        gradients[corner][2] = gradient[2];
+      }
+
+      return Perlin::perlinNoise(gradients, uvw);
+    }
+
+    inline bool isBuilt() const { return !table.empty(); }
+    inline size_t getCornerCount() const { return table.size() / 3; }
+
+    private:
+    // Lattice coordinates of one axis
+    struct AxisMap
+    {
+      std::vector<float> lattice; // Sorted unique lattice values (big + step) touched on this axis
+      std::vector<UInt> slot; // Position index -> slot of its 'big' in lattice
+      std::vector<float> uvw; // Position index -> distance into its section
+    };
+
+    static void mapAxis(const std::vector<float>& positions, float offset, float scale, AxisMap& map);
+
+    AxisMap axes[3];
+    std::vector<float> table; // xyz gradient per corner, x-fastest
+  };
+}
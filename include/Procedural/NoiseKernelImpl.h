@@ -0,0 +1,252 @@
+#pragma once
+#include "Procedural/NoiseKernels.h"
+
+// Width-agnostic body of the vector noise kernels, mirroring TEA.h, World.h, Perlin.h and fBM.h
+// Only included by the per instruction set sources, which provide a lane type L (Float, Int, Mask and operations)
+// Everything here has internal linkage so no copy built for a wider instruction set leaks into other objects
+namespace Haboob
+{
+  namespace NoiseKernels
+  {
+    namespace
+    {
+      template<typename L> struct Kernel
+      {
+        typedef typename L::Float Float;
+        typedef typename L::Int Int;
+
+        // WorldSpace::fmodHLSL
+        static inline Float fmodHLSL(Float x, Float y)
+        {
+          Float quotient = L::div(x, y);
+          Float fraction = L::abs(quotient);
+          fraction = L::sub(fraction, L::floor(fraction));
+          Float absY = L::abs(y);
+          return L::mul(fraction, L::select(L::greaterEqual(quotient, L::neg(quotient)), absY, L::neg(absY)));
+        }
+
+        // WorldSpace::toRange
+        static inline Float toRange(Float value, Float max)
+        {
+          typename L::Mask negative = L::lessThan(value, L::set(.0f));
+          Float folded = fmodHLSL(L::select(negative, L::neg(value), value), max);
+          return L::select(negative, L::sub(max, folded), folded);
+        }
+
+        // WorldSpace::packValue
+        static inline Int packValue(Float value, Float epsilon, UInt fractionBits)
+        {
+          Float big = L::trunc(value);
+          Float fraction = L::sub(value, big);
+          Int smallComponent = L::toInt(L::trunc(L::div(fraction, epsilon)));
+
+          return L::orInt(L::shiftLeftBy(L::toInt(big), fractionBits), smallComponent);
+        }
+
+        // TEA::next with a sum shared by every lane
+        static inline void next(Int values[2], Int sum, const Int key[4])
+        {
+          values[0] = L::addInt(values[0], L::xorInt(L::xorInt(L::addInt(L::template shiftLeft<4>(values[1]), key[0]), L::addInt(values[1], sum)), L::addInt(L::template shiftRight<5>(values[1]), key[1])));
+          values[1] = L::addInt(values[1], L::xorInt(L::xorInt(L::addInt(L::template shiftLeft<4>(values[0]), key[2]), L::addInt(values[0], sum)), L::addInt(L::template shiftRight<5>(values[0]), key[3])));
+        }
+
+        // TEA::getNormFloat
+        static inline Float getNormFloat(Int value)
+        {
+          Float unit = L::div(L::toFloat(value), L::set(float(UInt(~0))));
+          return L::sub(L::mul(L::set(2.f), unit), L::set(1.f));
+        }
+
+        // Perlin::getGradient
+        static inline void getGradient(const WorldSpace& space, const TEA& baseRNG, const Float worldPosition[3], Float gradient[3])
+        {
+          // Get the actual point as defined by the world
+          Float epsilon = L::set(space.epsilon);
+          Int packedX = packValue(toRange(worldPosition[0], L::set(space.worldMax[0])), epsilon, space.fractionBits);
+          Int packedY = packValue(toRange(worldPosition[1], L::set(space.worldMax[1])), epsilon, space.fractionBits);
+          Int packedZ = packValue(toRange(worldPosition[2], L::set(space.worldMax[2])), epsilon, space.fractionBits);
+
+          Int values[2];
+          values[0] = L::orInt(L::andInt(packedX, L::setInt(0xFFFF)), L::template shiftLeft<16>(packedY));
+          values[1] = packedZ;
+
+          // Every lane runs the same number of rounds so the key and rolling sum stay uniform
+          Int key[4] = { L::setInt(baseRNG.key[0]), L::setInt(baseRNG.key[1]), L::setInt(baseRNG.key[2]), L::setInt(baseRNG.key[3]) };
+          UInt sum = baseRNG.sum;
+          for (UInt i = 0; i < TEA::AVALANCHE; ++i)
+          {
+            sum += baseRNG.delta;
+            next(values, L::setInt(sum), key);
+          }
+
+          // Get the random gradient
+          for (UInt axis = 0; axis < 3; ++axis)
+          {
+            for (UInt i = 0; i < TEA::STIR; ++i)
+            {
+              sum += baseRNG.delta;
+              next(values, L::setInt(sum), key);
+            }
+
+            gradient[axis] = getNormFloat(values[0]);
+          }
+
+          Float length = L::sqrt(L::add(L::add(L::mul(gradient[0], gradient[0]), L::mul(gradient[1], gradient[1])), L::mul(gradient[2], gradient[2])));
+          gradient[0] = L::div(gradient[0], length);
+          gradient[1] = L::div(gradient[1], length);
+          gradient[2] = L::div(gradient[2], length);
+        }
+
+        static inline Float lerp(Float x, Float y, Float s)
+        {
+          return L::add(x, L::mul(s, L::sub(y, x)));
+        }
+
+        static inline Float dot(const Float a[3], Float x, Float y, Float z)
+        {
+          return L::add(L::add(L::mul(a[0], x), L::mul(a[1], y)), L::mul(a[2], z));
+        }
+
+        static inline Float fade(Float t)
+        {
+          Float t3 = L::mul(L::mul(t, t), t);
+          Float t4 = L::mul(t3, t);
+          Float t5 = L::mul(t4, t);
+          return L::add(L::sub(L::mul(L::set(6.f), t5), L::mul(L::set(15.f), t4)), L::mul(L::set(10.f), t3));
+        }
+
+        // Perlin::perlinNoise
+        static inline Float perlinNoise(const Float gradients[Perlin::CORNER_COUNT][3], const Float uvw[3])
+        {
+          using namespace Perlin;
+
+          Float u = fade(uvw[0]);
+          Float v = fade(uvw[1]);
+          Float w = fade(uvw[2]);
+
+          Float one = L::set(1.f);
+          Float x0 = uvw[0], x1 = L::sub(uvw[0], one);
+          Float y0 = uvw[1], y1 = L::sub(uvw[1], one);
+          Float z0 = uvw[2], z1 = L::sub(uvw[2], one);
+
+          Float back = lerp(
+            lerp(dot(gradients[BBL], x0, y0, z0), dot(gradients[BBR], x1, y0, z0), u),
+            lerp(dot(gradients[BTL], x0, y1, z0), dot(gradients[BTR], x1, y1, z0), u), v);
+          Float front = lerp(
+            lerp(dot(gradients[FBL], x0, y0, z1), dot(gradients[FBR], x1, y0, z1), u),
+            lerp(dot(gradients[FTL], x0, y1, z1), dot(gradients[FTR], x1, y1, z1), u), v);
+
+          return lerp(back, front, w);
+        }
+
+        // fBM::fBMNoise for a full set of lanes
+        static inline Float fBMNoise(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space, const Float position[3], const float absoluteOffset[3])
+        {
+          Float value = L::set(.0f);
+          Float offset[3] = { L::set(absoluteOffset[0]), L::set(absoluteOffset[1]), L::set(absoluteOffset[2]) };
+
+          for (UInt i = 0; i < octaveCount; ++i)
+          {
+            const fBMOctave& octave = octaves[i];
+            Float scale[3] = { L::set(octave.scale[0]), L::set(octave.scale[1]), L::set(octave.scale[2]) };
+
+            // Perlin::getLattice
+            Float big[3], uvw[3];
+            for (UInt axis = 0; axis < 3; ++axis)
+            {
+              Float perlinValue = L::div(L::sub(position[axis], offset[axis]), scale[axis]);
+              big[axis] = L::floor(perlinValue);
+              uvw[axis] = L::sub(perlinValue, big[axis]);
+            }
+
+            // Perlin::getSection
+            Float gradients[Perlin::CORNER_COUNT][3];
+            for (UInt corner = 0; corner < Perlin::CORNER_COUNT; ++corner)
+            {
+              Float cornerPosition[3];
+              for (UInt axis = 0; axis < 3; ++axis)
+              {
+                Float step = L::set((corner >> axis) & 1 ? 1.f : .0f);
+                cornerPosition[axis] = L::add(offset[axis], L::mul(L::add(big[axis], step), scale[axis]));
+              }
+
+              getGradient(space, octave.rng, cornerPosition, gradients[corner]);
+            }
+
+            Float noise = perlinNoise(gradients, uvw);
+            value = L::add(value, L::mul(L::mul(L::set(octave.coefficient), noise), L::set(octave.weight)));
+          }
+
+          return value;
+        }
+      };
+
+      // Loads a set of lanes from each stream, padding a final partial set with its last value
+      template<typename L> inline void loadLanes(const float* const streams[3], UInt base, UInt lanes, typename L::Float values[3])
+      {
+        for (UInt axis = 0; axis < 3; ++axis)
+        {
+          if (lanes == L::WIDTH)
+          {
+            values[axis] = L::load(streams[axis] + base);
+            continue;
+          }
+
+          float padded[L::WIDTH];
+          for (UInt lane = 0; lane < L::WIDTH; ++lane)
+          {
+            padded[lane] = streams[axis][base + (lane < lanes ? lane : lanes - 1)];
+          }
+
+          values[axis] = L::load(padded);
+        }
+      }
+
+      template<typename L> inline void storeLanes(float* out, UInt lanes, typename L::Float value)
+      {
+        if (lanes == L::WIDTH)
+        {
+          L::store(out, value);
+          return;
+        }
+
+        float result[L::WIDTH];
+        L::store(result, value);
+        for (UInt lane = 0; lane < lanes; ++lane) { out[lane] = result[lane]; }
+      }
+
+      // Runs the lanes over a batch of positions
+      template<typename L> void fBMBatchLanes(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space,
+        const float* x, const float* y, const float* z, const float absoluteOffset[3], float* out, UInt count)
+      {
+        const float* streams[3] = { x, y, z };
+        for (UInt base = 0; base < count; base += L::WIDTH)
+        {
+          UInt lanes = count - base < L::WIDTH ? count - base : L::WIDTH;
+
+          typename L::Float position[3];
+          loadLanes<L>(streams, base, lanes, position);
+          storeLanes<L>(out + base, lanes, Kernel<L>::fBMNoise(octaves, octaveCount, space, position, absoluteOffset));
+        }
+      }
+
+      // Runs the lanes over a batch of lattice corners
+      template<typename L> void gradientBatchLanes(const WorldSpace& space, const TEA& baseRNG,
+        const float* x, const float* y, const float* z, float* gradientX, float* gradientY, float* gradientZ, UInt count)
+      {
+        const float* streams[3] = { x, y, z };
+        for (UInt base = 0; base < count; base += L::WIDTH)
+        {
+          UInt lanes = count - base < L::WIDTH ? count - base : L::WIDTH;
+
+          typename L::Float position[3], gradient[3];
+          loadLanes<L>(streams, base, lanes, position);
+          Kernel<L>::getGradient(space, baseRNG, position, gradient);
+          storeLanes<L>(gradientX + base, lanes, gradient[0]);
+          storeLanes<L>(gradientY + base, lanes, gradient[1]);
+          storeLanes<L>(gradientZ + base, lanes, gradient[2]);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "Data/SIMD.h"
+#include "Procedural/fBM.h"
+
+// Batched fBM evaluation, one kernel per instruction set
+// Every kernel is bit-identical to fBM::fBMNoise (no FMA contraction, products for powers)
+namespace Haboob
+{
+  namespace NoiseKernels
+  {
+    // Evaluates planned fBM at count positions given as separate x, y and z streams
+    typedef void (*fBMBatch)(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space,
+      const float* x, const float* y, const float* z, const float absoluteOffset[3], float* out, UInt count);
+
+    void fBMBatchScalar(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space,
+      const float* x, const float* y, const float* z, const float absoluteOffset[3], float* out, UInt count);
+    void fBMBatchSSE4(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space,
+      const float* x, const float* y, const float* z, const float absoluteOffset[3], float* out, UInt count);
+    void fBMBatchAVX2(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space,
+      const float* x, const float* y, const float* z, const float absoluteOffset[3], float* out, UInt count);
+    void fBMBatchAVX512(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space,
+      const float* x, const float* y, const float* z, const float absoluteOffset[3], float* out, UInt count);
+
+    // Evaluates perlin gradients (Perlin::getGradient) at count lattice corners given as separate x, y and z streams
+    typedef void (*GradientBatch)(const WorldSpace& space, const TEA& baseRNG,
+      const float* x, const float* y, const float* z, float* gradientX, float* gradientY, float* gradientZ, UInt count);
+
+    void gradientBatchScalar(const WorldSpace& space, const TEA& baseRNG,
+      const float* x, const float* y, const float* z, float* gradientX, float* gradientY, float* gradientZ, UInt count);
+    void gradientBatchSSE4(const WorldSpace& space, const TEA& baseRNG,
+      const float* x, const float* y, const float* z, float* gradientX, float* gradientY, float* gradientZ, UInt count);
+    void gradientBatchAVX2(const WorldSpace& space, const TEA& baseRNG,
+      const float* x, const float* y, const float* z, float* gradientX, float* gradientY, float* gradientZ, UInt count);
+    void gradientBatchAVX512(const WorldSpace& space, const TEA& baseRNG,
+      const float* x, const float* y, const float* z, float* gradientX, float* gradientY, float* gradientZ, UInt count);
+
+    // Returns the kernels for a level (which must be supported by the CPU)
+    fBMBatch getfBMBatch(SIMD::Level level);
+    GradientBatch getGradientBatch(SIMD::Level level);
+  }
+}
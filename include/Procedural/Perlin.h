@@ -0,0 +1,147 @@
+#pragma once
+#include "Procedural/TEA.h"
+#include "Procedural/World.h"
+
+// CPU mirror of the 3D paths in shaders/Procedural/Perlin.lib
+namespace Haboob
+{
+  namespace Perlin
+  {
+    // Corner indices of a section, bit 0 = right, bit 1 = top, bit 2 = front
+    enum Corner : UInt
+    {
+      BBL = 0, BBR, BTL, BTR, FBL, FBR, FTL, FTR,
+      CORNER_COUNT
+    };
+
+    // A cube representing a section of the perlin noise grid
+    struct Section3D
+    {
+      float corners[CORNER_COUNT][3]; // Vertices
+      float gradients[CORNER_COUNT][3]; // Associated gradients of the vertices
+    };
+
+    inline float lerp(float x, float y, float s)
+    {
+      return x + s * (y - x);
+    }
+
+    inline float dot(const float a[3], float x, float y, float z)
+    {
+      return a[0] * x + a[1] * y + a[2] * z;
+    }
+
+    // Perlin fade function (smoother step)
+    // The shader's pow() calls are expanded to plain products so every CPU path rounds identically
+    inline float fade(float t)
+    {
+      float t3 = t * t * t;
+      float t4 = t3 * t;
+      float t5 = t4 * t;
+      return 6.f * t5 - 15.f * t4 + 10.f * t3;
+    }
+
+    // Returns the perlin gradient at a position
+    inline void getGradient(const WorldSpace& space, const TEA& baseRNG, const float worldPosition[3], float gradient[3])
+    {
+      // Get the actual point as defined by the world
+      UInt packed[2];
+      space.getPoint(worldPosition[0], worldPosition[1], worldPosition[2], packed);
+
+      // Fetch generator for this world point
+      TEA thisRNG = baseRNG;
+      thisRNG.associate(packed[0], packed[1]);
+
+      // Get the random gradient
+      thisRNG.stir();
+      gradient[0] = thisRNG.getNormFloat();
+      thisRNG.stir();
+      gradient[1] = thisRNG.getNormFloat();
+      thisRNG.stir();
+      gradient[2] = thisRNG.getNormFloat();
+
+      float length = std::sqrt(gradient[0] * gradient[0] + gradient[1] * gradient[1] + gradient[2] * gradient[2]);
+      gradient[0] /= length;
+      gradient[1] /= length;
+      gradient[2] /= length;
+    }
+
+    // Returns the lattice coordinate ('big') of a position and sets the position to its UVW within the section
+    inline void getLattice(float position[3], const float perlinOffset[3], const float perlinScale[3], float big[3])
+    {
+      for (UInt axis = 0; axis < 3; ++axis)
+      {
+        // Bring world position into perlin space
+        float value = (position[axis] - perlinOffset[axis]) / perlinScale[axis];
+        spatialize(value, big[axis], position[axis]);
+      }
+    }
+
+    // Returns the world position of a lattice corner
+    // (delayed until here rather than derived from the position to avoid seams due to FP error)
+    inline void getCorner(const float big[3], UInt corner, const float perlinOffset[3], const float perlinScale[3], float cornerPosition[3])
+    {
+      for (UInt axis = 0; axis < 3; ++axis)
+      {
+        float step = (corner >> axis) & 1 ? 1.f : .0f;
+        cornerPosition[axis] = perlinOffset[axis] + (big[axis] + step) * perlinScale[axis];
+      }
+    }
+
+    // Returns a section representing the current location in perlin noise relative to a provided world position
+    // Position is set to the UVW coordinates within the section
+    inline Section3D getSection(const WorldSpace& space, const TEA& baseRNG, float position[3], const float perlinOffset[3], const float perlinScale[3])
+    {
+      Section3D section;
+
+      float big[3];
+      getLattice(position, perlinOffset, perlinScale, big);
+
+      // Calculate the bounds and their gradients
+      for (UInt corner = 0; corner < CORNER_COUNT; ++corner)
+      {
+        getCorner(big, corner, perlinOffset, perlinScale, section.corners[corner]);
+        getGradient(space, baseRNG, section.corners[corner], section.gradients[corner]);
+      }
+
+      return section;
+    }
+
+    // Returns the value for perlin noise from the corner gradients of a section
+    inline float perlinNoise(const float gradients[CORNER_COUNT][3], const float uvw[3])
+    {
+      // Change from a linear scale
+      float u = fade(uvw[0]);
+      float v = fade(uvw[1]);
+      float w = fade(uvw[2]);
+
+      float x0 = uvw[0], x1 = uvw[0] - 1.f;
+      float y0 = uvw[1], y1 = uvw[1] - 1.f;
+      float z0 = uvw[2], z1 = uvw[2] - 1.f;
+
+      // Back quad
+      float back;
+      {
+        float bottom = lerp(dot(gradients[BBL], x0, y0, z0), dot(gradients[BBR], x1, y0, z0), u);
+        float top = lerp(dot(gradients[BTL], x0, y1, z0), dot(gradients[BTR], x1, y1, z0), u);
+        back = lerp(bottom, top, v);
+      }
+
+      // Front quad
+      float front;
+      {
+        float bottom = lerp(dot(gradients[FBL], x0, y0, z1), dot(gradients[FBR], x1, y0, z1), u);
+        float top = lerp(dot(gradients[FTL], x0, y1, z1), dot(gradients[FTR], x1, y1, z1), u);
+        front = lerp(bottom, top, v);
+      }
+
+      // Blend between back and front
+      return lerp(back, front, w);
+    }
+
+    inline float perlinNoise(const Section3D& section, const float uvw[3])
+    {
+      return perlinNoise(section.gradients, uvw);
+    }
+  }
+}
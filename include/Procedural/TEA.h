@@ -0,0 +1,94 @@
+#pragma once
+#include "Data/Defs.h"
+
+// CPU mirror of shaders/Procedural/TEA.lib, kept bit-compatible with the HLSL version
+namespace Haboob
+{
+  class TEA
+  {
+    public:
+    static constexpr UInt STIR = 6;
+    static constexpr UInt AVALANCHE = 32;
+    static constexpr UInt SALT = 0x9e3779b9;
+
+    UInt delta; // Magic number
+    UInt sum; // Rolling value
+    UInt values[2]; // Values at play in the generator
+
+    UInt key[4]; // 128 bit key
+
+    inline void next()
+    {
+      sum += delta;
+      values[0] += ((values[1] << 4) + key[0]) ^ (values[1] + sum) ^ ((values[1] >> 5) + key[1]);
+      values[1] += ((values[0] << 4) + key[2]) ^ (values[0] + sum) ^ ((values[0] >> 5) + key[3]);
+    }
+
+    // Cause the avalanche effect to dissociate from the starting values
+    inline void associate(UInt x, UInt y)
+    {
+      values[0] = x;
+      values[1] = y;
+
+      for (UInt i = 0; i < AVALANCHE; ++i)
+      {
+        next();
+      }
+    }
+
+    // Move onto another random number
+    inline void stir()
+    {
+      for (UInt i = 0; i < STIR; ++i)
+      {
+        next();
+      }
+    }
+
+    inline void seed(UInt k0, UInt k1, UInt k2, UInt k3)
+    {
+      key[0] = k0;
+      key[1] = k1;
+      key[2] = k2;
+      key[3] = k3;
+      sum = 0;
+    }
+
+    // Returns [0, 1]
+    inline float getFloat() const
+    {
+      return float(values[0]) / float(UInt(~0));
+    }
+
+    // Returns [-1, 1]
+    inline float getNormFloat() const
+    {
+      return 2.f * getFloat() - 1.f;
+    }
+
+    // Returns a new RNG which branches off of this one
+    inline TEA branch()
+    {
+      TEA branched;
+
+      // Generate half seeds
+      UInt newSeed[4];
+      stir();
+      newSeed[0] = values[0];
+      newSeed[1] = values[1];
+      stir();
+      newSeed[2] = values[0];
+      newSeed[3] = values[1];
+
+      // Use this as a new seed!
+      branched.seed(newSeed[0], newSeed[1], newSeed[2], newSeed[3]);
+
+      // Initialise rest
+      branched.delta = delta;
+      branched.sum = sum;
+      branched.values[0] = branched.values[1] = 0;
+
+      return branched;
+    }
+  };
+}
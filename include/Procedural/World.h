@@ -0,0 +1,66 @@
+#pragma once
+#include "Data/Defs.h"
+
+#include <cmath>
+
+// CPU mirror of shaders/Procedural/World.lib
+namespace Haboob
+{
+  class WorldSpace
+  {
+    public:
+    float worldMax[3]; // World is between origin and this point
+    float epsilon; // Float representing the smallest fractional unit
+    UInt fractionBits; // Number of bits dedicated to representing a fraction in the range [0, 1]
+
+    // fmod as lowered by the HLSL compiler (frac(|x / y|) * sign), rather than the exact std::fmod
+    static inline float fmodHLSL(float x, float y)
+    {
+      float quotient = x / y;
+      float fraction = std::fabs(quotient);
+      fraction = fraction - std::floor(fraction);
+      return fraction * (quotient >= -quotient ? std::fabs(y) : -std::fabs(y));
+    }
+
+    // Loop a value into [0, max] range
+    static inline float toRange(float value, float max)
+    {
+      if (value < 0)
+      {
+        return max - fmodHLSL(-value, max); // Fold over and loop in -ve direction
+      }
+
+      return fmodHLSL(value, max); // Loop in +ve direction
+    }
+
+    // Convert a +ve value into referenceable space
+    inline UInt packValue(float value) const
+    {
+      float big = std::trunc(value);
+      float fraction = value - big; // Fetch fraction value and major value
+      UInt smallComponent = UInt(std::trunc(fraction / epsilon)); // How many epsilon fit into the fraction
+
+      return (UInt(big) << fractionBits) | smallComponent;
+    }
+
+    // Brings an arbitrary point into the world and packs it into a referenceable coordinate
+    inline void getPoint(float x, float y, float z, UInt packed[2]) const
+    {
+      // Bring into world coordinates
+      x = toRange(x, worldMax[0]);
+      y = toRange(y, worldMax[1]);
+      z = toRange(z, worldMax[2]);
+
+      // Now pack
+      packed[0] = (packValue(x) & 0xFFFF) | (packValue(y) << 16);
+      packed[1] = packValue(z);
+    }
+  };
+
+  // Converts a value in unit space into a big component representing 'left' and a small component [0, 1] of distance right
+  inline void spatialize(float value, float& bigVal, float& smallVal)
+  {
+    bigVal = std::floor(value); // Always rounds in the -ve direction
+    smallVal = value - bigVal; // Left -> right = right - left
+  }
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "Procedural/Perlin.h"
+
+#include <vector>
+
+// CPU mirror of the 3D path in shaders/Procedural/fBM.lib
+namespace Haboob
+{
+  // Per octave state, independent of the sampled position
+  struct fBMOctave
+  {
+    TEA rng; // Generator branched for this octave
+    float scale[3]; // Absolute scale of this octave
+    float coefficient; // 1 for significant octaves, the remainder for the final octave
+    float weight; // Weight of this frequency
+  };
+
+  // Fractional brownian motion, a fractal-like application of perlin noise
+  class fBM
+  {
+    public:
+    float fracIncr; // Fractal increment
+    float fracGap; // Fractal gap
+    float octaves; // Number of frequencies/applications of perlin noise
+
+    // Returns the maximum possible value of this fBM (assuming each perlin octave returns 1)
+    inline float maxValue() const
+    {
+      float max = 0;
+
+      UInt cOctaves = UInt(std::trunc(octaves)); // Count of non-remainder octaves
+      for (UInt i = 0; i < cOctaves; ++i)
+      {
+        max += std::pow(std::pow(fracGap, float(i)), -fracIncr);
+      }
+
+      // Now add one final octave weight, scaled for the remainder
+      max += std::pow(std::pow(fracGap, float(cOctaves)), -fracIncr) * (octaves - float(cOctaves));
+
+      return max;
+    }
+
+    // Branches every octave generator from the base in the same order as the shader
+    // Nothing here depends on the sampled position so a whole volume can share one plan
+    inline void planOctaves(TEA& baseRNG, const float absoluteScale[3], std::vector<fBMOctave>& plan) const
+    {
+      plan.clear();
+
+      float scale[3] = { absoluteScale[0], absoluteScale[1], absoluteScale[2] };
+      UInt cOctaves = UInt(std::trunc(octaves)); // Count of non-remainder octaves
+      for (UInt i = 0; i <= cOctaves; ++i)
+      {
+        fBMOctave octave;
+        octave.rng = baseRNG.branch();
+        octave.scale[0] = scale[0];
+        octave.scale[1] = scale[1];
+        octave.scale[2] = scale[2];
+        octave.coefficient = i < cOctaves ? 1.f : octaves - float(cOctaves);
+
+        // Calculate the frequency and in turn the weight coefficient
+        float frequency = std::pow(fracGap, float(i));
+        octave.weight = std::pow(frequency, -fracIncr);
+
+        // A zero remainder contributes nothing (the generator is still branched to keep the sequence)
+        if (octave.coefficient != .0f)
+        {
+          plan.push_back(octave);
+        }
+
+        // Shift the scale for the next octave
+        scale[0] /= fracGap;
+        scale[1] /= fracGap;
+        scale[2] /= fracGap;
+      }
+    }
+
+    // Evaluates a planned fBM at a position
+    static inline float fBMNoise(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space, const float position[3], const float absoluteOffset[3])
+    {
+      float value = 0;
+
+      for (UInt i = 0; i < octaveCount; ++i)
+      {
+        const fBMOctave& octave = octaves[i];
+
+        // Get the section of this octave of perlin noise
+        float uvw[3] = { position[0], position[1], position[2] };
+        Perlin::Section3D section = Perlin::getSection(space, octave.rng, uvw, absoluteOffset, octave.scale);
+
+        // Add the weighted value of this octave of noise to the total
+        value += octave.coefficient * Perlin::perlinNoise(section, uvw) * octave.weight;
+      }
+
+      return value;
+    }
+
+    static inline float fBMNoise(const std::vector<fBMOctave>& plan, const WorldSpace& space, const float position[3], const float absoluteOffset[3])
+    {
+      return fBMNoise(plan.data(), UInt(plan.size()), space, position, absoluteOffset);
+    }
+
+    inline float fBMNoise(const WorldSpace& space, TEA& baseRNG, const float position[3], const float absoluteOffset[3], const float absoluteScale[3]) const
+    {
+      std::vector<fBMOctave> plan;
+      planOctaves(baseRNG, absoluteScale, plan);
+      return fBMNoise(plan, space, position, absoluteOffset);
+    }
+  };
+}
@@ -16,8 +16,7 @@
 using Microsoft::WRL::ComPtr;
 
 // Maths/data
-#include <directxmath.h>
-using namespace DirectX;
+#include "Data/MathCore.h"
 
 // Useful utils
 #define DEBUGFLAG (DEBUG || _DEBUG)
@@ -0,0 +1,598 @@
+#pragma once
+#include "Rendering/Raymarch/MarchKernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Width-agnostic body of the vector march kernels, mirroring the scalar kernel in MarchKernels.cpp
+// Only included by the per instruction set sources, which provide a lane type L (Float, Int, Mask and operations)
+// Everything here has internal linkage so no copy built for a wider instruction set leaks into other objects
+namespace Haboob
+{
+  namespace MarchKernels
+  {
+    namespace
+    {
+      template<typename L> struct Packet
+      {
+        typedef typename L::Float Float;
+        typedef typename L::Int Int;
+        typedef typename L::Mask Mask;
+
+        // Simpson buckets of one term, the count is shared by every lane
+        struct Integrator
+        {
+          Float lastTerm;
+          Float termBuckets[2];
+
+          inline Integrator() : lastTerm{ L::set(.0f) }, termBuckets{ L::set(.0f), L::set(.0f) } {}
+
+          inline void append(Float value, UInt count)
+          {
+            lastTerm = value;
+            termBuckets[count & 0x01] = L::add(termBuckets[count & 0x01], value);
+          }
+
+          // count being the number of appends, the first term is never set as in the shader
+          inline Float integrate(Float range, UInt count) const
+          {
+            Float stepSize = L::div(range, L::set(float(count)));
+            Float result = lastTerm;
+            result = L::add(result, L::mul(L::set(4.f), termBuckets[1])); // Odds
+            result = L::add(result, L::mul(L::set(2.f), L::sub(termBuckets[0], lastTerm))); // Evens
+            return L::div(L::mul(result, stepSize), L::set(3.f));
+          }
+        };
+
+        // Sums of one term, each sample standing for its whole step (progressive frames, as RectangleIntegrator)
+        struct RectangleIntegrator
+        {
+          Float total;
+
+          inline RectangleIntegrator() : total{ L::set(.0f) } {}
+
+          inline void append(Float value, UInt) { total = L::add(total, value); }
+          inline Float integrate(Float range, UInt count) const { return L::div(L::mul(total, range), L::set(float(count))); }
+        };
+
+        // 2^n for integral n within the normal range
+        static inline Float scale(Float n)
+        {
+          return L::asFloat(L::template shiftLeft<23>(L::addInt(L::toInt(n), L::setInt(127))));
+        }
+
+        // Cephes exp2f, ~2 ulp over the normal range
+        static inline Float exp2(Float x)
+        {
+          x = L::min(L::max(x, L::set(-126.f)), L::set(126.f));
+          Float whole = L::floor(L::add(x, L::set(.5f)));
+          Float f = L::sub(x, whole);
+
+          Float p = L::set(1.535336188319500e-4f);
+          p = L::add(L::mul(p, f), L::set(1.339887440266574e-3f));
+          p = L::add(L::mul(p, f), L::set(9.618437357674640e-3f));
+          p = L::add(L::mul(p, f), L::set(5.550332471162809e-2f));
+          p = L::add(L::mul(p, f), L::set(2.402264791363012e-1f));
+          p = L::add(L::mul(p, f), L::set(6.931472028550421e-1f));
+          p = L::add(L::mul(p, f), L::set(1.f));
+          return L::mul(p, scale(whole));
+        }
+
+        // Cephes expf, the reduction by ln(2) split in two to stay exact
+        static inline Float exp(Float x)
+        {
+          x = L::min(L::max(x, L::set(-87.3f)), L::set(88.3f));
+          Float whole = L::floor(L::add(L::mul(x, L::set(1.44269504088896341f)), L::set(.5f)));
+          x = L::sub(x, L::mul(whole, L::set(.693359375f)));
+          x = L::sub(x, L::mul(whole, L::set(-2.12194440e-4f)));
+
+          Float p = L::set(1.9875691500e-4f);
+          p = L::add(L::mul(p, x), L::set(1.3981999507e-3f));
+          p = L::add(L::mul(p, x), L::set(8.3334519073e-3f));
+          p = L::add(L::mul(p, x), L::set(4.1665795894e-2f));
+          p = L::add(L::mul(p, x), L::set(1.6666665459e-1f));
+          p = L::add(L::mul(p, x), L::set(5.0000001201e-1f));
+          p = L::add(L::add(L::mul(p, L::mul(x, x)), x), L::set(1.f));
+          return L::mul(p, scale(whole));
+        }
+
+        // Cephes log2f for normal positive values, anything else is -FLT_MAX (as a cone level that clamps to 0)
+        static inline Float log2(Float x)
+        {
+          Int bits = L::asInt(x);
+          Float exponent = L::toFloat(L::addInt(L::template shiftRight<23>(bits), L::setInt(UInt(-126))));
+          Float m = L::asFloat(L::orInt(L::andInt(bits, L::setInt(0x007FFFFFU)), L::setInt(0x3F000000U))); // [.5, 1)
+
+          // Centre the mantissa on 1
+          Mask low = L::lessThan(m, L::set(.707106781186547524f));
+          exponent = L::select(low, L::sub(exponent, L::set(1.f)), exponent);
+          m = L::sub(L::select(low, L::add(m, m), m), L::set(1.f));
+
+          Float z = L::mul(m, m);
+          Float p = L::set(7.0376836292e-2f);
+          p = L::add(L::mul(p, m), L::set(-1.1514610310e-1f));
+          p = L::add(L::mul(p, m), L::set(1.1676998740e-1f));
+          p = L::add(L::mul(p, m), L::set(-1.2420140846e-1f));
+          p = L::add(L::mul(p, m), L::set(1.4249322787e-1f));
+          p = L::add(L::mul(p, m), L::set(-1.6668057665e-1f));
+          p = L::add(L::mul(p, m), L::set(2.0000714765e-1f));
+          p = L::add(L::mul(p, m), L::set(-2.4999993993e-1f));
+          p = L::add(L::mul(p, m), L::set(3.3333331174e-1f));
+          Float y = L::sub(L::mul(L::mul(p, m), z), L::mul(L::set(.5f), z));
+
+          // log2(e) - 1 folds the conversion from ln into the sum
+          const Float log2eMinusOne = L::set(.44269504088896340736f);
+          Float result = L::add(L::add(L::add(L::add(L::mul(y, log2eMinusOne), L::mul(m, log2eMinusOne)), y), m), exponent);
+          return L::select(L::lessThan(L::set(FLT_MIN), x), result, L::set(-FLT_MAX));
+        }
+
+        static inline Float blTransmission(Float opticalDepth, bool applyBeer)
+        {
+          return applyBeer ? exp(L::sub(L::set(.0f), opticalDepth)) : L::div(L::set(1.f), L::add(L::set(1.f), opticalDepth));
+        }
+
+        static inline Float bpTransmission(Float opticalDepth, const Constants& constants)
+        {
+          return L::sub(blTransmission(opticalDepth, constants.applyBeer), blTransmission(L::mul(L::set(constants.powderCoefficient), opticalDepth), constants.applyBeer));
+        }
+
+        // mul(float4(position, 1), localTransform)
+        static inline void toLocal(const Constants& constants, const Float position[3], Float local[4])
+        {
+          const XMFLOAT4X4& matrix = constants.localTransform;
+          for (int column = 0; column < 4; ++column)
+          {
+            Float sum = L::add(L::mul(position[0], L::set(matrix.m[0][column])), L::mul(position[1], L::set(matrix.m[1][column])));
+            local[column] = L::add(L::add(sum, L::mul(position[2], L::set(matrix.m[2][column]))), L::set(matrix.m[3][column]));
+          }
+        }
+
+        // One level per lane with trilinear filtering and a zero border, as (density, angstrom exponent)
+        static void sampleLevel(const VolumeLevels& levels, Int level, const Float uvw[3], Float result[2])
+        {
+          Int sizeIndex = L::mulInt(level, L::setInt(3));
+          Float size[3], texel[3];
+          for (int axis = 0; axis < 3; ++axis)
+          {
+            size[axis] = L::gather(&levels.floatSizes[0][0], L::addInt(sizeIndex, L::setInt(UInt(axis))));
+            texel[axis] = L::sub(L::mul(uvw[axis], size[axis]), L::set(.5f));
+          }
+
+          // Entirely border (also catches NaNs)
+          Mask inside = L::maskAnd(L::lessThan(L::set(-1.f), texel[0]), L::lessThan(texel[0], size[0]));
+          for (int axis = 1; axis < 3; ++axis)
+          {
+            inside = L::maskAnd(inside, L::maskAnd(L::lessThan(L::set(-1.f), texel[axis]), L::lessThan(texel[axis], size[axis])));
+          }
+
+          result[0] = result[1] = L::set(.0f);
+          if (!L::any(inside)) { return; }
+
+          // Corners off the level are weighted 0 and read from its first texel
+          Int corner[3][2];
+          Float weight[3][2];
+          for (int axis = 0; axis < 3; ++axis)
+          {
+            Float position = L::select(inside, texel[axis], L::set(.0f));
+            Float floor = L::floor(position);
+            Float fraction = L::sub(position, floor);
+
+            Mask lowValid = L::lessEqual(L::set(.0f), floor);
+            Mask highValid = L::lessThan(L::add(floor, L::set(1.f)), size[axis]);
+            Int low = L::toInt(floor);
+            corner[axis][0] = L::selectInt(lowValid, low, L::setInt(0));
+            corner[axis][1] = L::selectInt(highValid, L::addInt(low, L::setInt(1)), L::setInt(0));
+            weight[axis][0] = L::select(lowValid, L::sub(L::set(1.f), fraction), L::set(.0f));
+            weight[axis][1] = L::select(highValid, fraction, L::set(.0f));
+          }
+
+          // VolumeLevels::texelIndex, per axis terms first
+          Int offset = L::gatherInt(levels.offsets, level);
+          Int strideX = L::gatherInt(&levels.strides[0][0], L::template shiftLeft<1>(level));
+          Int strideY = L::gatherInt(&levels.strides[0][0], L::addInt(L::template shiftLeft<1>(level), L::setInt(1)));
+          bool tiled = levels.layout == VolumeLevels::LAYOUT_TILED;
+          Int morton[3][2];
+          for (int axis = 0; axis < 3; ++axis)
+          {
+            for (int c = 0; c < 2; ++c)
+            {
+              if (!tiled) { morton[axis][c] = L::setInt(0); continue; }
+
+              Int local = L::andInt(corner[axis][c], L::setInt(7));
+              Int spread = L::orInt(L::andInt(local, L::setInt(1)), L::orInt(L::template shiftLeft<2>(L::andInt(local, L::setInt(2))), L::template shiftLeft<4>(L::andInt(local, L::setInt(4)))));
+              morton[axis][c] = axis == 0 ? spread : axis == 1 ? L::template shiftLeft<1>(spread) : L::template shiftLeft<2>(spread);
+              corner[axis][c] = L::template shiftRight<3>(corner[axis][c]); // To the tile
+            }
+          }
+
+          for (int i = 0; i < 8; ++i)
+          {
+            int cx = i & 1, cy = (i >> 1) & 1, cz = i >> 2;
+            Float cornerWeight = L::mul(L::mul(weight[0][cx], weight[1][cy]), weight[2][cz]);
+            Int index = L::addInt(L::mulInt(corner[2][cz], strideY), corner[1][cy]);
+            index = L::addInt(L::mulInt(index, strideX), corner[0][cx]);
+            if (tiled)
+            {
+              index = L::orInt(L::template shiftLeft<9>(index), L::orInt(morton[0][cx], L::orInt(morton[1][cy], morton[2][cz])));
+            }
+            index = L::template shiftLeft<1>(L::addInt(offset, index));
+
+            result[0] = L::add(result[0], L::mul(cornerWeight, L::gather(levels.texels.data(), index)));
+            result[1] = L::add(result[1], L::mul(cornerWeight, L::gather(levels.texels.data() + 1, index)));
+          }
+
+          result[0] = L::select(inside, result[0], L::set(.0f));
+          result[1] = L::select(inside, result[1], L::set(.0f));
+        }
+
+        // haboobCubeDensitySample, level being the unclamped mip per lane (or nullptr for the full resolution)
+        static void sample(const Constants& constants, const Float position[3], const Float* level, Float result[2])
+        {
+          const VolumeLevels& levels = *constants.levels;
+          Float local[4];
+          toLocal(constants, position, local);
+          Float uvw[3];
+          for (int axis = 0; axis < 3; ++axis) { uvw[axis] = L::add(L::div(local[axis], local[3]), L::set(.5f)); }
+
+          if (!level)
+          {
+            sampleLevel(levels, L::setInt(0), uvw, result);
+            return;
+          }
+
+          // Clamped to the chain, blending toward the next level where there is one
+          Float lastLevel = L::set(float(levels.levelCount - 1));
+          Float clamped = L::select(L::lessThan(L::set(.0f), *level), *level, L::set(.0f));
+          clamped = L::min(clamped, lastLevel);
+          Float base = L::floor(clamped);
+          Float blend = L::sub(clamped, base);
+
+          sampleLevel(levels, L::toInt(base), uvw, result);
+
+          Mask blended = L::maskAnd(L::lessThan(L::set(.0f), blend), L::lessThan(base, lastLevel));
+          if (!L::any(blended)) { return; }
+
+          Float next[2];
+          sampleLevel(levels, L::toInt(L::min(L::add(base, L::set(1.f)), lastLevel)), uvw, next);
+          blend = L::select(blended, blend, L::set(.0f));
+          result[0] = L::add(result[0], L::mul(L::sub(next[0], result[0]), blend));
+          result[1] = L::add(result[1], L::mul(L::sub(next[1], result[1]), blend));
+        }
+
+        static inline void march(Float position[3], const Float direction[3], Float& travelDistance, Float stepSize)
+        {
+          for (int i = 0; i < 3; ++i) { position[i] = L::add(position[i], L::mul(direction[i], stepSize)); }
+          travelDistance = L::add(travelDistance, stepSize);
+        }
+
+        // What BeerShadowMarchVolume.cs integrates, the light direction being shared by every lane
+        static void marchLight(const Constants& constants, const Float position[3], Float& opticalDepth, Float& angstrom)
+        {
+          float toLight[3] = { -constants.lightDirection[0], -constants.lightDirection[1], -constants.lightDirection[2] };
+          const XMFLOAT4X4& matrix = constants.localTransform;
+
+          Float localOrigin[4];
+          toLocal(constants, position, localOrigin);
+
+          Float entry = L::set(.0f), exit = L::set(FLT_MAX);
+          Mask hit = L::lessThan(entry, exit);
+          for (int axis = 0; axis < 3; ++axis)
+          {
+            float localDirection = toLight[0] * matrix.m[0][axis] + toLight[1] * matrix.m[1][axis] + toLight[2] * matrix.m[2][axis] + .0f * matrix.m[3][axis];
+            if (localDirection == .0f)
+            {
+              hit = L::maskAnd(hit, L::lessEqual(L::abs(localOrigin[axis]), L::set(.5f)));
+              continue;
+            }
+
+            Float inverse = L::set(1.f / localDirection);
+            Float near = L::mul(L::sub(L::set(-.5f), localOrigin[axis]), inverse);
+            Float far = L::mul(L::sub(L::set(.5f), localOrigin[axis]), inverse);
+            entry = L::max(L::min(far, near), entry);
+            exit = L::min(L::max(far, near), exit);
+          }
+
+          hit = L::maskAnd(hit, L::lessThan(entry, exit));
+          opticalDepth = angstrom = L::set(.0f);
+          if (!L::any(hit)) { return; }
+
+          // Missed lanes march nowhere
+          entry = L::select(hit, entry, L::set(.0f));
+          Float stepSize = L::select(hit, L::div(L::sub(exit, entry), L::set(float(constants.lightIterations))), L::set(.0f));
+          Float direction[3] = { L::set(toLight[0]), L::set(toLight[1]), L::set(toLight[2]) };
+          Float lightPosition[3] = { position[0], position[1], position[2] };
+          Float travelDistance = L::set(.0f);
+          march(lightPosition, direction, travelDistance, entry);
+          travelDistance = L::set(.0f);
+
+          Integrator absorptionInte, angstromInte;
+          for (UInt i = 0; i < constants.lightIterations; ++i)
+          {
+            Float haboobSample[2];
+            sample(constants, lightPosition, nullptr, haboobSample);
+            absorptionInte.append(haboobSample[0], i);
+            angstromInte.append(haboobSample[1], i);
+            march(lightPosition, direction, travelDistance, stepSize);
+          }
+
+          opticalDepth = L::select(hit, L::mul(L::set(constants.attenuationFactor), absorptionInte.integrate(travelDistance, constants.lightIterations)), opticalDepth);
+          angstrom = L::select(hit, L::mul(L::set(constants.scatterAngstromExponent), angstromInte.integrate(travelDistance, constants.lightIterations)), angstrom);
+        }
+
+        // SpectralOptics::TransmissionLUT::lookup of every lane, gathering the corners of each lane's cell
+        static inline void lookupTransmissions(const SpectralOptics::TransmissionLUT& lut, Float opticalDepth, Float angstrom, Float result[16])
+        {
+          typedef SpectralOptics::TransmissionLUT LUT;
+          const Float zero = L::set(.0f), one = L::set(1.f);
+          Float below = L::max(L::min(L::mul(opticalDepth, L::set(std::exp2(-LUT::MIN_LOG_DEPTH))), one), zero);
+
+          // log2 is -FLT_MAX at 0, which clamps to the first column
+          Float u = L::div(L::sub(log2(opticalDepth), L::set(LUT::MIN_LOG_DEPTH)), L::set(LUT::MAX_LOG_DEPTH - LUT::MIN_LOG_DEPTH));
+          u = L::mul(L::min(L::max(u, zero), one), L::set(float(LUT::DEPTH_SIZE - 1)));
+          Float v = L::mul(L::min(L::max(L::div(angstrom, L::set(lut.maxAngstrom)), zero), one), L::set(float(LUT::ANGSTROM_SIZE - 1)));
+          Float x = L::min(L::floor(u), L::set(float(LUT::DEPTH_SIZE - 2)));
+          Float y = L::min(L::floor(v), L::set(float(LUT::ANGSTROM_SIZE - 2)));
+          Float fu = L::sub(u, x), fv = L::sub(v, y);
+          Int index = L::toInt(L::mul(L::add(x, L::mul(y, L::set(float(LUT::DEPTH_SIZE)))), L::set(16.f)));
+
+          const float* t00 = lut.texels.data();
+          const float* t10 = t00 + 16;
+          const float* t01 = t00 + LUT::DEPTH_SIZE * 16;
+          const float* t11 = t01 + 16;
+          for (int i = 0; i < 16; ++i)
+          {
+            Float corner00 = L::gather(t00 + i, index), corner10 = L::gather(t10 + i, index);
+            Float corner01 = L::gather(t01 + i, index), corner11 = L::gather(t11 + i, index);
+            Float lower = L::add(corner00, L::mul(L::sub(corner10, corner00), fu));
+            Float upper = L::add(corner01, L::mul(L::sub(corner11, corner01), fu));
+            result[i] = L::mul(L::add(lower, L::mul(L::sub(upper, lower), fv)), below);
+          }
+        }
+
+        // Intensity as a function of optical thickness, summed over wavelengths (APPLY_SPECTRAL) or not
+        static void irradianceSample(const Constants& constants, const Float directIrradiance[4], Float opticalDepth, Float angstrom,
+          Float scatterOpticalDepth, Float scatterAngstrom, Float result[4])
+        {
+          bool constantScatter = constants.lightIterations == 0;
+          if (!constants.applySpectral)
+          {
+            Float scatterTransmission = constantScatter ? L::set(constants.scatterTransmission) : bpTransmission(scatterOpticalDepth, constants);
+            Float transmission = L::mul(bpTransmission(opticalDepth, constants), scatterTransmission);
+            for (int i = 0; i < 4; ++i) { result[i] = L::mul(transmission, directIrradiance[i]); }
+            return;
+          }
+
+          // Transmission per wavelength, row major as the spectral matrices
+          Float transmissions[16], scatterTransmissions[16];
+          if (constants.transmissionLUT)
+          {
+            lookupTransmissions(*constants.transmissionLUT, opticalDepth, angstrom, transmissions);
+            if (!constantScatter) { lookupTransmissions(*constants.transmissionLUT, scatterOpticalDepth, scatterAngstrom, scatterTransmissions); }
+          }
+          else
+          {
+            Float negativeAngstrom = L::sub(L::set(.0f), angstrom);
+            Float negativeScatterAngstrom = L::sub(L::set(.0f), scatterAngstrom);
+            for (int i = 0; i < 16; ++i)
+            {
+              Float logWavelength = L::set(constants.logWavelengths[i / 4][i % 4]);
+              if (!constantScatter) { scatterTransmissions[i] = bpTransmission(L::mul(scatterOpticalDepth, exp2(L::mul(negativeScatterAngstrom, logWavelength))), constants); }
+              transmissions[i] = bpTransmission(L::mul(opticalDepth, exp2(L::mul(negativeAngstrom, logWavelength))), constants);
+            }
+          }
+
+          for (int row = 0; row < 4; ++row)
+          {
+            Float total = L::set(.0f);
+            for (int column = 0; column < 4; ++column)
+            {
+              int i = row * 4 + column;
+              Float scatterTransmission = constantScatter ? L::set(constants.spectralScatterTransmissions[row][column]) : scatterTransmissions[i];
+              Float transmission = L::mul(transmissions[i], scatterTransmission);
+              total = L::add(total, L::mul(L::mul(directIrradiance[row], transmission), L::set(constants.spectralWeights[row][column])));
+            }
+            result[row] = total;
+          }
+        }
+
+        // Marches up to WIDTH rays, writing (irradiance, background transmission) per lane
+        // rays (one per lane) place each sample along their spans when skipping empty space, as marchRay
+        template<typename RayIntegrator> static void marchRays(const Constants& constants, Float position[3], const Float direction[3], Float travelDistance, Float marchZStep,
+          const Float directIrradiance[4], const Ray* rays, Float result[4])
+        {
+          constexpr UInt W = L::WIDTH;
+          alignas(64) float lanePosition[3][W], laneConeTravel[W], laneRange[W], laneGap[W], laneGapAngstrom[W];
+          float laneOccupied[W] = {}, laneSpanStart[W] = {}, laneSkipped[W] = {};
+          UInt laneSpan[W] = {};
+          Float lastIrradiance[4] = { L::set(.0f), L::set(.0f), L::set(.0f), L::set(.0f) };
+          Float gapIrradiance[4] = { L::set(.0f), L::set(.0f), L::set(.0f), L::set(.0f) };
+          Float lastScatterOpticalDepth = L::set(.0f), lastScatterAngstrom = L::set(.0f);
+
+          RayIntegrator absorptionInte, angstromInte;
+          RayIntegrator irradianceInte[4];
+          for (UInt i = 0; i < constants.iterations; ++i)
+          {
+            // Walks are per lane, as each has its own spans
+            Float coneTravel = travelDistance, range = travelDistance;
+            Float gap = L::set(.0f), gapAngstrom = L::set(.0f);
+            if (rays)
+            {
+              for (UInt lane = 0; lane < W; ++lane)
+              {
+                const Ray& ray = rays[lane];
+                float travel = travelAt(ray, laneSpan[lane], laneSpanStart[lane], laneOccupied[lane]);
+                for (int axis = 0; axis < 3; ++axis) { lanePosition[axis][lane] = ray.position[axis] + ray.direction[axis] * travel; }
+                laneConeTravel[lane] = ray.travelDistance + travel;
+                laneRange[lane] = ray.spanCount ? skipRange(float(i + 1), ray.marchZStep, ray.travelLength / float(constants.iterations), ray.travelDistance + travel, travel) : .0f;
+                laneGap[lane] = travel - laneOccupied[lane] - laneSkipped[lane];
+                laneGapAngstrom[lane] = ray.spanAngstroms[laneSpan[lane]];
+                laneSkipped[lane] += laneGap[lane];
+                laneOccupied[lane] += ray.marchZStep;
+              }
+              for (int axis = 0; axis < 3; ++axis) { position[axis] = L::load(lanePosition[axis]); }
+              coneTravel = L::load(laneConeTravel);
+              range = L::load(laneRange);
+              gap = L::load(laneGap);
+              gapAngstrom = L::load(laneGapAngstrom);
+            }
+
+            // Accumulate absorption from density
+            Float haboobSample[2];
+            if (constants.applyConeTrace)
+            {
+              Float radius = L::add(L::set(constants.pixelRadius), L::mul(L::set(constants.pixelRadiusDelta), coneTravel));
+              Float coneLevel = log2(L::mul(radius, L::set(constants.worldToTexels)));
+              sample(constants, position, &coneLevel, haboobSample);
+            }
+            else { sample(constants, position, nullptr, haboobSample); }
+            absorptionInte.append(haboobSample[0], i);
+            angstromInte.append(haboobSample[1], i);
+
+            // Integrate the direct optical depth + angstrom along the ray
+            Float referenceOpticalDepth = L::mul(L::set(constants.attenuationFactor), absorptionInte.integrate(range, i + 1));
+            Float referenceAngstrom = angstromInte.integrate(range, i + 1);
+            if (rays) { referenceAngstrom = L::add(referenceAngstrom, gapAngstrom); }
+            referenceAngstrom = L::mul(L::set(constants.absorptionAngstromExponent), referenceAngstrom);
+
+            // Along the incoming light ray
+            Float referenceScatterOpticalDepth = L::set(.0f), referenceScatterAngstrom = L::set(.0f);
+            if (constants.lightIterations > 0)
+            {
+              marchLight(constants, position, referenceScatterOpticalDepth, referenceScatterAngstrom);
+            }
+
+            Float irradiance[4];
+            irradianceSample(constants, directIrradiance, referenceOpticalDepth, referenceAngstrom, referenceScatterOpticalDepth, referenceScatterAngstrom, irradiance);
+            for (int channel = 0; channel < 4; ++channel)
+            {
+              irradianceInte[channel].append(irradiance[channel], i);
+              if (rays) { gapIrradiance[channel] = L::add(gapIrradiance[channel], L::mul(L::mul(gap, L::set(.5f)), L::add(lastIrradiance[channel], irradiance[channel]))); }
+              lastIrradiance[channel] = irradiance[channel];
+            }
+            lastScatterOpticalDepth = referenceScatterOpticalDepth;
+            lastScatterAngstrom = referenceScatterAngstrom;
+
+            march(position, direction, travelDistance, marchZStep);
+          }
+
+          // Background transmission, assume uniform behaviour across wavelengths (use Beer-Lambert over powder)
+          UInt count = constants.iterations;
+          Float range = travelDistance;
+          if (rays)
+          {
+            for (UInt lane = 0; lane < W; ++lane)
+            {
+              const Ray& ray = rays[lane];
+              float fullStep = ray.travelLength / float(count);
+              laneRange[lane] = ray.spanCount ? skipRange(float(count), ray.marchZStep, fullStep, ray.travelDistance + ray.travelLength, ray.travelLength - fullStep) : .0f;
+            }
+            range = L::load(laneRange);
+          }
+          Float finalOpticalDepth = L::mul(L::set(constants.attenuationFactor), absorptionInte.integrate(range, count));
+          result[3] = blTransmission(finalOpticalDepth, constants.applyBeer);
+
+          // CIE X1_Y_Z_X2 to RGB
+          Float xyzx[4];
+          for (int channel = 0; channel < 4; ++channel) { xyzx[channel] = irradianceInte[channel].integrate(range, count); }
+          if (rays)
+          {
+            // Through to where each ray would have ended
+            for (UInt lane = 0; lane < W; ++lane)
+            {
+              laneGap[lane] = std::max(rays[lane].travelLength - laneOccupied[lane] - laneSkipped[lane], .0f);
+              laneGapAngstrom[lane] = rays[lane].skippedAngstrom;
+            }
+            Float gap = L::mul(L::load(laneGap), L::set(.5f));
+            Float finalAngstrom = L::mul(L::set(constants.absorptionAngstromExponent), L::add(angstromInte.integrate(range, count), L::load(laneGapAngstrom)));
+            Float finalIrradiance[4];
+            irradianceSample(constants, directIrradiance, finalOpticalDepth, finalAngstrom, lastScatterOpticalDepth, lastScatterAngstrom, finalIrradiance);
+            for (int channel = 0; channel < 4; ++channel)
+            {
+              xyzx[channel] = L::add(xyzx[channel], L::add(gapIrradiance[channel], L::mul(gap, L::add(lastIrradiance[channel], finalIrradiance[channel]))));
+            }
+          }
+          if (constants.applySpectral)
+          {
+            for (int row = 0; row < 3; ++row)
+            {
+              const float* toRGB = constants.spectralToRGB[row];
+              Float rgb = L::mul(L::set(toRGB[0]), xyzx[0]);
+              for (int column = 1; column < 4; ++column) { rgb = L::add(rgb, L::mul(L::set(toRGB[column]), xyzx[column])); }
+              result[row] = rgb;
+            }
+            return;
+          }
+
+          result[0] = L::add(xyzx[0], xyzx[3]);
+          result[1] = xyzx[1];
+          result[2] = xyzx[2];
+        }
+      };
+
+      template<typename L> void marchRowLanes(const Constants& constants, UInt x, UInt y, UInt count, XMFLOAT4* out)
+      {
+        constexpr UInt W = L::WIDTH;
+        typedef typename L::Float Float;
+        if (constants.marchAdaptive)
+        {
+          marchRowScalar(constants, x, y, count, out);
+          return;
+        }
+
+        uint64_t samples = 0;
+        for (UInt begin = 0; begin < count; begin += W)
+        {
+          // Rays are formed per lane, lanes off the row or missing the volume are masked and march nothing
+          UInt lanes = count - begin < W ? count - begin : W;
+          alignas(64) float lanePosition[3][W] = {}, laneDirection[3][W] = {}, laneIrradiance[4][W] = {};
+          alignas(64) float laneTravel[W] = {}, laneStep[W] = {};
+          Ray rays[W] = {}; // Masked lanes walk no spans
+          bool hit[W] = {};
+          bool anyHit = false;
+          for (UInt lane = 0; lane < lanes; ++lane)
+          {
+            Ray& ray = rays[lane];
+            if (!setupRay(constants, x + begin + lane, y, ray)) { continue; }
+
+            hit[lane] = anyHit = true;
+            samples += constants.iterations;
+            for (int i = 0; i < 3; ++i)
+            {
+              lanePosition[i][lane] = ray.position[i];
+              laneDirection[i][lane] = ray.direction[i];
+            }
+            for (int i = 0; i < 4; ++i) { laneIrradiance[i][lane] = ray.directIrradiance[i]; }
+            laneTravel[lane] = ray.travelDistance;
+            laneStep[lane] = ray.marchZStep;
+          }
+
+          alignas(64) float laneResult[4][W];
+          if (anyHit)
+          {
+            Float position[3], direction[3], directIrradiance[4], result[4];
+            for (int i = 0; i < 3; ++i)
+            {
+              position[i] = L::load(lanePosition[i]);
+              direction[i] = L::load(laneDirection[i]);
+            }
+            for (int i = 0; i < 4; ++i) { directIrradiance[i] = L::load(laneIrradiance[i]); }
+
+            typedef Packet<L> P;
+            const Ray* skipRays = constants.skipEmpty ? rays : nullptr;
+            if (constants.applyJitter) { P::template marchRays<typename P::RectangleIntegrator>(constants, position, direction, L::load(laneTravel), L::load(laneStep), directIrradiance, skipRays, result); }
+            else { P::template marchRays<typename P::Integrator>(constants, position, direction, L::load(laneTravel), L::load(laneStep), directIrradiance, skipRays, result); }
+            for (int i = 0; i < 4; ++i) { L::store(laneResult[i], result[i]); }
+          }
+
+          for (UInt lane = 0; lane < lanes; ++lane)
+          {
+            out[begin + lane] = hit[lane] ? XMFLOAT4{ laneResult[0][lane], laneResult[1][lane], laneResult[2][lane], laneResult[3][lane] } : XMFLOAT4{ .0f, .0f, .0f, 1.f }; // Masked
+          }
+        }
+
+        if (constants.sampleCount) { *constants.sampleCount += samples; }
+      }
+    }
+  }
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include "Data/SIMD.h"
+#include "Data/MathCore.h"
+#include "Rendering/Volume/VolumeGrid.h"
+#include "Rendering/Raymarch/SpectralOptics.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// The per-pixel body of Raymarch/MarchVolume.cs, one kernel per instruction set
+// The vector kernels march a packet of neighbouring rays of a row together, one per lane
+// They evaluate exp, exp2 and log2 with polynomials, so match the scalar kernel to ~1e-5 rather than bit for bit
+namespace Haboob
+{
+  namespace MarchKernels
+  {
+    static constexpr UInt MAX_LEVELS = 16;
+    static constexpr UInt MAX_SPANS = 16; // Occupied spans kept per ray, the last absorbs any beyond
+
+    // Every level of a volume in one allocation, so kernels can gather the texels of any level by index
+    struct VolumeLevels
+    {
+      enum Layout : Byte
+      {
+        LAYOUT_LINEAR = 0, // x fastest, as VolumeGrid and the GPU texture
+        LAYOUT_TILED // 8^3 texel tiles (4KiB) in Morton order, so an aligned 2^3 footprint is one cache line
+      };
+
+      std::vector<float> texels; // (density, angstrom exponent) pairs, level after level
+      std::vector<float> macroCells; // As VolumeMips::buildMacroCells, a value per level for each cell
+      std::vector<float> macroAngstroms; // Mean angstrom exponent of each macro cell, as mip 3 on the GPU
+      int macroCounts[3];
+      int offsets[MAX_LEVELS]; // Of each level in texels
+      int sizes[MAX_LEVELS][3];
+      int strides[MAX_LEVELS][2]; // Texels (linear) or tiles (tiled) along x and y
+      float floatSizes[MAX_LEVELS][3];
+      UInt levelCount = 0;
+      Layout layout = LAYOUT_TILED;
+
+      // Packs the full resolution volume then its mips (mips[0] being level 1), and the macro cells
+      void assign(const VolumeGrid& source, const std::vector<VolumeGrid>& mips, Layout newLayout = LAYOUT_TILED);
+
+      // Spreads 3 bits to every third bit
+      static inline size_t spreadBits(int value) { return size_t((value & 1) | ((value & 2) << 2) | ((value & 4) << 4)); }
+
+      // Of the texel within texels (in pairs)
+      inline size_t texelIndex(UInt level, int x, int y, int z) const
+      {
+        const int* stride = strides[level];
+        if (layout == LAYOUT_LINEAR) { return size_t(offsets[level]) + size_t(x) + size_t(stride[0]) * (size_t(y) + size_t(stride[1]) * size_t(z)); }
+
+        size_t tile = size_t(x >> 3) + size_t(stride[0]) * (size_t(y >> 3) + size_t(stride[1]) * size_t(z >> 3));
+        return size_t(offsets[level]) + (tile << 9) + spreadBits(x & 7) + (spreadBits(y & 7) << 1) + (spreadBits(z & 7) << 2);
+      }
+    };
+
+    // One level with trilinear filtering and a zero border (D3D11_TEXTURE_ADDRESS_BORDER), as (density, angstrom exponent)
+    void sampleLevel(const VolumeLevels& levels, UInt level, float u, float v, float w, float result[2]);
+
+    // Everything constant across the screen, prepared once per render
+    struct Constants
+    {
+      const VolumeLevels* levels;
+      UInt width; // Of the target in pixels
+      UInt height;
+
+      XMFLOAT4X4 inverseViewProjection;
+      XMFLOAT4X4 localTransform;
+
+      float lightDirection[3]; // Normalised, as LightSource uploads it
+      float lightIrradiance[4];
+      float ambientScale[4]; // Light ambient by the ambient fraction
+      float anisotropicForwardTerms[4];
+      float anisotropicBackwardTerms[4];
+      float phaseBlendWeightTerms[4];
+
+      float logWavelengths[4][4]; // log2 of each relative wavelength, pow(x, y) being exp2(y * log2(x)) on the GPU
+      float spectralWeights[4][4];
+      float spectralToRGB[4][4];
+
+      // Powder transmission of the incoming light, which is constant along every ray without a light march
+      float scatterTransmission;
+      float spectralScatterTransmissions[4][4];
+      const SpectralOptics::TransmissionLUT* transmissionLUT; // Looked up in place of the spectral transmissions when set (APPLY_TRANSMISSION_LUT)
+
+      float attenuationFactor;
+      float absorptionAngstromExponent;
+      float scatterAngstromExponent;
+      float powderCoefficient;
+
+      float pixelRadius;
+      float pixelRadiusDelta;
+      float worldToTexels; // Texels per world unit along the volume's x
+      float initialZStep;
+      float marchZStep;
+      UInt iterations;
+      UInt lightIterations; // Steps toward the light per sample, 0 for the constant optical depth
+
+      bool marchManual;
+      bool applyConeTrace;
+      bool applyBeer;
+      bool applyHG;
+      bool applySpectral;
+      bool skipEmpty; // Spend the steps only within occupied macro cells
+      float emptyDensity; // Macro cells whose max is at most this are skipped
+
+      // Steps scale with density and stop once opaque, as MarchVolumeDispatchInfo describes (marched by the scalar kernel only)
+      bool marchAdaptive;
+      float stepOpticalDepth;
+      float terminationTransmission;
+      float minStepScale;
+      float maxStepScale;
+
+      // Progressive frames start each ray up to a step further, by the blue noise tile shifted for the frame
+      // Their samples are summed as rectangles rather than by Simpson's rule, so averaged frames converge
+      bool applyJitter;
+      UInt jitterFrame;
+
+      std::atomic<uint64_t>* sampleCount; // Density samples taken, added once per row (nullptr when not counting)
+    };
+
+    // A ray from the screen, clipped to the volume and advanced by the initial step
+    struct Ray
+    {
+      float position[3];
+      float direction[3];
+      float travelDistance;
+      float marchZStep;
+      float directIrradiance[4]; // Light scattered toward the eye before transmission, constant along the ray
+
+      // Distances from position through occupied macro cells, when skipping empty space
+      // Empty space still carries an angstrom exponent, which is integrated over the gaps from the macro cells
+      float spanBegins[MAX_SPANS];
+      float spanEnds[MAX_SPANS];
+      float spanAngstroms[MAX_SPANS]; // Over the gaps before each span
+      UInt spanCount;
+      float skippedAngstrom; // Over every gap
+      float travelLength; // Covered by the steps without skipping
+    };
+
+    // Forms the ray through a pixel centre, false if it misses the volume (the pixel is masked)
+    // A jittered ray starts further along without counting the offset as travelled, so its integrals keep their range
+    // When skipping empty space, rays through no occupied macro cell are masked too and the steps cover only the spans
+    bool setupRay(const Constants& constants, UInt x, UInt y, Ray& ray);
+
+    // The distance along a ray at an occupied distance (along its spans), which must not decrease between calls
+    // span and spanStart (the occupied distance where that span begins) follow the walk, starting at 0
+    float travelAt(const Ray& ray, UInt& span, float& spanStart, float occupied);
+
+    // The range a skipping ray integrates count samples over, giving the step the shader's integrator takes at that distance without skipping
+    // Its range trails the samples by a step, so its step grows toward the full step along the ray (exactly the same without gaps)
+    float skipRange(float count, float step, float fullStep, float range, float travel);
+
+    // Marches count pixels of row y from x, writing (irradiance, background transmission) into out
+    // Adaptive marches are handed to the scalar kernel, as each ray takes its own steps
+    typedef void (*MarchRow)(const Constants& constants, UInt x, UInt y, UInt count, XMFLOAT4* out);
+
+    void marchRowScalar(const Constants& constants, UInt x, UInt y, UInt count, XMFLOAT4* out);
+    void marchRowSSE4(const Constants& constants, UInt x, UInt y, UInt count, XMFLOAT4* out);
+    void marchRowAVX2(const Constants& constants, UInt x, UInt y, UInt count, XMFLOAT4* out);
+    void marchRowAVX512(const Constants& constants, UInt x, UInt y, UInt count, XMFLOAT4* out);
+
+    // Returns the kernel for a level (which must be supported by the CPU)
+    MarchRow getMarchRow(SIMD::Level level);
+  }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Data/Defs.h"
+#include "Data/MathCore.h"
+
+namespace Haboob
+{
+  // Mirrors the cbuffer layout consumed by Raymarch/MarchVolume.cs (RaymarchCommon.lib)
+  struct MarchVolumeDispatchInfo
+  {
+    float outputHorizontalStep = 1.f; // View step per horizontal thread
+    float outputVerticalStep = 1.f; // View step per vertical thread
+    float initialZStep = 0.f; // Distance to jump in Z
+    float marchZStep = .1f; // Distance to jump in Z
+    
+    UInt iterations = 10; // Number of volume steps to take
+    float texelDensity; // The density of the volume texture in world space
+    float pixelRadius = .001f; // The radius a pixel occupies in world space
+    float pixelRadiusDelta = .245f; // The linear change of pixel radius with world depth
+
+    XMMATRIX localVolumeTransform; // Transforms from world space to volume space
+    XMFLOAT3 volumeSize; // The scale of the volume in world space
+    float volumeSizeW = 1.f;
+
+    // MARCH_ADAPTIVE, steps scale about marchZStep (as spread over the ray) within [minStepScale, maxStepScale] of it
+    float stepOpticalDepth = .25f; // Optical depth each step aims to cover at the density it leaves from
+    float terminationTransmission = .005f; // Rays stop once their background transmission falls below this
+    float minStepScale = .25f;
+    float maxStepScale = 2.f;
+
+    // APPLY_PROGRESSIVE, jittered frames blend into a running average
+    float jitterOffset = 0.f; // Shifts the blue noise tile along (0, 1) each frame
+    float accumulationWeight = 1.f; // Of this frame in the average, 1 / frames accumulated
+    float progressivePadding[2];
+  };
+
+  struct BasicOptics
+  {
+    XMFLOAT4 anisotropicForwardTerms; // Forward anisotropic parameters per major light component
+    XMFLOAT4 anisotropicBackwardTerms; // Backward anisotropic parameters per major light component
+    XMFLOAT4 phaseBlendWeightTerms; // Per component phase blend factor
+
+    float scatterAngstromExponent;
+    float absorptionAngstromExponent;
+    float attenuationFactor; // Scales optical depth
+    float powderCoefficient; // Beers-Powder scaling factor
+    XMFLOAT4X4 spectralWavelengths; // Wavelengths to integrate over
+    XMFLOAT4X4 spectralWeights; // Spectral integration weights
+    XMFLOAT4X4 spectralToRGB; // CIEXYZ to linear RGB
+
+    XMFLOAT4 ambientFraction;
+    float referenceWavelength = 0.843f; // The wavelength which the Angstrom exponent is in relation to
+    UInt flagApplyBeer = 1; // Controls whether to apply Beer-Lambert attenuation
+    UInt flagApplyHG = 1; // Controls whether to apply the HG phase function
+    UInt flagApplySpectral = 1; // Controls whether to integrate over several wavelengths
+  };
+}
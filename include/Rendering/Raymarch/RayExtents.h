@@ -0,0 +1,37 @@
+#pragma once
+#include "Data/HDRImage.h"
+#include "Threading/ThreadPool.h"
+
+#include <vector>
+
+namespace Haboob
+{
+  // Per pixel ray extents through the volume cube, as RaymarchVolumeShader::optimiseRays writes rayTarget:
+  // (entry depth, exit depth, screen x, screen y) in normalised device coords, a negative depth masking the pixel
+  // An entry of 0 starts the ray at the near plane (the camera is within the cube)
+  namespace RayExtents
+  {
+    // What both paths see of the camera and the volume's bounding box
+    struct View
+    {
+      XMFLOAT4X4 viewProjection;
+      XMFLOAT4X4 inverseViewProjection;
+      XMFLOAT4X4 volumeTransform; // Volume to world space, as the bounding box is drawn
+      XMFLOAT4X4 localTransform; // World to volume space, MarchVolumeDispatchInfo::localVolumeTransform
+      float cameraPosition[3];
+    };
+
+    // Intersects every pixel centre's ray with the cube ([-.5, .5] in volume space) analytically, as Raymarch/AnalyticRayExtents.cs
+    // Entries and exits are linear in NDC depth along a ray, so each face is one division and the scene depth (row-major, 1 where null) clamps them directly
+    void trace(const View& view, const float* sceneDepth, HDRImage& rays, ThreadPool* pool = nullptr);
+
+    // Compacts the tiles (tileSize pixels per side, row-major) with any pixel centre's ray through the cube, as Raymarch/ClassifyMarchTiles.cs
+    // without scene depth, so only those need scheduling
+    void findActiveTiles(const XMFLOAT4X4& inverseViewProjection, const XMFLOAT4X4& localTransform, UInt width, UInt height, UInt tileSize, std::vector<UInt>& tiles,
+      ThreadPool* pool = nullptr);
+
+    // The rasterised front and back face passes, for checking and timing trace against
+    // Faces are clipped to the near plane and cover pixel centres, the camera counting as within by the bounding sphere test
+    void rasterise(const View& view, const float* sceneDepth, HDRImage& rays, ThreadPool* pool = nullptr);
+  }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "Data/HDRImage.h"
+#include "Rendering/Raymarch/MarchKernels.h"
+#include "Rendering/Raymarch/MarchStructs.h"
+#include "Rendering/Scene/SceneStructs.h"
+#include "Rendering/Lighting/LightStructs.h"
+#include "Rendering/Volume/VolumeGrid.h"
+#include "Threading/ThreadPool.h"
+
+namespace Haboob
+{
+  // The MarchVolume.cs permutation to follow, for the macros which have no BasicOptics flag
+  struct ReferenceMarchSettings
+  {
+    bool marchManual = false; // MARCH_MANUAL, steps from the dispatch info rather than spread over the ray
+    bool applyConeTrace = true; // APPLY_CONE_TRACE, sample mips by the pixel cone radius
+    bool skipEmpty = false; // APPLY_EMPTY_SKIP, spend the steps only within occupied macro cells
+    bool marchAdaptive = false; // MARCH_ADAPTIVE, steps scale with density and rays stop once opaque (replacing APPLY_EMPTY_SKIP)
+    float emptyDensity = 1.f / float(1 << 21); // Macro cells at most this are empty, R11 flushes anything smaller to zero
+    bool jitter = false; // APPLY_PROGRESSIVE, start each ray up to a step further by the blue noise tile, each sample standing for its whole step
+    UInt frame = 0; // Shifts the tile, so successive frames average over the step
+    bool transmissionLUT = false; // APPLY_TRANSMISSION_LUT, spectral transmissions from SpectralOptics::TransmissionLUT rather than pow and exp per sample
+
+    // Steps toward the light per sample in place of the Beer Shadow Map, exactly what the map approximates
+    // 0 follows a shader built without APPLY_BSM (a constant optical depth)
+    UInt lightIterations = 0;
+
+    UInt tileSize = 16; // Pixels per tile side, as the shader's thread groups
+    bool compactTiles = false; // APPLY_TILE_LIST, schedule only the tiles with a ray through the volume, the rest being cleared as masked
+  };
+
+  // A CPU port of Raymarch/MarchVolume.cs for headless ground truth renders
+  // Rays are found analytically against the volume cube (rather than rasterising its bounds) at full resolution,
+  // there is no scene geometry, so the direct shadow term is always lit
+  // Each row of a tile is marched by a MarchKernels kernel, a packet of rays at a time on SIMD levels
+  class ReferenceMarcher
+  {
+    public:
+    ReferenceMarcher(ThreadPool* threadPool = nullptr); // Tiles are split across the pool (if any)
+
+    // Picks the march kernel, clamped to what the CPU supports (the widest by default)
+    void setSIMDLevel(SIMD::Level level);
+    inline SIMD::Level getSIMDLevel() const { return simdLevel; }
+
+    // Copies the full resolution volume and builds its mips (and macro cells), as VolumeGenerationShader does
+    // Tiling keeps each trilinear footprint within a few cache lines for rays in any direction
+    void setVolume(const VolumeGrid& grid, MarchKernels::VolumeLevels::Layout layout = MarchKernels::VolumeLevels::LAYOUT_TILED);
+
+    // Renders (irradiance, background transmission) per pixel into the target's size, as the shader writes rayTarget
+    // The light direction is normalised as LightSource uploads it, and the density samples taken are counted into sampleCount (if any)
+    void render(const CameraPack& camera, const DirectionalLightPack& light, const MarchVolumeDispatchInfo& marchInfo, const BasicOptics& optics, HDRImage& target,
+      uint64_t* sampleCount = nullptr) const;
+
+    inline ReferenceMarchSettings& getSettings() { return settings; }
+    inline const MarchKernels::VolumeLevels& getLevels() const { return levels; }
+
+    private:
+    ThreadPool* pool;
+    SIMD::Level simdLevel;
+    ReferenceMarchSettings settings;
+    MarchKernels::VolumeLevels levels; // Level 0 is the full resolution volume
+
+    // Kept across renders and rebuilt only when the optics change it, as RaymarchVolumeShader does
+    mutable SpectralOptics::TransmissionLUT transmissionLUT;
+    mutable uint64_t transmissionLUTKey = 0;
+  };
+}
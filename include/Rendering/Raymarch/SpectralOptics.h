@@ -0,0 +1,72 @@
+#pragma once
+#include "Rendering/Raymarch/MarchStructs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace Haboob
+{
+  // Spectral quadrature shared by RaymarchVolumeShader and the CPU reference marcher
+  namespace SpectralOptics
+  {
+    // Coefficients of CIE functions in order {scale, exponentScale, wavelengthScale, wavelengthOffset}
+    static constexpr float redMinorCIECoefficients[4] = { 0.39800f, 35.35534f, 0.78895f, 0.56223f };
+    static constexpr float redMajorCIECoefficients[4] = { 1.13200f, 15.29706f, -1.07599f, 1.79960f };
+    static constexpr float greenCIECoefficients[4] = { 1.01100f, 1.f, 12.2602f, -8.52237f };
+    static constexpr float blueCIECoefficients[4] = { 2.06000f, 5.65685f, 4.43459f, -1.47339f };
+
+    // Fills spectralWavelengths, spectralWeights and spectralToRGB of the optics
+    void buildMatrices(BasicOptics& optics);
+
+    // Beer-Powder transmission of every wavelength over (optical depth, Angstrom exponent), in place of pow and exp per sample (APPLY_TRANSMISSION_LUT)
+    // Depth runs along log2 so the table keeps its resolution however far a wavelength scales it, each wavelength's transmissions lying along a shear
+    // Below the table transmission is linear in depth, above it every transmission is ~0
+    struct TransmissionLUT
+    {
+      static constexpr UInt DEPTH_SIZE = 128;
+      static constexpr UInt ANGSTROM_SIZE = 64;
+      static constexpr float MIN_LOG_DEPTH = -20.f;
+      static constexpr float MAX_LOG_DEPTH = 16.f;
+      static constexpr float ANGSTROM_LENGTH = 8.f; // World units of the densest Angstrom exponent covered, further lookups clamp to the last row
+
+      std::vector<float> texels; // 16 transmissions per texel (row major, as the spectral matrices), depth fastest
+      float maxAngstrom = .0f;
+
+      // Bilinear, with texel centres at the ends of both ranges
+      inline void lookup(float opticalDepth, float angstrom, float result[16]) const
+      {
+        if (!(opticalDepth > .0f))
+        {
+          std::fill(result, result + 16, .0f);
+          return;
+        }
+
+        float logDepth = std::log2(opticalDepth);
+        float below = std::min(opticalDepth * std::exp2(-MIN_LOG_DEPTH), 1.f);
+        float u = std::min(std::max((logDepth - MIN_LOG_DEPTH) / (MAX_LOG_DEPTH - MIN_LOG_DEPTH), .0f), 1.f) * float(DEPTH_SIZE - 1);
+        float v = std::min(std::max(angstrom / maxAngstrom, .0f), 1.f) * float(ANGSTROM_SIZE - 1);
+        UInt x = std::min(UInt(u), DEPTH_SIZE - 2), y = std::min(UInt(v), ANGSTROM_SIZE - 2);
+        float fu = u - float(x), fv = v - float(y);
+
+        const float* t00 = &texels[size_t(x + DEPTH_SIZE * y) * 16];
+        const float* t10 = t00 + 16;
+        const float* t01 = t00 + DEPTH_SIZE * 16;
+        const float* t11 = t01 + 16;
+        for (int i = 0; i < 16; ++i)
+        {
+          float lower = t00[i] + (t10[i] - t00[i]) * fu;
+          float upper = t01[i] + (t11[i] - t01[i]) * fu;
+          result[i] = (lower + (upper - lower) * fv) * below;
+        }
+      }
+    };
+
+    // Tabulates the transmissions for the optics' wavelengths, powder coefficient, Beer flag and Angstrom exponents
+    void buildTransmissionLUT(const BasicOptics& optics, TransmissionLUT& lut);
+
+    // Of everything buildTransmissionLUT reads, so the table is only rebuilt when the optics change it
+    uint64_t hashTransmissionLUT(const BasicOptics& optics);
+  }
+}
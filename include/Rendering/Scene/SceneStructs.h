@@ -1,5 +1,5 @@
 #pragma once
-#include "Rendering/D3DCore.h"
+#include "Data/MathCore.h"
 
 namespace Haboob
 {
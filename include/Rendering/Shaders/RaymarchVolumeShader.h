@@ -5,47 +5,13 @@
 #include <Rendering/Textures/GBuffer.h>
 #include <Rendering/Scene/Camera.h>
 #include <Rendering/Lighting/LightSource.h>
+#include "Rendering/Raymarch/MarchStructs.h"
+#include "Rendering/Volume/VolumeStructs.h"
+#include "Rendering/Volume/VolumeStages.h"
+#include "Rendering/Volume/VolumeCache.h"
 
 namespace Haboob
 {
-  struct MarchVolumeDispatchInfo
-  {
-    float outputHorizontalStep = 1.f; // View step per horizontal thread
-    float outputVerticalStep = 1.f; // View step per vertical thread
-    float initialZStep = 0.f; // Distance to jump in Z
-    float marchZStep = .1f; // Distance to jump in Z
-    
-    UINT iterations = 10; // Number of volume steps to take
-    float texelDensity; // The density of the volume texture in world space
-    float pixelRadius = .001f; // The radius a pixel occupies in world space
-    float pixelRadiusDelta = .245f; // The linear change of pixel radius with world depth
-
-    XMMATRIX localVolumeTransform; // Transforms from world space to volume space
-    XMFLOAT3 volumeSize; // The scale of the volume in world space
-    float volumeSizeW = 1.f;
-  };
-
-  struct BasicOptics
-  {
-    XMFLOAT4 anisotropicForwardTerms; // Forward anisotropic parameters per major light component
-    XMFLOAT4 anisotropicBackwardTerms; // Backward anisotropic parameters per major light component
-    XMFLOAT4 phaseBlendWeightTerms; // Per component phase blend factor
-
-    float scatterAngstromExponent;
-    float absorptionAngstromExponent;
-    float attenuationFactor; // Scales optical depth
-    float powderCoefficient; // Beers-Powder scaling factor
-    XMFLOAT4X4 spectralWavelengths; // Wavelengths to integrate over
-    XMFLOAT4X4 spectralWeights; // Spectral integration weights
-    XMFLOAT4X4 spectralToRGB; // CIEXYZ to linear RGB
-
-    XMFLOAT4 ambientFraction;
-    float referenceWavelength = 0.843f; // The wavelength which the Angstrom exponent is in relation to
-    UINT flagApplyBeer = 1; // Controls whether to apply Beer-Lambert attenuation
-    UINT flagApplyHG = 1; // Controls whether to apply the HG phase function
-    UINT flagApplySpectral = 1; // Controls whether to integrate over several wavelengths
-  };
-
   struct ComprehensiveBufferInfo
   {
     MarchVolumeDispatchInfo marchVolumeInfo;
@@ -53,74 +19,85 @@ namespace Haboob
   };
 
   // Generates a Haboob to a 3d texture
+  // Runs as noise field -> shape fields -> combine -> mips, each stage only when its parameters changed
   class VolumeGenerationShader
   {
     public:
-    struct HaboobRadial
-    {
-      float roofGradient = -3.58f;
-      float exponentialRate = 8.36f;
-      float exponentialScale = .22f;
-      float rOffset = .36f;
-      float noseHeight = .19f;
-      float blendHeight = .87f;
-      float blendRate = 1.45f;
-      float padding = .0f;
-    };
-
-    struct HaboobDistribution
-    {
-      float falloffScale = .22f;
-      float heightScale = 5.52f;
-      float heightExponent = .74f;
-      float angleRange = 4.33f;
-      float anglePower = 3.26f;
-      XMFLOAT3 padding;
-    };
-
-    struct VolumeInfo
-    {
-      XMINT3 size = {128, 128, 128}; // Texture size
-      UINT padding;
-
-      // Proc gen params
-      XMUINT4 seed = { 0x12345, 0xCAFEBABE, 0xDEADBEEF, 0 };
-
-      float worldSize = 5.f;
-      float octaves = 3.1f;
-      float fractionalGap = 4.4f;
-      float fractionalIncrement = 0.99f;
-
-      float fbmOffset = .1f;
-      float fbmScale = .4f;
-      float wackyPower = .32f;
-      float wackyScale = .31f;
-
-      HaboobRadial radial;
-      HaboobDistribution distribution;
-    };
+    typedef Haboob::HaboobRadial HaboobRadial;
+    typedef Haboob::HaboobDistribution HaboobDistribution;
+    typedef Haboob::VolumeInfo VolumeInfo;
 
     VolumeGenerationShader();
     ~VolumeGenerationShader();
 
     HRESULT initShader(ID3D11Device* device, ShaderManager* manager);
-    HRESULT rebuild(ID3D11Device* device); // Creates texture from params
-    void render(ID3D11DeviceContext* context); // Renders to the texture according to specifications
+    HRESULT rebuild(ID3D11Device* device); // Creates textures from params (only when the size changed)
+    HRESULT render(ID3D11DeviceContext* context); // Renders the dirty stages to the texture according to specifications, its mips follow from collectMips
+    HRESULT collectMips(ID3D11DeviceContext* context, bool wait = false); // Builds the mips (and caches) once the last render's readback is ready, blocking if waiting
+    void invalidate(); // Forces every stage to run on the next render
+    void uploadVolume(ID3D11DeviceContext* context, const VolumeGrid& grid); // Replaces the texture and its mips with a CPU volume of the allocated size
 
     inline VolumeInfo& getVolumeInfo() { return volumeInfo; }
+    inline uint64_t getVersion() const { return version; } // Bumped whenever the texture's contents change, for passes which cache what they read from it
     inline ID3D11RenderTargetView* getRenderTarget() { return textureTarget.Get(); }
     inline ID3D11ShaderResourceView* getShaderView() { return textureShaderView.Get(); }
     inline ID3D11UnorderedAccessView* getComputeView() { return computeAccessView.Get(); }
+    inline ID3D11ShaderResourceView* getMacroCellView() { return macroCellShaderView.Get(); } // As VolumeMips::buildMacroCells
+    inline const VolumeStage& getNoiseStage() const { return noiseStage; }
+    inline const VolumeStage& getShapeStage() const { return shapeStage; }
+    inline const VolumeStage& getCombineStage() const { return combineStage; }
+
+    // Baked volumes are mapped from the cache when present, and read back into it otherwise
+    inline void setCache(VolumeCache* volumeCache) { cache = volumeCache; }
+    inline VolumeCache* getCache() const { return cache; }
+
+    // Mips are built on the CPU across the pool (if any) rather than box filtered by GenerateMips, a frame or more after the render as its readback arrives
+    inline void setThreadPool(ThreadPool* threadPool) { pool = threadPool; }
+    inline ThreadPool* getThreadPool() const { return pool; }
 
     private:
-    void bindShader(ID3D11DeviceContext* context);
-    void unbindShader(ID3D11DeviceContext* context);
+    HRESULT createFieldTextures(ID3D11Device* device);
+    void updateVolumeBuffer(ID3D11DeviceContext* context);
+    bool loadFromCache(ID3D11DeviceContext* context, uint64_t key);
+    void requestMips(ID3D11DeviceContext* context, uint64_t key); // Copies the full resolution level for readback, collected without stalling the frame
+    void uploadMips(ID3D11DeviceContext* context, const VolumeGrid& grid, std::vector<std::vector<UInt>>& levels); // Packs levels 1 onwards
+    void uploadMacroCells(ID3D11DeviceContext* context, const VolumeGrid& grid, const std::vector<VolumeGrid>& mips);
+
+    Shader* noiseFieldShader;
+    Shader* shapeFieldShader;
+    Shader* combineShader;
+
+    // Intermediate fields
+    ComPtr<ID3D11Texture3D> noiseTexture;
+    ComPtr<ID3D11ShaderResourceView> noiseShaderView;
+    ComPtr<ID3D11UnorderedAccessView> noiseComputeView;
+    ComPtr<ID3D11Texture1D> heightTexture;
+    ComPtr<ID3D11ShaderResourceView> heightShaderView;
+    ComPtr<ID3D11UnorderedAccessView> heightComputeView;
+    ComPtr<ID3D11Texture2D> planeTexture;
+    ComPtr<ID3D11ShaderResourceView> planeShaderView;
+    ComPtr<ID3D11UnorderedAccessView> planeComputeView;
+
+    // Stage tracking
+    VolumeStage noiseStage;
+    VolumeStage shapeStage;
+    VolumeStage combineStage;
+    XMINT3 allocatedSize;
+    UInt mipLevels;
+    uint64_t version;
+    VolumeCache* cache;
+    ThreadPool* pool;
+
+    ComPtr<ID3D11Texture3D> readbackTexture; // Staging copy of the full resolution level
+    uint64_t readbackKey;
+    bool readbackPending;
 
-    Shader* generateVolumeShader;
     ComPtr<ID3D11Texture3D> texture;
     ComPtr<ID3D11RenderTargetView> textureTarget;
     ComPtr<ID3D11ShaderResourceView> textureShaderView;
     ComPtr<ID3D11UnorderedAccessView> computeAccessView;
+    ComPtr<ID3D11Buffer> macroCellBuffer;
+    ComPtr<ID3D11ShaderResourceView> macroCellShaderView;
     ComPtr<ID3D11Buffer> volumeInfoBuffer;
     VolumeInfo volumeInfo;
   };
@@ -134,26 +111,47 @@ namespace Haboob
 
 
     HRESULT initShader(ID3D11Device* device, ShaderManager* manager);
-    void bindShader(ID3D11DeviceContext* context, ID3D11ShaderResourceView* densityTexResource);
+    void bindShader(ID3D11DeviceContext* context, ID3D11ShaderResourceView* densityTexResource, ID3D11ShaderResourceView* macroCellResource);
     void unbindShader(ID3D11DeviceContext* context);
 
     void updateSharedBuffers(ID3D11DeviceContext* context);
 
+    // Progressive frames jitter each ray's start and blend into a running average, which restarts whenever viewKey
+    // (a hash of what the march sees beyond its own dispatch info and optics) or those change
+    inline void setProgressive(bool enabled, uint64_t viewKey) { progressive = enabled; progressiveViewKey = viewKey; }
+    inline UInt getAccumulatedFrames() const { return accumulatedFrames; }
+
+    // APPLY_TRANSMISSION_LUT, keeps the spectral transmission table current with the optics (rebuilt only when they change it)
+    inline void setTransmissionLUT(bool enabled) { transmissionLUTEnabled = enabled; }
+
     // Mirror from the intermediate to the target buffer
     void mirror(ID3D11DeviceContext* context);
 
     // Optimise rays based on the currently bound camera and render the information into the ray target
-    void optimiseRays(DisplayDevice& device, MeshRenderer<VertexType>& renderer, GBuffer& gbuffer, XMVECTOR& cameraPosition);
+    // Analytic rays are traced by a compute pass from viewBuffer (the camera buffer by default), that the march which follows reads,
+    // rather than rasterising the box's faces
+    void optimiseRays(DisplayDevice& device, MeshRenderer<VertexType>& renderer, GBuffer& gbuffer, XMVECTOR& cameraPosition, ID3D11Buffer* viewBuffer = nullptr);
+    inline void setAnalyticRays(bool enabled) { analyticRays = enabled; }
+
+    // APPLY_TILE_LIST, optimising rays also compacts the march's thread groups with any unmasked ray, and only those are dispatched (indirectly)
+    // The rest of the target is cleared to the masked result, so the march writes its own target rather than over the rays
+    inline void setTileList(bool enabled) { tileList = enabled; }
+    inline void setShowMasks(bool enabled) { showMasks = enabled; } // SHOW_MASK, for the cleared tiles
 
     // Renders the Beer Shadow Map
     void bindSoftShadowMap(ID3D11DeviceContext* context, ID3D11ShaderResourceView* densityTexResource);
-    void generateSoftShadowMap(ID3D11DeviceContext* context) const;
+    void generateSoftShadowMap(ID3D11DeviceContext* context);
     void unbindSoftShadowMap(ID3D11DeviceContext* context);
 
+    // The Beer Shadow Map only needs regenerating when its key changes, which covers the march and optics buffers and sceneKey
+    // (a hash of the light, the volume's version and the permutation, which this shader cannot see)
+    inline void setSoftShadowKey(uint64_t sceneKey) { softShadowSceneKey = sceneKey; }
+    inline bool isSoftShadowMapStale() const { return !softShadowBuilt || softShadowKey != builtSoftShadowKey; }
+
     HRESULT createTextures(ID3D11Device* device, UInt width, UInt height);
     HRESULT resizeTextures(ID3D11Device* device, UInt width, UInt height);
 
-    void render(ID3D11DeviceContext* context) const;
+    void render(ID3D11DeviceContext* context);
 
     inline void setTarget(RenderTarget* target) { renderTarget = target; }
     inline void setCameraBuffer(ComPtr<ID3D11Buffer> buffer) { cameraBuffer = buffer; }
@@ -172,6 +170,9 @@ namespace Haboob
     private:
     typedef MeshInstance<VertexType> MeshInstance;
 
+    void classifyTiles(ID3D11DeviceContext* context);
+    HRESULT createTileList(ID3D11Device* device, UInt width, UInt height);
+
     // Optimisations
     MeshInstance* boundingBox;
     ComPtr<ID3D11BlendState> frontRayBlend;
@@ -179,11 +180,24 @@ namespace Haboob
     ComPtr<ID3D11SamplerState> pixelSamplerState;
     Shader* frontRayVisibilityPixelShader;
     Shader* backRayVisibilityPixelShader;
+    Shader* rayExtentsComputeShader;
+    bool analyticRays;
+
+    // Tile classification
+    Shader* classifyComputeShader;
+    RenderTarget marchTarget; // The march's results when listed
+    ComPtr<ID3D11Buffer> tileListBuffer;
+    ComPtr<ID3D11UnorderedAccessView> tileListComputeView;
+    ComPtr<ID3D11ShaderResourceView> tileListShaderView;
+    ComPtr<ID3D11Buffer> tileArgsBuffer;
+    bool tileList;
+    bool showMasks;
     bool shouldUpscale;
 
     // Intermediates
     RenderTarget rayTarget; // Used to store ray information between stages
     RenderTarget bsmTarget; // Used to store ray information between stages
+    RenderTarget historyTarget; // The progressive running average
     Shader* mirrorComputeShader;
     Shader* bsmComputeShader;
 
@@ -199,10 +213,25 @@ namespace Haboob
     ComPtr<ID3D11Buffer> cameraBuffer;
     Light* mainLight;
 
-    // Coefficients of CIE functions in order {scale, exponentScale, wavelengthScale, wavelengthOffset}
-    float redMinorCIECoefficients[4] = { 0.39800f, 35.35534f, 0.78895f, 0.56223f };
-    float redMajorCIECoefficients[4] = { 1.13200f, 15.29706f, -1.07599f, 1.79960f };
-    float greenCIECoefficients[4] = { 1.01100f, 1.f, 12.2602f, -8.52237f };
-    float blueCIECoefficients[4] = { 2.06000f, 5.65685f, 4.43459f, -1.47339f };
+    // Progressive accumulation
+    static constexpr UInt MAX_ACCUMULATED_FRAMES = 1024; // Beyond which the average decays, before float precision stalls it
+    ComPtr<ID3D11ShaderResourceView> blueNoiseShaderView;
+    bool progressive;
+    uint64_t progressiveViewKey;
+    uint64_t accumulationKey;
+    UInt accumulatedFrames;
+
+    // Spectral transmission lookup, a slice per row of the spectral matrices
+    ComPtr<ID3D11Texture2D> transmissionLUTTexture;
+    ComPtr<ID3D11ShaderResourceView> transmissionLUTShaderView;
+    ComPtr<ID3D11SamplerState> transmissionLUTSamplerState;
+    bool transmissionLUTEnabled;
+    uint64_t transmissionLUTKey;
+
+    // Beer Shadow Map tracking
+    uint64_t softShadowSceneKey;
+    uint64_t softShadowKey;
+    uint64_t builtSoftShadowKey;
+    bool softShadowBuilt;
   };
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 namespace Haboob
 {
   class ShaderManager;
+  struct ShaderPermutation;
 
   class Shader
   {
@@ -23,17 +24,25 @@ namespace Haboob
     Shader(Type shaderType, const wchar_t* path, bool precompiled = false);
     ~Shader();
 
-    HRESULT initShader(ID3D11Device* device, const ShaderManager* manager);
-    HRESULT initShader(ID3D11Device* device, ShaderManager* manager);
+    HRESULT initShader(ID3D11Device* device, const ShaderManager* manager); // Compiles now
+    HRESULT initShader(ID3D11Device* device, ShaderManager* manager); // Listens for macros, compiling on the manager's pool
+    HRESULT loadPreCompiledShader(ID3D11Device* device, const ShaderManager* manager);
+    HRESULT swapShader(ID3D11Device* device, const ShaderManager* manager, const ShaderPermutation* permutation); // Replaces the compiled shader, if made from another permutation
     void bindShader(ID3D11DeviceContext* context);
     void unbindShader(ID3D11DeviceContext* context);
     static void dispatch(ID3D11DeviceContext* context, UInt groupX = 1, UInt groupY = 1, UInt groupZ = 1);
+    static void dispatchIndirect(ID3D11DeviceContext* context, ID3D11Buffer* arguments, UInt offset = 0); // Group counts from a DRAWINDIRECT_ARGS buffer
 
     inline Type getType() const { return type; }
     inline bool isCompiled() const { return compiledShader != nullptr; }
+    inline bool isPreCompiled() const { return preferCompiled; }
+    inline const wchar_t* getRelativePath() const { return relativePath; }
+    inline uint64_t getCompiledKey() const { return compiledKey; }
 
     protected:
-    HRESULT makeShader(ID3D11DeviceChild** shader, ID3D11Device* device, const ShaderManager* manager);
+    HRESULT replaceShader(ID3D11Device* device, const ShaderManager* manager, const void* bytecode, SIZE_T bytecodeSize, uint64_t key);
+    HRESULT makeShader(ID3D11DeviceChild** shader, ID3D11InputLayout** layout, ID3D11Device* device, const ShaderManager* manager, const void* bytecode,
+      SIZE_T bytecodeSize);
     void bindVertex(ID3D11DeviceContext* context);
     static void unbindVertex(ID3D11DeviceContext* context);
     void bindPixel(ID3D11DeviceContext* context);
@@ -53,5 +62,6 @@ namespace Haboob
     bool preferCompiled;
     ComPtr<ID3D11InputLayout> inputLayout; // Vertex descriptor
     ID3D11DeviceChild* compiledShader;
+    uint64_t compiledKey; // Permutation compiledShader was made from, 0 when precompiled
   };
 }
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+#include "Data/FileCache.h"
+#include "Rendering/Shaders/ShaderPermutations.h"
+
+#include <cstdint>
+#include <filesystem>
+
+namespace Haboob
+{
+  // Content-addressed on-disk cache of compiled shader bytecode, one file per permutation
+  // Keyed by the contents of the source and everything it includes, the macros, the profile and the compiler's settings,
+  // so repeat launches compile nothing, verified by checksum on load and evicted least recently used first
+  class ShaderBlobCache
+  {
+    public:
+    static constexpr uint64_t DEFAULT_CAPACITY = 64ULL << 20; // Bytes across every cached permutation, each edit leaves a new one
+
+    ShaderBlobCache(const std::filesystem::path& directory = {}, uint64_t capacity = DEFAULT_CAPACITY);
+
+    // Stable key of a permutation's bytecode, contentHash covering the include closure (ShaderDependencies::getContentHash)
+    static uint64_t getKey(uint64_t contentHash, const std::string& profile, const ShaderMacros& macros, uint64_t compilerSignature);
+
+    // Reads cached bytecode, returns false (removing the file if it is corrupt) when there is no valid entry
+    bool load(uint64_t key, ShaderBytecode& bytecode) const;
+
+    // Writes bytecode, then evicts old entries over capacity
+    bool store(uint64_t key, const ShaderBytecode& bytecode) const;
+
+    inline void evict() const { files.evict(); } // Removes least recently used entries until within capacity
+    inline void clear() const { files.clear(); } // Removes every entry
+
+    inline void setDirectory(const std::filesystem::path& path) { files.setDirectory(path); }
+    inline const std::filesystem::path& getDirectory() const { return files.getDirectory(); }
+    inline bool isEnabled() const { return files.isEnabled(); }
+
+    inline void setCapacity(uint64_t bytes) { files.setCapacity(bytes); }
+    inline uint64_t getCapacity() const { return files.getCapacity(); }
+    inline uint64_t getUsage() const { return files.getUsage(); } // Bytes currently cached
+
+    inline std::filesystem::path getPath(uint64_t key) const { return files.getPath(key); }
+
+    private:
+    FileCache files;
+  };
+}
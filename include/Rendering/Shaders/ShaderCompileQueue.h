@@ -0,0 +1,58 @@
+#pragma once
+#include "Rendering/Shaders/ShaderPermutations.h"
+#include "Threading/ThreadPool.h"
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace Haboob
+{
+  // A permutation compiled on a worker, null with the compiler's output when compilation failed
+  struct ShaderCompileResult
+  {
+    const ShaderPermutation* permutation = nullptr;
+    std::string errors;
+  };
+
+  typedef std::shared_future<ShaderCompileResult> ShaderCompileHandle;
+
+  // Runs shader compilation jobs across a thread pool (or immediately without one), keeping the latest request per shader
+  // The render thread collects finished jobs and swaps them in, so each shader keeps its current compilation until the replacement is ready
+  // Jobs must copy everything they read, as the requesting state may change while they run
+  class ShaderCompileQueue
+  {
+    public:
+    typedef std::function<ShaderCompileResult()> Job;
+    typedef std::function<void(const void* owner, const ShaderCompileResult& result)> Apply;
+
+    ShaderCompileQueue(ThreadPool* pool = nullptr) : pool{ pool }, outstanding{ 0 } {}
+    ~ShaderCompileQueue(); // Waits for every job, which may reference the caches they compile into
+
+    // Queues the owner's job, superseding any it has waiting to be collected (which still runs, its result is dropped)
+    ShaderCompileHandle submit(const void* owner, const Job& job);
+
+    // Hands each owner's finished latest job to apply on the calling thread, returns how many were applied
+    UInt collect(const Apply& apply);
+
+    void cancel(const void* owner); // Drops the owner's pending job, such as when it is destroyed
+    void wait(); // Blocks until every submitted job has run, including superseded ones
+
+    inline bool isBusy() const { return !latest.empty(); } // Some owner's latest job is yet to be collected
+    inline UInt getPendingCount() const { return UInt(latest.size()); }
+
+    inline void setThreadPool(ThreadPool* threadPool) { pool = threadPool; }
+    inline ThreadPool* getThreadPool() const { return pool; }
+
+    private:
+    ThreadPool* pool;
+    std::map<const void*, ShaderCompileHandle> latest; // Only touched by the submitting thread
+
+    UInt outstanding; // Jobs submitted but not yet run
+    std::mutex outstandingMutex;
+    std::condition_variable outstandingSignal;
+  };
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "Rendering/Shaders/ShaderPermutations.h"
+
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Haboob
+{
+  // The macros a shader can depend on, found by walking its #include closure as the compiler's include handler resolves it:
+  // against the shader's own directory first, then the directory of each open include from the innermost out
+  // Every identifier outside comments and strings is recorded regardless of conditionals, so a macro never referenced cannot change the output
+  class ShaderDependencies
+  {
+    public:
+    // Reads a file's text, returning false if it does not exist
+    typedef std::function<bool(const std::wstring& path, std::string& text)> FileReader;
+
+    ShaderDependencies(const FileReader& reader = {}); // Reads from disk by default
+
+    static bool readFile(const std::wstring& path, std::string& text); // From disk, the default reader
+
+    // Scans the shader and everything it includes, returns false if the shader itself cannot be read
+    bool scan(const std::wstring& path);
+
+    // If the shader's preprocessing can depend on the macro
+    bool references(const std::string& name) const;
+
+    // The subset of the macros the shader references, the permutation it actually compiles to
+    ShaderMacros filter(const ShaderMacros& macros) const;
+
+    inline const std::set<std::string>& getIdentifiers() const { return identifiers; }
+    inline const std::vector<std::wstring>& getFiles() const { return files; } // The closure in first include order, the shader first
+    inline const std::vector<std::string>& getMissing() const { return missing; } // Includes that resolved to no file
+    inline bool isOpaque() const { return opaque; } // Token pasting or a computed include, so every macro is assumed referenced
+    inline uint64_t getContentHash() const { return contentHash; } // Over the text of every file in the closure, in order
+
+    private:
+    void scanFile(const std::string& text, std::vector<std::wstring>& openDirectories);
+
+    FileReader reader;
+    std::wstring rootDirectory;
+    std::set<std::wstring> visited; // Lexically normal paths
+    std::set<std::string> identifiers;
+    std::vector<std::wstring> files;
+    std::vector<std::string> missing;
+    bool opaque;
+    uint64_t contentHash;
+  };
+}
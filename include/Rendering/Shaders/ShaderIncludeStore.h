@@ -0,0 +1,71 @@
+#pragma once
+#include "Rendering/Shaders/ShaderDependencies.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Haboob
+{
+  // One interned source file, never modified once stored so its text can be handed to the compiler as is
+  struct ShaderIncludeFile
+  {
+    std::wstring path; // Lexically normal
+    std::wstring directory; // Searched for the file's own includes
+    std::string text;
+  };
+
+  // Shader sources read once and shared by every compilation, on any thread
+  // Files stay at the same address until cleared, and includes are resolved once per including context and name
+  class ShaderIncludeStore
+  {
+    public:
+    typedef ShaderDependencies::FileReader FileReader;
+
+    ShaderIncludeStore(const FileReader& reader = {}); // Reads from disk by default
+
+    // The file, read on first request, null if it does not exist (also remembered, as most directories searched hold no such file)
+    const ShaderIncludeFile* get(const std::wstring& path);
+
+    // Resolves an include as ShaderDependencies does: against the shader's directory first, then each open include's from the innermost
+    // open lists the files including this one from the outermost, empty when the shader includes it directly
+    const ShaderIncludeFile* resolve(const std::wstring& rootDirectory, const std::vector<const ShaderIncludeFile*>& open, const std::string& name);
+
+    void clear(); // Forgets every file and resolution, such as after sources change (not while any compilation reads them)
+
+    size_t getSize() const;
+    UInt getHitCount() const; // Lookups answered by the store, including files known to be missing
+    UInt getMissCount() const; // Lookups read
+    UInt getResolveHitCount() const; // Includes resolved from the memo
+    UInt getResolveMissCount() const; // Includes searched for
+
+    private:
+    // Which file an include names depends on the directories searched, so on the whole chain of including files
+    struct ResolveKey
+    {
+      std::wstring rootDirectory;
+      std::vector<const ShaderIncludeFile*> open;
+      std::string name;
+
+      inline bool operator<(const ResolveKey& other) const
+      {
+        if (name != other.name) { return name < other.name; }
+        if (open != other.open) { return open < other.open; }
+        return rootDirectory < other.rootDirectory;
+      }
+    };
+
+    FileReader reader;
+    std::unordered_map<std::wstring, ShaderIncludeFile> files; // Nodes are stable, so handed out pointers stay valid until cleared
+    std::unordered_set<std::wstring> missing;
+    std::map<ResolveKey, const ShaderIncludeFile*> resolved; // Null when no directory holds the file
+    mutable std::mutex storeMutex;
+    UInt hits = 0;
+    UInt misses = 0;
+    UInt resolveHits = 0;
+    UInt resolveMisses = 0;
+  };
+}
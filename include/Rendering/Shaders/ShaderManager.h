@@ -6,36 +6,58 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 #include <set>
 
 #include "Rendering/Shaders/Shader.h"
+#include "Rendering/Shaders/ShaderPermutations.h"
+#include "Rendering/Shaders/ShaderDependencies.h"
+#include "Rendering/Shaders/ShaderBlobCache.h"
+#include "Rendering/Shaders/ShaderCompileQueue.h"
+#include "Rendering/Shaders/ShaderIncludeStore.h"
 
 namespace Haboob
 {
+  class D3DShaderCompiler;
+
   class ShaderManager
   {
     public:
     ShaderManager();
+    ~ShaderManager();
 
     inline const std::vector<D3D11_INPUT_ELEMENT_DESC>& getVertexLayout() const { return globalVertexLayout; }
 
-    void bakeMacros(ID3D11Device* device);
+    void bakeMacros(ID3D11Device* device); // Requests every shader if macros or sources changed, then swaps in those finished
+    void reloadSources(); // Rereads every source on the next bake, so edits take effect (unchanged shaders keep their permutations)
+    void waitForShaders(ID3D11Device* device); // Blocks until every requested shader is compiled and swapped in
 
     void addShader(Shader* shader);
     void removeShader(Shader* shader);
 
+    // Compiles the shader with the current macros on the pool (now, without one), it keeps its current compilation until swapped in
+    HRESULT requestShader(ID3D11Device* device, Shader* shader);
+    inline bool isCompiling() const { return compileQueue.isBusy(); }
+    inline uint64_t getSwapGeneration() const { return swapGeneration; } // Changes whenever a collected permutation replaces a shader, so results built with the old one can be invalidated
+
     void setMacro(const std::string& name, const std::string& value);
 
     void setVertexLayout(const std::vector<D3D11_INPUT_ELEMENT_DESC>& layout);
     void setRootDir(const std::wstring& root);
     void setShaderDir(const std::wstring& shaders);
     void setLevel(WLiteral level);
+    void setCacheDirectory(const std::wstring& cache); // Compiled permutations are kept here between launches, none when empty
+    void setThreadPool(ThreadPool* pool); // Compiles across the pool, serially on request without one
 
     HRESULT loadPreCompiledShaderBlob(const wchar_t* relativePath, ID3DBlob** blob) const;
-    HRESULT loadFormattedShaderBlob(Shader::Type shaderType, const wchar_t* relativePath, ID3DBlob** blob) const;
+    HRESULT loadFormattedShader(Shader::Type shaderType, const wchar_t* relativePath, const ShaderPermutation** permutation) const; // Compiled with the baked macros it references, cached per permutation
+
+    inline const ShaderPermutationCache& getPermutations() const { return permutations; }
+    inline const ShaderIncludeStore& getIncludes() const { return includes; }
 
     protected:
-    HRESULT recompileShaders(ID3D11Device* device); // Recompiles all listening shaders
+    HRESULT recompileShaders(ID3D11Device* device); // Requests all listening shaders
+    HRESULT collectShaders(ID3D11Device* device); // Swaps in every finished request
 
     private:
     static constexpr WLiteral COMPILED_EXT = L".cso";
@@ -48,12 +70,13 @@ namespace Haboob
     static constexpr WLiteral LIBRARY_ID = L"lib";
     static constexpr WLiteral EXT_DELIM = L".";
     static constexpr WLiteral PATH_DELIM = L"/";
-    static constexpr WLiteral UP_LEVEL_DELIM = L"/../";
 
     static const std::vector<D3D11_INPUT_ELEMENT_DESC> defaultVertexLayout;
     std::vector<D3D11_INPUT_ELEMENT_DESC> globalVertexLayout;
 
     void resolveFullPath();
+    void getShaderFile(Shader::Type shaderType, const wchar_t* relativePath, std::wstring& fullFile, std::string& profile) const;
+    ShaderCompileResult compilePermutation(const std::wstring& fullFile, const std::string& profile, const ShaderMacros& bakedMacros) const; // From any thread
 
     std::wstring rootDirectory;
     std::wstring shadersRelativePath;
@@ -62,10 +85,18 @@ namespace Haboob
 
     std::set<Shader*> shaders;
 
-    std::map<std::wstring, std::string> shaderFileCache; // Cached raw shader files
+    mutable ShaderIncludeStore includes; // Raw shader files, read once
+    mutable std::mutex dependencyMutex; // Guards the dependencies for compilation jobs, not held while scanning
+
+    D3DShaderCompiler* compiler; // Backs the permutation cache with D3DCompile, reading sources through the include store
+    mutable ShaderPermutationCache permutations;
+    ShaderBlobCache blobCache;
+    ShaderCompileQueue compileQueue;
+    mutable std::map<std::wstring, ShaderDependencies> shaderDependencies; // Per source file, scanned on first compile and after a reload
 
-    std::map<std::string, std::string> macroList;
-    std::vector<D3D_SHADER_MACRO> bakedMacros;
+    ShaderMacros macroList;
     bool isMacrosBaked; // Macro list has been propagated through shaders
+    bool isSourcesStale = false; // Sources are reread on the next bake
+    uint64_t swapGeneration = 0;
   };
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+#include "Data/Defs.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Haboob
+{
+  // Macro definitions by name, as ShaderManager::setMacro builds them
+  typedef std::map<std::string, std::string> ShaderMacros;
+
+  // Compiled shader bytecode, handed to the device as is
+  typedef std::vector<Byte> ShaderBytecode;
+
+  // Compiles one shader source file, the D3D backend lives with ShaderManager
+  class ShaderCompiler
+  {
+    public:
+    virtual ~ShaderCompiler() = default;
+
+    // Compiles the file's main for the profile (e.g. cs_5_0), returns false with the compiler's output in errors on failure
+    // Called from many threads at once
+    virtual bool compile(const std::wstring& path, const std::string& profile, const ShaderMacros& macros, ShaderBytecode& bytecode, std::string& errors) = 0;
+
+    // Identifies the settings beyond the source that change the bytecode, such as debug flags and the compiler's version
+    virtual uint64_t getSignature() const { return 0; }
+  };
+
+  class ShaderBlobCache;
+
+  // One compiled permutation of a shader source
+  struct ShaderPermutation
+  {
+    uint64_t key;
+    std::wstring path;
+    uint64_t contentHash;
+    std::string profile;
+    ShaderMacros macros;
+    ShaderBytecode bytecode;
+  };
+
+  // Compiled permutations per (source path and contents, profile, macros), so returning to a previous configuration needs no compilation
+  // and edited sources, once rescanned, compile anew
+  // Misses are looked up in the blob cache, if any, before compiling, so are shared between launches
+  // Safe to use from many threads, which compile different permutations concurrently and wait on one another for the same permutation
+  // Failed compilations are not kept, so they are retried on the next request
+  class ShaderPermutationCache
+  {
+    public:
+    ShaderPermutationCache(ShaderCompiler* compiler = nullptr) : compiler{ compiler } {}
+
+    // Stable key of a permutation, contentHash covering the source's include closure (ShaderDependencies::getContentHash)
+    static uint64_t getKey(const std::wstring& path, const std::string& profile, const ShaderMacros& macros, uint64_t contentHash = 0);
+
+    // The cached permutation, compiled on a miss, null (with any compiler output in errors) when compilation fails
+    // contentHash is 0 when unknown, skipping the blob cache
+    const ShaderPermutation* get(const std::wstring& path, const std::string& profile, const ShaderMacros& macros, uint64_t contentHash = 0,
+      std::string* errors = nullptr);
+
+    void clear(); // Forgets every permutation, such as after sources change (not while any are being compiled)
+
+    inline void setCompiler(ShaderCompiler* backend) { compiler = backend; }
+    inline ShaderCompiler* getCompiler() const { return compiler; }
+
+    inline void setBlobCache(const ShaderBlobCache* cache) { blobCache = cache; }
+    inline const ShaderBlobCache* getBlobCache() const { return blobCache; }
+
+    size_t getSize() const;
+    UInt getHitCount() const;
+    UInt getCompileCount() const;
+    UInt getLoadCount() const; // From the blob cache
+
+    private:
+    ShaderCompiler* compiler;
+    const ShaderBlobCache* blobCache = nullptr;
+    std::unordered_multimap<uint64_t, ShaderPermutation> permutations; // Never replaced and nodes are stable, so handed out pointers stay valid until cleared
+    std::set<uint64_t> compiling; // Keys a thread is compiling, which others wait for
+    mutable std::mutex permutationMutex;
+    std::condition_variable compiledSignal;
+    UInt hits = 0;
+    UInt compiles = 0;
+    UInt loads = 0;
+  };
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "Rendering/Volume/VolumeGrid.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Haboob
+{
+  // A sparse haboob volume split into 8^3 bricks, only occupied bricks are stored (in a pool of R11G11B10 texels, as on the GPU)
+  // Empty bricks have every density at most the bake's empty threshold and read as zero
+  class BrickedVolume
+  {
+    public:
+    static constexpr int BRICK_SIZE = 8;
+    static constexpr UInt BRICK_VOXELS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+    static constexpr UInt EMPTY_SLOT = ~0U;
+
+    // Density range within a brick (after packing)
+    struct BrickRange
+    {
+      float minDensity;
+      float maxDensity;
+    };
+
+    // Visits an occupied brick the ray passes through over [tEnter, tExit)
+    typedef std::function<void(UInt brick, float tEnter, float tExit)> BrickVisitor;
+
+    BrickedVolume() : size{ 0, 0, 0 }, brickCounts{ 0, 0, 0 } {}
+
+    // Clears to an entirely empty volume
+    void reset(const XMINT3& newSize);
+
+    // Replaces the pool, slots[brick] indexes a brick of the pool or is EMPTY_SLOT
+    void assign(std::vector<UInt>&& slots, std::vector<BrickRange>&& ranges, std::vector<UInt>&& pool);
+
+    inline const XMINT3& getSize() const { return size; }
+    inline const XMINT3& getBrickCounts() const { return brickCounts; }
+    inline UInt getBrickCount() const { return UInt(slots.size()); }
+    inline UInt getOccupiedCount() const { return UInt(pool.size() / BRICK_VOXELS); }
+
+    inline UInt brickIndex(int bx, int by, int bz) const { return UInt(bx + brickCounts.x * (by + brickCounts.y * bz)); }
+    inline bool isOccupied(UInt brick) const { return (occupancy[brick >> 6] >> (brick & 63)) & 1; }
+    inline const BrickRange& getRange(UInt brick) const { return ranges[brick]; }
+
+    // Packed voxels of a brick, x-fastest, or null when empty (edge bricks are padded with zeros)
+    inline const UInt* getBrick(UInt brick) const { return slots[brick] == EMPTY_SLOT ? nullptr : &pool[size_t(slots[brick]) * BRICK_VOXELS]; }
+
+    VolumeElement at(int x, int y, int z) const;
+
+    // Expands to a dense grid
+    void toGrid(VolumeGrid& grid) const;
+
+    // Bytes held by the pool and brick tables
+    size_t getMemoryUsage() const;
+
+    // Walks the brick grid along a ray in voxel space (the volume spans [0, size]), skipping empty bricks
+    void traverse(const float origin[3], const float direction[3], float tMin, float tMax, const BrickVisitor& visitor) const;
+
+    // Sums nearest voxel densities at tMin + (i + .5) * step along a ray in voxel space, times the step
+    // Only samples falling within occupied bricks are taken
+    float integrateDensity(const float origin[3], const float direction[3], float tMin, float tMax, float step) const;
+
+    private:
+    XMINT3 size;
+    XMINT3 brickCounts;
+    std::vector<uint64_t> occupancy; // Bit per brick
+    std::vector<BrickRange> ranges; // Per brick
+    std::vector<UInt> slots; // Per brick, into the pool
+    std::vector<UInt> pool; // Occupied bricks
+  };
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "Rendering/Volume/VolumeGenerator.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace Haboob
+{
+  // Bakes a time-evolving haboob on a background worker into a back buffer, while the front buffer stays readable
+  // Typical use renders the front, requests the next time step, then swaps once it is ready
+  class VolumeAnimator
+  {
+    public:
+    VolumeAnimator(ThreadPool* threadPool = nullptr); // The worker splits each frame across the pool (if any)
+    ~VolumeAnimator();
+
+    // Queues the volume at info.motion.time for the back buffer, replacing any request which has not started
+    // Generation starts once the back buffer is free (no finished frame waiting to be swapped)
+    void request(const VolumeInfo& info);
+
+    // Makes a finished back buffer the front, returns false while nothing has finished
+    bool swap();
+
+    // Blocks until a finished frame is waiting to be swapped, or nothing is queued
+    void wait();
+
+    bool isBusy() const; // A frame is queued or generating
+
+    // Only read from the thread calling swap
+    inline const VolumeGrid& getFront() const { return buffers[front]; }
+    inline float getFrontTime() const { return frontTime; }
+    inline UInt getFrameCount() const { return frames; } // Frames swapped to the front
+
+    private:
+    void work();
+
+    VolumeGenerator generator; // Worker only, keeps the stages of the previous frame
+    VolumeGrid buffers[2];
+    UInt front;
+    float frontTime;
+    float backTime;
+    UInt frames;
+
+    VolumeInfo pending;
+    bool hasPending;
+    bool generating;
+    bool backReady; // The back buffer holds a finished frame
+    bool stopping;
+
+    std::thread worker;
+    mutable std::mutex stateMutex;
+    std::condition_variable workSignal;
+    std::condition_variable doneSignal;
+  };
+}
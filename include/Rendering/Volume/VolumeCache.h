@@ -0,0 +1,76 @@
+#pragma once
+#include "Data/FileCache.h"
+#include "Data/MappedFile.h"
+#include "Rendering/Volume/VolumeGrid.h"
+#include "Threading/ThreadPool.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace Haboob
+{
+  // A baked volume mapped from the cache, as packed R11G11B10 texels per mip level (x-fastest, tightly packed)
+  class CachedVolume
+  {
+    public:
+    CachedVolume() : size{ 0, 0, 0 } {}
+
+    inline bool isLoaded() const { return file.isOpen(); }
+    inline const XMINT3& getSize() const { return size; }
+    inline UInt getLevelCount() const { return UInt(levels.size()); }
+    inline const UInt* getLevel(UInt level) const { return levels[level]; }
+    XMINT3 getLevelSize(UInt level) const;
+
+    // Decodes a level back to floats
+    void unpackLevel(UInt level, VolumeGrid& grid) const;
+
+    private:
+    friend class VolumeCache;
+
+    MappedFile file;
+    XMINT3 size;
+    std::vector<const UInt*> levels; // Into the mapping
+  };
+
+  // Content-addressed on-disk cache of baked volumes, one page aligned file per volume
+  // Files are keyed by the volume parameters and generator version, verified by checksum and evicted least recently used first
+  class VolumeCache
+  {
+    public:
+    static constexpr UInt GENERATOR_VERSION = 3; // Bump whenever generated volumes change for the same parameters
+    static constexpr size_t PAGE_SIZE = 4096; // Alignment of the header and every level within a file
+    static constexpr UInt MAX_LEVELS = 16;
+    static constexpr uint64_t DEFAULT_CAPACITY = 1ULL << 30; // Bytes across every cached volume
+
+    VolumeCache(const std::filesystem::path& directory = {}, uint64_t capacity = DEFAULT_CAPACITY);
+
+    // Stable key of the volume a specification generates
+    static uint64_t getKey(const VolumeInfo& info);
+
+    // Maps a cached volume, returns false (removing the file if it is corrupt) when there is no valid entry
+    bool load(uint64_t key, CachedVolume& volume);
+
+    // Writes a volume from its packed levels, then evicts old entries over capacity
+    bool store(uint64_t key, const XMINT3& size, UInt levelCount, const UInt* const* levels);
+
+    // Packs a CPU volume and its mip chain (built across the pool, if any)
+    bool store(uint64_t key, const VolumeGrid& grid, ThreadPool* pool = nullptr);
+
+    inline void evict() { files.evict(); } // Removes least recently used entries until within capacity
+    inline void clear() { files.clear(); } // Removes every entry
+
+    inline void setDirectory(const std::filesystem::path& path) { files.setDirectory(path); }
+    inline const std::filesystem::path& getDirectory() const { return files.getDirectory(); }
+    inline bool isEnabled() const { return files.isEnabled(); }
+
+    inline void setCapacity(uint64_t bytes) { files.setCapacity(bytes); }
+    inline uint64_t getCapacity() const { return files.getCapacity(); }
+    inline uint64_t getUsage() const { return files.getUsage(); } // Bytes currently cached
+
+    inline std::filesystem::path getPath(uint64_t key) const { return files.getPath(key); }
+
+    private:
+    FileCache files;
+  };
+}
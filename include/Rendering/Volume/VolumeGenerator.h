@@ -0,0 +1,119 @@
+#pragma once
+#include "Rendering/Volume/BrickedVolume.h"
+#include "Rendering/Volume/VolumeGrid.h"
+#include "Rendering/Volume/VolumeStages.h"
+#include "Procedural/GradientLattice.h"
+#include "Threading/ThreadPool.h"
+
+namespace Haboob
+{
+  // Bakes haboob volumes on the CPU, mirroring TestShaders/TestFormHaboob.cs
+  class VolumeGenerator
+  {
+    public:
+    static constexpr size_t GRADIENT_CACHE_BUDGET = 1 << 24; // Most lattice corners (12 bytes each) a single octave may cache
+    static constexpr float SEPARABLE_TOLERANCE = 1e-6f; // Largest difference of separable shape terms from per voxel evaluation
+    static constexpr float EMPTY_DENSITY = 1.f / float(1 << 21); // Default empty brick threshold, R11 flushes anything this small to zero
+
+    VolumeGenerator(ThreadPool* threadPool = nullptr);
+
+    // Fills the grid according to the specification (at its motion time), split into Z-slabs across the pool (if any)
+    // The fBM and shape fields are kept between calls and only recomputed when their parameters change
+    void generate(const VolumeInfo& info, VolumeGrid& grid);
+    void invalidate(); // Forces every stage to recompute
+
+    // Bakes only the bricks the haboob can reach, bounding each from the separable shape terms and the range of the fBM
+    // Bricks with every density at most the empty density are left out (the fBM is not kept between calls)
+    void generate(const VolumeInfo& info, BrickedVolume& volume);
+
+    inline void setEmptyDensity(float density) { emptyDensity = density; }
+    inline float getEmptyDensity() const { return emptyDensity; }
+
+    inline const VolumeStage& getNoiseStage() const { return noiseStage; }
+    inline const VolumeStage& getShapeStage() const { return shapeStage; }
+
+    inline void setThreadPool(ThreadPool* threadPool) { pool = threadPool; }
+    inline ThreadPool* getThreadPool() const { return pool; }
+
+    // Selects the noise kernel, clamped to what this CPU supports
+    void setSIMDLevel(SIMD::Level level);
+    inline SIMD::Level getSIMDLevel() const { return simdLevel; }
+
+    // Precomputes each octave's lattice gradients rather than evaluating 8 per voxel (octaves over budget stay direct)
+    inline void setGradientCache(bool enabled) { useGradientCache = enabled; noiseStage.invalidate(); }
+    inline bool isGradientCached() const { return useGradientCache; }
+
+    // Evaluates height-only and plane-only shape terms once into tables rather than per voxel
+    inline void setSeparable(bool enabled) { useSeparable = enabled; shapeStage.invalidate(); }
+    inline bool isSeparable() const { return useSeparable; }
+
+    private:
+    // Shape terms depending only on height
+    struct HeightTerms
+    {
+      float leadingRadius; // Radius of the leading edge
+      float heightDensity;
+      float angstromBase; // Angstrom exponent before the fBM alteration
+    };
+
+    // Shape terms depending only on the ground plane position
+    struct PlaneTerms
+    {
+      float radius; // Distance from the cylinder axis
+      float arcDensity;
+    };
+
+    // Noise state shared by every voxel
+    struct NoiseContext
+    {
+      WorldSpace world;
+      std::vector<fBMOctave> octaves;
+      float fbmOffset[3];
+
+      std::vector<float> positions[3]; // Normalised location along each axis
+      std::vector<GradientLattice> lattices; // Per octave, when cached
+    };
+
+    // Scratch streams for evaluating a row of noise
+    struct NoiseRow
+    {
+      NoiseRow(int length) : y(length), z(length), octave(length) {}
+
+      std::vector<float> y, z, octave;
+    };
+
+    static HeightTerms evaluateHeight(const VolumeInfo& info, int y);
+    static PlaneTerms evaluatePlane(const VolumeInfo& info, int x, int z);
+    static VolumeElement combine(const VolumeInfo& info, const HeightTerms& height, const PlaneTerms& plane, float fbm);
+
+    // Evaluates the fBM of count voxels along x from (xBegin, y, z)
+    static void evaluateNoiseRow(const NoiseContext& noise, NoiseKernels::fBMBatch fBMBatch, int xBegin, int count, int y, int z, NoiseRow& row, float* rowNoise);
+
+    // Splits [0, depth) into slabs across the pool
+    void forSlabs(int depth, const std::function<void(int, int)>& job) const;
+
+    void prepareNoise(const VolumeInfo& info, NoiseContext& noise) const;
+    void generateNoiseSlab(const VolumeInfo& info, const NoiseContext& noise, int zBegin, int zEnd);
+    void generateShape(const VolumeInfo& info);
+    void buildShapeTables(const VolumeInfo& info);
+    void combineSlab(const VolumeInfo& info, VolumeGrid& grid, int zBegin, int zEnd) const;
+
+    // Lists the bricks whose density bound exceeds the empty density
+    void classifyBricks(const VolumeInfo& info, const BrickedVolume& volume, std::vector<UInt>& candidates) const;
+    void bakeBrick(const VolumeInfo& info, const NoiseContext& noise, NoiseKernels::fBMBatch fBMBatch, const BrickedVolume& volume, UInt brick,
+      NoiseRow& row, UInt* out, BrickedVolume::BrickRange& range) const;
+
+    // Stage outputs
+    std::vector<float> noiseField; // fBM per voxel, x-fastest
+    std::vector<HeightTerms> heightTerms; // Per y, when separable
+    std::vector<PlaneTerms> planeTerms; // Per (x, z), x-fastest, when separable
+    VolumeStage noiseStage;
+    VolumeStage shapeStage;
+
+    ThreadPool* pool;
+    SIMD::Level simdLevel;
+    bool useGradientCache;
+    bool useSeparable;
+    float emptyDensity;
+  };
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "Rendering/Volume/VolumeStructs.h"
+
+#include <vector>
+
+namespace Haboob
+{
+  // A CPU-side haboob volume, x-fastest like a D3D 3d texture
+  class VolumeGrid
+  {
+    public:
+    VolumeGrid() : size{ 0, 0, 0 } {}
+
+    inline void resize(const XMINT3& newSize)
+    {
+      size = newSize;
+      elements.resize(size_t(size.x) * size_t(size.y) * size_t(size.z));
+    }
+
+    inline size_t index(int x, int y, int z) const { return size_t(x) + size_t(size.x) * (size_t(y) + size_t(size.y) * size_t(z)); }
+    inline VolumeElement& at(int x, int y, int z) { return elements[index(x, y, z)]; }
+    inline const VolumeElement& at(int x, int y, int z) const { return elements[index(x, y, z)]; }
+
+    inline const XMINT3& getSize() const { return size; }
+    inline size_t getVoxelCount() const { return elements.size(); }
+    inline VolumeElement* getData() { return elements.data(); }
+    inline const VolumeElement* getData() const { return elements.data(); }
+
+    private:
+    XMINT3 size;
+    std::vector<VolumeElement> elements;
+  };
+}
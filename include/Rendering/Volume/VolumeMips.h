@@ -0,0 +1,32 @@
+#pragma once
+#include "Rendering/Volume/VolumeGrid.h"
+#include "Threading/ThreadPool.h"
+
+namespace Haboob
+{
+  // CPU mip chain of a haboob volume, laid out like VolumeGenerationShader's texture
+  // Density and angstrom exponent are averaged while maxDensity keeps the maximum, so it stays a conservative bound at every level
+  namespace VolumeMips
+  {
+    static constexpr int BLOCK_SIZE = 16; // Source rows and slices per block, each block's levels are built while it is in cache
+    static constexpr int MACRO_CELL_SIZE = 8; // Source texels per macro cell side, as a texel of level 3
+
+    // Levels including the full resolution one, log2 of the smallest dimension as in VolumeGenerationShader::rebuild
+    UInt getLevelCount(const XMINT3& size);
+    XMINT3 getLevelSize(const XMINT3& size, UInt level);
+
+    // Reduces each 2x2x2 block of the source into one texel of the target (sized to the next level)
+    void downsample(const VolumeGrid& source, VolumeGrid& target);
+
+    // Builds levels 1 to levelCount - 1 into mips (mips[0] being level 1) in a single pass over the source
+    // Blocks of the source are split across the pool (if any), the result matches repeated downsampling exactly
+    void buildChain(const VolumeGrid& source, std::vector<VolumeGrid>& mips, UInt levelCount, ThreadPool* pool = nullptr);
+
+    // Macro cells along each axis, covering the source
+    XMINT3 getMacroCellCounts(const XMINT3& size);
+
+    // The max density around each macro cell (x fastest), with one value per level of the chain for each cell
+    // Value k covers the cell grown by 2^k texels, so bounds any trilinear sample within the cell from levels up to k
+    void buildMacroCells(const VolumeGrid& source, const std::vector<VolumeGrid>& mips, std::vector<float>& cells, ThreadPool* pool = nullptr);
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "Data/Hash.h"
+#include "Rendering/Volume/VolumeStructs.h"
+
+namespace Haboob
+{
+  // Parameter hashes of each stage in the haboob volume pipeline:
+  // fBM field -> shape field -> combine -> mips
+  struct VolumeStageHashes
+  {
+    uint64_t fbm; // Size and noise parameters
+    uint64_t shape; // Size, radial and distribution parameters (apart from the falloff)
+    uint64_t combine; // Both input stages, the falloff and the fBM alteration
+
+    static VolumeStageHashes compute(const VolumeInfo& info);
+  };
+
+  // Remembers the parameter hash a stage was last computed from
+  class VolumeStage
+  {
+    public:
+    VolumeStage() : builtHash{ 0 }, built{ false }, runs{ 0 } {}
+
+    inline bool isDirty(uint64_t hash) const { return !built || hash != builtHash; }
+    inline void markBuilt(uint64_t hash) { builtHash = hash; built = true; ++runs; }
+    inline void invalidate() { built = false; }
+
+    inline UInt getRunCount() const { return runs; }
+
+    private:
+    uint64_t builtHash;
+    bool built;
+    UInt runs; // Times this stage was computed
+  };
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include "Data/Defs.h"
+#include "Data/MathCore.h"
+
+namespace Haboob
+{
+  // Mirrors the cbuffer layout consumed by TestShaders/TestFormHaboob.cs
+  struct HaboobRadial
+  {
+    float roofGradient = -3.58f;
+    float exponentialRate = 8.36f;
+    float exponentialScale = .22f;
+    float rOffset = .36f;
+    float noseHeight = .19f;
+    float blendHeight = .87f;
+    float blendRate = 1.45f;
+    float padding = .0f;
+  };
+
+  struct HaboobDistribution
+  {
+    float falloffScale = .22f;
+    float heightScale = 5.52f;
+    float heightExponent = .74f;
+    float angleRange = 4.33f;
+    float anglePower = 3.26f;
+    XMFLOAT3 padding;
+  };
+
+  // How the haboob evolves over time, folded into the static parameters by VolumeInfo::getSnapshot
+  struct HaboobMotion
+  {
+    float time = .0f; // Seconds since the state the other parameters describe
+    float fbmAdvection = .05f; // fBM offset drift per second
+    float frontSpeed = .02f; // Leading edge (radial offset) growth per second
+    float padding = .0f;
+  };
+
+  struct VolumeInfo
+  {
+    XMINT3 size = {128, 128, 128}; // Texture size
+    UInt padding;
+
+    // Proc gen params
+    XMUINT4 seed = { 0x12345, 0xCAFEBABE, 0xDEADBEEF, 0 };
+
+    float worldSize = 5.f;
+    float octaves = 3.1f;
+    float fractionalGap = 4.4f;
+    float fractionalIncrement = 0.99f;
+
+    float fbmOffset = .1f;
+    float fbmScale = .4f;
+    float wackyPower = .32f;
+    float wackyScale = .31f;
+
+    HaboobRadial radial;
+    HaboobDistribution distribution;
+    HaboobMotion motion;
+
+    // The static volume at motion.time, which is what gets generated, hashed and cached
+    inline VolumeInfo getSnapshot() const
+    {
+      VolumeInfo snapshot = *this;
+      snapshot.fbmOffset += motion.fbmAdvection * motion.time;
+      snapshot.radial.rOffset += motion.frontSpeed * motion.time;
+      snapshot.motion.time = .0f;
+      return snapshot;
+    }
+  };
+
+  // A single texel of the haboob volume (R11G11B10 on the GPU)
+  struct VolumeElement
+  {
+    float density; // R11
+    float maxDensity; // G11
+    float angstromExponent; // B10
+  };
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "Data/Defs.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Haboob
+{
+  // A fixed set of worker threads consuming a shared job queue
+  class ThreadPool
+  {
+    public:
+    ThreadPool(UInt threadCount = 0); // 0 = one worker per hardware thread
+    ~ThreadPool();
+
+    // Queues a job to run on any worker
+    void enqueue(const std::function<void()>& job);
+
+    // Runs job(index) for every index in [0, count) across the workers and blocks until all are done
+    // (must not be called from a job, the caller waits on the workers)
+    void parallelFor(UInt count, const std::function<void(UInt)>& job);
+
+    inline UInt getThreadCount() const { return UInt(workers.size()); }
+
+    private:
+    void work();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex jobMutex;
+    std::condition_variable jobSignal;
+    bool stopping;
+  };
+}
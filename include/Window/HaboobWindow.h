@@ -13,6 +13,7 @@
 #include "Rendering/Lighting/LightStructs.h"
 #include "Rendering/Textures/RenderTarget.h"
 #include "Rendering/Shaders/RaymarchVolumeShader.h"
+#include "Rendering/Volume/VolumeAnimator.h"
 #include "Rendering/Textures/GBuffer.h"
 #include "Rendering/Scene/Scene.h"
 #include "Rendering/Lighting/LightSource.h"
@@ -56,6 +57,7 @@ namespace Haboob
     LRESULT customRoutine(UINT message, WPARAM wParam, LPARAM lParam) override;
 
     void setupDefaults();
+    void updateMacros(); // Mirrors the settings to shader macros
 
     // Captures the backbuffer and saves to file
     HRESULT exportFrame(); // Slow
@@ -81,6 +83,8 @@ namespace Haboob
 
     // Top level args
     args::ValueFlag<std::string>* exportPathFlag;
+    args::ValueFlag<std::string>* volumeCacheFlag;
+    args::ValueFlag<std::string>* shaderCacheFlag;
     std::wstring exportLocation;
     bool showWindow; // Window should be displayed
     bool dynamicResolution; // Scale with window?
@@ -104,10 +108,18 @@ namespace Haboob
     bool showAngstrom;
     bool showSampleLevel;
     bool renderHaboob;
+    bool animateHaboob;
+    float haboobTimeStep; // Seconds of haboob motion per frame when animating
     bool renderScene;
     bool coneTrace;
     bool upscaleTracing;
     bool manualMarch;
+    bool skipEmptySpace;
+    bool adaptiveMarch;
+    bool progressiveMarch;
+    bool transmissionLUT;
+    bool analyticRays;
+    bool tileList;
     bool showBoundingBoxes;
     bool showMasks;
     bool showRayTravel;
@@ -130,6 +142,10 @@ namespace Haboob
     SimpleSphereMesh sphereMesh;
     SimpleCubeMesh cubeMesh;
     VolumeGenerationShader haboobVolume;
+    VolumeCache volumeCache; // Baked volumes shared between launches
+    ThreadPool volumePool; // CPU volume work such as mip building
+    ThreadPool shaderPool; // Shader compilation
+    VolumeAnimator haboobAnimator; // Bakes the next time step while the current one renders
 
     // Scene objects
     Scene scene;
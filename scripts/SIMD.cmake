@@ -0,0 +1,26 @@
+# Per instruction set kernel sources, picked at runtime by SIMD::detectLevel (include/Data/SIMD.h)
+# MSVC accepts every intrinsic as is, GCC and Clang need the instruction set enabled per file
+# FP contraction is disabled so kernels round exactly like the scalar path
+get_filename_component(SIMD_SOURCE_ROOT "${CMAKE_CURRENT_LIST_DIR}/../src" ABSOLUTE)
+
+set(SIMDSources_SSE4
+  ${SIMD_SOURCE_ROOT}/Procedural/NoiseKernelsSSE4.cpp
+  ${SIMD_SOURCE_ROOT}/Data/PackedFloatKernelsSSE4.cpp
+  ${SIMD_SOURCE_ROOT}/Rendering/Raymarch/MarchKernelsSSE4.cpp
+)
+set(SIMDSources_AVX2
+  ${SIMD_SOURCE_ROOT}/Procedural/NoiseKernelsAVX2.cpp
+  ${SIMD_SOURCE_ROOT}/Data/PackedFloatKernelsAVX2.cpp
+  ${SIMD_SOURCE_ROOT}/Rendering/Raymarch/MarchKernelsAVX2.cpp
+)
+set(SIMDSources_AVX512
+  ${SIMD_SOURCE_ROOT}/Procedural/NoiseKernelsAVX512.cpp
+  ${SIMD_SOURCE_ROOT}/Data/PackedFloatKernelsAVX512.cpp
+  ${SIMD_SOURCE_ROOT}/Rendering/Raymarch/MarchKernelsAVX512.cpp
+)
+
+if(NOT MSVC AND CMAKE_SYSTEM_PROCESSOR MATCHES "(x86_64|AMD64|amd64|i.86)")
+  set_source_files_properties(${SIMDSources_SSE4} PROPERTIES COMPILE_OPTIONS "-msse4.1;-ffp-contract=off")
+  set_source_files_properties(${SIMDSources_AVX2} PROPERTIES COMPILE_OPTIONS "-mavx2;-ffp-contract=off")
+  set_source_files_properties(${SIMDSources_AVX512} PROPERTIES COMPILE_OPTIONS "-mavx512f;-ffp-contract=off")
+endif()
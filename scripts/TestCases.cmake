@@ -1,2 +1,65 @@
-add_executable(TestApp ${CMAKE_CURRENT_LIST_DIR}/../src/Testing/Tests.cpp)
-target_link_libraries(TestApp Catch2::Catch2WithMain)
\ No newline at end of file
+# Sources which build without D3D, shared by the headless test and benchmark apps
+set(PortableSources
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Data/SIMD.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Data/MappedFile.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Data/FileCache.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Data/PackedFloatKernels.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Data/HDRImage.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Threading/ThreadPool.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Procedural/NoiseKernels.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Procedural/GradientLattice.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Procedural/BlueNoise.cpp
+  ${SIMDSources_SSE4}
+  ${SIMDSources_AVX2}
+  ${SIMDSources_AVX512}
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Volume/VolumeStages.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Volume/BrickedVolume.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Volume/VolumeGenerator.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Volume/VolumeMips.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Volume/VolumeCache.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Volume/VolumeAnimator.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Raymarch/MarchKernels.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Raymarch/SpectralOptics.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Raymarch/RayExtents.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Raymarch/ReferenceMarcher.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Shaders/ShaderPermutations.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Shaders/ShaderDependencies.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Shaders/ShaderBlobCache.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Shaders/ShaderCompileQueue.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Rendering/Shaders/ShaderIncludeStore.cpp
+)
+find_package(Threads REQUIRED)
+
+add_executable(TestApp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Testing/Tests.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Testing/VolumeTests.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Testing/NoiseKernelTests.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Testing/VolumeCacheTests.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Testing/PackedFloatTests.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Testing/ReferenceMarcherTests.cpp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Testing/ShaderTests.cpp
+  ${PortableSources}
+)
+target_include_directories(TestApp PRIVATE ${CMAKE_CURRENT_LIST_DIR}/../include)
+target_compile_definitions(TestApp PRIVATE HABOOB_SHADER_DIRECTORY="${CMAKE_CURRENT_LIST_DIR}/../shaders")
+target_compile_features(TestApp PUBLIC cxx_std_17)
+target_link_libraries(TestApp Catch2::Catch2WithMain Threads::Threads)
+
+# Benchmarks are hidden test cases, run with: BenchApp "[bench]"
+add_executable(BenchApp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Testing/Benchmarks.cpp
+  ${PortableSources}
+)
+target_include_directories(BenchApp PRIVATE ${CMAKE_CURRENT_LIST_DIR}/../include)
+target_compile_features(BenchApp PUBLIC cxx_std_17)
+target_link_libraries(BenchApp Catch2::Catch2WithMain Threads::Threads)
+
+# Headless ground truth renders on the CPU, run with: ReferenceApp --it=100 --w=1024 --h=1024 --o="GroundTruth.dds"
+add_executable(ReferenceApp
+  ${CMAKE_CURRENT_LIST_DIR}/../src/Testing/ReferenceRender.cpp
+  ${PortableSources}
+)
+target_include_directories(ReferenceApp PRIVATE ${CMAKE_CURRENT_LIST_DIR}/../include)
+target_compile_definitions(ReferenceApp PRIVATE HABOOB_REFERENCE_APP)
+target_compile_features(ReferenceApp PUBLIC cxx_std_17)
+target_link_libraries(ReferenceApp args Threads::Threads)
@@ -0,0 +1,19 @@
+#include "HaboobCommon.lib"
+
+Texture3D<float> noiseField : register(t0);
+Texture1D<float4> heightField : register(t1);
+Texture2D<float2> planeField : register(t2);
+
+RWTexture3D<VolumeElement> textureOut : register(u0);
+
+// Stage 3, combines the fields into the haboob volume
+[numthreads(8, 8, 8)]
+void main(int3 groupThreadID : SV_GroupThreadID, int3 threadID : SV_DispatchThreadID)
+{
+  if (any(threadID >= info.size))
+  {
+    return;
+  }
+  
+  textureOut[threadID.xyz] = haboobCombine(noiseField[threadID.xyz], heightField[threadID.y].xyz, planeField[threadID.xz]);
+}
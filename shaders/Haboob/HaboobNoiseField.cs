@@ -0,0 +1,15 @@
+#include "HaboobCommon.lib"
+
+RWTexture3D<float> noiseOut : register(u0);
+
+// Stage 1, the fBM field
+[numthreads(8, 8, 8)]
+void main(int3 groupThreadID : SV_GroupThreadID, int3 threadID : SV_DispatchThreadID)
+{
+  if (any(threadID >= info.size))
+  {
+    return;
+  }
+  
+  noiseOut[threadID.xyz] = haboobFBM(threadID);
+}
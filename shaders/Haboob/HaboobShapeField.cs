@@ -0,0 +1,20 @@
+#include "HaboobCommon.lib"
+
+RWTexture1D<float4> heightOut : register(u0);
+RWTexture2D<float2> planeOut : register(u1);
+
+// Stage 2, the separable shape terms
+// Dispatched over (max(size.x, size.y), size.z), the first row also covers the height terms
+[numthreads(8, 8, 1)]
+void main(int3 groupThreadID : SV_GroupThreadID, int3 threadID : SV_DispatchThreadID)
+{
+  if (threadID.x < info.size.x && threadID.y < info.size.z)
+  {
+    planeOut[threadID.xy] = haboobPlaneTerms(threadID.xy);
+  }
+  
+  if (threadID.y == 0 && threadID.x < info.size.y)
+  {
+    heightOut[threadID.x] = float4(haboobHeightTerms(threadID.x), .0);
+  }
+}
@@ -0,0 +1,77 @@
+#include "../Utility/Globals.lib"
+#include "RaymarchCommon.lib"
+#include "../Utility/MeshCommon.lib"
+
+Texture2D<float4> normalDepthTexture : register(t0);
+SamplerState sampler0 : register(s0);
+
+cbuffer CameraSlot : register(b0)
+{
+  CameraBuffer camera;
+}
+
+cbuffer MarchSlot : register(b1)
+{
+  MarchVolumeDispatchInfo dispatchInfo;
+  BasicOptics opticalInfo;
+}
+
+RWTexture2D<float4> rayInformation : register(u0);
+
+// Replaces the front and back facing visibility passes, intersecting each pixel's ray with the volume cube directly (as RayExtents::trace)
+// Writes (entry depth, exit depth, screen x, screen y), -ve depths masking the pixel and an entry of 0 starting at the near plane
+[numthreads(16, 16, 1)]
+void main(int3 groupThreadID : SV_GroupThreadID, int3 threadID : SV_DispatchThreadID)
+{
+  uint width, height;
+  rayInformation.GetDimensions(width, height);
+  if (threadID.x >= int(width) || threadID.y >= int(height)) { return; }
+
+  // The pixel centre, as rasterisation samples it
+  float2 normScreen = float2((float(threadID.x) + .5) / float(width) * 2. - 1., 1. - (float(threadID.y) + .5) / float(height) * 2.);
+
+  // Along the pixel's ray in volume space (homogeneous), origin + z * along for NDC depth z
+  float4x4 screenToLocal = mul(camera.inverseViewProjectionMatrix, dispatchInfo.localVolumeTransform);
+  float4 origin = mul(float4(normScreen, .0, 1.), screenToLocal);
+  float4 along = screenToLocal[2];
+
+  // w keeps its sign from the camera to beyond the far plane, so each face is a linear inequality in z
+  float flip = origin.w < .0 ? -1. : 1.;
+  origin *= flip;
+  along *= flip;
+
+  // (side * local - .5 * w) <= 0 for both sides of each axis
+  float3 offsets[2] = { -origin.xyz - .5 * origin.w, origin.xyz - .5 * origin.w };
+  float3 slopes[2] = { -along.xyz - .5 * along.w, along.xyz - .5 * along.w };
+  float entry = -3.402823466e+38;
+  float exit = 1.;
+  bool hit = true;
+
+  [unroll]
+  for (int side = 0; side < 2; ++side)
+  {
+    [unroll]
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      float offset = offsets[side][axis];
+      float slope = slopes[side][axis];
+      if (slope > .0) { exit = min(exit, -offset / slope); }
+      else if (slope < .0) { entry = max(entry, -offset / slope); }
+      else if (offset > .0) { hit = false; }
+    }
+  }
+
+  if (!hit || entry > exit || exit < .0)
+  {
+    rayInformation[threadID.xy] = float4(-1., -1., .0, 1.);
+    return;
+  }
+
+  // Either the existing depth or bound extremity
+  float sceneDepth = normalDepthTexture.SampleLevel(sampler0, screenToTexel(normScreen), .0).w;
+  float4 output;
+  output.x = entry < .0 ? .0 : (entry < sceneDepth ? entry : -1.);
+  output.y = min(exit, sceneDepth);
+  output.zw = normScreen;
+  rayInformation[threadID.xy] = output;
+}
@@ -5,6 +5,9 @@ RWTexture2D<float4> rays : register(u0);
 RWTexture2D<float4> bsmOut : register(u1);
 Texture3D<float3> volumeTexture : register(t0);
 SamplerState volumeSampler : register(s0);
+#if APPLY_TILE_LIST
+  StructuredBuffer<uint> marchTiles : register(t1);
+#endif
 
 // Of the light source perspective
 cbuffer CameraSlot : register(b0)
@@ -23,9 +26,14 @@ cbuffer LightSlot : register(b2)
   DirectionalLight light;
 }
 
-[numthreads(16, 16, 1)]
-void main(int3 groupThreadID : SV_GroupThreadID, int3 threadID : SV_DispatchThreadID)
+[numthreads(MARCH_TILE_SIZE, MARCH_TILE_SIZE, 1)]
+void main(int3 groupThreadID : SV_GroupThreadID, int3 groupID : SV_GroupID, int3 dispatchThreadID : SV_DispatchThreadID)
 {
+  #if APPLY_TILE_LIST
+    int3 threadID = getTileThread(groupThreadID, groupID, marchTiles);
+  #else
+    int3 threadID = dispatchThreadID;
+  #endif
   int2 screenPosition;
   float4 rayParams;
   fetchPixelRayInfo(screenPosition, rayParams, threadID.xy, rays);
@@ -0,0 +1,31 @@
+#include "MarchVolumeMacros.lib"
+
+RWTexture2D<float4> rays : register(u0);
+AppendStructuredBuffer<uint> activeTiles : register(u1);
+
+groupshared uint tileActive;
+
+// Appends each march thread group with an unmasked ray, packed as x | y << 16, so the march is dispatched indirectly over only those
+// Run over the same groups the march would be, reading the rays exactly as it does
+[numthreads(MARCH_TILE_SIZE, MARCH_TILE_SIZE, 1)]
+void main(int3 groupThreadID : SV_GroupThreadID, int3 groupID : SV_GroupID, int3 threadID : SV_DispatchThreadID)
+{
+  bool first = groupThreadID.x == 0 && groupThreadID.y == 0;
+  if (first) { tileActive = 0; }
+  GroupMemoryBarrierWithGroupSync();
+  
+  int2 screenPosition;
+  float4 rayParams;
+  fetchPixelRayInfo(screenPosition, rayParams, threadID.xy, rays);
+  
+  // Padding threads past the target read zeros, which would pass as unmasked
+  uint width, height;
+  rays.GetDimensions(width, height);
+  if (screenPosition.x < int(width) && screenPosition.y < int(height) && isRayMasked(rayParams) == 0)
+  {
+    InterlockedOr(tileActive, 1);
+  }
+  GroupMemoryBarrierWithGroupSync();
+  
+  if (first && tileActive != 0) { activeTiles.Append(uint(groupID.x) | (uint(groupID.y) << 16)); }
+}
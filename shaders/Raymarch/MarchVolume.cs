@@ -5,8 +5,19 @@ RWTexture2D<float4> screenOut : register(u0);
 Texture3D<float3> volumeTexture : register(t0);
 Texture2D<float4> directShadowTexture : register(t1);
 Texture2D<float4> beerMapTexture : register(t2);
+Buffer<float> macroCells : register(t3);
+Texture2D<float> blueNoiseTexture : register(t4);
+RWTexture2D<float4> historyOut : register(u1);
+Texture2DArray<float4> transmissionLUT : register(t5);
 SamplerState volumeSampler : register(s0);
 SamplerState shadowSampler : register(s1);
+SamplerState transmissionLUTSampler : register(s2);
+
+#if APPLY_TILE_LIST
+  // The results go to their own target, leaving the rays intact for any group still to read them
+  RWTexture2D<float4> rayInformation : register(u2);
+  StructuredBuffer<uint> marchTiles : register(t6);
+#endif
 
 cbuffer CameraSlot : register(b0)
 {
@@ -29,12 +40,53 @@ cbuffer LightCameraSlot : register(b3)
   CameraBuffer lightCamera;
 }
 
-[numthreads(16, 16, 1)]
-void main(int3 groupThreadID : SV_GroupThreadID, int3 threadID : SV_DispatchThreadID)
+// Writes a result, blended into the running average of the frames before when progressive
+void writeResult(int2 position, float4 result)
+{
+  #if APPLY_PROGRESSIVE
+    result = lerp(historyOut[position], result, dispatchInfo.accumulationWeight);
+    historyOut[position] = result;
+  #endif
+  screenOut[position] = result;
+}
+
+// Irradiance reaching the eye from a sample, as CIE X1_Y_Z_X2
+float4 getIrradianceSample(float4 directIrradiance, float opticalDepth, float angstrom, float scatterOpticalDepth, float scatterAngstrom)
+{
+  #if APPLY_SPECTRAL
+    #if APPLY_TRANSMISSION_LUT
+      float4x4 transmissions = lookupTransmissions(opticalDepth, angstrom, opticalInfo, transmissionLUT, transmissionLUTSampler) *
+        lookupTransmissions(scatterOpticalDepth, scatterAngstrom, opticalInfo, transmissionLUT, transmissionLUTSampler);
+    #else
+      // Cache the wavelength matrix
+      float4x4 wavelengths = getSpectralWavelengths(opticalInfo);
+      
+      // Compute falloff per wavelength
+      float4x4 transmissions = Transmission(opticalDepth * spectralScatter(wavelengths, angstrom)) * Transmission(scatterOpticalDepth  * spectralScatter(wavelengths, scatterAngstrom));
+    #endif
+      
+    // Determine weighted transmission of irradiance across wavelengths
+    float4x4 integratorRadiance = mul(diagonal(directIrradiance), transmissions) * opticalInfo.spectralWeights;
+      
+    // Sum up all wavelength contributions
+    return mul(integratorRadiance, ONE_VEC);
+  #else
+    return Transmission(opticalDepth) * Transmission(scatterOpticalDepth) * directIrradiance;
+  #endif
+}
+
+[numthreads(MARCH_TILE_SIZE, MARCH_TILE_SIZE, 1)]
+void main(int3 groupThreadID : SV_GroupThreadID, int3 groupID : SV_GroupID, int3 dispatchThreadID : SV_DispatchThreadID)
 {
   int2 screenPosition;
   float4 rayParams;
-  fetchPixelRayInfo(screenPosition, rayParams, threadID.xy, screenOut);
+  #if APPLY_TILE_LIST
+    int3 threadID = getTileThread(groupThreadID, groupID, marchTiles);
+    fetchPixelRayInfo(screenPosition, rayParams, threadID.xy, rayInformation);
+  #else
+    int3 threadID = dispatchThreadID;
+    fetchPixelRayInfo(screenPosition, rayParams, threadID.xy, screenOut);
+  #endif
   
   // Mask fragments
   if (isRayMasked(rayParams) > 0) 
@@ -42,7 +94,7 @@ void main(int3 groupThreadID : SV_GroupThreadID, int3 threadID : SV_DispatchThre
     #if SHOW_MASK
     screenOut[threadID.xy] = float4(100., 100., 100., 1.);
     #else
-    screenOut[threadID.xy] = float4(.0, .0, .0, 1.);
+    writeResult(threadID.xy, float4(.0, .0, .0, 1.));
     #endif
     return; 
   }
@@ -97,6 +149,52 @@ void main(int3 groupThreadID : SV_GroupThreadID, int3 threadID : SV_DispatchThre
   // Jump ray forward
   march(ray, params.initialStep);
   
+  #if APPLY_PROGRESSIVE
+    // Start up to a step further by the blue noise tile, without counting it as travelled so the integrals keep their range
+    float jitter = frac(blueNoiseTexture[threadID.xy & (BLUE_NOISE_SIZE - 1)] + dispatchInfo.jitterOffset);
+    ray.pos += ray.dir * jitter * params.marchZStep;
+  #endif
+  
+  #if MARCH_SKIP
+    // Spend the steps only within occupied macro cells, over the distance they would have covered
+    float travelLength = params.marchZStep * float(params.iterations);
+    float initialTravel = ray.travelDistance;
+    float4 origin = ray.pos;
+    float occupiedLength = .0;
+    MacroWalk walk;
+    if (beginMacroWalk(walk, ray, travelLength, dispatchInfo, volumeTexture))
+    {
+      [loop]
+      while (walk.t < walk.exit)
+      {
+        occupiedLength += isMacroCellOccupied(walk, initialTravel, dispatchInfo, macroCells) ? max(macroCellExit(walk) - walk.t, .0) : .0;
+        stepMacroWalk(walk);
+      }
+    }
+    
+    // Nothing but empty space
+    if (occupiedLength <= .0)
+    {
+      writeResult(threadID.xy, float4(.0, .0, .0, 1.));
+      return;
+    }
+    
+    // Samples are placed by their occupied distance while the integrals run over it alone
+    // Scattering is integrated through empty space too, where the optical depth holds, so each gap adds its length by the irradiance either side
+    float fullStep = params.marchZStep;
+    params.marchZStep = occupiedLength / float(params.iterations);
+    beginMacroWalk(walk, ray, travelLength, dispatchInfo, volumeTexture);
+    float walkOccupied = .0; // Occupied distance where the current cell begins
+    float skippedAngstrom = .0; // Over the empty cells walked past
+    float occupied = .0;
+    float skipped = .0;
+    float4 lastIrradiance = ZERO_VEC;
+    float4 gapIrradiance = ZERO_VEC;
+    float4 lastDirectIrradiance = ZERO_VEC;
+    float lastScatterOpticalDepth = .0;
+    float lastScatterAngstrom = .0;
+  #endif
+  
   // Directional lighting will have a constant phase along the ray
   float angularDistance = dot(ray.dir.xyz, -light.direction.xyz);
   float4 ambientIrradiance = float4(light.diffuse, light.diffuse.r);
@@ -105,19 +203,127 @@ void main(int3 groupThreadID : SV_GroupThreadID, int3 threadID : SV_DispatchThre
   float4 incomingIrradianceBlend = lerp(incomingForwardIrradiance, incomingBackwardIrradiance, opticalInfo.phaseBlendWeightTerms);
   ambientIrradiance *= float4(light.ambient, light.ambient.r) * opticalInfo.ambientFraction;
   
+  #if MARCH_ADAPTIVE
+    // Steps scale with the optical depth they leave from and the cone's footprint, and the ray stops once nearly opaque
+    // Samples are no longer evenly spaced, so each integral is a running trapezoid over the steps actually taken
+    float travelLength = params.marchZStep * float(params.iterations);
+    float minStep = params.marchZStep * max(dispatchInfo.minStepScale, 1. / 64.);
+    float maxStep = max(params.marchZStep * dispatchInfo.maxStepScale, minStep);
+    float travel = .0;
+    float stepSize = .0;
+    float stepFloor = .0;
+    float opticalDepth = .0;
+    float angstrom = .0;
+    float lastDensity = .0;
+    float lastAngstrom = .0;
+    float finalTransmission = 1.;
+    float4 lastIrradiance = ZERO_VEC;
+    float4 xyzx = ZERO_VEC;
+    
+    [loop]
+    for (uint i = 0; params.mask && i < uint(travelLength / minStep) * 2 + 2; ++i)
+    {
+      float3 haboobSample = haboobCubeDensitySample(ray, dispatchInfo, volumeSampler, volumeTexture);
+      
+      // A step arriving where the density would take one under half as long is retaken shorter, so edges are resolved entering as leaving
+      if (opticalInfo.attenuationFactor * stepSize * haboobSample.x > 2. * dispatchInfo.stepOpticalDepth && stepSize > stepFloor)
+      {
+        float retake = max(min(.5 * stepSize, dispatchInfo.stepOpticalDepth / (opticalInfo.attenuationFactor * haboobSample.x)), stepFloor);
+        travel += retake - stepSize;
+        march(ray, retake - stepSize);
+        stepSize = retake;
+        continue;
+      }
+      
+      // The first sample closes no step
+      opticalDepth += .5 * stepSize * (lastDensity + haboobSample.x);
+      angstrom += .5 * stepSize * (lastAngstrom + haboobSample.z);
+      lastDensity = haboobSample.x;
+      lastAngstrom = haboobSample.z;
+      
+      float4 shadowTerms = shadowSpace + deltaShadowSpace * ray.travelDistance;
+      float referenceOpticalDepth = opticalInfo.attenuationFactor * opticalDepth;
+      float referenceAngstrom = opticalInfo.absorptionAngstromExponent * angstrom;
+      #if APPLY_BSM
+        float2 bsmValues = getBSMOpticalCoefficients(shadowTerms, beerMapTexture, shadowSampler);
+        float referenceScatterOpticalDepth = bsmValues.x;
+        float referenceScatterAngstrom = bsmValues.y;
+      #else
+        float referenceScatterOpticalDepth = opticalInfo.attenuationFactor * EULER;
+        float referenceScatterAngstrom = opticalInfo.scatterAngstromExponent * EULER;
+      #endif
+      float shadowValue = getExponentialShadowCoefficient(shadowTerms, directShadowTexture, shadowSampler);
+      
+      float4 irradianceSample = getIrradianceSample(ambientIrradiance + shadowValue * incomingIrradianceBlend, referenceOpticalDepth, referenceAngstrom, referenceScatterOpticalDepth, referenceScatterAngstrom);
+      xyzx += .5 * stepSize * (lastIrradiance + irradianceSample);
+      lastIrradiance = irradianceSample;
+      
+      finalTransmission = blTransmission(referenceOpticalDepth);
+      params.mask = finalTransmission >= dispatchInfo.terminationTransmission && travel < travelLength;
+      
+      // Sampling closer than the cone's texels reads the same filtered volume
+      stepFloor = minStep;
+      #if APPLY_CONE_TRACE
+        float worldToTexels = dispatchInfo.texelDensity / dispatchInfo.volumeSize.x;
+        stepFloor = min(max(stepFloor, exp2(getConeSampleLevel(ray, worldToTexels, dispatchInfo)) / worldToTexels), maxStep);
+      #endif
+      stepSize = haboobSample.x > .0 ? dispatchInfo.stepOpticalDepth / (opticalInfo.attenuationFactor * haboobSample.x) : maxStep;
+      stepSize = min(min(max(stepSize, stepFloor), maxStep), travelLength - travel);
+      
+      travel += stepSize;
+      march(ray, stepSize);
+    }
+    
+    #if SHOW_DENSITY
+      screenOut[threadID.xy] = float4(opticalInfo.attenuationFactor * opticalDepth, .0, .0, 1.);
+    #elif SHOW_ANGSTROM
+      screenOut[threadID.xy] = float4(opticalInfo.absorptionAngstromExponent * angstrom, .0, .0, 1.);
+    #elif SHOW_RAY_TRAVEL
+      screenOut[threadID.xy] = float4(travel, 1., 1., 1.);
+    #else
+      writeResult(threadID.xy, float4(spectralToRGB(xyzx, opticalInfo.spectralToRGB), finalTransmission));
+    #endif
+    return;
+  #endif
+  
   // Integrated optical depth and angstrom
-  Integrator absorptionInte = { 0, 0, 0, 0, 0 };
-  Integrator angstromInte = { 0, 0, 0, 0, 0 };
+  RayIntegrator absorptionInte = (RayIntegrator)0;
+  RayIntegrator angstromInte = (RayIntegrator)0;
   
   // Integrated spectral CIE X1_Y_Z_X2
-  Integrator4 irradianceInte;
-  irradianceInte.count = 0;
-  irradianceInte.termBuckets[0] = irradianceInte.termBuckets[1] = irradianceInte.firstTerms = irradianceInte.lastTerms = ZERO_VEC;
+  RayIntegrator4 irradianceInte = (RayIntegrator4)0;
   
   // Must not unroll due to iterative sampling
   [loop]
   for (uint i = 0; i < params.iterations; ++i)
   {
+    #if MARCH_SKIP
+      // Walk on to the cell holding this occupied distance
+      [loop]
+      while (walk.t < walk.exit)
+      {
+        float cellLength = max(macroCellExit(walk) - walk.t, .0);
+        if (isMacroCellOccupied(walk, initialTravel, dispatchInfo, macroCells))
+        {
+          if (occupied < walkOccupied + cellLength) { break; }
+          walkOccupied += cellLength;
+        }
+        else { skippedAngstrom += macroCellAngstrom(walk, volumeTexture); }
+        stepMacroWalk(walk);
+      }
+      
+      float travel = min(walk.t + occupied - walkOccupied, walk.exit);
+      ray.pos = origin + ray.dir * travel;
+      ray.travelDistance = initialTravel + travel;
+      float range = skipRange(float(i + 1), params.marchZStep, fullStep, ray.travelDistance, travel);
+      float gap = travel - occupied - skipped;
+      float gapAngstrom = skippedAngstrom;
+      skipped += gap;
+    #else
+      float range = ray.travelDistance;
+      float gapAngstrom = .0;
+    #endif
+    
     // Accumulate absorption from density
     {
       float3 haboobSample = haboobCubeDensitySample(ray, dispatchInfo, volumeSampler, volumeTexture);
@@ -133,8 +339,8 @@ void main(int3 groupThreadID : SV_GroupThreadID, int3 threadID : SV_DispatchThre
     float4 shadowTerms = shadowSpace + deltaShadowSpace * ray.travelDistance;
     
     // Integrate the direct optical depth + angstrom along the ray
-    float referenceOpticalDepth = opticalInfo.attenuationFactor * integrate(absorptionInte, ray.travelDistance);
-    float referenceAngstrom = opticalInfo.absorptionAngstromExponent * integrate(angstromInte, ray.travelDistance);
+    float referenceOpticalDepth = opticalInfo.attenuationFactor * integrate(absorptionInte, range);
+    float referenceAngstrom = opticalInfo.absorptionAngstromExponent * (integrate(angstromInte, range) + gapAngstrom);
     
     // Determine the integrated optical depth + angstrom value along the incoming light ray according to the BSM
     #if APPLY_BSM
@@ -153,35 +359,37 @@ void main(int3 groupThreadID : SV_GroupThreadID, int3 threadID : SV_DispatchThre
     // Accumulate intensity as a function of optical thickness
     {
       float4 directIrradiance = ambientIrradiance + shadowValue * incomingIrradianceBlend;
-      #if APPLY_SPECTRAL
-        // Cache the wavelength matrix
-        float4x4 wavelengths = getSpectralWavelengths(opticalInfo);
-      
-        // Compute falloff per wavelength
-        float4x4 transmissions = Transmission(referenceOpticalDepth * spectralScatter(wavelengths, referenceAngstrom)) * Transmission(referenceScatterOpticalDepth  * spectralScatter(wavelengths, referenceScatterAngstrom));
-      
-        // Determine weighted transmission of irradiance across wavelengths
-        float4x4 integratorRadiance = mul(diagonal(directIrradiance), transmissions) * opticalInfo.spectralWeights;
+      float4 irradianceSample = getIrradianceSample(directIrradiance, referenceOpticalDepth, referenceAngstrom, referenceScatterOpticalDepth, referenceScatterAngstrom);
+      append4(irradianceInte, irradianceSample);
       
-        // Sum up all wavelength contributions
-        float4 irradianceSample = mul(integratorRadiance, ONE_VEC);
-      #else
-        float4 irradianceSample = Transmission(referenceOpticalDepth) * Transmission(referenceScatterOpticalDepth) * directIrradiance;
+      #if MARCH_SKIP
+        gapIrradiance += gap * .5 * (lastIrradiance + irradianceSample);
+        lastIrradiance = irradianceSample;
+        lastDirectIrradiance = directIrradiance;
+        lastScatterOpticalDepth = referenceScatterOpticalDepth;
+        lastScatterAngstrom = referenceScatterAngstrom;
       #endif
-      
-      append4(irradianceInte, irradianceSample);
     }
     
     // March again!
     march(ray, params.marchZStep);
+    #if MARCH_SKIP
+      occupied += params.marchZStep;
+    #endif
   }
   
+  #if MARCH_SKIP
+    float finalRange = skipRange(float(params.iterations), params.marchZStep, fullStep, initialTravel + travelLength, travelLength - fullStep);
+  #else
+    float finalRange = ray.travelDistance;
+  #endif
+  
   // Debug/testing outputs
   #if SHOW_DENSITY
-    screenOut[threadID.xy] = float4(opticalInfo.attenuationFactor * integrate(absorptionInte, ray.travelDistance), .0, .0, 1.);
+    screenOut[threadID.xy] = float4(opticalInfo.attenuationFactor * integrate(absorptionInte, finalRange), .0, .0, 1.);
     return;
   #elif SHOW_ANGSTROM
-    screenOut[threadID.xy] = float4(opticalInfo.absorptionAngstromExponent * integrate(angstromInte, ray.travelDistance), .0, .0, 1.);
+    screenOut[threadID.xy] = float4(opticalInfo.absorptionAngstromExponent * integrate(angstromInte, finalRange), .0, .0, 1.);
     return;
   #elif SHOW_SAMPLE_LEVEL
     float4 sampleLevelInfo = float4(.0, getConeSampleLevel(ray, dispatchInfo.texelDensity / dispatchInfo.volumeSize.x), .0, 1.);
@@ -195,11 +403,28 @@ void main(int3 groupThreadID : SV_GroupThreadID, int3 threadID : SV_DispatchThre
   #endif
   
   // Background transmission, assume uniform behaviour across wavelengths (use Beer-Lambert over powder)
-  float finalTransmission = blTransmission(opticalInfo.attenuationFactor * integrate(absorptionInte, ray.travelDistance));
+  float finalOpticalDepth = opticalInfo.attenuationFactor * integrate(absorptionInte, finalRange);
+  float finalTransmission = blTransmission(finalOpticalDepth);
+  
+  float4 xyzx = integrate4(irradianceInte, finalRange);
+  #if MARCH_SKIP
+    // Through to where the ray would have ended, with the angstrom exponent of every empty cell left
+    [loop]
+    while (walk.t < walk.exit)
+    {
+      if (!isMacroCellOccupied(walk, initialTravel, dispatchInfo, macroCells)) { skippedAngstrom += macroCellAngstrom(walk, volumeTexture); }
+      stepMacroWalk(walk);
+    }
+    
+    float trailingGap = max(travelLength - occupied - skipped, .0);
+    float finalAngstrom = opticalInfo.absorptionAngstromExponent * (integrate(angstromInte, finalRange) + skippedAngstrom);
+    float4 trailingIrradiance = getIrradianceSample(lastDirectIrradiance, finalOpticalDepth, finalAngstrom, lastScatterOpticalDepth, lastScatterAngstrom);
+    xyzx += gapIrradiance + trailingGap * .5 * (lastIrradiance + trailingIrradiance);
+  #endif
   
   // Determine final colour
-  float3 finalIrradiance = spectralToRGB(integrate4(irradianceInte, ray.travelDistance), opticalInfo.spectralToRGB);
+  float3 finalIrradiance = spectralToRGB(xyzx, opticalInfo.spectralToRGB);
   
   // Set as irradiance from the volume with alpha = background transmission
-  screenOut[threadID.xy] = float4(finalIrradiance, finalTransmission);
+  writeResult(threadID.xy, float4(finalIrradiance, finalTransmission));
 }
\ No newline at end of file
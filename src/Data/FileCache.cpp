@@ -0,0 +1,138 @@
+#include "Data/FileCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace Haboob
+{
+  FileCache::FileCache(const std::filesystem::path& directory, Literal extension, uint64_t capacity) : directory{ directory }, extension{ extension }, capacity{ capacity }
+  {
+
+  }
+
+  std::filesystem::path FileCache::getPath(uint64_t key) const
+  {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << extension;
+    return directory / name.str();
+  }
+
+  bool FileCache::write(uint64_t key, const Writer& writer) const
+  {
+    if (!isEnabled()) { return false; }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    // Named apart from any other thread's or launch's, as they may write the same entry at once
+    std::filesystem::path path = getPath(key);
+    std::filesystem::path staging = path;
+    std::ostringstream suffix;
+    suffix << "." << std::hex << std::random_device()() << ".tmp";
+    staging += suffix.str();
+
+    bool written = false;
+    {
+      std::ofstream out(staging, std::ios::binary | std::ios::trunc);
+      writer(out);
+
+      out.close();
+      written = !out.fail();
+    }
+
+    if (written) { std::filesystem::rename(staging, path, error); }
+    if (!written || error)
+    {
+      std::filesystem::remove(staging, error);
+      return false;
+    }
+
+    evict(path);
+    return true;
+  }
+
+  void FileCache::touch(uint64_t key) const
+  {
+    std::error_code error;
+    std::filesystem::last_write_time(getPath(key), std::filesystem::file_time_type::clock::now(), error);
+  }
+
+  void FileCache::remove(uint64_t key) const
+  {
+    std::error_code error;
+    std::filesystem::remove(getPath(key), error);
+  }
+
+  uint64_t FileCache::getUsage() const
+  {
+    uint64_t usage = 0;
+
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+      if (entry.is_regular_file(error) && entry.path().extension() == extension)
+      {
+        usage += entry.file_size(error);
+      }
+    }
+
+    return usage;
+  }
+
+  void FileCache::evict() const
+  {
+    evict(std::filesystem::path());
+  }
+
+  void FileCache::evict(const std::filesystem::path& keep) const
+  {
+    struct Entry
+    {
+      std::filesystem::path path;
+      std::filesystem::file_time_type lastUse;
+      uint64_t size;
+    };
+
+    std::vector<Entry> entries;
+    uint64_t usage = 0;
+
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+      if (!entry.is_regular_file(error) || entry.path().extension() != extension) { continue; }
+
+      Entry cached = { entry.path(), entry.last_write_time(error), entry.file_size(error) };
+      usage += cached.size;
+      if (cached.path != keep) { entries.push_back(cached); }
+    }
+
+    // Oldest first
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+    for (const Entry& entry : entries)
+    {
+      if (usage <= capacity) { break; }
+
+      // Mapped files can't be removed on every platform, skip them
+      if (std::filesystem::remove(entry.path, error))
+      {
+        usage -= entry.size;
+      }
+    }
+  }
+
+  void FileCache::clear() const
+  {
+    std::error_code error;
+    std::vector<std::filesystem::path> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+      if (entry.path().extension() == extension) { paths.push_back(entry.path()); }
+    }
+
+    for (const auto& path : paths) { std::filesystem::remove(path, error); }
+  }
+}
@@ -0,0 +1,70 @@
+#include "Data/HDRImage.h"
+
+#include <cstdint>
+#include <fstream>
+
+namespace Haboob
+{
+  namespace
+  {
+    // DDS_HEADER and DDS_HEADER_DXT10 from dds.h, written field by field so no Windows headers are needed
+    constexpr uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+    constexpr uint32_t DDS_HEADER_SIZE = 124;
+    constexpr uint32_t DDS_PIXELFORMAT_SIZE = 32;
+    constexpr uint32_t DDSD_CAPS_HEIGHT_WIDTH_PITCH_PIXELFORMAT = 0x0000100F;
+    constexpr uint32_t DDPF_FOURCC = 0x00000004;
+    constexpr uint32_t FOURCC_DX10 = 0x30315844; // "DX10"
+    constexpr uint32_t DDSCAPS_TEXTURE = 0x00001000;
+    constexpr uint32_t DXGI_FORMAT_R32G32B32A32_FLOAT_VALUE = 2;
+    constexpr uint32_t RESOURCE_DIMENSION_TEXTURE2D = 3;
+  }
+
+  void HDRImage::accumulate(const HDRImage& frame, UInt count)
+  {
+    if (count == 0 || frame.width != width || frame.height != height)
+    {
+      *this = frame;
+      return;
+    }
+
+    float weight = 1.f / float(count + 1);
+    for (size_t i = 0; i < pixels.size(); ++i)
+    {
+      XMFLOAT4& average = pixels[i];
+      const XMFLOAT4& sample = frame.pixels[i];
+      average.x += (sample.x - average.x) * weight;
+      average.y += (sample.y - average.y) * weight;
+      average.z += (sample.z - average.z) * weight;
+      average.w += (sample.w - average.w) * weight;
+    }
+  }
+
+  bool HDRImage::writeDDS(const std::filesystem::path& path) const
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) { return false; }
+
+    uint32_t header[1 + 31 + 5] = {}; // Magic, DDS_HEADER, DDS_HEADER_DXT10
+    header[0] = DDS_MAGIC;
+    header[1] = DDS_HEADER_SIZE;
+    header[2] = DDSD_CAPS_HEIGHT_WIDTH_PITCH_PIXELFORMAT;
+    header[3] = height;
+    header[4] = width;
+    header[5] = width * uint32_t(sizeof(XMFLOAT4)); // Pitch
+    header[7] = 1; // Mip count
+
+    // Pixel format (after the 11 reserved words)
+    header[19] = DDS_PIXELFORMAT_SIZE;
+    header[20] = DDPF_FOURCC;
+    header[21] = FOURCC_DX10;
+    header[27] = DDSCAPS_TEXTURE;
+
+    header[32] = DXGI_FORMAT_R32G32B32A32_FLOAT_VALUE;
+    header[33] = RESOURCE_DIMENSION_TEXTURE2D;
+    header[35] = 1; // Array size
+
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(pixels.data()), std::streamsize(pixels.size() * sizeof(XMFLOAT4)));
+    return bool(out);
+  }
+}
@@ -0,0 +1,120 @@
+#include "Data/MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <utility>
+
+namespace Haboob
+{
+  MappedFile::MappedFile() : data{ nullptr }, size{ 0 }
+  #ifdef _WIN32
+    , fileHandle{ INVALID_HANDLE_VALUE }, mappingHandle{ nullptr }
+  #endif
+  {
+
+  }
+
+  MappedFile::~MappedFile()
+  {
+    close();
+  }
+
+  MappedFile::MappedFile(MappedFile&& other) noexcept : MappedFile()
+  {
+    *this = std::move(other);
+  }
+
+  MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+  {
+    if (this != &other)
+    {
+      close();
+      std::swap(data, other.data);
+      std::swap(size, other.size);
+      #ifdef _WIN32
+      std::swap(fileHandle, other.fileHandle);
+      std::swap(mappingHandle, other.mappingHandle);
+      #endif
+    }
+
+    return *this;
+  }
+
+  bool MappedFile::open(const std::filesystem::path& path)
+  {
+    close();
+
+    #ifdef _WIN32
+    fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) { return false; }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+      close();
+      return false;
+    }
+
+    mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle)
+    {
+      close();
+      return false;
+    }
+
+    data = static_cast<const Byte*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    size = size_t(fileSize.QuadPart);
+    #else
+    int descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) { return false; }
+
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size == 0)
+    {
+      ::close(descriptor);
+      return false;
+    }
+
+    // The mapping holds its own reference to the file
+    void* mapped = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+    ::close(descriptor);
+
+    if (mapped != MAP_FAILED)
+    {
+      data = static_cast<const Byte*>(mapped);
+      size = size_t(status.st_size);
+    }
+    #endif
+
+    if (!data)
+    {
+      close();
+      return false;
+    }
+
+    return true;
+  }
+
+  void MappedFile::close()
+  {
+    #ifdef _WIN32
+    if (data) { UnmapViewOfFile(data); }
+    if (mappingHandle) { CloseHandle(mappingHandle); }
+    if (fileHandle != INVALID_HANDLE_VALUE) { CloseHandle(fileHandle); }
+    mappingHandle = nullptr;
+    fileHandle = INVALID_HANDLE_VALUE;
+    #else
+    if (data) { munmap(const_cast<Byte*>(data), size); }
+    #endif
+
+    data = nullptr;
+    size = 0;
+  }
+}
@@ -0,0 +1,45 @@
+#include "Data/PackedFloatKernels.h"
+
+namespace Haboob
+{
+  namespace PackedFloat
+  {
+    void packBatchScalar(const float* rgb, UInt* out, size_t count)
+    {
+      for (size_t i = 0; i < count; ++i)
+      {
+        out[i] = packR11G11B10(rgb[3 * i], rgb[3 * i + 1], rgb[3 * i + 2]);
+      }
+    }
+
+    void unpackBatchScalar(const UInt* packed, float* rgb, size_t count)
+    {
+      for (size_t i = 0; i < count; ++i)
+      {
+        unpackR11G11B10(packed[i], rgb + 3 * i);
+      }
+    }
+
+    PackBatch getPackBatch(SIMD::Level level)
+    {
+      switch (level)
+      {
+        case SIMD::LEVEL_SSE4: return packBatchSSE4;
+        case SIMD::LEVEL_AVX2: return packBatchAVX2;
+        case SIMD::LEVEL_AVX512: return packBatchAVX512;
+        default: return packBatchScalar;
+      }
+    }
+
+    UnpackBatch getUnpackBatch(SIMD::Level level)
+    {
+      switch (level)
+      {
+        case SIMD::LEVEL_SSE4: return unpackBatchSSE4;
+        case SIMD::LEVEL_AVX2: return unpackBatchAVX2;
+        case SIMD::LEVEL_AVX512: return unpackBatchAVX512;
+        default: return unpackBatchScalar;
+      }
+    }
+  }
+}
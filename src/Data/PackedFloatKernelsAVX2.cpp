@@ -0,0 +1,100 @@
+#include "Data/PackedFloatKernels.h"
+
+// Built with AVX2 enabled (scripts/SIMD.cmake), only called when the CPU supports it
+#ifdef HABOOB_SIMD_X86
+#include <immintrin.h>
+#include "Data/PackedFloatKernelImpl.h"
+
+namespace Haboob
+{
+  namespace PackedFloat
+  {
+    namespace
+    {
+      struct LanesAVX2
+      {
+        static constexpr UInt WIDTH = 8;
+        typedef __m256 Float;
+        typedef __m256i Int;
+        typedef __m256i Mask;
+
+        static inline Float set(float value) { return _mm256_set1_ps(value); }
+        static inline Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+
+        static inline Int setInt(UInt value) { return _mm256_set1_epi32(int(value)); }
+        static inline Int loadInt(const UInt* values) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values)); }
+        static inline void storeInt(UInt* values, Int value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(values), value); }
+        static inline Int addInt(Int a, Int b) { return _mm256_add_epi32(a, b); }
+        static inline Int orInt(Int a, Int b) { return _mm256_or_si256(a, b); }
+        static inline Int andInt(Int a, Int b) { return _mm256_and_si256(a, b); }
+        template<int N> static inline Int shiftLeft(Int a) { return _mm256_slli_epi32(a, N); }
+        template<int N> static inline Int shiftRight(Int a) { return _mm256_srli_epi32(a, N); }
+
+        static inline Mask equalInt(Int a, Int b) { return _mm256_cmpeq_epi32(a, b); }
+        static inline Mask greaterInt(Int a, Int b) { return _mm256_cmpgt_epi32(a, b); }
+        static inline Mask maskOr(Mask a, Mask b) { return _mm256_or_si256(a, b); }
+        static inline Int selectInt(Mask mask, Int onTrue, Int onFalse) { return _mm256_blendv_epi8(onFalse, onTrue, mask); }
+
+        static inline Int asInt(Float a) { return _mm256_castps_si256(a); }
+        static inline Float asFloat(Int a) { return _mm256_castsi256_ps(a); }
+
+        // Truncating, only used for values below 2^24
+        static inline Int toInt(Float a) { return _mm256_cvttps_epi32(a); }
+        static inline Float toFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+
+        // Transposes 8 rgb triples to one vector per channel
+        // Each channel is first blended from whichever of the three vectors holds it per lane, then permuted into order
+        static inline void loadRGB(const float* rgb, Float channels[3])
+        {
+          Float a = _mm256_loadu_ps(rgb), b = _mm256_loadu_ps(rgb + 8), c = _mm256_loadu_ps(rgb + 16);
+
+          Float red = _mm256_blend_ps(_mm256_blend_ps(a, b, 0x92), c, 0x24);
+          Float green = _mm256_blend_ps(_mm256_blend_ps(a, b, 0x24), c, 0x49);
+          Float blue = _mm256_blend_ps(_mm256_blend_ps(a, b, 0x49), c, 0x92);
+          channels[0] = _mm256_permutevar8x32_ps(red, _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+          channels[1] = _mm256_permutevar8x32_ps(green, _mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6));
+          channels[2] = _mm256_permutevar8x32_ps(blue, _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
+        }
+
+        // The inverse of loadRGB
+        static inline void storeRGB(float* rgb, const Float channels[3])
+        {
+          Float red = _mm256_permutevar8x32_ps(channels[0], _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+          Float green = _mm256_permutevar8x32_ps(channels[1], _mm256_setr_epi32(5, 0, 3, 6, 1, 4, 7, 2));
+          Float blue = _mm256_permutevar8x32_ps(channels[2], _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
+
+          _mm256_storeu_ps(rgb, _mm256_blend_ps(_mm256_blend_ps(red, green, 0x92), blue, 0x24));
+          _mm256_storeu_ps(rgb + 8, _mm256_blend_ps(_mm256_blend_ps(red, green, 0x24), blue, 0x49));
+          _mm256_storeu_ps(rgb + 16, _mm256_blend_ps(_mm256_blend_ps(red, green, 0x49), blue, 0x92));
+        }
+      };
+    }
+
+    void packBatchAVX2(const float* rgb, UInt* out, size_t count)
+    {
+      packBatchLanes<LanesAVX2>(rgb, out, count);
+    }
+
+    void unpackBatchAVX2(const UInt* packed, float* rgb, size_t count)
+    {
+      unpackBatchLanes<LanesAVX2>(packed, rgb, count);
+    }
+  }
+}
+#else
+namespace Haboob
+{
+  namespace PackedFloat
+  {
+    void packBatchAVX2(const float* rgb, UInt* out, size_t count)
+    {
+      packBatchScalar(rgb, out, count);
+    }
+
+    void unpackBatchAVX2(const UInt* packed, float* rgb, size_t count)
+    {
+      unpackBatchScalar(packed, rgb, count);
+    }
+  }
+}
+#endif
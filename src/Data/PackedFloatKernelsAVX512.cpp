@@ -0,0 +1,100 @@
+#include "Data/PackedFloatKernels.h"
+
+// Built with AVX-512F enabled (scripts/SIMD.cmake), only called when the CPU supports it
+#ifdef HABOOB_SIMD_X86
+#include <immintrin.h>
+#include "Data/PackedFloatKernelImpl.h"
+
+namespace Haboob
+{
+  namespace PackedFloat
+  {
+    namespace
+    {
+      struct LanesAVX512
+      {
+        static constexpr UInt WIDTH = 16;
+        typedef __m512 Float;
+        typedef __m512i Int;
+        typedef __mmask16 Mask;
+
+        static inline Float set(float value) { return _mm512_set1_ps(value); }
+        static inline Float mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+
+        static inline Int setInt(UInt value) { return _mm512_set1_epi32(int(value)); }
+        static inline Int loadInt(const UInt* values) { return _mm512_loadu_si512(values); }
+        static inline void storeInt(UInt* values, Int value) { _mm512_storeu_si512(values, value); }
+        static inline Int addInt(Int a, Int b) { return _mm512_add_epi32(a, b); }
+        static inline Int orInt(Int a, Int b) { return _mm512_or_si512(a, b); }
+        static inline Int andInt(Int a, Int b) { return _mm512_and_si512(a, b); }
+        template<int N> static inline Int shiftLeft(Int a) { return _mm512_slli_epi32(a, N); }
+        template<int N> static inline Int shiftRight(Int a) { return _mm512_srli_epi32(a, N); }
+
+        static inline Mask equalInt(Int a, Int b) { return _mm512_cmpeq_epi32_mask(a, b); }
+        static inline Mask greaterInt(Int a, Int b) { return _mm512_cmpgt_epi32_mask(a, b); }
+        static inline Mask maskOr(Mask a, Mask b) { return Mask(a | b); }
+        static inline Int selectInt(Mask mask, Int onTrue, Int onFalse) { return _mm512_mask_blend_epi32(mask, onFalse, onTrue); }
+
+        static inline Int asInt(Float a) { return _mm512_castps_si512(a); }
+        static inline Float asFloat(Int a) { return _mm512_castsi512_ps(a); }
+
+        // Truncating, only used for values below 2^24
+        static inline Int toInt(Float a) { return _mm512_cvttps_epi32(a); }
+        static inline Float toFloat(Int a) { return _mm512_cvtepi32_ps(a); }
+
+        // Transposes 16 rgb triples to one vector per channel
+        // Lanes held by the first two vectors are gathered first (zero as a placeholder), then those in the third
+        static inline void loadRGB(const float* rgb, Float channels[3])
+        {
+          Float a = _mm512_loadu_ps(rgb), b = _mm512_loadu_ps(rgb + 16), c = _mm512_loadu_ps(rgb + 32);
+
+          Float red = _mm512_permutex2var_ps(a, _mm512_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 0, 0, 0, 0, 0), b);
+          Float green = _mm512_permutex2var_ps(a, _mm512_setr_epi32(1, 4, 7, 10, 13, 16, 19, 22, 25, 28, 31, 0, 0, 0, 0, 0), b);
+          Float blue = _mm512_permutex2var_ps(a, _mm512_setr_epi32(2, 5, 8, 11, 14, 17, 20, 23, 26, 29, 0, 0, 0, 0, 0, 0), b);
+          channels[0] = _mm512_permutex2var_ps(red, _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 17, 20, 23, 26, 29), c);
+          channels[1] = _mm512_permutex2var_ps(green, _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 18, 21, 24, 27, 30), c);
+          channels[2] = _mm512_permutex2var_ps(blue, _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 16, 19, 22, 25, 28, 31), c);
+        }
+
+        // The inverse of loadRGB, interleaving red and green first then inserting blue
+        static inline void storeRGB(float* rgb, const Float channels[3])
+        {
+          Float a = _mm512_permutex2var_ps(channels[0], _mm512_setr_epi32(0, 16, 0, 1, 17, 0, 2, 18, 0, 3, 19, 0, 4, 20, 0, 5), channels[1]);
+          Float b = _mm512_permutex2var_ps(channels[0], _mm512_setr_epi32(21, 0, 6, 22, 0, 7, 23, 0, 8, 24, 0, 9, 25, 0, 10, 26), channels[1]);
+          Float c = _mm512_permutex2var_ps(channels[0], _mm512_setr_epi32(0, 11, 27, 0, 12, 28, 0, 13, 29, 0, 14, 30, 0, 15, 31, 0), channels[1]);
+
+          _mm512_storeu_ps(rgb, _mm512_permutex2var_ps(a, _mm512_setr_epi32(0, 1, 16, 3, 4, 17, 6, 7, 18, 9, 10, 19, 12, 13, 20, 15), channels[2]));
+          _mm512_storeu_ps(rgb + 16, _mm512_permutex2var_ps(b, _mm512_setr_epi32(0, 21, 2, 3, 22, 5, 6, 23, 8, 9, 24, 11, 12, 25, 14, 15), channels[2]));
+          _mm512_storeu_ps(rgb + 32, _mm512_permutex2var_ps(c, _mm512_setr_epi32(26, 1, 2, 27, 4, 5, 28, 7, 8, 29, 10, 11, 30, 13, 14, 31), channels[2]));
+        }
+      };
+    }
+
+    void packBatchAVX512(const float* rgb, UInt* out, size_t count)
+    {
+      packBatchLanes<LanesAVX512>(rgb, out, count);
+    }
+
+    void unpackBatchAVX512(const UInt* packed, float* rgb, size_t count)
+    {
+      unpackBatchLanes<LanesAVX512>(packed, rgb, count);
+    }
+  }
+}
+#else
+namespace Haboob
+{
+  namespace PackedFloat
+  {
+    void packBatchAVX512(const float* rgb, UInt* out, size_t count)
+    {
+      packBatchScalar(rgb, out, count);
+    }
+
+    void unpackBatchAVX512(const UInt* packed, float* rgb, size_t count)
+    {
+      unpackBatchScalar(packed, rgb, count);
+    }
+  }
+}
+#endif
@@ -0,0 +1,99 @@
+#include "Data/PackedFloatKernels.h"
+
+// Built with SSE4.1 enabled (scripts/SIMD.cmake), only called when the CPU supports it
+#ifdef HABOOB_SIMD_X86
+#include <smmintrin.h>
+#include "Data/PackedFloatKernelImpl.h"
+
+namespace Haboob
+{
+  namespace PackedFloat
+  {
+    namespace
+    {
+      struct LanesSSE4
+      {
+        static constexpr UInt WIDTH = 4;
+        typedef __m128 Float;
+        typedef __m128i Int;
+        typedef __m128i Mask;
+
+        static inline Float set(float value) { return _mm_set1_ps(value); }
+        static inline Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+
+        static inline Int setInt(UInt value) { return _mm_set1_epi32(int(value)); }
+        static inline Int loadInt(const UInt* values) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(values)); }
+        static inline void storeInt(UInt* values, Int value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(values), value); }
+        static inline Int addInt(Int a, Int b) { return _mm_add_epi32(a, b); }
+        static inline Int orInt(Int a, Int b) { return _mm_or_si128(a, b); }
+        static inline Int andInt(Int a, Int b) { return _mm_and_si128(a, b); }
+        template<int N> static inline Int shiftLeft(Int a) { return _mm_slli_epi32(a, N); }
+        template<int N> static inline Int shiftRight(Int a) { return _mm_srli_epi32(a, N); }
+
+        static inline Mask equalInt(Int a, Int b) { return _mm_cmpeq_epi32(a, b); }
+        static inline Mask greaterInt(Int a, Int b) { return _mm_cmpgt_epi32(a, b); }
+        static inline Mask maskOr(Mask a, Mask b) { return _mm_or_si128(a, b); }
+        static inline Int selectInt(Mask mask, Int onTrue, Int onFalse) { return _mm_blendv_epi8(onFalse, onTrue, mask); }
+
+        static inline Int asInt(Float a) { return _mm_castps_si128(a); }
+        static inline Float asFloat(Int a) { return _mm_castsi128_ps(a); }
+
+        // Truncating, only used for values below 2^24
+        static inline Int toInt(Float a) { return _mm_cvttps_epi32(a); }
+        static inline Float toFloat(Int a) { return _mm_cvtepi32_ps(a); }
+
+        // Transposes 4 rgb triples (three vectors r0g0b0r1, g1b1r2g2, b2r3g3b3) to one vector per channel
+        static inline void loadRGB(const float* rgb, Float channels[3])
+        {
+          Float a = _mm_loadu_ps(rgb), b = _mm_loadu_ps(rgb + 4), c = _mm_loadu_ps(rgb + 8);
+
+          Float red = _mm_blend_ps(_mm_blend_ps(a, b, 0x4), c, 0x2); // r0 r3 r2 r1
+          Float green = _mm_blend_ps(_mm_blend_ps(a, b, 0x9), c, 0x4); // g1 g0 g3 g2
+          Float blue = _mm_blend_ps(_mm_blend_ps(a, b, 0x2), c, 0x9); // b2 b1 b0 b3
+          channels[0] = _mm_shuffle_ps(red, red, _MM_SHUFFLE(1, 2, 3, 0));
+          channels[1] = _mm_shuffle_ps(green, green, _MM_SHUFFLE(2, 3, 0, 1));
+          channels[2] = _mm_shuffle_ps(blue, blue, _MM_SHUFFLE(3, 0, 1, 2));
+        }
+
+        // The inverse of loadRGB (each shuffle is its own inverse)
+        static inline void storeRGB(float* rgb, const Float channels[3])
+        {
+          Float red = _mm_shuffle_ps(channels[0], channels[0], _MM_SHUFFLE(1, 2, 3, 0));
+          Float green = _mm_shuffle_ps(channels[1], channels[1], _MM_SHUFFLE(2, 3, 0, 1));
+          Float blue = _mm_shuffle_ps(channels[2], channels[2], _MM_SHUFFLE(3, 0, 1, 2));
+
+          _mm_storeu_ps(rgb, _mm_blend_ps(_mm_blend_ps(red, green, 0x2), blue, 0x4));
+          _mm_storeu_ps(rgb + 4, _mm_blend_ps(_mm_blend_ps(red, green, 0x9), blue, 0x2));
+          _mm_storeu_ps(rgb + 8, _mm_blend_ps(_mm_blend_ps(red, green, 0x4), blue, 0x9));
+        }
+      };
+    }
+
+    void packBatchSSE4(const float* rgb, UInt* out, size_t count)
+    {
+      packBatchLanes<LanesSSE4>(rgb, out, count);
+    }
+
+    void unpackBatchSSE4(const UInt* packed, float* rgb, size_t count)
+    {
+      unpackBatchLanes<LanesSSE4>(packed, rgb, count);
+    }
+  }
+}
+#else
+namespace Haboob
+{
+  namespace PackedFloat
+  {
+    void packBatchSSE4(const float* rgb, UInt* out, size_t count)
+    {
+      packBatchScalar(rgb, out, count);
+    }
+
+    void unpackBatchSSE4(const UInt* packed, float* rgb, size_t count)
+    {
+      unpackBatchScalar(packed, rgb, count);
+    }
+  }
+}
+#endif
@@ -0,0 +1,94 @@
+#include "Data/SIMD.h"
+
+#if defined(HABOOB_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(HABOOB_SIMD_X86)
+#include <cpuid.h>
+#endif
+
+namespace Haboob
+{
+  namespace SIMD
+  {
+    namespace
+    {
+      // Returns registers { eax, ebx, ecx, edx } for a cpuid leaf
+      void queryCPU(UInt leaf, UInt subLeaf, UInt registers[4])
+      {
+#if defined(HABOOB_SIMD_X86) && defined(_MSC_VER)
+        int values[4];
+        __cpuidex(values, int(leaf), int(subLeaf));
+        for (UInt i = 0; i < 4; ++i) { registers[i] = UInt(values[i]); }
+#elif defined(HABOOB_SIMD_X86)
+        __cpuid_count(leaf, subLeaf, registers[0], registers[1], registers[2], registers[3]);
+#else
+        registers[0] = registers[1] = registers[2] = registers[3] = 0;
+#endif
+      }
+
+      // Returns the OS enabled register state (XCR0)
+      unsigned long long queryOSState()
+      {
+#if defined(HABOOB_SIMD_X86) && defined(_MSC_VER)
+        return _xgetbv(0);
+#elif defined(HABOOB_SIMD_X86)
+        UInt low, high;
+        __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+        return ((unsigned long long)high << 32) | low;
+#else
+        return 0;
+#endif
+      }
+    }
+
+    Level detectLevel()
+    {
+      UInt registers[4];
+      queryCPU(0, 0, registers);
+      UInt maxLeaf = registers[0];
+      if (maxLeaf < 1) { return LEVEL_SCALAR; }
+
+      queryCPU(1, 0, registers);
+      bool sse4 = registers[2] & BIT(19);
+      bool osSave = registers[2] & BIT(27);
+      bool avx = registers[2] & BIT(28);
+      if (!sse4) { return LEVEL_SCALAR; }
+      if (!(osSave && avx) || maxLeaf < 7) { return LEVEL_SSE4; }
+
+      // The OS must preserve the wider registers across context switches
+      unsigned long long osState = queryOSState();
+      if ((osState & 0x6) != 0x6) { return LEVEL_SSE4; } // XMM | YMM
+
+      queryCPU(7, 0, registers);
+      bool avx2 = registers[1] & BIT(5);
+      bool avx512 = registers[1] & BIT(16);
+      if (!avx2) { return LEVEL_SSE4; }
+      if (!avx512 || (osState & 0xE6) != 0xE6) { return LEVEL_AVX2; } // + opmask | ZMM
+
+      return LEVEL_AVX512;
+    }
+
+    CString getLevelName(Level level)
+    {
+      switch (level)
+      {
+        case LEVEL_SSE4: return "SSE4";
+        case LEVEL_AVX2: return "AVX2";
+        case LEVEL_AVX512: return "AVX-512";
+        default: return "Scalar";
+      }
+    }
+
+    UInt getLevelWidth(Level level)
+    {
+      switch (level)
+      {
+        case LEVEL_SSE4: return 4;
+        case LEVEL_AVX2: return 8;
+        case LEVEL_AVX512: return 16;
+        default: return 1;
+      }
+    }
+  }
+}
@@ -0,0 +1,129 @@
+#include "Procedural/BlueNoise.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace Haboob
+{
+  namespace BlueNoise
+  {
+    namespace
+    {
+      static constexpr UInt TEXEL_COUNT = TILE_SIZE * TILE_SIZE;
+      static constexpr float SIGMA = 1.5f; // Of the energy filter, as Ulichney suggests
+
+      // Gaussian energy of every point of a binary pattern, on a torus so the tile wraps seamlessly
+      class EnergyField
+      {
+        public:
+        EnergyField() : points(TEXEL_COUNT, 0), energies(TEXEL_COUNT, .0f), filter(TEXEL_COUNT)
+        {
+          for (UInt y = 0; y < TILE_SIZE; ++y)
+          {
+            for (UInt x = 0; x < TILE_SIZE; ++x)
+            {
+              float dx = float(std::min(x, TILE_SIZE - x)), dy = float(std::min(y, TILE_SIZE - y));
+              filter[x + TILE_SIZE * y] = std::exp(-(dx * dx + dy * dy) / (2.f * SIGMA * SIGMA));
+            }
+          }
+        }
+
+        inline bool isSet(UInt index) const { return points[index] != 0; }
+
+        void toggle(UInt index)
+        {
+          float sign = points[index] ? -1.f : 1.f;
+          points[index] ^= 1;
+
+          UInt x = index & (TILE_SIZE - 1), y = index / TILE_SIZE;
+          for (UInt qy = 0; qy < TILE_SIZE; ++qy)
+          {
+            const float* row = &filter[TILE_SIZE * ((qy - y) & (TILE_SIZE - 1))];
+            float* energy = &energies[TILE_SIZE * qy];
+            for (UInt qx = 0; qx < TILE_SIZE; ++qx) { energy[qx] += sign * row[(qx - x) & (TILE_SIZE - 1)]; }
+          }
+        }
+
+        // The set point with the most energy around it
+        UInt tightestCluster() const
+        {
+          UInt best = 0;
+          float bestEnergy = -1.f;
+          for (UInt i = 0; i < TEXEL_COUNT; ++i)
+          {
+            if (points[i] && energies[i] > bestEnergy) { bestEnergy = energies[i]; best = i; }
+          }
+          return best;
+        }
+
+        // The unset point with the least energy around it
+        UInt largestVoid() const
+        {
+          UInt best = 0;
+          float bestEnergy = INFINITY;
+          for (UInt i = 0; i < TEXEL_COUNT; ++i)
+          {
+            if (!points[i] && energies[i] < bestEnergy) { bestEnergy = energies[i]; best = i; }
+          }
+          return best;
+        }
+
+        private:
+        std::vector<Byte> points;
+        std::vector<float> energies;
+        std::vector<float> filter; // By wrapped offset
+      };
+
+      std::vector<float> buildTile()
+      {
+        // A tenth of the texels scattered by a fixed LCG, then relaxed until moving the tightest cluster would put it straight back
+        EnergyField initial;
+        UInt initialCount = TEXEL_COUNT / 10;
+        uint32_t state = 0x9E3779B9u;
+        for (UInt placed = 0; placed < initialCount;)
+        {
+          state = state * 1664525u + 1013904223u;
+          UInt index = (state >> 8) % TEXEL_COUNT;
+          if (!initial.isSet(index)) { initial.toggle(index); ++placed; }
+        }
+
+        for (UInt i = 0; i < TEXEL_COUNT; ++i)
+        {
+          UInt cluster = initial.tightestCluster();
+          initial.toggle(cluster);
+          UInt gap = initial.largestVoid();
+          initial.toggle(gap);
+          if (gap == cluster) { break; }
+        }
+
+        // Ranks below the initial pattern by removing clusters, those above by filling voids
+        // Filling the largest void is also removing the tightest cluster of the unset points, so one rule covers the upper half
+        std::vector<float> tile(TEXEL_COUNT);
+        EnergyField removing = initial;
+        for (UInt rank = initialCount; rank-- > 0;)
+        {
+          UInt cluster = removing.tightestCluster();
+          removing.toggle(cluster);
+          tile[cluster] = float(rank);
+        }
+
+        for (UInt rank = initialCount; rank < TEXEL_COUNT; ++rank)
+        {
+          UInt gap = initial.largestVoid();
+          initial.toggle(gap);
+          tile[gap] = float(rank);
+        }
+
+        for (float& value : tile) { value = (value + .5f) / float(TEXEL_COUNT); }
+        return tile;
+      }
+    }
+
+    const std::vector<float>& getTile()
+    {
+      static const std::vector<float> tile = buildTile();
+      return tile;
+    }
+  }
+}
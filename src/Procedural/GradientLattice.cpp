@@ -0,0 +1,107 @@
+#include "Procedural/GradientLattice.h"
+
+#include <algorithm>
+
+namespace Haboob
+{
+  size_t GradientLattice::measure(const fBMOctave& octave, const std::vector<float> positions[3], const float absoluteOffset[3])
+  {
+    size_t count = 1;
+    for (UInt axis = 0; axis < 3; ++axis)
+    {
+      AxisMap map;
+      mapAxis(positions[axis], absoluteOffset[axis], octave.scale[axis], map);
+      count *= map.lattice.size();
+    }
+
+    return count;
+  }
+
+  void GradientLattice::mapAxis(const std::vector<float>& positions, float offset, float scale, AxisMap& map)
+  {
+    map.lattice.clear();
+    map.slot.resize(positions.size());
+    map.uvw.resize(positions.size());
+
+    // Same steps as Perlin::getLattice and Perlin::getCorner
+    std::vector<float> bigs(positions.size());
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+      float position = positions[i];
+      float value = (position - offset) / scale;
+      spatialize(value, bigs[i], map.uvw[i]);
+
+      map.lattice.push_back(bigs[i] + .0f);
+      map.lattice.push_back(bigs[i] + 1.f);
+    }
+
+    std::sort(map.lattice.begin(), map.lattice.end());
+    map.lattice.erase(std::unique(map.lattice.begin(), map.lattice.end()), map.lattice.end());
+
+    for (size_t i = 0; i < positions.size(); ++i)
+    {
+      map.slot[i] = UInt(std::lower_bound(map.lattice.begin(), map.lattice.end(), bigs[i] + .0f) - map.lattice.begin());
+    }
+  }
+
+  void GradientLattice::build(const fBMOctave& octave, const WorldSpace& space, const std::vector<float> positions[3], const float absoluteOffset[3], ThreadPool* pool, SIMD::Level level)
+  {
+    // World position of every lattice value, per axis
+    std::vector<float> corners[3];
+    for (UInt axis = 0; axis < 3; ++axis)
+    {
+      mapAxis(positions[axis], absoluteOffset[axis], octave.scale[axis], axes[axis]);
+
+      corners[axis].resize(axes[axis].lattice.size());
+      for (size_t i = 0; i < corners[axis].size(); ++i)
+      {
+        corners[axis][i] = absoluteOffset[axis] + axes[axis].lattice[i] * octave.scale[axis];
+      }
+    }
+
+    UInt countX = UInt(corners[0].size()), countY = UInt(corners[1].size()), countZ = UInt(corners[2].size());
+    table.resize(3 * size_t(countX) * countY * countZ);
+
+    NoiseKernels::GradientBatch gradientBatch = NoiseKernels::getGradientBatch(level);
+    auto buildRows = [&](UInt z)
+      {
+        // Each row of corners along x goes through the kernel at once
+        std::vector<float> rowY(countX), rowZ(countX, corners[2][z]), gradients[3];
+        for (UInt axis = 0; axis < 3; ++axis) { gradients[axis].resize(countX); }
+
+        for (UInt y = 0; y < countY; ++y)
+        {
+          std::fill(rowY.begin(), rowY.end(), corners[1][y]);
+          gradientBatch(space, octave.rng, corners[0].data(), rowY.data(), rowZ.data(), gradients[0].data(), gradients[1].data(), gradients[2].data(), countX);
+
+          float* row = &table[3 * (size_t(countX) * (y + size_t(countY) * z))];
+          for (UInt x = 0; x < countX; ++x)
+          {
+            row[3 * x] = gradients[0][x];
+            row[3 * x + 1] = gradients[1][x];
+            row[3 * x + 2] = gradients[2][x];
+          }
+        }
+      };
+
+    if (pool)
+    {
+      pool->parallelFor(countZ, buildRows);
+    }
+    else
+    {
+      for (UInt z = 0; z < countZ; ++z) { buildRows(z); }
+    }
+  }
+
+  void GradientLattice::clear()
+  {
+    for (UInt axis = 0; axis < 3; ++axis)
+    {
+      axes[axis] = AxisMap();
+    }
+
+    table.clear();
+    table.shrink_to_fit();
+  }
+}
@@ -0,0 +1,54 @@
+#include "Procedural/NoiseKernels.h"
+
+namespace Haboob
+{
+  namespace NoiseKernels
+  {
+    void fBMBatchScalar(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space,
+      const float* x, const float* y, const float* z, const float absoluteOffset[3], float* out, UInt count)
+    {
+      for (UInt i = 0; i < count; ++i)
+      {
+        float position[3] = { x[i], y[i], z[i] };
+        out[i] = fBM::fBMNoise(octaves, octaveCount, space, position, absoluteOffset);
+      }
+    }
+
+    void gradientBatchScalar(const WorldSpace& space, const TEA& baseRNG,
+      const float* x, const float* y, const float* z, float* gradientX, float* gradientY, float* gradientZ, UInt count)
+    {
+      for (UInt i = 0; i < count; ++i)
+      {
+        float position[3] = { x[i], y[i], z[i] };
+        float gradient[3];
+        Perlin::getGradient(space, baseRNG, position, gradient);
+
+        gradientX[i] = gradient[0];
+        gradientY[i] = gradient[1];
+        gradientZ[i] = gradient[2];
+      }
+    }
+
+    fBMBatch getfBMBatch(SIMD::Level level)
+    {
+      switch (level)
+      {
+        case SIMD::LEVEL_SSE4: return fBMBatchSSE4;
+        case SIMD::LEVEL_AVX2: return fBMBatchAVX2;
+        case SIMD::LEVEL_AVX512: return fBMBatchAVX512;
+        default: return fBMBatchScalar;
+      }
+    }
+
+    GradientBatch getGradientBatch(SIMD::Level level)
+    {
+      switch (level)
+      {
+        case SIMD::LEVEL_SSE4: return gradientBatchSSE4;
+        case SIMD::LEVEL_AVX2: return gradientBatchAVX2;
+        case SIMD::LEVEL_AVX512: return gradientBatchAVX512;
+        default: return gradientBatchScalar;
+      }
+    }
+  }
+}
@@ -0,0 +1,92 @@
+#include "Procedural/NoiseKernels.h"
+
+// Built with AVX2 enabled (scripts/SIMD.cmake), only called when the CPU supports it
+#ifdef HABOOB_SIMD_X86
+#include <immintrin.h>
+#include "Procedural/NoiseKernelImpl.h"
+
+namespace Haboob
+{
+  namespace NoiseKernels
+  {
+    namespace
+    {
+      struct LanesAVX2
+      {
+        static constexpr UInt WIDTH = 8;
+        typedef __m256 Float;
+        typedef __m256i Int;
+        typedef __m256 Mask;
+
+        static inline Float set(float value) { return _mm256_set1_ps(value); }
+        static inline Float load(const float* values) { return _mm256_loadu_ps(values); }
+        static inline void store(float* values, Float value) { _mm256_storeu_ps(values, value); }
+
+        static inline Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+        static inline Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+        static inline Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+        static inline Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+        static inline Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+        static inline Float floor(Float a) { return _mm256_floor_ps(a); }
+        static inline Float trunc(Float a) { return _mm256_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+        static inline Float abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-.0f), a); }
+        static inline Float neg(Float a) { return _mm256_xor_ps(_mm256_set1_ps(-.0f), a); }
+
+        static inline Mask lessThan(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static inline Mask greaterEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+        static inline Float select(Mask mask, Float onTrue, Float onFalse) { return _mm256_blendv_ps(onFalse, onTrue, mask); }
+
+        static inline Int setInt(UInt value) { return _mm256_set1_epi32(int(value)); }
+        static inline Int addInt(Int a, Int b) { return _mm256_add_epi32(a, b); }
+        static inline Int xorInt(Int a, Int b) { return _mm256_xor_si256(a, b); }
+        static inline Int orInt(Int a, Int b) { return _mm256_or_si256(a, b); }
+        static inline Int andInt(Int a, Int b) { return _mm256_and_si256(a, b); }
+        template<int N> static inline Int shiftLeft(Int a) { return _mm256_slli_epi32(a, N); }
+        template<int N> static inline Int shiftRight(Int a) { return _mm256_srli_epi32(a, N); }
+        static inline Int shiftLeftBy(Int a, UInt bits) { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(int(bits))); }
+
+        // Truncating, only used for positive values within int range
+        static inline Int toInt(Float a) { return _mm256_cvttps_epi32(a); }
+
+        // Unsigned conversion, both 16 bit halves convert exactly so the sum is the only rounding
+        static inline Float toFloat(Int a)
+        {
+          Float high = _mm256_cvtepi32_ps(_mm256_srli_epi32(a, 16));
+          Float low = _mm256_cvtepi32_ps(_mm256_and_si256(a, _mm256_set1_epi32(0xFFFF)));
+          return _mm256_add_ps(_mm256_mul_ps(high, _mm256_set1_ps(65536.f)), low);
+        }
+      };
+    }
+
+    void fBMBatchAVX2(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space,
+      const float* x, const float* y, const float* z, const float absoluteOffset[3], float* out, UInt count)
+    {
+      fBMBatchLanes<LanesAVX2>(octaves, octaveCount, space, x, y, z, absoluteOffset, out, count);
+    }
+
+    void gradientBatchAVX2(const WorldSpace& space, const TEA& baseRNG,
+      const float* x, const float* y, const float* z, float* gradientX, float* gradientY, float* gradientZ, UInt count)
+    {
+      gradientBatchLanes<LanesAVX2>(space, baseRNG, x, y, z, gradientX, gradientY, gradientZ, count);
+    }
+  }
+}
+#else
+namespace Haboob
+{
+  namespace NoiseKernels
+  {
+    void fBMBatchAVX2(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space,
+      const float* x, const float* y, const float* z, const float absoluteOffset[3], float* out, UInt count)
+    {
+      fBMBatchScalar(octaves, octaveCount, space, x, y, z, absoluteOffset, out, count);
+    }
+
+    void gradientBatchAVX2(const WorldSpace& space, const TEA& baseRNG,
+      const float* x, const float* y, const float* z, float* gradientX, float* gradientY, float* gradientZ, UInt count)
+    {
+      gradientBatchScalar(space, baseRNG, x, y, z, gradientX, gradientY, gradientZ, count);
+    }
+  }
+}
+#endif
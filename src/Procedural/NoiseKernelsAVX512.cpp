@@ -0,0 +1,87 @@
+#include "Procedural/NoiseKernels.h"
+
+// Built with AVX-512F enabled (scripts/SIMD.cmake), only called when the CPU supports it
+#ifdef HABOOB_SIMD_X86
+#include <immintrin.h>
+#include "Procedural/NoiseKernelImpl.h"
+
+namespace Haboob
+{
+  namespace NoiseKernels
+  {
+    namespace
+    {
+      struct LanesAVX512
+      {
+        static constexpr UInt WIDTH = 16;
+        typedef __m512 Float;
+        typedef __m512i Int;
+        typedef __mmask16 Mask;
+
+        static inline Float set(float value) { return _mm512_set1_ps(value); }
+        static inline Float load(const float* values) { return _mm512_loadu_ps(values); }
+        static inline void store(float* values, Float value) { _mm512_storeu_ps(values, value); }
+
+        static inline Float add(Float a, Float b) { return _mm512_add_ps(a, b); }
+        static inline Float sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+        static inline Float mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+        static inline Float div(Float a, Float b) { return _mm512_div_ps(a, b); }
+        static inline Float sqrt(Float a) { return _mm512_sqrt_ps(a); }
+        static inline Float floor(Float a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+        static inline Float trunc(Float a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+        static inline Float abs(Float a) { return _mm512_abs_ps(a); }
+
+        // (float xor needs AVX-512DQ, so flip the sign as an integer)
+        static inline Float neg(Float a) { return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), _mm512_set1_epi32(int(0x80000000)))); }
+
+        static inline Mask lessThan(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static inline Mask greaterEqual(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+        static inline Float select(Mask mask, Float onTrue, Float onFalse) { return _mm512_mask_blend_ps(mask, onFalse, onTrue); }
+
+        static inline Int setInt(UInt value) { return _mm512_set1_epi32(int(value)); }
+        static inline Int addInt(Int a, Int b) { return _mm512_add_epi32(a, b); }
+        static inline Int xorInt(Int a, Int b) { return _mm512_xor_si512(a, b); }
+        static inline Int orInt(Int a, Int b) { return _mm512_or_si512(a, b); }
+        static inline Int andInt(Int a, Int b) { return _mm512_and_si512(a, b); }
+        template<int N> static inline Int shiftLeft(Int a) { return _mm512_slli_epi32(a, N); }
+        template<int N> static inline Int shiftRight(Int a) { return _mm512_srli_epi32(a, N); }
+        static inline Int shiftLeftBy(Int a, UInt bits) { return _mm512_sll_epi32(a, _mm_cvtsi32_si128(int(bits))); }
+
+        // Truncating, only used for positive values within int range
+        static inline Int toInt(Float a) { return _mm512_cvttps_epi32(a); }
+        static inline Float toFloat(Int a) { return _mm512_cvtepu32_ps(a); }
+      };
+    }
+
+    void fBMBatchAVX512(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space,
+      const float* x, const float* y, const float* z, const float absoluteOffset[3], float* out, UInt count)
+    {
+      fBMBatchLanes<LanesAVX512>(octaves, octaveCount, space, x, y, z, absoluteOffset, out, count);
+    }
+
+    void gradientBatchAVX512(const WorldSpace& space, const TEA& baseRNG,
+      const float* x, const float* y, const float* z, float* gradientX, float* gradientY, float* gradientZ, UInt count)
+    {
+      gradientBatchLanes<LanesAVX512>(space, baseRNG, x, y, z, gradientX, gradientY, gradientZ, count);
+    }
+  }
+}
+#else
+namespace Haboob
+{
+  namespace NoiseKernels
+  {
+    void fBMBatchAVX512(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space,
+      const float* x, const float* y, const float* z, const float absoluteOffset[3], float* out, UInt count)
+    {
+      fBMBatchScalar(octaves, octaveCount, space, x, y, z, absoluteOffset, out, count);
+    }
+
+    void gradientBatchAVX512(const WorldSpace& space, const TEA& baseRNG,
+      const float* x, const float* y, const float* z, float* gradientX, float* gradientY, float* gradientZ, UInt count)
+    {
+      gradientBatchScalar(space, baseRNG, x, y, z, gradientX, gradientY, gradientZ, count);
+    }
+  }
+}
+#endif
@@ -0,0 +1,92 @@
+#include "Procedural/NoiseKernels.h"
+
+// Built with SSE4.1 enabled (scripts/SIMD.cmake), only called when the CPU supports it
+#ifdef HABOOB_SIMD_X86
+#include <smmintrin.h>
+#include "Procedural/NoiseKernelImpl.h"
+
+namespace Haboob
+{
+  namespace NoiseKernels
+  {
+    namespace
+    {
+      struct LanesSSE4
+      {
+        static constexpr UInt WIDTH = 4;
+        typedef __m128 Float;
+        typedef __m128i Int;
+        typedef __m128 Mask;
+
+        static inline Float set(float value) { return _mm_set1_ps(value); }
+        static inline Float load(const float* values) { return _mm_loadu_ps(values); }
+        static inline void store(float* values, Float value) { _mm_storeu_ps(values, value); }
+
+        static inline Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+        static inline Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+        static inline Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        static inline Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+        static inline Float sqrt(Float a) { return _mm_sqrt_ps(a); }
+        static inline Float floor(Float a) { return _mm_floor_ps(a); }
+        static inline Float trunc(Float a) { return _mm_round_ps(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC); }
+        static inline Float abs(Float a) { return _mm_andnot_ps(_mm_set1_ps(-.0f), a); }
+        static inline Float neg(Float a) { return _mm_xor_ps(_mm_set1_ps(-.0f), a); }
+
+        static inline Mask lessThan(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+        static inline Mask greaterEqual(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+        static inline Float select(Mask mask, Float onTrue, Float onFalse) { return _mm_blendv_ps(onFalse, onTrue, mask); }
+
+        static inline Int setInt(UInt value) { return _mm_set1_epi32(int(value)); }
+        static inline Int addInt(Int a, Int b) { return _mm_add_epi32(a, b); }
+        static inline Int xorInt(Int a, Int b) { return _mm_xor_si128(a, b); }
+        static inline Int orInt(Int a, Int b) { return _mm_or_si128(a, b); }
+        static inline Int andInt(Int a, Int b) { return _mm_and_si128(a, b); }
+        template<int N> static inline Int shiftLeft(Int a) { return _mm_slli_epi32(a, N); }
+        template<int N> static inline Int shiftRight(Int a) { return _mm_srli_epi32(a, N); }
+        static inline Int shiftLeftBy(Int a, UInt bits) { return _mm_sll_epi32(a, _mm_cvtsi32_si128(int(bits))); }
+
+        // Truncating, only used for positive values within int range
+        static inline Int toInt(Float a) { return _mm_cvttps_epi32(a); }
+
+        // Unsigned conversion, both 16 bit halves convert exactly so the sum is the only rounding
+        static inline Float toFloat(Int a)
+        {
+          Float high = _mm_cvtepi32_ps(_mm_srli_epi32(a, 16));
+          Float low = _mm_cvtepi32_ps(_mm_and_si128(a, _mm_set1_epi32(0xFFFF)));
+          return _mm_add_ps(_mm_mul_ps(high, _mm_set1_ps(65536.f)), low);
+        }
+      };
+    }
+
+    void fBMBatchSSE4(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space,
+      const float* x, const float* y, const float* z, const float absoluteOffset[3], float* out, UInt count)
+    {
+      fBMBatchLanes<LanesSSE4>(octaves, octaveCount, space, x, y, z, absoluteOffset, out, count);
+    }
+
+    void gradientBatchSSE4(const WorldSpace& space, const TEA& baseRNG,
+      const float* x, const float* y, const float* z, float* gradientX, float* gradientY, float* gradientZ, UInt count)
+    {
+      gradientBatchLanes<LanesSSE4>(space, baseRNG, x, y, z, gradientX, gradientY, gradientZ, count);
+    }
+  }
+}
+#else
+namespace Haboob
+{
+  namespace NoiseKernels
+  {
+    void fBMBatchSSE4(const fBMOctave* octaves, UInt octaveCount, const WorldSpace& space,
+      const float* x, const float* y, const float* z, const float absoluteOffset[3], float* out, UInt count)
+    {
+      fBMBatchScalar(octaves, octaveCount, space, x, y, z, absoluteOffset, out, count);
+    }
+
+    void gradientBatchSSE4(const WorldSpace& space, const TEA& baseRNG,
+      const float* x, const float* y, const float* z, float* gradientX, float* gradientY, float* gradientZ, UInt count)
+    {
+      gradientBatchScalar(space, baseRNG, x, y, z, gradientX, gradientY, gradientZ, count);
+    }
+  }
+}
+#endif
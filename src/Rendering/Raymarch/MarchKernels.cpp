@@ -0,0 +1,724 @@
+#include "Rendering/Raymarch/MarchKernels.h"
+#include "Rendering/Volume/VolumeMips.h"
+#include "Procedural/BlueNoise.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace Haboob
+{
+  namespace MarchKernels
+  {
+    namespace
+    {
+      // mul(vector, matrix) of a row_major matrix
+      inline void transform(const float vector[4], const XMFLOAT4X4& matrix, float result[4])
+      {
+        for (int column = 0; column < 4; ++column)
+        {
+          result[column] = vector[0] * matrix.m[0][column] + vector[1] * matrix.m[1][column] + vector[2] * matrix.m[2][column] + vector[3] * matrix.m[3][column];
+        }
+      }
+
+      inline float dot3(const float a[3], const float b[3]) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+      // SimpsonsIntegrator (the shader never sets the first term, so neither does this)
+      struct SimpsonIntegrator
+      {
+        float firstTerm = .0f;
+        float lastTerm = .0f;
+        float termBuckets[2] = { .0f, .0f };
+        UInt count = 0;
+
+        inline void append(float value)
+        {
+          lastTerm = value;
+          termBuckets[count & 0x01] += value; // Append depending on parity
+          ++count;
+        }
+
+        inline float integrate(float range) const
+        {
+          float stepSize = range / float(count);
+          float result = firstTerm + lastTerm;
+          result += 4.f * termBuckets[1]; // Odds
+          result += 2.f * (termBuckets[0] - lastTerm); // Evens
+          return result * stepSize / 3.f;
+        }
+      };
+
+      // SimpsonsIntegrator4
+      struct SimpsonIntegrator4
+      {
+        SimpsonIntegrator terms[4];
+
+        inline void append(const float values[4])
+        {
+          for (int i = 0; i < 4; ++i) { terms[i].append(values[i]); }
+        }
+
+        inline void integrate(float range, float result[4]) const
+        {
+          for (int i = 0; i < 4; ++i) { result[i] = terms[i].integrate(range); }
+        }
+      };
+
+      // RectangleIntegrator, for progressive frames whose jittered samples each stand for their whole step
+      // Averaged over jitter this is stratified sampling, which converges where Simpson's alternating weights leave bands
+      struct RectangleIntegrator
+      {
+        float total = .0f;
+        UInt count = 0;
+
+        inline void append(float value)
+        {
+          total += value;
+          ++count;
+        }
+
+        inline float integrate(float range) const { return total * range / float(count); }
+      };
+
+      // RectangleIntegrator4
+      struct RectangleIntegrator4
+      {
+        RectangleIntegrator terms[4];
+
+        inline void append(const float values[4])
+        {
+          for (int i = 0; i < 4; ++i) { terms[i].append(values[i]); }
+        }
+
+        inline void integrate(float range, float result[4]) const
+        {
+          for (int i = 0; i < 4; ++i) { result[i] = terms[i].integrate(range); }
+        }
+      };
+
+      inline float blTransmission(float opticalDepth, bool applyBeer)
+      {
+        return applyBeer ? std::exp(-opticalDepth) : 1.f / (1.f + opticalDepth);
+      }
+
+      inline float bpTransmission(float opticalDepth, float powderCoefficient, bool applyBeer)
+      {
+        return blTransmission(opticalDepth, applyBeer) - blTransmission(powderCoefficient * opticalDepth, applyBeer);
+      }
+
+      // Henyey-Greenstein phase function (w.r.t. precomputed angular term), unnormalised as in the shader
+      void hgScatter(float angularDistance, const float terms[4], bool applyHG, float result[4])
+      {
+        for (int i = 0; i < 4; ++i)
+        {
+          if (!applyHG) { result[i] = 1.f; continue; }
+
+          float numerator = 1.f - terms[i] * terms[i];
+          float denominator = terms[i] * (terms[i] - 2.f * angularDistance) + 1.f;
+          result[i] = numerator / std::pow(denominator, 1.5f);
+        }
+      }
+
+      // Distances along a ray where it is within the volume cube ([-.5, .5] in volume space), narrowing [entry, exit]
+      bool intersectVolume(const float origin[3], const float direction[3], const XMFLOAT4X4& localTransform, float& entry, float& exit)
+      {
+        float localOrigin[4], localDirection[4];
+        float origin4[4] = { origin[0], origin[1], origin[2], 1.f };
+        float direction4[4] = { direction[0], direction[1], direction[2], .0f };
+        transform(origin4, localTransform, localOrigin);
+        transform(direction4, localTransform, localDirection);
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+          if (localDirection[axis] == .0f)
+          {
+            if (std::abs(localOrigin[axis]) > .5f) { return false; }
+            continue;
+          }
+
+          float inverse = 1.f / localDirection[axis];
+          float near = (-.5f - localOrigin[axis]) * inverse;
+          float far = (.5f - localOrigin[axis]) * inverse;
+          entry = std::max(entry, std::min(near, far));
+          exit = std::min(exit, std::max(near, far));
+        }
+
+        return entry < exit;
+      }
+
+      // haboobCubeDensitySample, SampleLevel with MIN_MAG_MIP_LINEAR and the level clamped to the chain
+      void sample(const Constants& constants, const float position[3], float level, float result[2])
+      {
+        const VolumeLevels& levels = *constants.levels;
+        float position4[4] = { position[0], position[1], position[2], 1.f };
+        float local[4];
+        transform(position4, constants.localTransform, local);
+        float u = local[0] / local[3] + .5f, v = local[1] / local[3] + .5f, w = local[2] / local[3] + .5f;
+
+        if (!(level > .0f)) { level = .0f; }
+        level = std::min(level, float(levels.levelCount - 1));
+
+        UInt base = UInt(level);
+        float blend = level - float(base);
+
+        sampleLevel(levels, base, u, v, w, result);
+        if (blend > .0f && base + 1 < levels.levelCount)
+        {
+          float next[2];
+          sampleLevel(levels, base + 1, u, v, w, next);
+          result[0] += (next[0] - result[0]) * blend;
+          result[1] += (next[1] - result[1]) * blend;
+        }
+      }
+
+      inline void march(float position[3], const float direction[3], float& travelDistance, float stepSize)
+      {
+        for (int i = 0; i < 3; ++i) { position[i] += direction[i] * stepSize; }
+        travelDistance += stepSize;
+      }
+
+      // What BeerShadowMarchVolume.cs integrates, from the sample to where the light enters the volume
+      void marchLight(const Constants& constants, const float position[3], float& opticalDepth, float& angstrom)
+      {
+        float toLight[3] = { -constants.lightDirection[0], -constants.lightDirection[1], -constants.lightDirection[2] };
+        float entry = .0f, exit = FLT_MAX;
+        if (!intersectVolume(position, toLight, constants.localTransform, entry, exit))
+        {
+          opticalDepth = angstrom = .0f;
+          return;
+        }
+
+        float stepSize = (exit - entry) / float(constants.lightIterations);
+        float lightPosition[3] = { position[0], position[1], position[2] };
+        float travelDistance = .0f;
+        march(lightPosition, toLight, travelDistance, entry);
+        travelDistance = .0f;
+
+        SimpsonIntegrator absorptionInte, angstromInte;
+        for (UInt i = 0; i < constants.lightIterations; ++i)
+        {
+          float haboobSample[2];
+          sample(constants, lightPosition, .0f, haboobSample);
+          absorptionInte.append(haboobSample[0]);
+          angstromInte.append(haboobSample[1]);
+          march(lightPosition, toLight, travelDistance, stepSize);
+        }
+
+        opticalDepth = constants.attenuationFactor * absorptionInte.integrate(travelDistance);
+        angstrom = constants.scatterAngstromExponent * angstromInte.integrate(travelDistance);
+      }
+
+      // Intensity as a function of optical thickness, summed over wavelengths (APPLY_SPECTRAL) or not
+      void irradianceSample(const Constants& constants, const float directIrradiance[4], float opticalDepth, float angstrom,
+        float scatterOpticalDepth, float scatterAngstrom, float result[4])
+      {
+        bool constantScatter = constants.lightIterations == 0;
+        if (!constants.applySpectral)
+        {
+          float scatterTransmission = constantScatter ? constants.scatterTransmission : bpTransmission(scatterOpticalDepth, constants.powderCoefficient, constants.applyBeer);
+          float transmission = bpTransmission(opticalDepth, constants.powderCoefficient, constants.applyBeer) * scatterTransmission;
+          for (int i = 0; i < 4; ++i) { result[i] = transmission * directIrradiance[i]; }
+          return;
+        }
+
+        // Transmission per wavelength, row major as the spectral matrices
+        float transmissions[16], scatterTransmissions[16];
+        const float* scatter = constantScatter ? &constants.spectralScatterTransmissions[0][0] : scatterTransmissions;
+        if (constants.transmissionLUT)
+        {
+          constants.transmissionLUT->lookup(opticalDepth, angstrom, transmissions);
+          if (!constantScatter) { constants.transmissionLUT->lookup(scatterOpticalDepth, scatterAngstrom, scatterTransmissions); }
+        }
+        else
+        {
+          for (int i = 0; i < 16; ++i)
+          {
+            float logWavelength = constants.logWavelengths[i / 4][i % 4];
+            if (!constantScatter) { scatterTransmissions[i] = bpTransmission(scatterOpticalDepth * std::exp2(-scatterAngstrom * logWavelength), constants.powderCoefficient, constants.applyBeer); }
+            transmissions[i] = bpTransmission(opticalDepth * std::exp2(-angstrom * logWavelength), constants.powderCoefficient, constants.applyBeer);
+          }
+        }
+
+        for (int row = 0; row < 4; ++row)
+        {
+          float total = .0f;
+          for (int column = 0; column < 4; ++column)
+          {
+            int i = row * 4 + column;
+            total += directIrradiance[row] * (transmissions[i] * scatter[i]) * constants.spectralWeights[row][column];
+          }
+          result[row] = total;
+        }
+      }
+
+      // CIE X1_Y_Z_X2 to RGB, with the background transmission
+      inline XMFLOAT4 toResult(const Constants& constants, const float xyzx[4], float transmission)
+      {
+        if (constants.applySpectral)
+        {
+          float rgb[3];
+          for (int row = 0; row < 3; ++row)
+          {
+            const float* toRGB = constants.spectralToRGB[row];
+            rgb[row] = toRGB[0] * xyzx[0] + toRGB[1] * xyzx[1] + toRGB[2] * xyzx[2] + toRGB[3] * xyzx[3];
+          }
+          return { rgb[0], rgb[1], rgb[2], transmission };
+        }
+
+        return { xyzx[0] + xyzx[3], xyzx[1], xyzx[2], transmission };
+      }
+
+      // The macro cell value bounding every sample a ray takes within [t, tExit], by the levels its cone reads
+      inline UInt footprintLevel(const Constants& constants, const Ray& ray, float t, float tExit)
+      {
+        if (!constants.applyConeTrace) { return 0; }
+
+        // The cone is widest at one end, and blending toward the next level reads up to the ceiling
+        float nearRadius = constants.pixelRadius + constants.pixelRadiusDelta * (ray.travelDistance + t);
+        float farRadius = constants.pixelRadius + constants.pixelRadiusDelta * (ray.travelDistance + tExit);
+        float level = std::log2(std::max(nearRadius, farRadius) * constants.worldToTexels);
+        if (!(level > .0f)) { return 0; }
+        return std::min(UInt(std::ceil(level)), constants.levels->levelCount - 1);
+      }
+
+      // Walks the macro cells over [0, length] of a ray with a 3D DDA, merging occupied cells into spans, returning their total length
+      float findSpans(const Constants& constants, float length, Ray& ray)
+      {
+        const VolumeLevels& levels = *constants.levels;
+        float entry = .0f, exit = length;
+        if (!intersectVolume(ray.position, ray.direction, constants.localTransform, entry, exit)) { return .0f; }
+
+        // Macro cell space, the volume spanning [0, size / VolumeMips::MACRO_CELL_SIZE]
+        float position4[4] = { ray.position[0], ray.position[1], ray.position[2], 1.f };
+        float direction4[4] = { ray.direction[0], ray.direction[1], ray.direction[2], .0f };
+        float localOrigin[4], localDirection[4];
+        transform(position4, constants.localTransform, localOrigin);
+        transform(direction4, constants.localTransform, localDirection);
+
+        int cell[3], step[3];
+        float origin[3], direction[3], tNext[3], tDelta[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+          float scale = levels.floatSizes[0][axis] / float(VolumeMips::MACRO_CELL_SIZE);
+          origin[axis] = (localOrigin[axis] + .5f) * scale;
+          direction[axis] = localDirection[axis] * scale;
+          cell[axis] = std::min(std::max(int(std::floor(origin[axis] + direction[axis] * entry)), 0), levels.macroCounts[axis] - 1);
+
+          if (direction[axis] == .0f)
+          {
+            step[axis] = 0;
+            tNext[axis] = tDelta[axis] = FLT_MAX;
+            continue;
+          }
+
+          step[axis] = direction[axis] > .0f ? 1 : -1;
+          tNext[axis] = (float(cell[axis] + (step[axis] > 0 ? 1 : 0)) - origin[axis]) / direction[axis];
+          tDelta[axis] = 1.f / std::abs(direction[axis]);
+        }
+
+        float occupiedLength = .0f, pendingAngstrom = .0f;
+        ray.skippedAngstrom = .0f;
+        float t = entry;
+        while (t < exit)
+        {
+          int axis = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+          float tExit = std::min(tNext[axis], exit);
+
+          size_t index = size_t(cell[0]) + size_t(levels.macroCounts[0]) * (size_t(cell[1]) + size_t(levels.macroCounts[1]) * size_t(cell[2]));
+          if (tExit > t && levels.macroCells[index * levels.levelCount + footprintLevel(constants, ray, t, tExit)] > constants.emptyDensity)
+          {
+            // Adjacent cells extend the last span, as does everything once the spans run out (so the gap is marched instead)
+            UInt last = ray.spanCount - 1;
+            if (ray.spanCount > 0 && (ray.spanEnds[last] >= t || ray.spanCount == MAX_SPANS))
+            {
+              occupiedLength += tExit - ray.spanEnds[last];
+              ray.spanEnds[last] = tExit;
+            }
+            else
+            {
+              ray.skippedAngstrom += pendingAngstrom;
+              ray.spanBegins[ray.spanCount] = t;
+              ray.spanEnds[ray.spanCount] = tExit;
+              ray.spanAngstroms[ray.spanCount] = ray.skippedAngstrom;
+              ++ray.spanCount;
+              occupiedLength += tExit - t;
+            }
+            pendingAngstrom = .0f;
+          }
+          else if (tExit > t) { pendingAngstrom += levels.macroAngstroms[index] * (tExit - t); }
+
+          t = std::max(t, tExit);
+          cell[axis] += step[axis];
+          if (cell[axis] < 0 || cell[axis] >= levels.macroCounts[axis]) { break; }
+          tNext[axis] += tDelta[axis];
+        }
+
+        ray.skippedAngstrom += pendingAngstrom;
+        return occupiedLength;
+      }
+
+      // RayIntegrator follows the shader's, Simpson's rule unless progressive
+      template<typename RayIntegrator, typename RayIntegrator4> XMFLOAT4 marchRay(const Constants& constants, Ray& ray)
+      {
+        RayIntegrator absorptionInte, angstromInte;
+        RayIntegrator4 irradianceInte;
+
+        // When skipping, samples are placed by their occupied distance while the integrals run over it alone
+        // Scattering is integrated through empty space too, where the optical depth holds, so each gap adds its length by the irradiance either side
+        const float origin[3] = { ray.position[0], ray.position[1], ray.position[2] };
+        float initialTravel = ray.travelDistance, occupied = .0f, spanStart = .0f, skipped = .0f;
+        float fullStep = constants.skipEmpty ? ray.travelLength / float(constants.iterations) : .0f;
+        float lastIrradiance[4] = { .0f, .0f, .0f, .0f }, gapIrradiance[4] = { .0f, .0f, .0f, .0f };
+        float lastScatterOpticalDepth = .0f, lastScatterAngstrom = .0f;
+        UInt span = 0;
+        for (UInt i = 0; i < constants.iterations; ++i)
+        {
+          float coneTravel = ray.travelDistance, range = ray.travelDistance;
+          float gap = .0f, gapAngstrom = .0f;
+          if (constants.skipEmpty)
+          {
+            float travel = travelAt(ray, span, spanStart, occupied);
+            for (int axis = 0; axis < 3; ++axis) { ray.position[axis] = origin[axis] + ray.direction[axis] * travel; }
+            coneTravel = initialTravel + travel;
+            range = skipRange(float(i + 1), ray.marchZStep, fullStep, initialTravel + travel, travel);
+            gap = travel - occupied - skipped;
+            gapAngstrom = ray.spanAngstroms[span];
+            skipped += gap;
+          }
+
+          // Accumulate absorption from density
+          float coneLevel = constants.applyConeTrace ? std::log2((constants.pixelRadius + constants.pixelRadiusDelta * coneTravel) * constants.worldToTexels) : .0f;
+          float haboobSample[2];
+          sample(constants, ray.position, coneLevel, haboobSample);
+          absorptionInte.append(haboobSample[0]);
+          angstromInte.append(haboobSample[1]);
+
+          // Integrate the direct optical depth + angstrom along the ray
+          float referenceOpticalDepth = constants.attenuationFactor * absorptionInte.integrate(range);
+          float referenceAngstrom = constants.absorptionAngstromExponent * (angstromInte.integrate(range) + gapAngstrom);
+
+          // Along the incoming light ray
+          float referenceScatterOpticalDepth = .0f, referenceScatterAngstrom = .0f;
+          if (constants.lightIterations > 0)
+          {
+            marchLight(constants, ray.position, referenceScatterOpticalDepth, referenceScatterAngstrom);
+          }
+
+          float irradiance[4];
+          irradianceSample(constants, ray.directIrradiance, referenceOpticalDepth, referenceAngstrom, referenceScatterOpticalDepth, referenceScatterAngstrom, irradiance);
+          irradianceInte.append(irradiance);
+          for (int channel = 0; channel < 4; ++channel)
+          {
+            gapIrradiance[channel] += gap * .5f * (lastIrradiance[channel] + irradiance[channel]);
+            lastIrradiance[channel] = irradiance[channel];
+          }
+          lastScatterOpticalDepth = referenceScatterOpticalDepth;
+          lastScatterAngstrom = referenceScatterAngstrom;
+
+          march(ray.position, ray.direction, ray.travelDistance, ray.marchZStep);
+          occupied += ray.marchZStep;
+        }
+
+        // Background transmission, assume uniform behaviour across wavelengths (use Beer-Lambert over powder)
+        float range = constants.skipEmpty ? skipRange(float(constants.iterations), ray.marchZStep, fullStep, initialTravel + ray.travelLength, ray.travelLength - fullStep) : ray.travelDistance;
+        float finalOpticalDepth = constants.attenuationFactor * absorptionInte.integrate(range);
+        float finalTransmission = blTransmission(finalOpticalDepth, constants.applyBeer);
+
+        // CIE X1_Y_Z_X2 to RGB
+        float xyzx[4];
+        irradianceInte.integrate(range, xyzx);
+        if (constants.skipEmpty)
+        {
+          // Through to where the ray would have ended
+          float gap = std::max(ray.travelLength - occupied - skipped, .0f);
+          float finalAngstrom = constants.absorptionAngstromExponent * (angstromInte.integrate(range) + ray.skippedAngstrom);
+          float finalIrradiance[4];
+          irradianceSample(constants, ray.directIrradiance, finalOpticalDepth, finalAngstrom, lastScatterOpticalDepth, lastScatterAngstrom, finalIrradiance);
+          for (int channel = 0; channel < 4; ++channel)
+          {
+            xyzx[channel] += gapIrradiance[channel] + gap * .5f * (lastIrradiance[channel] + finalIrradiance[channel]);
+          }
+        }
+
+        return toResult(constants, xyzx, finalTransmission);
+      }
+
+      // MARCH_ADAPTIVE, steps scale with the optical depth they leave from and the cone's footprint, and the ray stops once nearly opaque
+      // Samples are no longer evenly spaced, so each integral is a running trapezoid over the steps actually taken
+      XMFLOAT4 marchRayAdaptive(const Constants& constants, Ray& ray, UInt& samples)
+      {
+        float travelLength = ray.marchZStep * float(constants.iterations); // As the uniform march
+        float minStep = ray.marchZStep * constants.minStepScale, maxStep = ray.marchZStep * constants.maxStepScale;
+        float travel = .0f, stepSize = .0f, stepFloor = .0f, opticalDepth = .0f, angstrom = .0f, finalTransmission = 1.f;
+        float lastDensity = .0f, lastAngstrom = .0f, lastIrradiance[4] = { .0f, .0f, .0f, .0f }, xyzx[4] = { .0f, .0f, .0f, .0f };
+        samples = 0;
+        while (true)
+        {
+          float coneLevel = constants.applyConeTrace ? std::log2((constants.pixelRadius + constants.pixelRadiusDelta * ray.travelDistance) * constants.worldToTexels) : .0f;
+          float haboobSample[2];
+          sample(constants, ray.position, coneLevel, haboobSample);
+          ++samples;
+
+          // A step arriving where the density would take one under half as long is retaken shorter, so edges are resolved entering as leaving
+          if (constants.attenuationFactor * stepSize * haboobSample[0] > 2.f * constants.stepOpticalDepth && stepSize > stepFloor)
+          {
+            float retake = std::max(std::min(.5f * stepSize, constants.stepOpticalDepth / (constants.attenuationFactor * haboobSample[0])), stepFloor);
+            travel += retake - stepSize;
+            march(ray.position, ray.direction, ray.travelDistance, retake - stepSize);
+            stepSize = retake;
+            continue;
+          }
+
+          // The first sample closes no step
+          opticalDepth += .5f * stepSize * (lastDensity + haboobSample[0]);
+          angstrom += .5f * stepSize * (lastAngstrom + haboobSample[1]);
+          lastDensity = haboobSample[0];
+          lastAngstrom = haboobSample[1];
+
+          float referenceOpticalDepth = constants.attenuationFactor * opticalDepth;
+          float referenceAngstrom = constants.absorptionAngstromExponent * angstrom;
+          float referenceScatterOpticalDepth = .0f, referenceScatterAngstrom = .0f;
+          if (constants.lightIterations > 0)
+          {
+            marchLight(constants, ray.position, referenceScatterOpticalDepth, referenceScatterAngstrom);
+          }
+
+          float irradiance[4];
+          irradianceSample(constants, ray.directIrradiance, referenceOpticalDepth, referenceAngstrom, referenceScatterOpticalDepth, referenceScatterAngstrom, irradiance);
+          for (int channel = 0; channel < 4; ++channel)
+          {
+            xyzx[channel] += .5f * stepSize * (lastIrradiance[channel] + irradiance[channel]);
+            lastIrradiance[channel] = irradiance[channel];
+          }
+
+          finalTransmission = blTransmission(referenceOpticalDepth, constants.applyBeer);
+          if (finalTransmission < constants.terminationTransmission || travel >= travelLength) { break; }
+
+          // Sampling closer than the cone's texels reads the same filtered volume
+          stepFloor = constants.applyConeTrace ? std::min(std::max(minStep, std::exp2(coneLevel) / constants.worldToTexels), maxStep) : minStep;
+          stepSize = haboobSample[0] > .0f ? constants.stepOpticalDepth / (constants.attenuationFactor * haboobSample[0]) : maxStep;
+          stepSize = std::min(std::min(std::max(stepSize, stepFloor), maxStep), travelLength - travel);
+
+          travel += stepSize;
+          march(ray.position, ray.direction, ray.travelDistance, stepSize);
+        }
+
+        return toResult(constants, xyzx, finalTransmission);
+      }
+    }
+
+    void VolumeLevels::assign(const VolumeGrid& source, const std::vector<VolumeGrid>& mips, Layout newLayout)
+    {
+      layout = newLayout;
+      levelCount = std::min(UInt(mips.size()) + 1, MAX_LEVELS);
+
+      // Tiled levels are padded to whole tiles
+      size_t texelCount = 0;
+      for (UInt level = 0; level < levelCount; ++level)
+      {
+        const VolumeGrid& grid = level == 0 ? source : mips[level - 1];
+        offsets[level] = int(texelCount);
+        sizes[level][0] = grid.getSize().x;
+        sizes[level][1] = grid.getSize().y;
+        sizes[level][2] = grid.getSize().z;
+        for (int axis = 0; axis < 3; ++axis) { floatSizes[level][axis] = float(sizes[level][axis]); }
+
+        if (layout == LAYOUT_LINEAR)
+        {
+          strides[level][0] = sizes[level][0];
+          strides[level][1] = sizes[level][1];
+          texelCount += grid.getVoxelCount();
+          continue;
+        }
+
+        int tilesZ = (sizes[level][2] + 7) >> 3;
+        strides[level][0] = (sizes[level][0] + 7) >> 3;
+        strides[level][1] = (sizes[level][1] + 7) >> 3;
+        texelCount += size_t(strides[level][0]) * size_t(strides[level][1]) * size_t(tilesZ) << 9;
+      }
+
+      texels.assign(2 * texelCount, .0f);
+      for (UInt level = 0; level < levelCount; ++level)
+      {
+        const VolumeGrid& grid = level == 0 ? source : mips[level - 1];
+        const VolumeElement* element = grid.getData();
+        for (int z = 0; z < sizes[level][2]; ++z)
+        {
+          for (int y = 0; y < sizes[level][1]; ++y)
+          {
+            for (int x = 0; x < sizes[level][0]; ++x, ++element)
+            {
+              float* texel = texels.data() + 2 * texelIndex(level, x, y, z);
+              texel[0] = element->density;
+              texel[1] = element->angstromExponent;
+            }
+          }
+        }
+      }
+
+      XMINT3 counts = VolumeMips::getMacroCellCounts(source.getSize());
+      macroCounts[0] = counts.x;
+      macroCounts[1] = counts.y;
+      macroCounts[2] = counts.z;
+      VolumeMips::buildMacroCells(source, mips, macroCells);
+
+      // Means over the texels within each cell
+      std::vector<int> texelCounts(size_t(counts.x) * size_t(counts.y) * size_t(counts.z), 0);
+      macroAngstroms.assign(texelCounts.size(), .0f);
+      const VolumeElement* element = source.getData();
+      for (int z = 0; z < sizes[0][2]; ++z)
+      {
+        for (int y = 0; y < sizes[0][1]; ++y)
+        {
+          size_t row = size_t(counts.x) * (size_t(y / VolumeMips::MACRO_CELL_SIZE) + size_t(counts.y) * size_t(z / VolumeMips::MACRO_CELL_SIZE));
+          for (int x = 0; x < sizes[0][0]; ++x, ++element)
+          {
+            size_t cell = row + size_t(x / VolumeMips::MACRO_CELL_SIZE);
+            macroAngstroms[cell] += element->angstromExponent;
+            ++texelCounts[cell];
+          }
+        }
+      }
+      for (size_t cell = 0; cell < texelCounts.size(); ++cell) { macroAngstroms[cell] /= float(texelCounts[cell]); }
+    }
+
+    void sampleLevel(const VolumeLevels& levels, UInt level, float u, float v, float w, float result[2])
+    {
+      const int* size = levels.sizes[level];
+      float x = u * levels.floatSizes[level][0] - .5f;
+      float y = v * levels.floatSizes[level][1] - .5f;
+      float z = w * levels.floatSizes[level][2] - .5f;
+
+      // Entirely border (also catches NaNs)
+      result[0] = result[1] = .0f;
+      if (!(x > -1.f && x < float(size[0]) && y > -1.f && y < float(size[1]) && z > -1.f && z < float(size[2]))) { return; }
+
+      float floorX = std::floor(x), floorY = std::floor(y), floorZ = std::floor(z);
+      int x0 = int(floorX), y0 = int(floorY), z0 = int(floorZ);
+      float fractionX = x - floorX, fractionY = y - floorY, fractionZ = z - floorZ;
+
+      for (int corner = 0; corner < 8; ++corner)
+      {
+        int cornerX = x0 + (corner & 1), cornerY = y0 + ((corner >> 1) & 1), cornerZ = z0 + (corner >> 2);
+        if (cornerX < 0 || cornerY < 0 || cornerZ < 0 || cornerX >= size[0] || cornerY >= size[1] || cornerZ >= size[2]) { continue; }
+
+        float weight = ((corner & 1) ? fractionX : 1.f - fractionX) * (((corner >> 1) & 1) ? fractionY : 1.f - fractionY) * ((corner >> 2) ? fractionZ : 1.f - fractionZ);
+        const float* texel = levels.texels.data() + 2 * levels.texelIndex(level, cornerX, cornerY, cornerZ);
+        result[0] += weight * texel[0];
+        result[1] += weight * texel[1];
+      }
+    }
+
+
+    bool setupRay(const Constants& constants, UInt x, UInt y, Ray& ray)
+    {
+      // Rasterised screen positions are at pixel centres
+      float screenX = (float(x) + .5f) / float(constants.width) * 2.f - 1.f;
+      float screenY = 1.f - (float(y) + .5f) / float(constants.height) * 2.f;
+
+      // Form a ray from the screen, bounded by the volume
+      float nearPoint[4], farPoint[4];
+      float nearScreen[4] = { screenX, screenY, .0f, 1.f }, farScreen[4] = { screenX, screenY, 1.f, 1.f };
+      transform(nearScreen, constants.inverseViewProjection, nearPoint);
+      transform(farScreen, constants.inverseViewProjection, farPoint);
+      for (int i = 0; i < 4; ++i)
+      {
+        nearPoint[i] /= nearPoint[3];
+        farPoint[i] /= farPoint[3];
+      }
+
+      float* direction = ray.direction;
+      for (int i = 0; i < 3; ++i) { direction[i] = farPoint[i] - nearPoint[i]; }
+      float length = std::sqrt(dot3(direction, direction));
+      for (int i = 0; i < 3; ++i) { direction[i] /= length; }
+
+      float entry = .0f, exit = length;
+      if (!(length > .0f) || !intersectVolume(nearPoint, direction, constants.localTransform, entry, exit)) { return false; }
+
+      for (int i = 0; i < 3; ++i) { ray.position[i] = nearPoint[i] + direction[i] * entry; }
+      ray.travelDistance = .0f;
+      ray.marchZStep = constants.marchManual ? constants.marchZStep : (exit - entry) / float(constants.iterations);
+      march(ray.position, direction, ray.travelDistance, constants.marchManual ? constants.initialZStep : .0f);
+      if (constants.applyJitter)
+      {
+        float jitter = BlueNoise::sample(x, y, constants.jitterFrame) * ray.marchZStep;
+        for (int i = 0; i < 3; ++i) { ray.position[i] += direction[i] * jitter; }
+      }
+
+      // The same steps, spread over only the occupied spans of what the ray would have covered
+      ray.spanCount = 0;
+      if (constants.skipEmpty)
+      {
+        ray.travelLength = ray.marchZStep * float(constants.iterations);
+        float occupiedLength = findSpans(constants, ray.travelLength, ray);
+        if (ray.spanCount == 0) { return false; }
+        ray.marchZStep = occupiedLength / float(constants.iterations);
+      }
+
+      // Directional lighting will have a constant phase along the ray (and there is no geometry to shadow it)
+      float angularDistance = -dot3(direction, constants.lightDirection);
+      float incomingForward[4], incomingBackward[4];
+      hgScatter(angularDistance, constants.anisotropicForwardTerms, constants.applyHG, incomingForward);
+      hgScatter(angularDistance, constants.anisotropicBackwardTerms, constants.applyHG, incomingBackward);
+      for (int i = 0; i < 4; ++i)
+      {
+        float forward = incomingForward[i] * constants.lightIrradiance[i];
+        float backward = incomingBackward[i] * constants.lightIrradiance[i];
+        ray.directIrradiance[i] = constants.lightIrradiance[i] * constants.ambientScale[i] + (forward + (backward - forward) * constants.phaseBlendWeightTerms[i]);
+      }
+
+      return true;
+    }
+
+    float skipRange(float count, float step, float fullStep, float range, float travel)
+    {
+      return count * step * range / (travel + fullStep);
+    }
+
+    float travelAt(const Ray& ray, UInt& span, float& spanStart, float occupied)
+    {
+      if (ray.spanCount == 0) { return .0f; }
+
+      // Past the last span the walk continues along it
+      while (span + 1 < ray.spanCount && occupied - spanStart >= ray.spanEnds[span] - ray.spanBegins[span])
+      {
+        spanStart += ray.spanEnds[span] - ray.spanBegins[span];
+        ++span;
+      }
+      return ray.spanBegins[span] + (occupied - spanStart);
+    }
+
+    void marchRowScalar(const Constants& constants, UInt x, UInt y, UInt count, XMFLOAT4* out)
+    {
+      uint64_t samples = 0;
+      for (UInt i = 0; i < count; ++i)
+      {
+        Ray ray;
+        if (!setupRay(constants, x + i, y, ray))
+        {
+          out[i] = { .0f, .0f, .0f, 1.f }; // Masked
+          continue;
+        }
+
+        UInt raySamples = constants.iterations;
+        if (constants.marchAdaptive) { out[i] = marchRayAdaptive(constants, ray, raySamples); }
+        else if (constants.applyJitter) { out[i] = marchRay<RectangleIntegrator, RectangleIntegrator4>(constants, ray); }
+        else { out[i] = marchRay<SimpsonIntegrator, SimpsonIntegrator4>(constants, ray); }
+        samples += raySamples;
+      }
+
+      if (constants.sampleCount) { *constants.sampleCount += samples; }
+    }
+
+    MarchRow getMarchRow(SIMD::Level level)
+    {
+      switch (level)
+      {
+        case SIMD::LEVEL_SSE4: return marchRowSSE4;
+        case SIMD::LEVEL_AVX2: return marchRowAVX2;
+        case SIMD::LEVEL_AVX512: return marchRowAVX512;
+        default: return marchRowScalar;
+      }
+    }
+  }
+}
@@ -0,0 +1,76 @@
+#include "Rendering/Raymarch/MarchKernels.h"
+
+// Built with AVX2 enabled (scripts/SIMD.cmake), only called when the CPU supports it
+#ifdef HABOOB_SIMD_X86
+#include <immintrin.h>
+#include "Rendering/Raymarch/MarchKernelImpl.h"
+
+namespace Haboob
+{
+  namespace MarchKernels
+  {
+    namespace
+    {
+      struct LanesAVX2
+      {
+        static constexpr UInt WIDTH = 8;
+        typedef __m256 Float;
+        typedef __m256i Int;
+        typedef __m256 Mask;
+
+        static inline Float set(float value) { return _mm256_set1_ps(value); }
+        static inline Float load(const float* values) { return _mm256_loadu_ps(values); }
+        static inline void store(float* values, Float value) { _mm256_storeu_ps(values, value); }
+
+        static inline Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+        static inline Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+        static inline Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+        static inline Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+        static inline Float floor(Float a) { return _mm256_floor_ps(a); }
+        static inline Float abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-.0f), a); }
+        static inline Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+        static inline Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+
+        static inline Mask lessThan(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static inline Mask lessEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        static inline Mask maskAnd(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+        static inline bool any(Mask mask) { return _mm256_movemask_ps(mask) != 0; }
+        static inline Float select(Mask mask, Float onTrue, Float onFalse) { return _mm256_blendv_ps(onFalse, onTrue, mask); }
+
+        static inline Int setInt(UInt value) { return _mm256_set1_epi32(int(value)); }
+        static inline Int addInt(Int a, Int b) { return _mm256_add_epi32(a, b); }
+        static inline Int mulInt(Int a, Int b) { return _mm256_mullo_epi32(a, b); }
+        static inline Int andInt(Int a, Int b) { return _mm256_and_si256(a, b); }
+        static inline Int orInt(Int a, Int b) { return _mm256_or_si256(a, b); }
+        template<int N> static inline Int shiftLeft(Int a) { return _mm256_slli_epi32(a, N); }
+        template<int N> static inline Int shiftRight(Int a) { return _mm256_srli_epi32(a, N); }
+        static inline Int selectInt(Mask mask, Int onTrue, Int onFalse) { return _mm256_blendv_epi8(onFalse, onTrue, _mm256_castps_si256(mask)); }
+
+        static inline Int asInt(Float a) { return _mm256_castps_si256(a); }
+        static inline Float asFloat(Int a) { return _mm256_castsi256_ps(a); }
+        static inline Int toInt(Float a) { return _mm256_cvttps_epi32(a); } // Truncating
+        static inline Float toFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+
+        static inline Float gather(const float* base, Int index) { return _mm256_i32gather_ps(base, index, 4); }
+        static inline Int gatherInt(const int* base, Int index) { return _mm256_i32gather_epi32(base, index, 4); }
+      };
+    }
+
+    void marchRowAVX2(const Constants& constants, UInt x, UInt y, UInt count, XMFLOAT4* out)
+    {
+      marchRowLanes<LanesAVX2>(constants, x, y, count, out);
+    }
+  }
+}
+#else
+namespace Haboob
+{
+  namespace MarchKernels
+  {
+    void marchRowAVX2(const Constants& constants, UInt x, UInt y, UInt count, XMFLOAT4* out)
+    {
+      marchRowScalar(constants, x, y, count, out);
+    }
+  }
+}
+#endif
@@ -0,0 +1,76 @@
+#include "Rendering/Raymarch/MarchKernels.h"
+
+// Built with AVX-512F enabled (scripts/SIMD.cmake), only called when the CPU supports it
+#ifdef HABOOB_SIMD_X86
+#include <immintrin.h>
+#include "Rendering/Raymarch/MarchKernelImpl.h"
+
+namespace Haboob
+{
+  namespace MarchKernels
+  {
+    namespace
+    {
+      struct LanesAVX512
+      {
+        static constexpr UInt WIDTH = 16;
+        typedef __m512 Float;
+        typedef __m512i Int;
+        typedef __mmask16 Mask;
+
+        static inline Float set(float value) { return _mm512_set1_ps(value); }
+        static inline Float load(const float* values) { return _mm512_loadu_ps(values); }
+        static inline void store(float* values, Float value) { _mm512_storeu_ps(values, value); }
+
+        static inline Float add(Float a, Float b) { return _mm512_add_ps(a, b); }
+        static inline Float sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+        static inline Float mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+        static inline Float div(Float a, Float b) { return _mm512_div_ps(a, b); }
+        static inline Float floor(Float a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+        static inline Float abs(Float a) { return _mm512_abs_ps(a); }
+        static inline Float min(Float a, Float b) { return _mm512_min_ps(a, b); }
+        static inline Float max(Float a, Float b) { return _mm512_max_ps(a, b); }
+
+        static inline Mask lessThan(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static inline Mask lessEqual(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+        static inline Mask maskAnd(Mask a, Mask b) { return Mask(a & b); }
+        static inline bool any(Mask mask) { return mask != 0; }
+        static inline Float select(Mask mask, Float onTrue, Float onFalse) { return _mm512_mask_blend_ps(mask, onFalse, onTrue); }
+
+        static inline Int setInt(UInt value) { return _mm512_set1_epi32(int(value)); }
+        static inline Int addInt(Int a, Int b) { return _mm512_add_epi32(a, b); }
+        static inline Int mulInt(Int a, Int b) { return _mm512_mullo_epi32(a, b); }
+        static inline Int andInt(Int a, Int b) { return _mm512_and_si512(a, b); }
+        static inline Int orInt(Int a, Int b) { return _mm512_or_si512(a, b); }
+        template<int N> static inline Int shiftLeft(Int a) { return _mm512_slli_epi32(a, N); }
+        template<int N> static inline Int shiftRight(Int a) { return _mm512_srli_epi32(a, N); }
+        static inline Int selectInt(Mask mask, Int onTrue, Int onFalse) { return _mm512_mask_blend_epi32(mask, onFalse, onTrue); }
+
+        static inline Int asInt(Float a) { return _mm512_castps_si512(a); }
+        static inline Float asFloat(Int a) { return _mm512_castsi512_ps(a); }
+        static inline Int toInt(Float a) { return _mm512_cvttps_epi32(a); } // Truncating
+        static inline Float toFloat(Int a) { return _mm512_cvtepi32_ps(a); }
+
+        static inline Float gather(const float* base, Int index) { return _mm512_i32gather_ps(index, base, 4); }
+        static inline Int gatherInt(const int* base, Int index) { return _mm512_i32gather_epi32(index, base, 4); }
+      };
+    }
+
+    void marchRowAVX512(const Constants& constants, UInt x, UInt y, UInt count, XMFLOAT4* out)
+    {
+      marchRowLanes<LanesAVX512>(constants, x, y, count, out);
+    }
+  }
+}
+#else
+namespace Haboob
+{
+  namespace MarchKernels
+  {
+    void marchRowAVX512(const Constants& constants, UInt x, UInt y, UInt count, XMFLOAT4* out)
+    {
+      marchRowScalar(constants, x, y, count, out);
+    }
+  }
+}
+#endif
@@ -0,0 +1,88 @@
+#include "Rendering/Raymarch/MarchKernels.h"
+
+// Built with SSE4.1 enabled (scripts/SIMD.cmake), only called when the CPU supports it
+#ifdef HABOOB_SIMD_X86
+#include <smmintrin.h>
+#include "Rendering/Raymarch/MarchKernelImpl.h"
+
+namespace Haboob
+{
+  namespace MarchKernels
+  {
+    namespace
+    {
+      struct LanesSSE4
+      {
+        static constexpr UInt WIDTH = 4;
+        typedef __m128 Float;
+        typedef __m128i Int;
+        typedef __m128 Mask;
+
+        static inline Float set(float value) { return _mm_set1_ps(value); }
+        static inline Float load(const float* values) { return _mm_loadu_ps(values); }
+        static inline void store(float* values, Float value) { _mm_storeu_ps(values, value); }
+
+        static inline Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+        static inline Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+        static inline Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+        static inline Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+        static inline Float floor(Float a) { return _mm_floor_ps(a); }
+        static inline Float abs(Float a) { return _mm_andnot_ps(_mm_set1_ps(-.0f), a); }
+        static inline Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+        static inline Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+
+        static inline Mask lessThan(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+        static inline Mask lessEqual(Float a, Float b) { return _mm_cmple_ps(a, b); }
+        static inline Mask maskAnd(Mask a, Mask b) { return _mm_and_ps(a, b); }
+        static inline bool any(Mask mask) { return _mm_movemask_ps(mask) != 0; }
+        static inline Float select(Mask mask, Float onTrue, Float onFalse) { return _mm_blendv_ps(onFalse, onTrue, mask); }
+
+        static inline Int setInt(UInt value) { return _mm_set1_epi32(int(value)); }
+        static inline Int addInt(Int a, Int b) { return _mm_add_epi32(a, b); }
+        static inline Int mulInt(Int a, Int b) { return _mm_mullo_epi32(a, b); }
+        static inline Int andInt(Int a, Int b) { return _mm_and_si128(a, b); }
+        static inline Int orInt(Int a, Int b) { return _mm_or_si128(a, b); }
+        template<int N> static inline Int shiftLeft(Int a) { return _mm_slli_epi32(a, N); }
+        template<int N> static inline Int shiftRight(Int a) { return _mm_srli_epi32(a, N); }
+        static inline Int selectInt(Mask mask, Int onTrue, Int onFalse) { return _mm_blendv_epi8(onFalse, onTrue, _mm_castps_si128(mask)); }
+
+        static inline Int asInt(Float a) { return _mm_castps_si128(a); }
+        static inline Float asFloat(Int a) { return _mm_castsi128_ps(a); }
+        static inline Int toInt(Float a) { return _mm_cvttps_epi32(a); } // Truncating
+        static inline Float toFloat(Int a) { return _mm_cvtepi32_ps(a); }
+
+        // No gather before AVX2, each lane is read in turn
+        static inline Float gather(const float* base, Int index)
+        {
+          alignas(16) int lanes[4];
+          _mm_store_si128(reinterpret_cast<__m128i*>(lanes), index);
+          return _mm_setr_ps(base[lanes[0]], base[lanes[1]], base[lanes[2]], base[lanes[3]]);
+        }
+
+        static inline Int gatherInt(const int* base, Int index)
+        {
+          alignas(16) int lanes[4];
+          _mm_store_si128(reinterpret_cast<__m128i*>(lanes), index);
+          return _mm_setr_epi32(base[lanes[0]], base[lanes[1]], base[lanes[2]], base[lanes[3]]);
+        }
+      };
+    }
+
+    void marchRowSSE4(const Constants& constants, UInt x, UInt y, UInt count, XMFLOAT4* out)
+    {
+      marchRowLanes<LanesSSE4>(constants, x, y, count, out);
+    }
+  }
+}
+#else
+namespace Haboob
+{
+  namespace MarchKernels
+  {
+    void marchRowSSE4(const Constants& constants, UInt x, UInt y, UInt count, XMFLOAT4* out)
+    {
+      marchRowScalar(constants, x, y, count, out);
+    }
+  }
+}
+#endif
@@ -0,0 +1,311 @@
+#include "Rendering/Raymarch/RayExtents.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Haboob
+{
+  namespace RayExtents
+  {
+    namespace
+    {
+      // mul(vector, matrix) of a row_major matrix
+      inline void transform(const float vector[4], const XMFLOAT4X4& matrix, float result[4])
+      {
+        for (int column = 0; column < 4; ++column)
+        {
+          result[column] = vector[0] * matrix.m[0][column] + vector[1] * matrix.m[1][column] + vector[2] * matrix.m[2][column] + vector[3] * matrix.m[3][column];
+        }
+      }
+
+      inline void multiply(const XMFLOAT4X4& a, const XMFLOAT4X4& b, XMFLOAT4X4& result)
+      {
+        for (int row = 0; row < 4; ++row) { transform(a.m[row], b, result.m[row]); }
+      }
+
+      inline float depthAt(const float* sceneDepth, UInt width, UInt x, UInt y)
+      {
+        return sceneDepth ? sceneDepth[size_t(x) + size_t(width) * size_t(y)] : 1.f;
+      }
+
+      inline void forRows(UInt height, ThreadPool* pool, const std::function<void(UInt)>& row)
+      {
+        if (pool) { pool->parallelFor(height, row); }
+        else { for (UInt y = 0; y < height; ++y) { row(y); } }
+      }
+
+      // A pixel's NDC depths through the cube ([-.5, .5] in volume space), the exit clamped to the far plane
+      bool traceRay(const XMFLOAT4X4& screenToLocal, float screenX, float screenY, float& entry, float& exit)
+      {
+        // origin + z * along in homogeneous volume space
+        float origin[4], along[4];
+        for (int i = 0; i < 4; ++i)
+        {
+          origin[i] = screenX * screenToLocal.m[0][i] + screenY * screenToLocal.m[1][i] + screenToLocal.m[3][i];
+          along[i] = screenToLocal.m[2][i];
+        }
+
+        // w is positive from the camera to beyond the far plane once the near plane's is, so each face is a linear inequality in z
+        if (origin[3] < .0f)
+        {
+          for (int i = 0; i < 4; ++i) { origin[i] = -origin[i]; along[i] = -along[i]; }
+        }
+
+        entry = -INFINITY;
+        exit = 1.f;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+          for (float side = -1.f; side <= 1.f; side += 2.f)
+          {
+            // side * local - .5 * w <= 0
+            float offset = side * origin[axis] - .5f * origin[3];
+            float slope = side * along[axis] - .5f * along[3];
+            if (slope > .0f) { exit = std::min(exit, -offset / slope); }
+            else if (slope < .0f) { entry = std::max(entry, -offset / slope); }
+            else if (offset > .0f) { return false; }
+          }
+        }
+
+        return entry <= exit && exit >= .0f;
+      }
+
+      // A box corner after the vertex shader, its screen position being the NDC it passes on
+      struct ClipVertex
+      {
+        float position[4];
+        float screen[2];
+      };
+
+      // Splits a triangle's edge where it crosses the near plane (clip z = 0), attributes following linearly in clip space
+      ClipVertex clipEdge(const ClipVertex& from, const ClipVertex& to)
+      {
+        float t = from.position[2] / (from.position[2] - to.position[2]);
+        ClipVertex result;
+        for (int i = 0; i < 4; ++i) { result.position[i] = from.position[i] + (to.position[i] - from.position[i]) * t; }
+        for (int i = 0; i < 2; ++i) { result.screen[i] = from.screen[i] + (to.screen[i] - from.screen[i]) * t; }
+        return result;
+      }
+
+      // A triangle set up for rasterising, in pixels with (0, 0) the top left corner
+      struct Triangle
+      {
+        float x[3], y[3];
+        float depth[3]; // NDC, affine in screen space
+        float inverseW[3];
+        float screen[3][2]; // Perspective correct
+        float area;
+        float minY, maxY;
+      };
+
+      void setupTriangle(const ClipVertex* vertices, UInt width, UInt height, std::vector<Triangle>& triangles)
+      {
+        Triangle triangle;
+        for (int i = 0; i < 3; ++i)
+        {
+          const float* position = vertices[i].position;
+          triangle.inverseW[i] = 1.f / position[3];
+          triangle.x[i] = (position[0] * triangle.inverseW[i] * .5f + .5f) * float(width);
+          triangle.y[i] = (.5f - position[1] * triangle.inverseW[i] * .5f) * float(height);
+          triangle.depth[i] = position[2] * triangle.inverseW[i];
+          triangle.screen[i][0] = vertices[i].screen[0];
+          triangle.screen[i][1] = vertices[i].screen[1];
+        }
+
+        triangle.area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.x[2] - triangle.x[0]) * (triangle.y[1] - triangle.y[0]);
+        if (triangle.area == .0f) { return; }
+        triangle.minY = std::min({ triangle.y[0], triangle.y[1], triangle.y[2] });
+        triangle.maxY = std::max({ triangle.y[0], triangle.y[1], triangle.y[2] });
+        triangles.push_back(triangle);
+      }
+
+      // Clips a triangle to the near plane, fanning what remains
+      void addTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, UInt width, UInt height, std::vector<Triangle>& triangles)
+      {
+        const ClipVertex* corners[3] = { &a, &b, &c };
+        ClipVertex polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+          const ClipVertex& from = *corners[i];
+          const ClipVertex& to = *corners[(i + 1) % 3];
+          bool fromInside = from.position[2] >= .0f, toInside = to.position[2] >= .0f;
+          if (fromInside) { polygon[count++] = from; }
+          if (fromInside != toInside) { polygon[count++] = clipEdge(from, to); }
+        }
+
+        for (int i = 2; i < count; ++i)
+        {
+          ClipVertex fan[3] = { polygon[0], polygon[i - 1], polygon[i] };
+          setupTriangle(fan, width, height, triangles);
+        }
+      }
+
+      // Whether a triangle covers a pixel centre, with its barycentric weights
+      inline bool cover(const Triangle& triangle, float x, float y, float weights[3])
+      {
+        for (int i = 0; i < 3; ++i)
+        {
+          int j = (i + 1) % 3, k = (i + 2) % 3;
+          weights[i] = ((triangle.x[k] - triangle.x[j]) * (y - triangle.y[j]) - (x - triangle.x[j]) * (triangle.y[k] - triangle.y[j])) / triangle.area;
+          if (weights[i] < .0f) { return false; }
+        }
+        return true;
+      }
+    }
+
+    void trace(const View& view, const float* sceneDepth, HDRImage& rays, ThreadPool* pool)
+    {
+      UInt width = rays.getWidth(), height = rays.getHeight();
+
+      // NDC straight to volume space, where a pixel's ray is origin + z * along in homogeneous coords
+      XMFLOAT4X4 screenToLocal;
+      multiply(view.inverseViewProjection, view.localTransform, screenToLocal);
+
+      forRows(height, pool, [&](UInt y)
+      {
+        float screenY = 1.f - (float(y) + .5f) / float(height) * 2.f;
+        for (UInt x = 0; x < width; ++x)
+        {
+          float screenX = (float(x) + .5f) / float(width) * 2.f - 1.f;
+          float entry, exit;
+          XMFLOAT4& ray = rays.at(x, y);
+          if (!traceRay(screenToLocal, screenX, screenY, entry, exit))
+          {
+            ray = { -1.f, -1.f, .0f, 1.f };
+            continue;
+          }
+
+          float depth = depthAt(sceneDepth, width, x, y);
+          ray.x = entry < .0f ? .0f : (entry < depth ? entry : -1.f);
+          ray.y = std::min(exit, depth);
+          ray.z = screenX;
+          ray.w = screenY;
+        }
+      });
+    }
+
+    void findActiveTiles(const XMFLOAT4X4& inverseViewProjection, const XMFLOAT4X4& localTransform, UInt width, UInt height, UInt tileSize, std::vector<UInt>& tiles,
+      ThreadPool* pool)
+    {
+      XMFLOAT4X4 screenToLocal;
+      multiply(inverseViewProjection, localTransform, screenToLocal);
+
+      // Each tile stops at its first ray through the cube
+      UInt tilesX = (width + tileSize - 1) / tileSize, tilesY = (height + tileSize - 1) / tileSize;
+      std::vector<Byte> active(size_t(tilesX) * tilesY, 0);
+      auto classify = [&](UInt tile)
+        {
+          UInt beginX = (tile % tilesX) * tileSize, beginY = (tile / tilesX) * tileSize;
+          UInt endX = std::min(beginX + tileSize, width), endY = std::min(beginY + tileSize, height);
+          for (UInt y = beginY; y < endY && !active[tile]; ++y)
+          {
+            float screenY = 1.f - (float(y) + .5f) / float(height) * 2.f;
+            for (UInt x = beginX; x < endX; ++x)
+            {
+              float entry, exit;
+              if (traceRay(screenToLocal, (float(x) + .5f) / float(width) * 2.f - 1.f, screenY, entry, exit)) { active[tile] = 1; break; }
+            }
+          }
+        };
+
+      UInt tileCount = tilesX * tilesY;
+      if (pool) { pool->parallelFor(tileCount, classify); }
+      else
+      {
+        for (UInt tile = 0; tile < tileCount; ++tile) { classify(tile); }
+      }
+
+      tiles.clear();
+      for (UInt tile = 0; tile < tileCount; ++tile)
+      {
+        if (active[tile]) { tiles.push_back(tile); }
+      }
+    }
+
+    void rasterise(const View& view, const float* sceneDepth, HDRImage& rays, ThreadPool* pool)
+    {
+      UInt width = rays.getWidth(), height = rays.getHeight();
+
+      // Determine if the camera is within a regular bounding sphere
+      float camera[4] = { view.cameraPosition[0], view.cameraPosition[1], view.cameraPosition[2], 1.f }, cameraLocal[4];
+      transform(camera, view.localTransform, cameraLocal);
+      bool cameraWithin = std::sqrt(cameraLocal[0] * cameraLocal[0] + cameraLocal[1] * cameraLocal[1] + cameraLocal[2] * cameraLocal[2]) <= std::sqrt(3.f) * .5f + .03f;
+
+      // The vertex shader over the box's corners
+      XMFLOAT4X4 localToClip;
+      multiply(view.volumeTransform, view.viewProjection, localToClip);
+      ClipVertex corners[8];
+      for (int corner = 0; corner < 8; ++corner)
+      {
+        float local[4] = { (corner & 1) ? .5f : -.5f, (corner & 2) ? .5f : -.5f, (corner & 4) ? .5f : -.5f, 1.f };
+        transform(local, localToClip, corners[corner].position);
+        corners[corner].screen[0] = corners[corner].position[0] / corners[corner].position[3];
+        corners[corner].screen[1] = corners[corner].position[1] / corners[corner].position[3];
+      }
+
+      // Two triangles per face, facing the camera when it is beyond the face's plane
+      std::vector<Triangle> frontFaces, backFaces;
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        for (int side = 0; side < 2; ++side)
+        {
+          int bit = 1 << axis, u = 1 << ((axis + 1) % 3), v = 1 << ((axis + 2) % 3);
+          int base = side ? bit : 0;
+          const ClipVertex& c0 = corners[base], & c1 = corners[base | u], & c2 = corners[base | u | v], & c3 = corners[base | v];
+
+          bool facing = (side ? cameraLocal[axis] : -cameraLocal[axis]) > .5f;
+          std::vector<Triangle>& faces = facing ? frontFaces : backFaces;
+          addTriangle(c0, c1, c2, width, height, faces);
+          addTriangle(c0, c2, c3, width, height, faces);
+        }
+      }
+
+      forRows(height, pool, [&](UInt y)
+      {
+        float centreY = float(y) + .5f;
+        for (UInt x = 0; x < width; ++x) { rays.at(x, y) = { cameraWithin ? .0f : -1.f, -1.f, .0f, 1.f }; }
+
+        // Front faces write depth and alpha where they pass the depth test
+        if (!cameraWithin)
+        {
+          for (const Triangle& triangle : frontFaces)
+          {
+            if (centreY < triangle.minY || centreY > triangle.maxY) { continue; }
+            for (UInt x = 0; x < width; ++x)
+            {
+              float weights[3];
+              if (!cover(triangle, float(x) + .5f, centreY, weights)) { continue; }
+              float depth = weights[0] * triangle.depth[0] + weights[1] * triangle.depth[1] + weights[2] * triangle.depth[2];
+              if (depth < .0f || depth > 1.f || depth >= depthAt(sceneDepth, width, x, y)) { continue; }
+
+              XMFLOAT4& ray = rays.at(x, y);
+              ray.x = depth;
+              ray.w = -1.f;
+            }
+          }
+        }
+
+        // Back faces always write the rest, clamped to the scene
+        for (const Triangle& triangle : backFaces)
+        {
+          if (centreY < triangle.minY || centreY > triangle.maxY) { continue; }
+          for (UInt x = 0; x < width; ++x)
+          {
+            float weights[3];
+            if (!cover(triangle, float(x) + .5f, centreY, weights)) { continue; }
+            float depth = weights[0] * triangle.depth[0] + weights[1] * triangle.depth[1] + weights[2] * triangle.depth[2];
+            if (depth < .0f || depth > 1.f) { continue; }
+
+            float perspective[3], total = .0f;
+            for (int i = 0; i < 3; ++i) { perspective[i] = weights[i] * triangle.inverseW[i]; total += perspective[i]; }
+
+            XMFLOAT4& ray = rays.at(x, y);
+            ray.y = std::min(depth, depthAt(sceneDepth, width, x, y));
+            ray.z = (perspective[0] * triangle.screen[0][0] + perspective[1] * triangle.screen[1][0] + perspective[2] * triangle.screen[2][0]) / total;
+            ray.w = (perspective[0] * triangle.screen[0][1] + perspective[1] * triangle.screen[1][1] + perspective[2] * triangle.screen[2][1]) / total;
+          }
+        }
+      });
+    }
+  }
+}
@@ -0,0 +1,187 @@
+#include "Rendering/Raymarch/ReferenceMarcher.h"
+#include "Rendering/Raymarch/RayExtents.h"
+#include "Rendering/Volume/VolumeMips.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Haboob
+{
+  namespace
+  {
+    constexpr float EULER = 1.f; // exp(0), as Globals.lib defines it
+
+    inline float blTransmission(float opticalDepth, bool applyBeer)
+    {
+      return applyBeer ? std::exp(-opticalDepth) : 1.f / (1.f + opticalDepth);
+    }
+
+    inline float bpTransmission(float opticalDepth, float powderCoefficient, bool applyBeer)
+    {
+      return blTransmission(opticalDepth, applyBeer) - blTransmission(powderCoefficient * opticalDepth, applyBeer);
+    }
+
+    inline void copy(const XMFLOAT4& value, float out[4])
+    {
+      out[0] = value.x;
+      out[1] = value.y;
+      out[2] = value.z;
+      out[3] = value.w;
+    }
+
+    // Everything MarchVolume.cs reads from its constant buffers, with the screen invariant terms evaluated once
+    void prepareConstants(const MarchKernels::VolumeLevels& levels, const ReferenceMarchSettings& settings, UInt width, UInt height, const CameraPack& camera,
+      const DirectionalLightPack& light, const MarchVolumeDispatchInfo& marchInfo, const BasicOptics& optics, const SpectralOptics::TransmissionLUT* transmissionLUT,
+      MarchKernels::Constants& constants)
+    {
+      constants.levels = &levels;
+      constants.width = width;
+      constants.height = height;
+      XMStoreFloat4x4(&constants.inverseViewProjection, camera.inverseViewProjectionMatrix);
+      XMStoreFloat4x4(&constants.localTransform, marchInfo.localVolumeTransform);
+
+      constants.applyBeer = optics.flagApplyBeer != 0;
+      constants.applyHG = optics.flagApplyHG != 0;
+      constants.applySpectral = optics.flagApplySpectral != 0;
+      constants.marchManual = settings.marchManual;
+      constants.applyConeTrace = settings.applyConeTrace;
+      constants.skipEmpty = settings.skipEmpty && !settings.marchAdaptive; // Adaptive steps place themselves
+      constants.emptyDensity = settings.emptyDensity;
+      constants.marchAdaptive = settings.marchAdaptive;
+      constants.stepOpticalDepth = marchInfo.stepOpticalDepth;
+      constants.terminationTransmission = marchInfo.terminationTransmission;
+      constants.minStepScale = std::max(marchInfo.minStepScale, 1.f / 64.f); // Bounds the samples per ray
+      constants.maxStepScale = std::max(marchInfo.maxStepScale, constants.minStepScale);
+      constants.applyJitter = settings.jitter;
+      constants.jitterFrame = settings.frame;
+      constants.transmissionLUT = transmissionLUT;
+      constants.sampleCount = nullptr;
+
+      // LightSource normalises the direction on upload
+      float lightDirection[3] = { light.direction.x, light.direction.y, light.direction.z };
+      float lightLength = std::sqrt(lightDirection[0] * lightDirection[0] + lightDirection[1] * lightDirection[1] + lightDirection[2] * lightDirection[2]);
+      for (int i = 0; i < 3; ++i) { constants.lightDirection[i] = lightLength > .0f ? lightDirection[i] / lightLength : lightDirection[i]; }
+
+      float lightIrradiance[4] = { light.diffuse.x, light.diffuse.y, light.diffuse.z, light.diffuse.x };
+      float lightAmbient[4] = { light.ambient.x, light.ambient.y, light.ambient.z, light.ambient.x };
+      float ambientFraction[4];
+      copy(optics.ambientFraction, ambientFraction);
+      for (int i = 0; i < 4; ++i)
+      {
+        constants.lightIrradiance[i] = lightIrradiance[i];
+        constants.ambientScale[i] = lightAmbient[i] * ambientFraction[i];
+      }
+      copy(optics.anisotropicForwardTerms, constants.anisotropicForwardTerms);
+      copy(optics.anisotropicBackwardTerms, constants.anisotropicBackwardTerms);
+      copy(optics.phaseBlendWeightTerms, constants.phaseBlendWeightTerms);
+
+      constants.attenuationFactor = optics.attenuationFactor;
+      constants.absorptionAngstromExponent = optics.absorptionAngstromExponent;
+      constants.scatterAngstromExponent = optics.scatterAngstromExponent;
+      constants.powderCoefficient = optics.powderCoefficient;
+
+      // Without a light march the incoming light has a constant optical depth
+      float scatterOpticalDepth = optics.attenuationFactor * EULER;
+      float scatterAngstrom = optics.scatterAngstromExponent * EULER;
+      constants.scatterTransmission = bpTransmission(scatterOpticalDepth, optics.powderCoefficient, constants.applyBeer);
+      for (int row = 0; row < 4; ++row)
+      {
+        for (int column = 0; column < 4; ++column)
+        {
+          // pow(x, y) is exp2(y * log2(x)) on the GPU, so the logarithm of each relative wavelength is taken once
+          float logWavelength = std::log2(optics.spectralWavelengths.m[row][column] / optics.referenceWavelength);
+          constants.logWavelengths[row][column] = logWavelength;
+          constants.spectralWeights[row][column] = optics.spectralWeights.m[row][column];
+          constants.spectralToRGB[row][column] = optics.spectralToRGB.m[row][column];
+          constants.spectralScatterTransmissions[row][column] = bpTransmission(scatterOpticalDepth * std::exp2(-scatterAngstrom * logWavelength), optics.powderCoefficient, constants.applyBeer);
+        }
+      }
+
+      constants.pixelRadius = marchInfo.pixelRadius;
+      constants.pixelRadiusDelta = marchInfo.pixelRadiusDelta;
+      constants.worldToTexels = marchInfo.texelDensity / marchInfo.volumeSize.x;
+      constants.initialZStep = marchInfo.initialZStep;
+      constants.marchZStep = marchInfo.marchZStep;
+      constants.iterations = marchInfo.iterations;
+      constants.lightIterations = settings.lightIterations;
+    }
+  }
+
+  ReferenceMarcher::ReferenceMarcher(ThreadPool* threadPool) : pool{ threadPool }, simdLevel{ SIMD::detectLevel() }
+  {
+
+  }
+
+  void ReferenceMarcher::setSIMDLevel(SIMD::Level level)
+  {
+    simdLevel = std::min(level, SIMD::detectLevel());
+  }
+
+  void ReferenceMarcher::setVolume(const VolumeGrid& grid, MarchKernels::VolumeLevels::Layout layout)
+  {
+    std::vector<VolumeGrid> mips;
+    VolumeMips::buildChain(grid, mips, VolumeMips::getLevelCount(grid.getSize()), pool);
+    levels.assign(grid, mips, layout);
+  }
+
+  void ReferenceMarcher::render(const CameraPack& camera, const DirectionalLightPack& light, const MarchVolumeDispatchInfo& marchInfo, const BasicOptics& optics, HDRImage& target,
+    uint64_t* sampleCount) const
+  {
+    UInt width = target.getWidth(), height = target.getHeight();
+    if (levels.levelCount == 0 || width == 0 || height == 0) { return; }
+
+    const SpectralOptics::TransmissionLUT* lut = nullptr;
+    if (settings.transmissionLUT && optics.flagApplySpectral)
+    {
+      uint64_t key = SpectralOptics::hashTransmissionLUT(optics);
+      if (transmissionLUT.texels.empty() || key != transmissionLUTKey)
+      {
+        SpectralOptics::buildTransmissionLUT(optics, transmissionLUT);
+        transmissionLUTKey = key;
+      }
+      lut = &transmissionLUT;
+    }
+
+    MarchKernels::Constants constants;
+    prepareConstants(levels, settings, width, height, camera, light, marchInfo, optics, lut, constants);
+    std::atomic<uint64_t> samples{ 0 };
+    if (sampleCount) { constants.sampleCount = &samples; }
+    MarchKernels::MarchRow marchRow = MarchKernels::getMarchRow(simdLevel);
+
+    // Tiles of the screen are independent, as the shader's thread groups
+    UInt tileSize = std::max(settings.tileSize, 1U);
+    UInt tilesX = (width + tileSize - 1) / tileSize, tilesY = (height + tileSize - 1) / tileSize;
+    auto renderTile = [&](UInt tile)
+      {
+        UInt beginX = (tile % tilesX) * tileSize, beginY = (tile / tilesX) * tileSize;
+        UInt endX = std::min(beginX + tileSize, width), endY = std::min(beginY + tileSize, height);
+        for (UInt y = beginY; y < endY; ++y)
+        {
+          marchRow(constants, beginX, y, endX - beginX, &target.at(beginX, y));
+        }
+      };
+
+    UInt tileCount = tilesX * tilesY;
+    if (settings.compactTiles)
+    {
+      // Every ray of the tiles left out is masked
+      std::vector<UInt> activeTiles;
+      RayExtents::findActiveTiles(constants.inverseViewProjection, constants.localTransform, width, height, tileSize, activeTiles, pool);
+      target.fill({ .0f, .0f, .0f, 1.f });
+
+      auto renderActiveTile = [&](UInt index) { renderTile(activeTiles[index]); };
+      if (pool) { pool->parallelFor(UInt(activeTiles.size()), renderActiveTile); }
+      else
+      {
+        for (UInt index = 0; index < UInt(activeTiles.size()); ++index) { renderActiveTile(index); }
+      }
+    }
+    else if (pool) { pool->parallelFor(tileCount, renderTile); }
+    else
+    {
+      for (UInt tile = 0; tile < tileCount; ++tile) { renderTile(tile); }
+    }
+
+    if (sampleCount) { *sampleCount = samples; }
+  }
+}
@@ -0,0 +1,112 @@
+#include "Rendering/Raymarch/SpectralOptics.h"
+#include "Data/Hash.h"
+
+#include <cmath>
+
+namespace Haboob
+{
+  namespace SpectralOptics
+  {
+    void buildMatrices(BasicOptics& optics)
+    {
+      // Hermit-Gauss quadrature of order n=4
+      float hermitGaussAbscissas[4] = { 0.524647623275f, -0.524647623275f, 1.650680123886f, -1.650680123886f };
+      float hermitGaussWeights[4] = { 0.804914090006f, 0.804914090006f, 0.0813128354473f, 0.0813128354473f };
+
+      // Substitution is in order
+      auto logAbscissasAdjust = [](float abscissas, const float distributionCoefficients[4]) -> float {
+        return (std::exp(abscissas / distributionCoefficients[1]) - distributionCoefficients[3]) / distributionCoefficients[2];
+      };
+      auto linearAbscissasAdjust = [](float abscissas, const float distributionCoefficients[4]) -> float {
+        return (abscissas - distributionCoefficients[3]) / distributionCoefficients[2];
+      };
+      auto logWeight = [](float abscissas, const float distributionCoefficients[4]) -> float {
+        return std::abs(std::exp(abscissas / distributionCoefficients[1]) / (distributionCoefficients[1] * distributionCoefficients[2]));
+      };
+      auto linearWeight = [](float /*abscissas*/, const float distributionCoefficients[4]) -> float {
+        return 1.f / distributionCoefficients[2];
+      };
+
+      for (size_t wavelet = 0; wavelet < 4; ++wavelet)
+      {
+        const float* distribution = nullptr;
+        switch (wavelet)
+        {
+          case 0: distribution = redMajorCIECoefficients;
+          break;
+          case 1: distribution = greenCIECoefficients;
+          break;
+          case 2: distribution = blueCIECoefficients;
+          break;
+          case 3: distribution = redMinorCIECoefficients;
+          break;
+        }
+
+        for (size_t term = 0; term < 4; ++term)
+        {
+          if (wavelet == 1) // Green = linear
+          {
+            optics.spectralWeights.m[wavelet][term] = hermitGaussWeights[term] * linearWeight(hermitGaussAbscissas[term], distribution) * distribution[0];
+            optics.spectralWavelengths.m[wavelet][term] = linearAbscissasAdjust(hermitGaussAbscissas[term], distribution);
+          }
+          else // Everything else = logarithmic
+          {
+            optics.spectralWeights.m[wavelet][term] = hermitGaussWeights[term] * logWeight(hermitGaussAbscissas[term], distribution) * distribution[0];
+            optics.spectralWavelengths.m[wavelet][term] = logAbscissasAdjust(hermitGaussAbscissas[term], distribution);
+          }
+        }
+      }
+
+      // This matrix transforms from the CIEXYZ components to display independent linear RGB (note: column1 = column4)
+      // Stored transposed, as XMMatrixTranspose of the rows below
+      const float spectralToRGB[4][4] = {
+        { 3.2406f, -1.5372f, -.4986f, 3.2406f },
+        { -.9689f, 1.8758f, .0415f, -.9689f },
+        { .0557f, -.2040f, 1.0570f, .0557f },
+        { .0f, .0f, .0f, .0f } };
+      for (size_t row = 0; row < 4; ++row)
+      {
+        for (size_t column = 0; column < 4; ++column)
+        {
+          optics.spectralToRGB.m[column][row] = spectralToRGB[row][column];
+        }
+      }
+    }
+
+    void buildTransmissionLUT(const BasicOptics& optics, TransmissionLUT& lut)
+    {
+      bool applyBeer = optics.flagApplyBeer != 0;
+      auto blTransmission = [applyBeer](float opticalDepth) -> float { return applyBeer ? std::exp(-opticalDepth) : 1.f / (1.f + opticalDepth); };
+
+      float logWavelengths[16];
+      for (int i = 0; i < 16; ++i) { logWavelengths[i] = std::log2(optics.spectralWavelengths.m[i / 4][i % 4] / optics.referenceWavelength); }
+
+      // Both the view and light lookups share the table, so it covers the larger exponent
+      lut.maxAngstrom = TransmissionLUT::ANGSTROM_LENGTH * std::max(std::max(optics.absorptionAngstromExponent, optics.scatterAngstromExponent), 1e-3f);
+      lut.texels.resize(size_t(TransmissionLUT::DEPTH_SIZE) * TransmissionLUT::ANGSTROM_SIZE * 16);
+      float* texel = lut.texels.data();
+      for (UInt y = 0; y < TransmissionLUT::ANGSTROM_SIZE; ++y)
+      {
+        float angstrom = lut.maxAngstrom * float(y) / float(TransmissionLUT::ANGSTROM_SIZE - 1);
+        for (UInt x = 0; x < TransmissionLUT::DEPTH_SIZE; ++x)
+        {
+          float logDepth = TransmissionLUT::MIN_LOG_DEPTH + (TransmissionLUT::MAX_LOG_DEPTH - TransmissionLUT::MIN_LOG_DEPTH) * float(x) / float(TransmissionLUT::DEPTH_SIZE - 1);
+          for (int i = 0; i < 16; ++i, ++texel)
+          {
+            // As spectralScatter then bpTransmission
+            float opticalDepth = std::exp2(logDepth - angstrom * logWavelengths[i]);
+            *texel = blTransmission(opticalDepth) - blTransmission(optics.powderCoefficient * opticalDepth);
+          }
+        }
+      }
+    }
+
+    uint64_t hashTransmissionLUT(const BasicOptics& optics)
+    {
+      Hasher hasher;
+      for (int i = 0; i < 16; ++i) { hasher.add(optics.spectralWavelengths.m[i / 4][i % 4]); }
+      return hasher.add(optics.referenceWavelength).add(optics.powderCoefficient).add(optics.flagApplyBeer)
+        .add(optics.absorptionAngstromExponent).add(optics.scatterAngstromExponent).get();
+    }
+  }
+}
@@ -1,8 +1,15 @@
 #include "Rendering/Shaders/ShaderManager.h"
 #include "Rendering/Geometry/MeshRendererImpl.h"
 #include "Rendering/Shaders/RaymarchVolumeShader.h"
+#include "Rendering/Raymarch/SpectralOptics.h"
+#include "Rendering/Volume/VolumeMips.h"
+#include "Procedural/BlueNoise.h"
+#include "Data/PackedFloatKernels.h"
+#include "Data/Hash.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
 
 #undef min
 #undef max
@@ -16,10 +23,22 @@ namespace Haboob
     mirrorComputeShader = new Shader(Shader::Type::Compute, L"Raymarch/MirrorMarchTexture");
     frontRayVisibilityPixelShader = new Shader(Shader::Type::Pixel, L"Raymarch/FrontFacingRayVisibility");
     backRayVisibilityPixelShader = new Shader(Shader::Type::Pixel, L"Raymarch/BackFacingRayVisibility");
+    rayExtentsComputeShader = new Shader(Shader::Type::Compute, L"Raymarch/AnalyticRayExtents");
+    classifyComputeShader = new Shader(Shader::Type::Compute, L"Raymarch/ClassifyMarchTiles");
 
+    analyticRays = false;
+    tileList = false;
+    showMasks = false;
     shouldUpscale = true;
     renderTarget = nullptr;
     boundingBox = nullptr;
+    progressive = false;
+    progressiveViewKey = accumulationKey = 0;
+    accumulatedFrames = 0;
+    transmissionLUTEnabled = false;
+    transmissionLUTKey = 0;
+    softShadowSceneKey = softShadowKey = builtSoftShadowKey = 0;
+    softShadowBuilt = false;
     buildSpectralMatrices();
   }
 
@@ -30,6 +49,8 @@ namespace Haboob
     delete mirrorComputeShader; mirrorComputeShader = nullptr;
     delete frontRayVisibilityPixelShader; frontRayVisibilityPixelShader = nullptr;
     delete backRayVisibilityPixelShader; backRayVisibilityPixelShader = nullptr;
+    delete rayExtentsComputeShader; rayExtentsComputeShader = nullptr;
+    delete classifyComputeShader; classifyComputeShader = nullptr;
   }
 
   HRESULT RaymarchVolumeShader::initShader(ID3D11Device* device, ShaderManager* manager)
@@ -46,6 +67,10 @@ namespace Haboob
     Firebreak(result);
     result = backRayVisibilityPixelShader->initShader(device, manager);
     Firebreak(result);
+    result = rayExtentsComputeShader->initShader(device, manager);
+    Firebreak(result);
+    result = classifyComputeShader->initShader(device, manager);
+    Firebreak(result);
 
     // Create the raymarch info buffer
     {
@@ -60,6 +85,71 @@ namespace Haboob
       Firebreak(result);
     }
 
+    // Upload the blue noise tile for progressive jitter
+    {
+      const std::vector<float>& tile = BlueNoise::getTile();
+      D3D11_TEXTURE2D_DESC noiseDesc;
+      ZeroMemory(&noiseDesc, sizeof(D3D11_TEXTURE2D_DESC));
+      noiseDesc.Width = noiseDesc.Height = BlueNoise::TILE_SIZE;
+      noiseDesc.MipLevels = noiseDesc.ArraySize = 1;
+      noiseDesc.Format = DXGI_FORMAT_R32_FLOAT;
+      noiseDesc.SampleDesc.Count = 1;
+      noiseDesc.Usage = D3D11_USAGE_IMMUTABLE;
+      noiseDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+      D3D11_SUBRESOURCE_DATA noiseData = { tile.data(), UINT(BlueNoise::TILE_SIZE * sizeof(float)), 0 };
+      ComPtr<ID3D11Texture2D> noiseTexture;
+      result = device->CreateTexture2D(&noiseDesc, &noiseData, noiseTexture.GetAddressOf());
+      Firebreak(result);
+      result = device->CreateShaderResourceView(noiseTexture.Get(), nullptr, blueNoiseShaderView.ReleaseAndGetAddressOf());
+      Firebreak(result);
+    }
+
+    // Allocate the spectral transmission table, filled once the optics are known
+    {
+      D3D11_TEXTURE2D_DESC lutDesc;
+      ZeroMemory(&lutDesc, sizeof(D3D11_TEXTURE2D_DESC));
+      lutDesc.Width = SpectralOptics::TransmissionLUT::DEPTH_SIZE;
+      lutDesc.Height = SpectralOptics::TransmissionLUT::ANGSTROM_SIZE;
+      lutDesc.MipLevels = 1;
+      lutDesc.ArraySize = 4;
+      lutDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+      lutDesc.SampleDesc.Count = 1;
+      lutDesc.Usage = D3D11_USAGE_DEFAULT;
+      lutDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+      result = device->CreateTexture2D(&lutDesc, nullptr, transmissionLUTTexture.ReleaseAndGetAddressOf());
+      Firebreak(result);
+      result = device->CreateShaderResourceView(transmissionLUTTexture.Get(), nullptr, transmissionLUTShaderView.ReleaseAndGetAddressOf());
+      Firebreak(result);
+
+      D3D11_SAMPLER_DESC lutSamplerDesc;
+      ZeroMemory(&lutSamplerDesc, sizeof(D3D11_SAMPLER_DESC));
+      lutSamplerDesc.AddressU = lutSamplerDesc.AddressV = lutSamplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+      lutSamplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+      lutSamplerDesc.MaxAnisotropy = 1;
+      lutSamplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
+      lutSamplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+
+      result = device->CreateSamplerState(&lutSamplerDesc, transmissionLUTSamplerState.ReleaseAndGetAddressOf());
+      Firebreak(result);
+      transmissionLUTKey = 0;
+    }
+
+    // The indirect march's group counts, of which the tile count is copied in each time the tiles are classified
+    {
+      D3D11_BUFFER_DESC argsDesc;
+      ZeroMemory(&argsDesc, sizeof(D3D11_BUFFER_DESC));
+      argsDesc.Usage = D3D11_USAGE_DEFAULT;
+      argsDesc.ByteWidth = 3 * sizeof(UINT);
+      argsDesc.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;
+
+      UINT groupCounts[3] = { 0, 1, 1 };
+      D3D11_SUBRESOURCE_DATA argsData = { groupCounts, 0, 0 };
+      result = device->CreateBuffer(&argsDesc, &argsData, tileArgsBuffer.ReleaseAndGetAddressOf());
+      Firebreak(result);
+    }
+
     // Create the density volume sampler
     {
       D3D11_SAMPLER_DESC volumeSamplerDesc;
@@ -136,6 +226,57 @@ namespace Haboob
     marchInfo.localVolumeTransform = XMMatrixInverse(nullptr, boundingBox->getTransform());
     marchInfo.volumeSize = boundingBox->getScale();
 
+    // The march buffer minus the progressive terms, which the Beer Shadow Map never reads
+    softShadowKey = Hasher().add(softShadowSceneKey)
+      .addBytes(&marchInfo, offsetof(MarchVolumeDispatchInfo, jitterOffset))
+      .addBytes(&opticsInfo, sizeof(BasicOptics)).get();
+
+    // Progressive frames restart their average whenever the view or anything the march reads changes
+    if (progressive)
+    {
+      uint64_t key = Hasher().add(progressiveViewKey)
+        .addBytes(&marchInfo, offsetof(MarchVolumeDispatchInfo, jitterOffset)) // Cbuffer mirrors, so no padding
+        .addBytes(&opticsInfo, sizeof(BasicOptics)).get();
+      if (key != accumulationKey)
+      {
+        accumulationKey = key;
+        accumulatedFrames = 0;
+      }
+
+      // The shifts repeat once the average has become a window of as many frames
+      float shift = float(accumulatedFrames % MAX_ACCUMULATED_FRAMES) * BlueNoise::GOLDEN_RATIO_FRACTION;
+      marchInfo.jitterOffset = shift - std::floor(shift);
+      marchInfo.accumulationWeight = 1.f / float(std::min(accumulatedFrames, MAX_ACCUMULATED_FRAMES - 1) + 1);
+      ++accumulatedFrames;
+    }
+    else
+    {
+      marchInfo.jitterOffset = .0f;
+      marchInfo.accumulationWeight = 1.f;
+      accumulatedFrames = 0;
+    }
+
+    // Rebuild the transmission table when the optics it reads change, repacked from 16 floats per texel to a slice per spectral row
+    uint64_t lutKey = transmissionLUTEnabled ? SpectralOptics::hashTransmissionLUT(opticsInfo) : transmissionLUTKey;
+    if (lutKey != transmissionLUTKey && transmissionLUTTexture)
+    {
+      transmissionLUTKey = lutKey;
+      SpectralOptics::TransmissionLUT lut;
+      SpectralOptics::buildTransmissionLUT(opticsInfo, lut);
+
+      constexpr UInt texelCount = SpectralOptics::TransmissionLUT::DEPTH_SIZE * SpectralOptics::TransmissionLUT::ANGSTROM_SIZE;
+      std::vector<float> slice(size_t(texelCount) * 4);
+      for (UInt row = 0; row < 4; ++row)
+      {
+        for (UInt texel = 0; texel < texelCount; ++texel)
+        {
+          std::memcpy(&slice[size_t(texel) * 4], &lut.texels[size_t(texel) * 16 + row * 4], 4 * sizeof(float));
+        }
+        context->UpdateSubresource(transmissionLUTTexture.Get(), D3D11CalcSubresource(0, row, 1), nullptr, slice.data(),
+          UINT(SpectralOptics::TransmissionLUT::DEPTH_SIZE * 4 * sizeof(float)), 0);
+      }
+    }
+
     // Update the march buffer
     {
       D3D11_MAPPED_SUBRESOURCE mapped;
@@ -147,11 +288,13 @@ namespace Haboob
     }
   }
 
-  void RaymarchVolumeShader::bindShader(ID3D11DeviceContext* context, ID3D11ShaderResourceView* densityTexResource)
+  void RaymarchVolumeShader::bindShader(ID3D11DeviceContext* context, ID3D11ShaderResourceView* densityTexResource, ID3D11ShaderResourceView* macroCellResource)
   {
     computeShader->bindShader(context);
-    ID3D11UnorderedAccessView* accessView = rayTarget.getComputeView();
-    context->CSSetUnorderedAccessViews(0, 1, &accessView, 0);
+    // A listed march writes its own target, reading the rays from the third slot
+    ID3D11UnorderedAccessView* accessViews[3] = { tileList ? marchTarget.getComputeView() : rayTarget.getComputeView(), historyTarget.getComputeView(),
+      tileList ? rayTarget.getComputeView() : nullptr };
+    context->CSSetUnorderedAccessViews(0, 3, accessViews, 0);
     context->CSSetConstantBuffers(0, 1, cameraBuffer.GetAddressOf());
 
     context->CSSetConstantBuffers(1, 1, marchBuffer.GetAddressOf());
@@ -167,17 +310,24 @@ namespace Haboob
 
     auto bsmTextureView = bsmTarget.getShaderView();
     context->CSSetShaderResources(2, 1, &bsmTextureView);
+
+    context->CSSetShaderResources(3, 1, &macroCellResource);
+    context->CSSetShaderResources(4, 1, blueNoiseShaderView.GetAddressOf());
+
+    context->CSSetSamplers(2, 1, transmissionLUTSamplerState.GetAddressOf());
+    context->CSSetShaderResources(5, 1, transmissionLUTShaderView.GetAddressOf());
+    context->CSSetShaderResources(6, 1, tileListShaderView.GetAddressOf());
   }
 
   void RaymarchVolumeShader::unbindShader(ID3D11DeviceContext* context)
   {
     computeShader->unbindShader(context);
 
-    void* nullpo[4] = { nullptr, nullptr, nullptr, nullptr };
-    context->CSSetUnorderedAccessViews(0, 1, (ID3D11UnorderedAccessView**)&nullpo, 0);
+    void* nullpo[7] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+    context->CSSetUnorderedAccessViews(0, 3, (ID3D11UnorderedAccessView**)&nullpo, 0);
     context->CSSetConstantBuffers(0, 4, (ID3D11Buffer**)&nullpo);
-    context->CSSetSamplers(0, 2, (ID3D11SamplerState**)&nullpo);
-    context->CSSetShaderResources(0, 3, (ID3D11ShaderResourceView**)&nullpo);
+    context->CSSetSamplers(0, 3, (ID3D11SamplerState**)&nullpo);
+    context->CSSetShaderResources(0, 7, (ID3D11ShaderResourceView**)&nullpo);
   }
 
   void RaymarchVolumeShader::mirror(ID3D11DeviceContext* context)
@@ -192,7 +342,7 @@ namespace Haboob
     ID3D11SamplerState* sampler = copyShader.getSampler().Get();
     context->CSSetSamplers(0, 1, &sampler);
 
-    ID3D11ShaderResourceView* rayResourceTexture = rayTarget.getShaderView();
+    ID3D11ShaderResourceView* rayResourceTexture = tileList ? marchTarget.getShaderView() : rayTarget.getShaderView();
     context->CSSetShaderResources(0, 1, &rayResourceTexture);
 
     context->CSSetConstantBuffers(1, 1, marchBuffer.GetAddressOf());
@@ -208,9 +358,37 @@ namespace Haboob
     context->CSSetShaderResources(0, 1, (ID3D11ShaderResourceView**)&nullpo);
   }
 
-  void RaymarchVolumeShader::optimiseRays(DisplayDevice& device, MeshRenderer<VertexType>& renderer, GBuffer& gbuffer, XMVECTOR& cameraPosition)
+  void RaymarchVolumeShader::optimiseRays(DisplayDevice& device, MeshRenderer<VertexType>& renderer, GBuffer& gbuffer, XMVECTOR& cameraPosition, ID3D11Buffer* viewBuffer)
   {
     auto context = device.getContext().Get();
+
+    // One thread per pixel, every pixel written so there is nothing to clear
+    if (analyticRays)
+    {
+      static constexpr UInt groupSize = 16;
+
+      rayExtentsComputeShader->bindShader(context);
+      ID3D11UnorderedAccessView* rayComputeView = rayTarget.getComputeView();
+      context->CSSetUnorderedAccessViews(0, 1, &rayComputeView, 0);
+      ID3D11Buffer* buffers[2] = { viewBuffer ? viewBuffer : cameraBuffer.Get(), marchBuffer.Get() };
+      context->CSSetConstantBuffers(0, 2, buffers);
+      ID3D11ShaderResourceView* textureView = gbuffer.getNormalDepthTarget().getShaderView();
+      context->CSSetShaderResources(0, 1, &textureView);
+      context->CSSetSamplers(0, 1, pixelSamplerState.GetAddressOf());
+
+      rayExtentsComputeShader->dispatch(context, 1 + rayTarget.getWidth() / groupSize, 1 + rayTarget.getHeight() / groupSize);
+
+      rayExtentsComputeShader->unbindShader(context);
+      void* nullpo[2] = { nullptr, nullptr };
+      context->CSSetUnorderedAccessViews(0, 1, (ID3D11UnorderedAccessView**)&nullpo, 0);
+      context->CSSetConstantBuffers(0, 2, (ID3D11Buffer**)&nullpo);
+      context->CSSetShaderResources(0, 1, (ID3D11ShaderResourceView**)&nullpo);
+      context->CSSetSamplers(0, 1, (ID3D11SamplerState**)&nullpo);
+
+      if (tileList) { classifyTiles(context); }
+      return;
+    }
+
     renderer.bind(context);
 
     bool cameraWithin = false;
@@ -271,6 +449,66 @@ namespace Haboob
     boundingBox->setVisible(false);
     context->OMSetBlendState(nullptr, nullptr, ~0);
     device.setBackBufferTarget();
+
+    if (tileList) { classifyTiles(context); }
+  }
+
+  void RaymarchVolumeShader::classifyTiles(ID3D11DeviceContext* context)
+  {
+    static constexpr UInt groupSize = 16;
+
+    classifyComputeShader->bindShader(context);
+    ID3D11UnorderedAccessView* accessViews[2] = { rayTarget.getComputeView(), tileListComputeView.Get() };
+    UINT initialCounts[2] = { 0, 0 }; // Empties the list
+    context->CSSetUnorderedAccessViews(0, 2, accessViews, initialCounts);
+
+    // Over the groups the march would dispatch
+    XMUINT2 rayCount = shouldUpscale ? XMUINT2(rayTarget.getWidth() >> 1, rayTarget.getHeight() >> 1) : XMUINT2(rayTarget.getWidth(), rayTarget.getHeight());
+    classifyComputeShader->dispatch(context, 1 + rayCount.x / groupSize, 1 + rayCount.y / groupSize);
+
+    classifyComputeShader->unbindShader(context);
+    void* nullpo[2] = { nullptr, nullptr };
+    context->CSSetUnorderedAccessViews(0, 2, (ID3D11UnorderedAccessView**)&nullpo, 0);
+
+    context->CopyStructureCount(tileArgsBuffer.Get(), 0, tileListComputeView.Get());
+  }
+
+  HRESULT RaymarchVolumeShader::createTileList(ID3D11Device* device, UInt width, UInt height)
+  {
+    static constexpr UInt groupSize = 16;
+    HRESULT result = S_OK;
+
+    // Room for every group of a full resolution march, packed as x | y << 16
+    UInt capacity = (1 + width / groupSize) * (1 + height / groupSize);
+
+    D3D11_BUFFER_DESC listDesc;
+    ZeroMemory(&listDesc, sizeof(D3D11_BUFFER_DESC));
+    listDesc.Usage = D3D11_USAGE_DEFAULT;
+    listDesc.ByteWidth = capacity * sizeof(UINT);
+    listDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+    listDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    listDesc.StructureByteStride = sizeof(UINT);
+    result = device->CreateBuffer(&listDesc, nullptr, tileListBuffer.ReleaseAndGetAddressOf());
+    Firebreak(result);
+
+    D3D11_UNORDERED_ACCESS_VIEW_DESC listComputeDesc;
+    ZeroMemory(&listComputeDesc, sizeof(D3D11_UNORDERED_ACCESS_VIEW_DESC));
+    listComputeDesc.Format = DXGI_FORMAT_UNKNOWN;
+    listComputeDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+    listComputeDesc.Buffer.NumElements = capacity;
+    listComputeDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_APPEND;
+    result = device->CreateUnorderedAccessView(tileListBuffer.Get(), &listComputeDesc, tileListComputeView.ReleaseAndGetAddressOf());
+    Firebreak(result);
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC listShaderDesc;
+    ZeroMemory(&listShaderDesc, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+    listShaderDesc.Format = DXGI_FORMAT_UNKNOWN;
+    listShaderDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    listShaderDesc.Buffer.NumElements = capacity;
+    result = device->CreateShaderResourceView(tileListBuffer.Get(), &listShaderDesc, tileListShaderView.ReleaseAndGetAddressOf());
+    Firebreak(result);
+
+    return result;
   }
 
   HRESULT RaymarchVolumeShader::createTextures(ID3D11Device* device, UInt width, UInt height)
@@ -284,6 +522,15 @@ namespace Haboob
     result = bsmTarget.create(device, width, height);
     Firebreak(result);
 
+    result = historyTarget.create(device, width, height);
+    Firebreak(result);
+
+    result = marchTarget.create(device, width, height);
+    Firebreak(result);
+
+    result = createTileList(device, width, height);
+    Firebreak(result);
+
     return result;
   }
 
@@ -297,6 +544,18 @@ namespace Haboob
 
     result = bsmTarget.resize(device, width, height);
     Firebreak(result);
+    softShadowBuilt = false;
+
+    // The average is of the old size
+    result = historyTarget.resize(device, width, height);
+    Firebreak(result);
+    accumulatedFrames = 0;
+
+    result = marchTarget.resize(device, width, height);
+    Firebreak(result);
+
+    result = createTileList(device, width, height);
+    Firebreak(result);
 
     return result;
   }
@@ -313,6 +572,7 @@ namespace Haboob
 
     context->CSSetSamplers(0, 1, marchSamplerState.GetAddressOf());
     context->CSSetShaderResources(0, 1, &densityTexResource);
+    context->CSSetShaderResources(1, 1, tileListShaderView.GetAddressOf());
   }
 
   void RaymarchVolumeShader::unbindSoftShadowMap(ID3D11DeviceContext* context)
@@ -323,23 +583,45 @@ namespace Haboob
     context->CSSetUnorderedAccessViews(0, 2, (ID3D11UnorderedAccessView**)nullpo, 0);
     context->CSSetConstantBuffers(0, 3, (ID3D11Buffer**)&nullpo);
     context->CSSetSamplers(0, 1, (ID3D11SamplerState**)&nullpo);
-    context->CSSetShaderResources(0, 1, (ID3D11ShaderResourceView**)&nullpo);
+    context->CSSetShaderResources(0, 2, (ID3D11ShaderResourceView**)&nullpo);
   }
 
-  void RaymarchVolumeShader::generateSoftShadowMap(ID3D11DeviceContext* context) const
+  void RaymarchVolumeShader::generateSoftShadowMap(ID3D11DeviceContext* context)
   {
     static constexpr UInt groupSize = 16;
 
-    // Render with a quarter of rays if upscaling
-    XMUINT2 rayCount = shouldUpscale ? XMUINT2(bsmTarget.getWidth() >> 1, bsmTarget.getHeight() >> 1) : XMUINT2(bsmTarget.getWidth(), bsmTarget.getHeight());
-    // Divide rays into groups plus an extra padding group
-    bsmComputeShader->dispatch(context, 1 + rayCount.x / groupSize, 1 + rayCount.y / groupSize);
+    if (tileList)
+    {
+      // Only the classified tiles, over what every masked ray would have written
+      float maskedBSM[4] = { .0f, showMasks ? .0f : 1.f, showMasks ? 100.f : .0f, showMasks ? 1.f : .0f };
+      context->ClearUnorderedAccessViewFloat(bsmTarget.getComputeView(), maskedBSM);
+      Shader::dispatchIndirect(context, tileArgsBuffer.Get());
+    }
+    else
+    {
+      // Render with a quarter of rays if upscaling
+      XMUINT2 rayCount = shouldUpscale ? XMUINT2(bsmTarget.getWidth() >> 1, bsmTarget.getHeight() >> 1) : XMUINT2(bsmTarget.getWidth(), bsmTarget.getHeight());
+      // Divide rays into groups plus an extra padding group
+      bsmComputeShader->dispatch(context, 1 + rayCount.x / groupSize, 1 + rayCount.y / groupSize);
+    }
+
+    builtSoftShadowKey = softShadowKey;
+    softShadowBuilt = true;
   }
 
-  void RaymarchVolumeShader::render(ID3D11DeviceContext* context) const
+  void RaymarchVolumeShader::render(ID3D11DeviceContext* context)
   {
     static constexpr UInt groupSize = 16;
 
+    if (tileList)
+    {
+      // Only the classified tiles, over what every masked ray would have written
+      float maskedResult[4] = { showMasks ? 100.f : .0f, showMasks ? 100.f : .0f, showMasks ? 100.f : .0f, 1.f };
+      context->ClearUnorderedAccessViewFloat(marchTarget.getComputeView(), maskedResult);
+      Shader::dispatchIndirect(context, tileArgsBuffer.Get());
+      return;
+    }
+
     // Render with a quarter of rays if upscaling
     XMUINT2 rayCount = shouldUpscale ? XMUINT2(rayTarget.getWidth() >> 1, rayTarget.getHeight() >> 1) : XMUINT2(rayTarget.getWidth(), rayTarget.getHeight());
     // Divide rays into groups plus an extra padding group
@@ -348,79 +630,34 @@ namespace Haboob
 
   void RaymarchVolumeShader::buildSpectralMatrices()
   {
-    // Hermit-Gauss quadrature of order n=4
-    float hermitGaussAbscissas[4] = { 0.524647623275f, -0.524647623275f, 1.650680123886f, -1.650680123886f };
-    float hermitGaussWeights[4] = { 0.804914090006f, 0.804914090006f, 0.0813128354473f, 0.0813128354473f };
-
-    // Substitution is in order
-    auto logAbscissasAdjust = [](float abscissas, float distributionCoefficients[4]) -> float {
-      return (exp(abscissas / distributionCoefficients[1]) - distributionCoefficients[3]) / distributionCoefficients[2];
-    };
-    auto linearAbscissasAdjust = [](float abscissas, float distributionCoefficients[4]) -> float {
-      return (abscissas - distributionCoefficients[3]) / distributionCoefficients[2];
-    };
-    auto logWeight = [](float abscissas, float distributionCoefficients[4]) -> float {
-      return abs(exp(abscissas / distributionCoefficients[1]) / (distributionCoefficients[1] * distributionCoefficients[2]));
-    };
-    auto linearWeight = [](float abscissas, float distributionCoefficients[4]) -> float {
-      return 1.f / distributionCoefficients[2];
-    };
-
-    auto& optics = getOpticsInfo();
-    for (size_t wavelet = 0; wavelet < 4; ++wavelet)
-    {
-      float* distribution = nullptr;
-      switch (wavelet)
-      {
-        case 0: distribution = redMajorCIECoefficients;
-        break;
-        case 1: distribution = greenCIECoefficients;
-        break;
-        case 2: distribution = blueCIECoefficients;
-        break;
-        case 3: distribution = redMinorCIECoefficients;
-        break;
-      }
-
-      for (size_t term = 0; term < 4; ++term)
-      {
-        if (wavelet == 1) // Green = linear
-        {
-          optics.spectralWeights.m[wavelet][term] = hermitGaussWeights[term] * linearWeight(hermitGaussAbscissas[term], distribution) * distribution[0];
-          optics.spectralWavelengths.m[wavelet][term] = linearAbscissasAdjust(hermitGaussAbscissas[term], distribution);
-        }
-        else // Everything else = logarithmic
-        {
-          optics.spectralWeights.m[wavelet][term] = hermitGaussWeights[term] * logWeight(hermitGaussAbscissas[term], distribution) * distribution[0];
-          optics.spectralWavelengths.m[wavelet][term] = logAbscissasAdjust(hermitGaussAbscissas[term], distribution);
-        }
-      }
-    }
-
-    // This matrix transforms from the CIEXYZ components to display independent linear RGB (note: column1 = column4)
-    XMMATRIX spectralToRGB = XMMatrixSet(
-      3.2406, -1.5372, -.4986, 3.2406,
-      -.9689, 1.8758, .0415, -.9689,
-      .0557, -.2040, 1.0570, .0557,
-      .0, .0, .0, .0);
-    spectralToRGB = XMMatrixTranspose(spectralToRGB);
-    XMStoreFloat4x4(&optics.spectralToRGB, spectralToRGB);
+    SpectralOptics::buildMatrices(getOpticsInfo());
   }
 
-  VolumeGenerationShader::VolumeGenerationShader()
+  VolumeGenerationShader::VolumeGenerationShader() : allocatedSize{ 0, 0, 0 }, mipLevels{ 0 }, version{ 0 }, cache{ nullptr }, pool{ nullptr },
+    readbackKey{ 0 }, readbackPending{ false }
   {
-    generateVolumeShader = new Shader(Shader::Type::Compute, L"TestShaders/TestFormHaboob", true);
+    noiseFieldShader = new Shader(Shader::Type::Compute, L"Haboob/HaboobNoiseField", true);
+    shapeFieldShader = new Shader(Shader::Type::Compute, L"Haboob/HaboobShapeField", true);
+    combineShader = new Shader(Shader::Type::Compute, L"Haboob/HaboobCombine", true);
   }
 
   VolumeGenerationShader::~VolumeGenerationShader()
   {
-    delete generateVolumeShader; generateVolumeShader = nullptr;
+    delete noiseFieldShader; noiseFieldShader = nullptr;
+    delete shapeFieldShader; shapeFieldShader = nullptr;
+    delete combineShader; combineShader = nullptr;
   }
   HRESULT VolumeGenerationShader::initShader(ID3D11Device* device, ShaderManager* manager)
   {
     HRESULT result = S_OK;
 
-    result = generateVolumeShader->initShader(device, manager);
+    result = noiseFieldShader->initShader(device, manager);
+    Firebreak(result);
+
+    result = shapeFieldShader->initShader(device, manager);
+    Firebreak(result);
+
+    result = combineShader->initShader(device, manager);
     Firebreak(result);
 
     // Create the volume info buffer
@@ -443,6 +680,12 @@ namespace Haboob
   {
     HRESULT result = S_OK;
 
+    // Parameter changes are picked up by the stages, only a new size needs new textures
+    if (texture && allocatedSize.x == volumeInfo.size.x && allocatedSize.y == volumeInfo.size.y && allocatedSize.z == volumeInfo.size.z)
+    {
+      return result;
+    }
+
     // Create the texture
     D3D11_TEXTURE3D_DESC volumeTextureDesc;
     {
@@ -457,7 +700,6 @@ namespace Haboob
       volumeTextureDesc.Format = DXGI_FORMAT_R11G11B10_FLOAT;
       volumeTextureDesc.Usage = D3D11_USAGE_DEFAULT;
       volumeTextureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
-      volumeTextureDesc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
 
       result = device->CreateTexture3D(&volumeTextureDesc, nullptr, texture.ReleaseAndGetAddressOf());
       Firebreak(result);
@@ -505,41 +747,351 @@ namespace Haboob
       Firebreak(result);
     }
 
+    // Create the macro cell buffer, a value per level for each cell
+    {
+      XMINT3 macroCounts = VolumeMips::getMacroCellCounts(volumeInfo.size);
+      UInt cellCount = UInt(macroCounts.x) * UInt(macroCounts.y) * UInt(macroCounts.z) * volumeTextureDesc.MipLevels;
+
+      D3D11_BUFFER_DESC macroDesc;
+      ZeroMemory(&macroDesc, sizeof(D3D11_BUFFER_DESC));
+      macroDesc.ByteWidth = cellCount * sizeof(float);
+      macroDesc.Usage = D3D11_USAGE_DEFAULT;
+      macroDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+      result = device->CreateBuffer(&macroDesc, nullptr, macroCellBuffer.ReleaseAndGetAddressOf());
+      Firebreak(result);
+
+      D3D11_SHADER_RESOURCE_VIEW_DESC macroViewDesc;
+      ZeroMemory(&macroViewDesc, sizeof(D3D11_SHADER_RESOURCE_VIEW_DESC));
+      macroViewDesc.Format = DXGI_FORMAT_R32_FLOAT;
+      macroViewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+      macroViewDesc.Buffer.NumElements = cellCount;
+
+      result = device->CreateShaderResourceView(macroCellBuffer.Get(), &macroViewDesc, macroCellShaderView.ReleaseAndGetAddressOf());
+      Firebreak(result);
+    }
+
+    // Create the readback copy
+    {
+      D3D11_TEXTURE3D_DESC readbackDesc = volumeTextureDesc;
+      readbackDesc.MipLevels = 1;
+      readbackDesc.Usage = D3D11_USAGE_STAGING;
+      readbackDesc.BindFlags = 0;
+      readbackDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+      readbackDesc.MiscFlags = 0;
+
+      result = device->CreateTexture3D(&readbackDesc, nullptr, readbackTexture.ReleaseAndGetAddressOf());
+      Firebreak(result);
+    }
+    readbackPending = false;
+
+    result = createFieldTextures(device);
+    Firebreak(result);
+
+    // Every stage has to run again into the new textures
+    allocatedSize = volumeInfo.size;
+    mipLevels = volumeTextureDesc.MipLevels;
+    invalidate();
+    ++version;
+
     return result;
   }
 
-  void VolumeGenerationShader::render(ID3D11DeviceContext* context)
+  HRESULT VolumeGenerationShader::createFieldTextures(ID3D11Device* device)
   {
-    generateVolumeShader->bindShader(context);
-    bindShader(context);
-    static constexpr UInt groupSize = 8;
-    Shader::dispatch(context, volumeInfo.size.x / groupSize, volumeInfo.size.y / groupSize, volumeInfo.size.z / groupSize);
-    unbindShader(context);
-    generateVolumeShader->unbindShader(context);
+    HRESULT result = S_OK;
+
+    // Noise field, one value per voxel
+    {
+      D3D11_TEXTURE3D_DESC noiseDesc;
+      ZeroMemory(&noiseDesc, sizeof(D3D11_TEXTURE3D_DESC));
+      noiseDesc.Width = volumeInfo.size.x;
+      noiseDesc.Height = volumeInfo.size.y;
+      noiseDesc.Depth = volumeInfo.size.z;
+      noiseDesc.MipLevels = 1;
+      noiseDesc.Format = DXGI_FORMAT_R32_FLOAT;
+      noiseDesc.Usage = D3D11_USAGE_DEFAULT;
+      noiseDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+
+      result = device->CreateTexture3D(&noiseDesc, nullptr, noiseTexture.ReleaseAndGetAddressOf());
+      Firebreak(result);
+
+      result = device->CreateShaderResourceView(noiseTexture.Get(), nullptr, noiseShaderView.ReleaseAndGetAddressOf());
+      Firebreak(result);
+
+      result = device->CreateUnorderedAccessView(noiseTexture.Get(), nullptr, noiseComputeView.ReleaseAndGetAddressOf());
+      Firebreak(result);
+    }
 
-    context->GenerateMips(textureShaderView.Get());
+    // Height terms, one set per row
+    {
+      D3D11_TEXTURE1D_DESC heightDesc;
+      ZeroMemory(&heightDesc, sizeof(D3D11_TEXTURE1D_DESC));
+      heightDesc.Width = volumeInfo.size.y;
+      heightDesc.MipLevels = 1;
+      heightDesc.ArraySize = 1;
+      heightDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+      heightDesc.Usage = D3D11_USAGE_DEFAULT;
+      heightDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+
+      result = device->CreateTexture1D(&heightDesc, nullptr, heightTexture.ReleaseAndGetAddressOf());
+      Firebreak(result);
+
+      result = device->CreateShaderResourceView(heightTexture.Get(), nullptr, heightShaderView.ReleaseAndGetAddressOf());
+      Firebreak(result);
+
+      result = device->CreateUnorderedAccessView(heightTexture.Get(), nullptr, heightComputeView.ReleaseAndGetAddressOf());
+      Firebreak(result);
+    }
+
+    // Plane terms, one set per column
+    {
+      D3D11_TEXTURE2D_DESC planeDesc;
+      ZeroMemory(&planeDesc, sizeof(D3D11_TEXTURE2D_DESC));
+      planeDesc.Width = volumeInfo.size.x;
+      planeDesc.Height = volumeInfo.size.z;
+      planeDesc.MipLevels = 1;
+      planeDesc.ArraySize = 1;
+      planeDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+      planeDesc.SampleDesc.Count = 1;
+      planeDesc.Usage = D3D11_USAGE_DEFAULT;
+      planeDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+
+      result = device->CreateTexture2D(&planeDesc, nullptr, planeTexture.ReleaseAndGetAddressOf());
+      Firebreak(result);
+
+      result = device->CreateShaderResourceView(planeTexture.Get(), nullptr, planeShaderView.ReleaseAndGetAddressOf());
+      Firebreak(result);
+
+      result = device->CreateUnorderedAccessView(planeTexture.Get(), nullptr, planeComputeView.ReleaseAndGetAddressOf());
+      Firebreak(result);
+    }
+
+    return result;
   }
 
-  void VolumeGenerationShader::bindShader(ID3D11DeviceContext* context)
+  HRESULT VolumeGenerationShader::render(ID3D11DeviceContext* context)
   {
-    // Update volume buffer
+    VolumeStageHashes hashes = VolumeStageHashes::compute(volumeInfo);
+
+    // The combine hash covers both inputs so nothing else can be dirty when it is clean
+    if (!combineStage.isDirty(hashes.combine))
     {
-      D3D11_MAPPED_SUBRESOURCE mapped;
-      HRESULT result = context->Map(volumeInfoBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
-      std::memcpy(mapped.pData, &volumeInfo, sizeof(VolumeInfo));
-      context->Unmap(volumeInfoBuffer.Get(), 0);
+      return S_OK;
     }
+    ++version;
+    readbackPending = false; // Superseded
 
+    // A warm start skips every stage (their fields keep whatever they were last built from)
+    uint64_t cacheKey = VolumeCache::getKey(volumeInfo);
+    if (cache && loadFromCache(context, cacheKey))
+    {
+      combineStage.markBuilt(hashes.combine);
+      return S_OK;
+    }
+
+    updateVolumeBuffer(context);
     context->CSSetConstantBuffers(0, 1, volumeInfoBuffer.GetAddressOf());
-    context->CSSetUnorderedAccessViews(0, 1, computeAccessView.GetAddressOf(), 0);
+
+    static constexpr UInt groupSize = 8;
+    auto groups = [](UInt count) { return (count + groupSize - 1) / groupSize; };
+    void* nullpo[3] = { nullptr, nullptr, nullptr };
+
+    // Noise field
+    if (noiseStage.isDirty(hashes.fbm))
+    {
+      noiseFieldShader->bindShader(context);
+      context->CSSetUnorderedAccessViews(0, 1, noiseComputeView.GetAddressOf(), 0);
+      Shader::dispatch(context, groups(volumeInfo.size.x), groups(volumeInfo.size.y), groups(volumeInfo.size.z));
+      context->CSSetUnorderedAccessViews(0, 1, (ID3D11UnorderedAccessView**)nullpo, 0);
+      noiseFieldShader->unbindShader(context);
+
+      noiseStage.markBuilt(hashes.fbm);
+    }
+
+    // Shape fields
+    if (shapeStage.isDirty(hashes.shape))
+    {
+      ID3D11UnorderedAccessView* shapeViews[2] = { heightComputeView.Get(), planeComputeView.Get() };
+
+      shapeFieldShader->bindShader(context);
+      context->CSSetUnorderedAccessViews(0, 2, shapeViews, 0);
+      Shader::dispatch(context, groups(std::max(volumeInfo.size.x, volumeInfo.size.y)), groups(volumeInfo.size.z), 1);
+      context->CSSetUnorderedAccessViews(0, 2, (ID3D11UnorderedAccessView**)nullpo, 0);
+      shapeFieldShader->unbindShader(context);
+
+      shapeStage.markBuilt(hashes.shape);
+    }
+
+    // Combine into the volume
+    {
+      ID3D11ShaderResourceView* fieldViews[3] = { noiseShaderView.Get(), heightShaderView.Get(), planeShaderView.Get() };
+
+      combineShader->bindShader(context);
+      context->CSSetShaderResources(0, 3, fieldViews);
+      context->CSSetUnorderedAccessViews(0, 1, computeAccessView.GetAddressOf(), 0);
+      Shader::dispatch(context, groups(volumeInfo.size.x), groups(volumeInfo.size.y), groups(volumeInfo.size.z));
+      context->CSSetUnorderedAccessViews(0, 1, (ID3D11UnorderedAccessView**)nullpo, 0);
+      context->CSSetShaderResources(0, 3, (ID3D11ShaderResourceView**)nullpo);
+      combineShader->unbindShader(context);
+
+      combineStage.markBuilt(hashes.combine);
+    }
+
+    context->CSSetConstantBuffers(0, 1, (ID3D11Buffer**)nullpo);
+
+    // Mips (and the cache) only follow a new combine
+    requestMips(context, cacheKey);
+
+    return S_OK;
   }
 
-  void VolumeGenerationShader::unbindShader(ID3D11DeviceContext* context)
+  void VolumeGenerationShader::invalidate()
   {
-    void* nullpo = nullptr;
+    noiseStage.invalidate();
+    shapeStage.invalidate();
+    combineStage.invalidate();
+  }
 
-    context->CSSetConstantBuffers(0, 1, (ID3D11Buffer**)&nullpo);
-    context->CSSetUnorderedAccessViews(0, 1, (ID3D11UnorderedAccessView**)&nullpo, 0);
+  bool VolumeGenerationShader::loadFromCache(ID3D11DeviceContext* context, uint64_t key)
+  {
+    CachedVolume cached;
+    if (!cache->load(key, cached) || cached.getLevelCount() != mipLevels)
+    {
+      return false;
+    }
+
+    // Upload every level straight from the mapping
+    for (UInt level = 0; level < mipLevels; ++level)
+    {
+      XMINT3 levelSize = cached.getLevelSize(level);
+      UInt rowPitch = UInt(levelSize.x) * sizeof(UInt);
+      context->UpdateSubresource(texture.Get(), D3D11CalcSubresource(level, 0, mipLevels), nullptr, cached.getLevel(level), rowPitch, rowPitch * UInt(levelSize.y));
+    }
+
+    // The macro cells are not cached, but follow from the levels
+    VolumeGrid grid;
+    std::vector<VolumeGrid> mips(mipLevels - 1);
+    cached.unpackLevel(0, grid);
+    for (UInt level = 1; level < mipLevels; ++level) { cached.unpackLevel(level, mips[level - 1]); }
+    uploadMacroCells(context, grid, mips);
+
+    return true;
+  }
+
+  void VolumeGenerationShader::requestMips(ID3D11DeviceContext* context, uint64_t key)
+  {
+    context->CopySubresourceRegion(readbackTexture.Get(), 0, 0, 0, 0, texture.Get(), 0, nullptr);
+    readbackKey = key;
+    readbackPending = true;
+  }
+
+  HRESULT VolumeGenerationShader::collectMips(ID3D11DeviceContext* context, bool wait)
+  {
+    if (!readbackPending) { return S_OK; }
+
+    // Until the copy lands the previous mips and macro cells stay bound
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    HRESULT result = context->Map(readbackTexture.Get(), 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped);
+    if (result == DXGI_ERROR_WAS_STILL_DRAWING) { return S_OK; }
+
+    readbackPending = false;
+    if (FAILED(result))
+    {
+      // The texture has no mips for what was combined, so combine again on the next render
+      combineStage.invalidate();
+      return result;
+    }
+
+    const XMINT3& size = volumeInfo.size;
+    std::vector<std::vector<UInt>> levels(mipLevels);
+    std::vector<const UInt*> levelData(mipLevels);
+    levels[0].resize(size_t(size.x) * size_t(size.y) * size_t(size.z));
+
+    // Strip the row and depth pitch
+    const Byte* source = static_cast<const Byte*>(mapped.pData);
+    for (int z = 0; z < size.z; ++z)
+    {
+      for (int y = 0; y < size.y; ++y)
+      {
+        std::memcpy(&levels[0][size_t(size.x) * (size_t(y) + size_t(size.y) * size_t(z))],
+          source + size_t(z) * mapped.DepthPitch + size_t(y) * mapped.RowPitch, size_t(size.x) * sizeof(UInt));
+      }
+    }
+    context->Unmap(readbackTexture.Get(), 0);
+
+    // Reduce on the CPU so the max density channel stays a true maximum at every level
+    VolumeGrid grid;
+    grid.resize(size);
+    PackedFloat::getUnpackBatch(SIMD::detectLevel())(levels[0].data(), &grid.getData()->density, grid.getVoxelCount());
+    uploadMips(context, grid, levels);
+    ++version;
+
+    if (cache)
+    {
+      for (UInt level = 0; level < mipLevels; ++level) { levelData[level] = levels[level].data(); }
+      cache->store(readbackKey, size, mipLevels, levelData.data());
+    }
+
+    return S_OK;
+  }
+
+  void VolumeGenerationShader::uploadMips(ID3D11DeviceContext* context, const VolumeGrid& grid, std::vector<std::vector<UInt>>& levels)
+  {
+    std::vector<VolumeGrid> mips;
+    VolumeMips::buildChain(grid, mips, mipLevels, pool);
+
+    PackedFloat::PackBatch packBatch = PackedFloat::getPackBatch(SIMD::detectLevel());
+    for (UInt level = 1; level < mipLevels; ++level)
+    {
+      const VolumeGrid& mip = mips[level - 1];
+      levels[level].resize(mip.getVoxelCount());
+      packBatch(&mip.getData()->density, levels[level].data(), mip.getVoxelCount());
+
+      XMINT3 levelSize = mip.getSize();
+      UInt rowPitch = UInt(levelSize.x) * sizeof(UInt);
+      context->UpdateSubresource(texture.Get(), D3D11CalcSubresource(level, 0, mipLevels), nullptr, levels[level].data(), rowPitch, rowPitch * UInt(levelSize.y));
+    }
+
+    uploadMacroCells(context, grid, mips);
+  }
+
+  void VolumeGenerationShader::uploadMacroCells(ID3D11DeviceContext* context, const VolumeGrid& grid, const std::vector<VolumeGrid>& mips)
+  {
+    std::vector<float> cells;
+    VolumeMips::buildMacroCells(grid, mips, cells, pool);
+    context->UpdateSubresource(macroCellBuffer.Get(), 0, nullptr, cells.data(), 0, 0);
+  }
+
+  void VolumeGenerationShader::uploadVolume(ID3D11DeviceContext* context, const VolumeGrid& grid)
+  {
+    const XMINT3& size = grid.getSize();
+    if (!texture || size.x != allocatedSize.x || size.y != allocatedSize.y || size.z != allocatedSize.z)
+    {
+      return;
+    }
+
+    std::vector<std::vector<UInt>> levels(mipLevels);
+    levels[0].resize(grid.getVoxelCount());
+    PackedFloat::getPackBatch(SIMD::detectLevel())(&grid.getData()->density, levels[0].data(), grid.getVoxelCount());
+
+    UInt rowPitch = UInt(size.x) * sizeof(UInt);
+    context->UpdateSubresource(texture.Get(), D3D11CalcSubresource(0, 0, mipLevels), nullptr, levels[0].data(), rowPitch, rowPitch * UInt(size.y));
+    uploadMips(context, grid, levels);
+    ++version;
+
+    // The texture no longer holds what the stages last built
+    combineStage.invalidate();
+    readbackPending = false;
+  }
+
+  void VolumeGenerationShader::updateVolumeBuffer(ID3D11DeviceContext* context)
+  {
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    HRESULT result = context->Map(volumeInfoBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+    VolumeInfo snapshot = volumeInfo.getSnapshot(); // The shaders only see the volume at its motion time
+    std::memcpy(mapped.pData, &snapshot, sizeof(VolumeInfo));
+    context->Unmap(volumeInfoBuffer.Get(), 0);
   }
 
 }
\ No newline at end of file
@@ -7,6 +7,7 @@ namespace Haboob
     type = shaderType;
     relativePath = path;
     compiledShader = nullptr;
+    compiledKey = 0;
     preferCompiled = precompiled;
   }
 
@@ -23,18 +24,46 @@ namespace Haboob
   {
     manager->addShader(this);
 
-    return initShader(device, (const ShaderManager*)manager);
+    return manager->requestShader(device, this);
   }
 
   HRESULT Shader::initShader(ID3D11Device* device, const ShaderManager* manager)
   {
-    if (compiledShader)
+    HRESULT result = S_OK;
+
+    if (preferCompiled)
     {
-      compiledShader->Release();
-      compiledShader = nullptr;
+      result = loadPreCompiledShader(device, manager);
+      if (SUCCEEDED(result)) { return result; }
     }
 
-    return makeShader(&compiledShader, device, manager);
+    // For lightweight shaders with macros, compiled once per permutation
+    const ShaderPermutation* permutation = nullptr;
+    result = manager->loadFormattedShader(type, relativePath, &permutation);
+    Firebreak(result);
+
+    return swapShader(device, manager, permutation);
+  }
+
+  HRESULT Shader::loadPreCompiledShader(ID3D11Device* device, const ShaderManager* manager)
+  {
+    // Macros don't apply, so only read once
+    if (compiledShader && !compiledKey) { return S_OK; }
+
+    // For speed of large shaders
+    ComPtr<ID3DBlob> shaderBlob;
+    HRESULT result = manager->loadPreCompiledShaderBlob(relativePath, shaderBlob.GetAddressOf());
+    Firebreak(result);
+
+    return replaceShader(device, manager, shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), 0);
+  }
+
+  HRESULT Shader::swapShader(ID3D11Device* device, const ShaderManager* manager, const ShaderPermutation* permutation)
+  {
+    // Kept when the permutation is the one already in use
+    if (compiledShader && permutation->key == compiledKey) { return S_OK; }
+
+    return replaceShader(device, manager, permutation->bytecode.data(), permutation->bytecode.size(), permutation->key);
   }
 
   void Shader::bindShader(ID3D11DeviceContext* context)
@@ -92,51 +121,65 @@ namespace Haboob
     context->Dispatch(groupX, groupY, groupZ);
   }
 
-  HRESULT Shader::makeShader(ID3D11DeviceChild** shader, ID3D11Device* device, const ShaderManager* manager)
+  void Shader::dispatchIndirect(ID3D11DeviceContext* context, ID3D11Buffer* arguments, UInt offset)
   {
-    HRESULT result = S_OK;
+    context->DispatchIndirect(arguments, offset);
+  }
 
-    // Load the raw shader file
-    ComPtr<ID3DBlob> shaderBlob;
-    if (preferCompiled)
+  HRESULT Shader::replaceShader(ID3D11Device* device, const ShaderManager* manager, const void* bytecode, SIZE_T bytecodeSize, uint64_t key)
+  {
+    ID3D11DeviceChild* shader = nullptr;
+    ComPtr<ID3D11InputLayout> layout;
+    HRESULT result = makeShader(&shader, layout.GetAddressOf(), device, manager, bytecode, bytecodeSize);
+    if (FAILED(result))
     {
-      // For speed of large shaders
-      result = manager->loadPreCompiledShaderBlob(relativePath, shaderBlob.GetAddressOf());
+      // The current shader stays in use
+      if (shader) { shader->Release(); }
+      return result;
     }
-    if (!preferCompiled || FAILED(result))
+
+    if (compiledShader)
     {
-      // For lightweight shaders with macros
-      result = manager->loadFormattedShaderBlob(type, relativePath, shaderBlob.GetAddressOf());
+      compiledShader->Release();
     }
+    compiledShader = shader;
+    compiledKey = key;
+    inputLayout = layout;
 
-    Firebreak(result);
+    return result;
+  }
+
+  HRESULT Shader::makeShader(ID3D11DeviceChild** shader, ID3D11InputLayout** layout, ID3D11Device* device, const ShaderManager* manager,
+    const void* bytecode, SIZE_T bytecodeSize)
+  {
+    HRESULT result = S_OK;
 
     switch (type)
     {
       case Type::Vertex:
       {
-        result = device->CreateVertexShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), NULL, reinterpret_cast<ID3D11VertexShader**>(shader));
+        result = device->CreateVertexShader(bytecode, bytecodeSize, NULL, reinterpret_cast<ID3D11VertexShader**>(shader));
         Firebreak(result);
 
         // Link the specified vertex layout
-        auto& layout = manager->getVertexLayout();
-        result = device->CreateInputLayout(layout.data(), layout.size(), shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), &inputLayout);
+        auto& vertexLayout = manager->getVertexLayout();
+        result = device->CreateInputLayout(vertexLayout.data(), vertexLayout.size(), bytecode, bytecodeSize, layout);
       }
       break;
       case Type::Pixel:
-        result = device->CreatePixelShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), NULL, reinterpret_cast<ID3D11PixelShader**>(shader));
+        result = device->CreatePixelShader(bytecode, bytecodeSize, NULL, reinterpret_cast<ID3D11PixelShader**>(shader));
       break;
       case Type::Hull:
-        result = device->CreateHullShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), NULL, reinterpret_cast<ID3D11HullShader**>(shader));
+        result = device->CreateHullShader(bytecode, bytecodeSize, NULL, reinterpret_cast<ID3D11HullShader**>(shader));
       break;
       case Type::Domain:
-        result = device->CreateDomainShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), NULL, reinterpret_cast<ID3D11DomainShader**>(shader));
+        result = device->CreateDomainShader(bytecode, bytecodeSize, NULL, reinterpret_cast<ID3D11DomainShader**>(shader));
       break;
       case Type::Geometry:
-        result = device->CreateGeometryShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), NULL, reinterpret_cast<ID3D11GeometryShader**>(shader));
+        result = device->CreateGeometryShader(bytecode, bytecodeSize, NULL, reinterpret_cast<ID3D11GeometryShader**>(shader));
       break;
       case Type::Compute:
-        result = device->CreateComputeShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), NULL, reinterpret_cast<ID3D11ComputeShader**>(shader));
+        result = device->CreateComputeShader(bytecode, bytecodeSize, NULL, reinterpret_cast<ID3D11ComputeShader**>(shader));
       break;
     }
 
@@ -0,0 +1,101 @@
+#include "Rendering/Shaders/ShaderBlobCache.h"
+#include "Data/Hash.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace Haboob
+{
+  namespace
+  {
+    constexpr UInt FILE_MAGIC = 0x42534848; // "HHSB"
+    constexpr UInt FILE_VERSION = 1;
+    constexpr Literal FILE_EXTENSION = ".hsb";
+
+    // Followed directly by the bytecode
+    struct FileHeader
+    {
+      UInt magic;
+      UInt fileVersion;
+      uint64_t key;
+      uint64_t checksum; // FNV-1a over the bytecode
+      uint64_t size;
+    };
+  }
+
+  ShaderBlobCache::ShaderBlobCache(const std::filesystem::path& directory, uint64_t capacity) : files{ directory, FILE_EXTENSION, capacity }
+  {
+
+  }
+
+  uint64_t ShaderBlobCache::getKey(uint64_t contentHash, const std::string& profile, const ShaderMacros& macros, uint64_t compilerSignature)
+  {
+    Hasher hasher;
+    hasher.add(FILE_VERSION).add(contentHash).add(compilerSignature).addString(profile);
+
+    hasher.add(uint64_t(macros.size()));
+    for (auto& it : macros)
+    {
+      hasher.addString(it.first).addString(it.second);
+    }
+
+    return hasher.get();
+  }
+
+  bool ShaderBlobCache::load(uint64_t key, ShaderBytecode& bytecode) const
+  {
+    if (!isEnabled()) { return false; }
+
+    std::filesystem::path path = getPath(key);
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) { return false; }
+
+    bool valid = false;
+    {
+      std::ifstream in(path, std::ios::binary);
+      FileHeader header;
+      std::memset(&header, 0, sizeof(FileHeader));
+      in.read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+
+      uint64_t fileSize = std::filesystem::file_size(path, error);
+      valid = in && !error && header.magic == FILE_MAGIC && header.fileVersion == FILE_VERSION && header.key == key
+        && header.size > 0 && fileSize == sizeof(FileHeader) + header.size;
+
+      if (valid)
+      {
+        bytecode.resize(size_t(header.size));
+        in.read(reinterpret_cast<char*>(bytecode.data()), std::streamsize(header.size));
+        valid = in && Hasher().addBytes(bytecode.data(), bytecode.size()).get() == header.checksum;
+      }
+    }
+
+    if (!valid)
+    {
+      bytecode.clear();
+      files.remove(key);
+      return false;
+    }
+
+    files.touch(key);
+    return true;
+  }
+
+  bool ShaderBlobCache::store(uint64_t key, const ShaderBytecode& bytecode) const
+  {
+    if (!isEnabled() || bytecode.empty()) { return false; }
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(FileHeader));
+    header.magic = FILE_MAGIC;
+    header.fileVersion = FILE_VERSION;
+    header.key = key;
+    header.checksum = Hasher().addBytes(bytecode.data(), bytecode.size()).get();
+    header.size = bytecode.size();
+
+    return files.write(key, [&](std::ostream& out)
+    {
+      out.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+      out.write(reinterpret_cast<const char*>(bytecode.data()), std::streamsize(bytecode.size()));
+    });
+  }
+}
@@ -0,0 +1,103 @@
+#include "Rendering/Shaders/ShaderCompileQueue.h"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace Haboob
+{
+  ShaderCompileQueue::~ShaderCompileQueue()
+  {
+    wait();
+  }
+
+  ShaderCompileHandle ShaderCompileQueue::submit(const void* owner, const Job& job)
+  {
+    auto promise = std::make_shared<std::promise<ShaderCompileResult>>();
+    ShaderCompileHandle handle = promise->get_future().share();
+    latest[owner] = handle;
+
+    {
+      std::lock_guard<std::mutex> lock(outstandingMutex);
+      ++outstanding;
+    }
+
+    auto run = [this, promise, job]()
+    {
+      try
+      {
+        promise->set_value(job());
+      }
+      catch (...)
+      {
+        promise->set_exception(std::current_exception());
+      }
+
+      // Notified under the lock, as wait() may return and the queue be destroyed as soon as it is released
+      std::lock_guard<std::mutex> lock(outstandingMutex);
+      --outstanding;
+      outstandingSignal.notify_all();
+    };
+
+    if (pool)
+    {
+      pool->enqueue(run);
+    }
+    else
+    {
+      run();
+    }
+
+    return handle;
+  }
+
+  UInt ShaderCompileQueue::collect(const Apply& apply)
+  {
+    // Taken out first, so apply may submit again
+    std::vector<std::pair<const void*, ShaderCompileHandle>> finished;
+    for (auto it = latest.begin(); it != latest.end();)
+    {
+      if (it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+      {
+        finished.push_back(*it);
+        it = latest.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+
+    for (auto& it : finished)
+    {
+      ShaderCompileResult result;
+      try
+      {
+        result = it.second.get();
+      }
+      catch (const std::exception& exception)
+      {
+        result.errors = exception.what();
+      }
+      catch (...)
+      {
+        result.errors = "Shader compilation threw";
+      }
+
+      apply(it.first, result);
+    }
+
+    return UInt(finished.size());
+  }
+
+  void ShaderCompileQueue::cancel(const void* owner)
+  {
+    latest.erase(owner);
+  }
+
+  void ShaderCompileQueue::wait()
+  {
+    std::unique_lock<std::mutex> lock(outstandingMutex);
+    outstandingSignal.wait(lock, [this]() { return outstanding == 0; });
+  }
+}
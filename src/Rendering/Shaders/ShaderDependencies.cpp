@@ -0,0 +1,232 @@
+#include "Rendering/Shaders/ShaderDependencies.h"
+#include "Data/Hash.h"
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace Haboob
+{
+  namespace
+  {
+    inline bool isIdentifierStart(char c)
+    {
+      return std::isalpha((unsigned char)c) || c == '_';
+    }
+
+    inline bool isIdentifierPart(char c)
+    {
+      return std::isalnum((unsigned char)c) || c == '_';
+    }
+
+    inline bool isBlank(char c)
+    {
+      return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    inline std::wstring getDirectory(const std::wstring& path)
+    {
+      return std::filesystem::path(path).parent_path().wstring();
+    }
+
+    // Chains a file's text onto the closure's hash
+    inline uint64_t addContent(uint64_t hash, const std::string& text)
+    {
+      return Hasher().add(hash).add(uint64_t(text.size())).addBytes(text.data(), text.size()).get();
+    }
+  }
+
+  ShaderDependencies::ShaderDependencies(const FileReader& reader) : reader{ reader ? reader : FileReader(readFile) }, opaque{ false }, contentHash{ 0 }
+  {
+
+  }
+
+  bool ShaderDependencies::readFile(const std::wstring& path, std::string& text)
+  {
+    std::ifstream in(std::filesystem::path(path), std::ios::binary);
+    if (!in) { return false; }
+
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    text = contents.str();
+
+    return true;
+  }
+
+  bool ShaderDependencies::scan(const std::wstring& path)
+  {
+    visited.clear();
+    identifiers.clear();
+    files.clear();
+    missing.clear();
+    opaque = false;
+    contentHash = 0;
+
+    std::wstring normalPath = std::filesystem::path(path).lexically_normal().wstring();
+    std::string text;
+    if (!reader(normalPath, text)) { return false; }
+
+    rootDirectory = getDirectory(normalPath);
+    visited.insert(normalPath);
+    files.push_back(normalPath);
+    contentHash = addContent(contentHash, text);
+
+    std::vector<std::wstring> openDirectories;
+    scanFile(text, openDirectories);
+
+    return true;
+  }
+
+  bool ShaderDependencies::references(const std::string& name) const
+  {
+    return opaque || identifiers.count(name) > 0;
+  }
+
+  ShaderMacros ShaderDependencies::filter(const ShaderMacros& macros) const
+  {
+    if (opaque) { return macros; }
+
+    ShaderMacros referenced;
+    for (auto& it : macros)
+    {
+      if (identifiers.count(it.first))
+      {
+        referenced.insert(referenced.end(), it);
+      }
+    }
+
+    return referenced;
+  }
+
+  void ShaderDependencies::scanFile(const std::string& text, std::vector<std::wstring>& openDirectories)
+  {
+    size_t size = text.size();
+    size_t i = 0;
+    bool lineStart = true; // Only whitespace since the last newline, so a # begins a directive
+
+    while (i < size)
+    {
+      char c = text[i];
+      char next = i + 1 < size ? text[i + 1] : '\0';
+
+      if (c == '\n')
+      {
+        lineStart = true;
+        ++i;
+      }
+      else if (isBlank(c) || (c == '\\' && (next == '\n' || next == '\r')))
+      {
+        ++i; // Continued lines are one logical line
+      }
+      else if (c == '/' && next == '/')
+      {
+        while (i < size && text[i] != '\n') { ++i; }
+      }
+      else if (c == '/' && next == '*')
+      {
+        size_t end = text.find("*/", i + 2);
+        i = end == std::string::npos ? size : end + 2;
+      }
+      else if (c == '"')
+      {
+        for (++i; i < size && text[i] != '"' && text[i] != '\n'; ++i)
+        {
+          if (text[i] == '\\') { ++i; }
+        }
+        ++i;
+        lineStart = false;
+      }
+      else if (c == '#' && next == '#')
+      {
+        // Pasted tokens can name any macro
+        opaque = true;
+        i += 2;
+        lineStart = false;
+      }
+      else if (c == '#' && lineStart)
+      {
+        for (++i; i < size && isBlank(text[i]); ++i) {}
+
+        size_t start = i;
+        while (i < size && isIdentifierPart(text[i])) { ++i; }
+        lineStart = false;
+
+        if (text.compare(start, i - start, "include") != 0) { continue; }
+
+        for (; i < size && isBlank(text[i]); ++i) {}
+
+        char close = i < size && text[i] == '"' ? '"' : (i < size && text[i] == '<' ? '>' : '\0');
+        size_t nameEnd = close ? text.find_first_of(std::string(1, close) + "\n", i + 1) : std::string::npos;
+        if (nameEnd == std::string::npos || text[nameEnd] != close)
+        {
+          // Named by a macro
+          opaque = true;
+          continue;
+        }
+
+        std::string name = text.substr(i + 1, nameEnd - i - 1);
+        i = nameEnd + 1;
+
+        // The shader's directory first, then the including files' from the innermost
+        std::wstring wname(name.begin(), name.end());
+        std::vector<std::wstring> candidates = { rootDirectory };
+        candidates.insert(candidates.end(), openDirectories.rbegin(), openDirectories.rend());
+
+        bool found = false;
+        for (auto& directory : candidates)
+        {
+          std::wstring candidate = (std::filesystem::path(directory) / wname).lexically_normal().wstring();
+          if (visited.count(candidate))
+          {
+            found = true;
+            break;
+          }
+
+          std::string included;
+          if (reader(candidate, included))
+          {
+            visited.insert(candidate);
+            files.push_back(candidate);
+            contentHash = addContent(contentHash, included);
+
+            openDirectories.push_back(getDirectory(candidate));
+            scanFile(included, openDirectories);
+            openDirectories.pop_back();
+
+            found = true;
+            break;
+          }
+        }
+
+        if (!found)
+        {
+          missing.push_back(name);
+        }
+      }
+      else if (isIdentifierStart(c))
+      {
+        size_t start = i;
+        while (i < size && isIdentifierPart(text[i])) { ++i; }
+        identifiers.insert(text.substr(start, i - start));
+        lineStart = false;
+      }
+      else if (std::isdigit((unsigned char)c) || (c == '.' && std::isdigit((unsigned char)next)))
+      {
+        // Numbers such as 1e-3f or 0xFF hold no identifiers
+        for (++i; i < size; ++i)
+        {
+          char part = text[i];
+          bool exponentSign = (part == '+' || part == '-') && (text[i - 1] == 'e' || text[i - 1] == 'E');
+          if (!isIdentifierPart(part) && part != '.' && !exponentSign) { break; }
+        }
+        lineStart = false;
+      }
+      else
+      {
+        ++i;
+        lineStart = false;
+      }
+    }
+  }
+}
@@ -0,0 +1,125 @@
+#include "Rendering/Shaders/ShaderIncludeStore.h"
+
+#include <filesystem>
+
+namespace Haboob
+{
+  ShaderIncludeStore::ShaderIncludeStore(const FileReader& reader) : reader{ reader ? reader : FileReader(ShaderDependencies::readFile) }
+  {
+
+  }
+
+  const ShaderIncludeFile* ShaderIncludeStore::get(const std::wstring& path)
+  {
+    std::filesystem::path normalPath = std::filesystem::path(path).lexically_normal();
+    std::wstring key = normalPath.wstring();
+
+    {
+      std::lock_guard<std::mutex> lock(storeMutex);
+      auto fileIt = files.find(key);
+      if (fileIt != files.end())
+      {
+        ++hits;
+        return &fileIt->second;
+      }
+
+      if (missing.count(key))
+      {
+        ++hits;
+        return nullptr;
+      }
+
+      ++misses;
+    }
+
+    // Read outside the lock, so other compilations are not held up by the disk
+    std::string text;
+    bool found = reader(key, text);
+
+    // Whichever thread stores it first wins, so every compilation shares the one copy
+    std::lock_guard<std::mutex> lock(storeMutex);
+    if (!found)
+    {
+      missing.insert(key);
+      return nullptr;
+    }
+
+    auto fileIt = files.find(key);
+    if (fileIt == files.end())
+    {
+      fileIt = files.insert({ key, ShaderIncludeFile{ key, normalPath.parent_path().wstring(), std::move(text) } }).first;
+    }
+
+    return &fileIt->second;
+  }
+
+  const ShaderIncludeFile* ShaderIncludeStore::resolve(const std::wstring& rootDirectory, const std::vector<const ShaderIncludeFile*>& open, const std::string& name)
+  {
+    ResolveKey key{ rootDirectory, open, name };
+
+    {
+      std::lock_guard<std::mutex> lock(storeMutex);
+      auto resolvedIt = resolved.find(key);
+      if (resolvedIt != resolved.end())
+      {
+        ++resolveHits;
+        return resolvedIt->second;
+      }
+
+      ++resolveMisses;
+    }
+
+    // The shader's directory first, then the including files' from the innermost
+    std::wstring wname(name.begin(), name.end());
+    const ShaderIncludeFile* file = get((std::filesystem::path(rootDirectory) / wname).wstring());
+    for (auto openIt = open.rbegin(); !file && openIt != open.rend(); ++openIt)
+    {
+      file = get((std::filesystem::path((*openIt)->directory) / wname).wstring());
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(storeMutex);
+      resolved.insert({ std::move(key), file });
+    }
+
+    return file;
+  }
+
+  void ShaderIncludeStore::clear()
+  {
+    std::lock_guard<std::mutex> lock(storeMutex);
+    resolved.clear();
+    missing.clear();
+    files.clear();
+  }
+
+  size_t ShaderIncludeStore::getSize() const
+  {
+    std::lock_guard<std::mutex> lock(storeMutex);
+    return files.size();
+  }
+
+  UInt ShaderIncludeStore::getHitCount() const
+  {
+    std::lock_guard<std::mutex> lock(storeMutex);
+    return hits;
+  }
+
+  UInt ShaderIncludeStore::getMissCount() const
+  {
+    std::lock_guard<std::mutex> lock(storeMutex);
+    return misses;
+  }
+
+  UInt ShaderIncludeStore::getResolveHitCount() const
+  {
+    std::lock_guard<std::mutex> lock(storeMutex);
+    return resolveHits;
+  }
+
+  UInt ShaderIncludeStore::getResolveMissCount() const
+  {
+    std::lock_guard<std::mutex> lock(storeMutex);
+    return resolveMisses;
+  }
+}
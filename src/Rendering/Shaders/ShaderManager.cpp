@@ -1,8 +1,114 @@
 #include "Rendering/Shaders/Shader.h"
 #include "Rendering/Shaders/ShaderManager.h"
+#include "Data/Hash.h"
 
 namespace Haboob
 {
+  // Compiles sources from the manager's include store
+  class D3DShaderCompiler : public ShaderCompiler
+  {
+    public:
+    D3DShaderCompiler(ShaderIncludeStore* store) : includes{ store } {}
+
+    bool compile(const std::wstring& path, const std::string& profile, const ShaderMacros& macros, ShaderBytecode& bytecode, std::string& errors) final
+    {
+      // Manages includes, handing the compiler the store's text as is (nothing to copy or free)
+      class SubShaderProcessor : public ID3DInclude
+      {
+        public:
+        ShaderIncludeStore* includes;
+        std::wstring rootDirectory; // The shader's
+        std::vector<const ShaderIncludeFile*> openFiles; // Additional directories to check, innermost last
+
+        SubShaderProcessor(const std::wstring& directory, ShaderIncludeStore* store)
+        {
+          rootDirectory = directory;
+          includes = store;
+        }
+
+        HRESULT Open(D3D_INCLUDE_TYPE IncludeType, LPCSTR pFileName, LPCVOID pParentData, LPCVOID* ppData, UINT* pBytes) final
+        {
+          const ShaderIncludeFile* file = includes->resolve(rootDirectory, openFiles, pFileName);
+          if (!file)
+          {
+            *ppData = nullptr;
+            *pBytes = 0;
+            return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+          }
+
+          openFiles.push_back(file);
+          *ppData = file->text.data();
+          *pBytes = (UINT)file->text.size();
+
+          return S_OK;
+        }
+
+        HRESULT Close(LPCVOID pData) final
+        {
+          if (pData)
+          {
+            openFiles.pop_back();
+          }
+
+          return S_OK;
+        }
+      };
+
+      const ShaderIncludeFile* source = includes->get(path);
+      if (!source) { return false; }
+
+      // Produce macro list
+      std::vector<D3D_SHADER_MACRO> bakedMacros;
+      for (auto& it : macros)
+      {
+        bakedMacros.push_back({ it.first.c_str(), it.second.c_str() });
+      }
+      bakedMacros.push_back({ nullptr, nullptr }); // Terminator
+
+      // Compile shader
+      ComPtr<ID3DBlob> blob;
+      ComPtr<ID3DBlob> errorBlob;
+      SubShaderProcessor includer(source->directory, includes);
+      std::string sourceName(source->path.begin(), source->path.end());
+      HRESULT result = D3DCompile(source->text.data(), source->text.size(), sourceName.c_str(), bakedMacros.data(), &includer, "main", profile.c_str(), getFlags(), 0,
+        blob.GetAddressOf(), errorBlob.GetAddressOf());
+
+      if (FAILED(result))
+      {
+        if (errorBlob.Get())
+        {
+          errors = std::string((char*)errorBlob->GetBufferPointer(), errorBlob->GetBufferSize());
+        }
+
+        return false;
+      }
+
+      const Byte* data = (const Byte*)blob->GetBufferPointer();
+      bytecode.assign(data, data + blob->GetBufferSize());
+
+      return true;
+    }
+
+    uint64_t getSignature() const final
+    {
+      return Hasher().add(getFlags()).add(UInt(D3D_COMPILER_VERSION)).get();
+    }
+
+    private:
+    ShaderIncludeStore* includes;
+
+    static UINT getFlags()
+    {
+      // Shader flags
+      UINT flags = D3DCOMPILE_ENABLE_STRICTNESS;
+      #if DEBUGFLAG
+      flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_DEBUG_NAME_FOR_SOURCE;
+      #endif
+
+      return flags;
+    }
+  };
+
   const std::vector<D3D11_INPUT_ELEMENT_DESC> ShaderManager::defaultVertexLayout = {
     { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
     { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
@@ -16,39 +122,97 @@ namespace Haboob
     shaderLevel = L"_5_0";
     isMacrosBaked = false;
     bakeMacros(nullptr);
+
+    compiler = new D3DShaderCompiler(&includes);
+    permutations.setCompiler(compiler);
+    permutations.setBlobCache(&blobCache);
+  }
+
+  ShaderManager::~ShaderManager()
+  {
+    // Jobs still running compile through the backend
+    compileQueue.wait();
+    delete compiler;
   }
 
   void ShaderManager::bakeMacros(ID3D11Device* device)
   {
-    if (isMacrosBaked) { return; } // Skip if the same
+    if (isSourcesStale)
+    {
+      // Nothing may read the store while it is cleared, requests still to be collected hold permutations rather than sources
+      compileQueue.wait();
+      includes.clear();
+      {
+        std::lock_guard<std::mutex> lock(dependencyMutex);
+        shaderDependencies.clear();
+      }
 
-    // Produce macro list
-    bakedMacros.clear();
-    for (auto& it : macroList)
+      isSourcesStale = false;
+      isMacrosBaked = false;
+    }
+
+    if (!isMacrosBaked) // Skip if the same
     {
-      bakedMacros.push_back({ it.first.c_str(), it.second.c_str() });
+      // Previously compiled permutations are reused rather than recompiled
+      if (device)
+      {
+        recompileShaders(device);
+      }
+
+      isMacrosBaked = true;
     }
-    bakedMacros.push_back({ nullptr, nullptr }); // Terminator
 
+    // Swap in whichever have finished, the rest keep their current compilation
     if (device)
     {
-      recompileShaders(device);
+      collectShaders(device);
     }
+  }
+
+  void ShaderManager::reloadSources()
+  {
+    isSourcesStale = true;
+  }
 
-    isMacrosBaked = true;
+  void ShaderManager::waitForShaders(ID3D11Device* device)
+  {
+    compileQueue.wait();
+    collectShaders(device);
   }
 
   void ShaderManager::addShader(Shader* shader)
   {
-    if (shaders.insert(shader).second)
-    {
-      isMacrosBaked = false; // Hack
-    }
+    shaders.insert(shader); // Requested with the current macros by the caller
   }
 
   void ShaderManager::removeShader(Shader* shader)
   {
     shaders.erase(shader);
+    compileQueue.cancel(shader);
+  }
+
+  HRESULT ShaderManager::requestShader(ID3D11Device* device, Shader* shader)
+  {
+    // Precompiled shaders are only read
+    if (shader->isPreCompiled())
+    {
+      HRESULT result = shader->loadPreCompiledShader(device, this);
+      if (SUCCEEDED(result)) { return result; }
+    }
+
+    // The job takes copies, as macros may change while it runs
+    std::wstring fullFile;
+    std::string profile;
+    getShaderFile(shader->getType(), shader->getRelativePath(), fullFile, profile);
+    ShaderMacros macros = macroList;
+
+    compileQueue.submit(shader, [this, fullFile, profile, macros]()
+      {
+        return compilePermutation(fullFile, profile, macros);
+      });
+
+    // Without a pool the job has already run
+    return compileQueue.getThreadPool() ? S_OK : collectShaders(device);
   }
 
   void ShaderManager::setMacro(const std::string& name, const std::string& value)
@@ -83,93 +247,43 @@ namespace Haboob
     shaderLevel = level;
   }
 
-  HRESULT ShaderManager::loadFormattedShaderBlob(Shader::Type shaderType, const wchar_t* relativePath, ID3DBlob** blob) const
+  void ShaderManager::setCacheDirectory(const std::wstring& cache)
   {
-    // Manages includes
-    class SubShaderProcessor : public ID3DInclude
-    {
-      public:
-      std::map<std::wstring, std::string>* fileCache;
-      std::wstring parentPath; // Root
-      std::vector<std::pair<LPCVOID, std::wstring>> treeDirectories; // Additional recursive directories to check
-
-      SubShaderProcessor(const std::wstring& basePath, std::map<std::wstring, std::string>* cache)
-      {
-        parentPath = basePath;
-        fileCache = (std::map<std::wstring, std::string>*)cache;
-      }
-
-      HRESULT Open(D3D_INCLUDE_TYPE IncludeType, LPCSTR pFileName, LPCVOID pParentData, LPCVOID* ppData, UINT* pBytes) final
-      {
-        std::string fileName(pFileName);
-        std::wstring wfileName(fileName.begin(), fileName.end());
-        std::wstring fullFile = parentPath + wfileName;
-
-        #define ReadFileToBlob(filePath, blob)\
-        {\
-          auto cacheIt = fileCache->find(filePath);\
-          if (cacheIt != fileCache->end())\
-          {\
-            D3DCreateBlob(cacheIt->second.size(), blob.GetAddressOf());\
-            std::memcpy((void*)fileBlob->GetBufferPointer(), cacheIt->second.data(), cacheIt->second.size());\
-          }\
-          else\
-          {\
-            D3DReadFileToBlob(fullFile.c_str(), fileBlob.GetAddressOf());\
-            if (fileBlob.Get())\
-            {\
-              std::string shaderFile((char*)fileBlob->GetBufferPointer(), fileBlob->GetBufferSize());\
-              fileCache->insert({ filePath, shaderFile });\
-            }\
-          }\
-        }
+    blobCache.setDirectory(cache);
+  }
 
-        ComPtr<ID3DBlob> fileBlob;
-        HRESULT result = S_OK;
-        ReadFileToBlob(fullFile, fileBlob);
-        
-        for (auto& treeDirsIt = treeDirectories.rbegin(); (result & (HRESULT)ERROR_FILE_NOT_FOUND) && treeDirsIt != treeDirectories.rend(); ++treeDirsIt)
-        {
-          fullFile = treeDirsIt->second + wfileName;
-          ReadFileToBlob(fullFile, fileBlob);
-        }
+  void ShaderManager::setThreadPool(ThreadPool* pool)
+  {
+    compileQueue.setThreadPool(pool);
+  }
 
-        #undef ReadFileToBlob
-        
-        if (fileBlob.Get())
-        {
-          *pBytes = fileBlob->GetBufferSize();
-          *ppData = new Byte[*pBytes];
-          std::memcpy((void*)*ppData, fileBlob->GetBufferPointer(), *pBytes);
-        }
-        else
-        {
-          *ppData = nullptr;
-        }
+  HRESULT ShaderManager::loadFormattedShader(Shader::Type shaderType, const wchar_t* relativePath, const ShaderPermutation** permutation) const
+  {
+    std::wstring fullFile;
+    std::string profile;
+    getShaderFile(shaderType, relativePath, fullFile, profile);
 
-        if (SUCCEEDED(result))
-        {
-          treeDirectories.push_back({ *ppData, fullFile + UP_LEVEL_DELIM });
-        }
+    ShaderCompileResult compiled = compilePermutation(fullFile, profile, macroList);
+    *permutation = compiled.permutation;
 
-        return result;
+    if (!compiled.permutation)
+    {
+      if (!compiled.errors.empty())
+      {
+        // Print error
+        MessageBox(NULL, compiled.errors.c_str(), "Shader Compile Error", MB_ICONERROR | MB_OK);
       }
 
-      HRESULT Close(LPCVOID pData) final
-      {
-        if (pData)
-        {
-          treeDirectories.pop_back();
-          delete[](void*)pData;
-        }
+      return E_FAIL;
+    }
 
-        return S_OK;
-      }
-    };
-    
+    return S_OK;
+  }
+
+  void ShaderManager::getShaderFile(Shader::Type shaderType, const wchar_t* relativePath, std::wstring& fullFile, std::string& profile) const
+  {
     // Determine file path and extension
-    std::wstring fullFile = fullResolvedPath + relativePath;
-    std::wstring basePath = fullFile + UP_LEVEL_DELIM;
+    fullFile = fullResolvedPath + relativePath;
 
     WLiteral typeID = VERTEX_ID;
     switch (shaderType)
@@ -195,33 +309,63 @@ namespace Haboob
     }
     fullFile = fullFile + EXT_DELIM + typeID;
 
-    // Shader flags
-    UINT flags = D3DCOMPILE_ENABLE_STRICTNESS;
-    #if DEBUGFLAG
-    flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_DEBUG_NAME_FOR_SOURCE;
-    #endif
-
     // Shader profile
     std::wstring wprofile = std::wstring(typeID) + shaderLevel;
-    std::string profile = std::string(wprofile.begin(), wprofile.end());
+    profile = std::string(wprofile.begin(), wprofile.end());
+  }
+
+  ShaderCompileResult ShaderManager::compilePermutation(const std::wstring& fullFile, const std::string& profile, const ShaderMacros& bakedMacros) const
+  {
+    // Only the macros the shader's include closure references, so changing any other keeps its permutation
+    ShaderMacros macros = bakedMacros;
+    uint64_t contentHash = 0; // Keys the permutation, so edited sources compile anew
+    bool scanned = false;
+    {
+      std::lock_guard<std::mutex> lock(dependencyMutex);
 
-    // Compile shader
-    ComPtr<ID3DBlob> errorBlob;
-    SubShaderProcessor includer(basePath, const_cast<std::map<std::wstring, std::string>*>(&shaderFileCache));
-    HRESULT result = D3DCompileFromFile(fullFile.data(), bakedMacros.data(), &includer, "main", profile.c_str(), flags, NULL, blob, errorBlob.GetAddressOf());
+      auto dependencyIt = shaderDependencies.find(fullFile);
+      if (dependencyIt != shaderDependencies.end())
+      {
+        macros = dependencyIt->second.filter(bakedMacros);
+        contentHash = dependencyIt->second.getContentHash();
+        scanned = true;
+      }
+    }
 
-    if (FAILED(result) && errorBlob.Get())
+    if (!scanned)
     {
-      std::string error;
+      // Scanned outside the lock, as it reads files, through the store so compiling reads nothing again
+      ShaderDependencies dependencies([this](const std::wstring& path, std::string& text)
+      {
+        const ShaderIncludeFile* file = includes.get(path);
+        if (!file) { return false; }
 
-      error = "Shader (" + profile + ") path [" + std::string(fullFile.begin(), fullFile.end()) + "] says \n";
-      error = error + std::string((char*)errorBlob.Get()->GetBufferPointer(), errorBlob.Get()->GetBufferSize());
+        text = file->text;
+        return true;
+      });
+
+      if (dependencies.scan(fullFile))
+      {
+        macros = dependencies.filter(bakedMacros);
+        contentHash = dependencies.getContentHash();
 
-      // Print error
-      MessageBox(NULL, error.c_str(), "Shader Compile Error", MB_ICONERROR | MB_OK);
+        // Whichever thread stores it first wins, the others scanned the same files
+        std::lock_guard<std::mutex> lock(dependencyMutex);
+        shaderDependencies.insert({ fullFile, std::move(dependencies) });
+      }
     }
 
-    return result;
+    // Compile shader, unless this permutation already has been, in this launch or a previous one
+    ShaderCompileResult compiled;
+    std::string errors;
+    compiled.permutation = permutations.get(fullFile, profile, macros, contentHash, &errors);
+
+    if (!compiled.permutation && !errors.empty())
+    {
+      compiled.errors = "Shader (" + profile + ") path [" + std::string(fullFile.begin(), fullFile.end()) + "] says \n" + errors;
+    }
+
+    return compiled;
   }
 
   HRESULT ShaderManager::loadPreCompiledShaderBlob(const wchar_t* relativePath, ID3DBlob** blob) const
@@ -236,13 +380,42 @@ namespace Haboob
     
     for (auto shader : shaders)
     {
-      result = shader->initShader(device, this);
+      result = requestShader(device, shader);
       Firebreak(result);
     }
 
     return result;
   }
 
+  HRESULT ShaderManager::collectShaders(ID3D11Device* device)
+  {
+    HRESULT result = S_OK;
+
+    compileQueue.collect([&](const void* owner, const ShaderCompileResult& compiled)
+      {
+        Shader* shader = (Shader*)owner;
+        if (compiled.permutation)
+        {
+          uint64_t previousKey = shader->getCompiledKey();
+          HRESULT swapped = shader->swapShader(device, this, compiled.permutation);
+          if (FAILED(swapped)) { result = swapped; }
+          else if (shader->getCompiledKey() != previousKey) { ++swapGeneration; }
+        }
+        else
+        {
+          if (!compiled.errors.empty())
+          {
+            // Print error
+            MessageBox(NULL, compiled.errors.c_str(), "Shader Compile Error", MB_ICONERROR | MB_OK);
+          }
+
+          result = E_FAIL;
+        }
+      });
+
+    return result;
+  }
+
   void ShaderManager::resolveFullPath()
   {
     fullResolvedPath = rootDirectory + PATH_DELIM + shadersRelativePath + PATH_DELIM;
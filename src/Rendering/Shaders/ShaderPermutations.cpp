@@ -0,0 +1,135 @@
+#include "Rendering/Shaders/ShaderPermutations.h"
+#include "Rendering/Shaders/ShaderBlobCache.h"
+#include "Data/Hash.h"
+
+namespace Haboob
+{
+  uint64_t ShaderPermutationCache::getKey(const std::wstring& path, const std::string& profile, const ShaderMacros& macros, uint64_t contentHash)
+  {
+    Hasher hasher;
+    hasher.addString(path).add(contentHash).addString(profile);
+
+    // Ordered by name, so the key does not depend on the order macros were set in
+    hasher.add(uint64_t(macros.size()));
+    for (auto& it : macros)
+    {
+      hasher.addString(it.first).addString(it.second);
+    }
+
+    return hasher.get();
+  }
+
+  const ShaderPermutation* ShaderPermutationCache::get(const std::wstring& path, const std::string& profile, const ShaderMacros& macros, uint64_t contentHash,
+    std::string* errors)
+  {
+    uint64_t key = getKey(path, profile, macros, contentHash);
+
+    {
+      std::unique_lock<std::mutex> lock(permutationMutex);
+      while (true)
+      {
+        // Compared in full, colliding keys are kept side by side
+        auto range = permutations.equal_range(key);
+        for (auto permutationIt = range.first; permutationIt != range.second; ++permutationIt)
+        {
+          const ShaderPermutation& permutation = permutationIt->second;
+          if (permutation.path == path && permutation.contentHash == contentHash && permutation.profile == profile && permutation.macros == macros)
+          {
+            ++hits;
+            return &permutation;
+          }
+        }
+
+        // Another thread is already compiling it
+        if (!compiling.count(key)) { break; }
+        compiledSignal.wait(lock);
+      }
+
+      if (!compiler) { return nullptr; }
+      compiling.insert(key);
+    }
+
+    // Compiled by a previous launch
+    ShaderPermutation permutation;
+    bool cacheable = blobCache && blobCache->isEnabled() && contentHash != 0;
+    uint64_t blobKey = cacheable ? ShaderBlobCache::getKey(contentHash, profile, macros, compiler->getSignature()) : 0;
+    bool loaded = false;
+    bool compiled = false;
+    try
+    {
+      loaded = cacheable && blobCache->load(blobKey, permutation.bytecode);
+      if (!loaded)
+      {
+        std::string output;
+        compiled = compiler->compile(path, profile, macros, permutation.bytecode, output);
+        if (!compiled && errors) { *errors = output; }
+
+        if (compiled && cacheable)
+        {
+          blobCache->store(blobKey, permutation.bytecode);
+        }
+      }
+    }
+    catch (...)
+    {
+      // Release any waiting threads to try themselves
+      {
+        std::lock_guard<std::mutex> lock(permutationMutex);
+        compiling.erase(key);
+      }
+      compiledSignal.notify_all();
+      throw;
+    }
+
+    const ShaderPermutation* stored = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(permutationMutex);
+      compiling.erase(key);
+      loaded ? ++loads : ++compiles;
+
+      if (loaded || compiled)
+      {
+        permutation.key = key;
+        permutation.path = path;
+        permutation.contentHash = contentHash;
+        permutation.profile = profile;
+        permutation.macros = macros;
+
+        stored = &(permutations.emplace(key, std::move(permutation))->second);
+      }
+    }
+    compiledSignal.notify_all();
+
+    return stored;
+  }
+
+  void ShaderPermutationCache::clear()
+  {
+    std::lock_guard<std::mutex> lock(permutationMutex);
+    permutations.clear();
+  }
+
+  size_t ShaderPermutationCache::getSize() const
+  {
+    std::lock_guard<std::mutex> lock(permutationMutex);
+    return permutations.size();
+  }
+
+  UInt ShaderPermutationCache::getHitCount() const
+  {
+    std::lock_guard<std::mutex> lock(permutationMutex);
+    return hits;
+  }
+
+  UInt ShaderPermutationCache::getCompileCount() const
+  {
+    std::lock_guard<std::mutex> lock(permutationMutex);
+    return compiles;
+  }
+
+  UInt ShaderPermutationCache::getLoadCount() const
+  {
+    std::lock_guard<std::mutex> lock(permutationMutex);
+    return loads;
+  }
+}
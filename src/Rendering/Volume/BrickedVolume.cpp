@@ -0,0 +1,176 @@
+#include "Rendering/Volume/BrickedVolume.h"
+#include "Data/PackedFloat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Haboob
+{
+  void BrickedVolume::reset(const XMINT3& newSize)
+  {
+    size = newSize;
+    brickCounts = { (size.x + BRICK_SIZE - 1) / BRICK_SIZE, (size.y + BRICK_SIZE - 1) / BRICK_SIZE, (size.z + BRICK_SIZE - 1) / BRICK_SIZE };
+
+    size_t brickCount = size_t(brickCounts.x) * size_t(brickCounts.y) * size_t(brickCounts.z);
+    occupancy.assign((brickCount + 63) / 64, 0);
+    ranges.assign(brickCount, { .0f, .0f });
+    slots.assign(brickCount, EMPTY_SLOT);
+    pool.clear();
+  }
+
+  void BrickedVolume::assign(std::vector<UInt>&& newSlots, std::vector<BrickRange>&& newRanges, std::vector<UInt>&& newPool)
+  {
+    slots = std::move(newSlots);
+    ranges = std::move(newRanges);
+    pool = std::move(newPool);
+
+    std::fill(occupancy.begin(), occupancy.end(), 0);
+    for (UInt brick = 0; brick < UInt(slots.size()); ++brick)
+    {
+      if (slots[brick] != EMPTY_SLOT)
+      {
+        occupancy[brick >> 6] |= uint64_t(1) << (brick & 63);
+      }
+    }
+  }
+
+  VolumeElement BrickedVolume::at(int x, int y, int z) const
+  {
+    const UInt* brick = getBrick(brickIndex(x / BRICK_SIZE, y / BRICK_SIZE, z / BRICK_SIZE));
+    if (!brick) { return { .0f, .0f, .0f }; }
+
+    float rgb[3];
+    PackedFloat::unpackR11G11B10(brick[(x % BRICK_SIZE) + BRICK_SIZE * ((y % BRICK_SIZE) + BRICK_SIZE * (z % BRICK_SIZE))], rgb);
+    return { rgb[0], rgb[1], rgb[2] };
+  }
+
+  void BrickedVolume::toGrid(VolumeGrid& grid) const
+  {
+    grid.resize(size);
+    std::fill(grid.getData(), grid.getData() + grid.getVoxelCount(), VolumeElement{ .0f, .0f, .0f });
+
+    for (int bz = 0; bz < brickCounts.z; ++bz)
+    {
+      for (int by = 0; by < brickCounts.y; ++by)
+      {
+        for (int bx = 0; bx < brickCounts.x; ++bx)
+        {
+          const UInt* brick = getBrick(brickIndex(bx, by, bz));
+          if (!brick) { continue; }
+
+          // Copy the rows which lie within the volume
+          int x0 = bx * BRICK_SIZE, y0 = by * BRICK_SIZE, z0 = bz * BRICK_SIZE;
+          int width = std::min(BRICK_SIZE, size.x - x0);
+          for (int z = 0; z < std::min(BRICK_SIZE, size.z - z0); ++z)
+          {
+            for (int y = 0; y < std::min(BRICK_SIZE, size.y - y0); ++y)
+            {
+              const UInt* brickRow = brick + BRICK_SIZE * (y + BRICK_SIZE * z);
+              VolumeElement* row = &grid.at(x0, y0 + y, z0 + z);
+              for (int x = 0; x < width; ++x)
+              {
+                float rgb[3];
+                PackedFloat::unpackR11G11B10(brickRow[x], rgb);
+                row[x] = { rgb[0], rgb[1], rgb[2] };
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+  size_t BrickedVolume::getMemoryUsage() const
+  {
+    return pool.size() * sizeof(UInt) + slots.size() * sizeof(UInt) + ranges.size() * sizeof(BrickRange) + occupancy.size() * sizeof(uint64_t);
+  }
+
+  void BrickedVolume::traverse(const float origin[3], const float direction[3], float tMin, float tMax, const BrickVisitor& visitor) const
+  {
+    const int extent[3] = { size.x, size.y, size.z };
+    const int counts[3] = { brickCounts.x, brickCounts.y, brickCounts.z };
+
+    // Clip to the volume
+    for (UInt axis = 0; axis < 3; ++axis)
+    {
+      if (direction[axis] == .0f)
+      {
+        if (origin[axis] < .0f || origin[axis] > float(extent[axis])) { return; }
+        continue;
+      }
+
+      float tNear = -origin[axis] / direction[axis];
+      float tFar = (float(extent[axis]) - origin[axis]) / direction[axis];
+      if (tNear > tFar) { std::swap(tNear, tFar); }
+      tMin = std::max(tMin, tNear);
+      tMax = std::min(tMax, tFar);
+    }
+
+    if (!(tMin < tMax)) { return; }
+
+    // 3D DDA over the brick grid
+    int cell[3], step[3];
+    float tNext[3], tDelta[3];
+    for (UInt axis = 0; axis < 3; ++axis)
+    {
+      float position = origin[axis] + direction[axis] * tMin;
+      cell[axis] = std::min(std::max(int(std::floor(position / float(BRICK_SIZE))), 0), counts[axis] - 1);
+
+      if (direction[axis] == .0f)
+      {
+        step[axis] = 0;
+        tNext[axis] = tDelta[axis] = std::numeric_limits<float>::infinity();
+        continue;
+      }
+
+      step[axis] = direction[axis] > .0f ? 1 : -1;
+      float boundary = float((cell[axis] + (step[axis] > 0 ? 1 : 0)) * BRICK_SIZE);
+      tNext[axis] = (boundary - origin[axis]) / direction[axis];
+      tDelta[axis] = float(BRICK_SIZE) / std::abs(direction[axis]);
+    }
+
+    float t = tMin;
+    while (t < tMax)
+    {
+      UInt axis = tNext[0] < tNext[1] ? (tNext[0] < tNext[2] ? 0 : 2) : (tNext[1] < tNext[2] ? 1 : 2);
+      float tExit = std::min(tNext[axis], tMax);
+
+      UInt brick = brickIndex(cell[0], cell[1], cell[2]);
+      if (tExit > t && isOccupied(brick))
+      {
+        visitor(brick, t, tExit);
+      }
+
+      t = std::max(t, tExit);
+      cell[axis] += step[axis];
+      if (cell[axis] < 0 || cell[axis] >= counts[axis]) { break; }
+      tNext[axis] += tDelta[axis];
+    }
+  }
+
+  float BrickedVolume::integrateDensity(const float origin[3], const float direction[3], float tMin, float tMax, float step) const
+  {
+    float sum = .0f;
+    traverse(origin, direction, tMin, tMax, [&](UInt, float tEnter, float tExit)
+      {
+        // Samples whose position lies within this brick's span
+        long long first = (long long)std::ceil((tEnter - tMin) / step - .5f);
+        long long last = (long long)std::ceil((tExit - tMin) / step - .5f);
+        for (long long i = std::max(first, 0LL); i < last; ++i)
+        {
+          float t = tMin + (float(i) + .5f) * step;
+          int voxel[3];
+          const int extent[3] = { size.x, size.y, size.z };
+          for (UInt axis = 0; axis < 3; ++axis)
+          {
+            voxel[axis] = std::min(std::max(int(std::floor(origin[axis] + direction[axis] * t)), 0), extent[axis] - 1);
+          }
+
+          sum += at(voxel[0], voxel[1], voxel[2]).density;
+        }
+      });
+
+    return sum * step;
+  }
+}
@@ -0,0 +1,88 @@
+#include "Rendering/Volume/VolumeAnimator.h"
+
+namespace Haboob
+{
+  VolumeAnimator::VolumeAnimator(ThreadPool* threadPool) : generator{ threadPool }, front{ 0 }, frontTime{ .0f }, backTime{ .0f }, frames{ 0 },
+    hasPending{ false }, generating{ false }, backReady{ false }, stopping{ false }
+  {
+    worker = std::thread(&VolumeAnimator::work, this);
+  }
+
+  VolumeAnimator::~VolumeAnimator()
+  {
+    {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      stopping = true;
+    }
+    workSignal.notify_all();
+
+    worker.join();
+  }
+
+  void VolumeAnimator::request(const VolumeInfo& info)
+  {
+    {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      pending = info;
+      hasPending = true;
+    }
+    workSignal.notify_one();
+  }
+
+  bool VolumeAnimator::swap()
+  {
+    {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      if (!backReady) { return false; }
+
+      front = 1 - front;
+      frontTime = backTime;
+      backReady = false;
+      ++frames;
+    }
+
+    // The back buffer is free for any queued request
+    workSignal.notify_one();
+    return true;
+  }
+
+  void VolumeAnimator::wait()
+  {
+    std::unique_lock<std::mutex> lock(stateMutex);
+    doneSignal.wait(lock, [&]() { return !generating && (backReady || !hasPending); });
+  }
+
+  bool VolumeAnimator::isBusy() const
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return hasPending || generating;
+  }
+
+  void VolumeAnimator::work()
+  {
+    while (true)
+    {
+      VolumeInfo info;
+      {
+        std::unique_lock<std::mutex> lock(stateMutex);
+        workSignal.wait(lock, [&]() { return stopping || (hasPending && !backReady); });
+        if (stopping) { return; }
+
+        info = pending;
+        hasPending = false;
+        generating = true;
+      }
+
+      // Only the worker touches the back buffer until it is marked ready
+      generator.generate(info, buffers[1 - front]);
+
+      {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        backTime = info.motion.time;
+        backReady = true;
+        generating = false;
+      }
+      doneSignal.notify_all();
+    }
+  }
+}
@@ -0,0 +1,217 @@
+#include "Rendering/Volume/VolumeCache.h"
+#include "Rendering/Volume/VolumeMips.h"
+#include "Rendering/Volume/VolumeStages.h"
+#include "Data/Hash.h"
+#include "Data/PackedFloatKernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Haboob
+{
+  namespace
+  {
+    constexpr UInt FILE_MAGIC = 0x4C4F5648; // "HVOL"
+    constexpr UInt FILE_VERSION = 1; // Layout of the file itself
+    constexpr Literal FILE_EXTENSION = ".hvol";
+
+    // Elements are converted as interleaved rgb triples
+    static_assert(sizeof(VolumeElement) == 3 * sizeof(float), "VolumeElement must be three packed floats");
+
+    // Occupies the first page, followed by each level at a page aligned offset
+    struct FileHeader
+    {
+      UInt magic;
+      UInt fileVersion;
+      UInt generatorVersion;
+      UInt levelCount;
+      uint64_t key;
+      uint64_t checksum; // FNV-1a over the texels of every level
+      uint64_t fileSize;
+      int size[3];
+      UInt padding;
+      uint64_t levelOffsets[VolumeCache::MAX_LEVELS];
+    };
+    static_assert(sizeof(FileHeader) <= VolumeCache::PAGE_SIZE, "The header must fit in the first page");
+
+    inline uint64_t alignPage(uint64_t offset)
+    {
+      return (offset + VolumeCache::PAGE_SIZE - 1) & ~uint64_t(VolumeCache::PAGE_SIZE - 1);
+    }
+
+    inline uint64_t getLevelBytes(const XMINT3& size)
+    {
+      return uint64_t(size.x) * uint64_t(size.y) * uint64_t(size.z) * sizeof(UInt);
+    }
+
+    // If a level of the size fits within limit bytes, checked a dimension at a time so untrusted sizes cannot wrap
+    inline bool fitsLevel(const XMINT3& size, uint64_t limit)
+    {
+      uint64_t texels = limit / sizeof(UInt);
+      if (size.x <= 0 || size.y <= 0 || size.z <= 0 || uint64_t(size.x) > texels) { return false; }
+
+      texels /= uint64_t(size.x);
+      if (uint64_t(size.y) > texels) { return false; }
+
+      texels /= uint64_t(size.y);
+      return uint64_t(size.z) <= texels;
+    }
+  }
+
+  XMINT3 CachedVolume::getLevelSize(UInt level) const
+  {
+    return VolumeMips::getLevelSize(size, level);
+  }
+
+  void CachedVolume::unpackLevel(UInt level, VolumeGrid& grid) const
+  {
+    grid.resize(getLevelSize(level));
+
+    PackedFloat::getUnpackBatch(SIMD::detectLevel())(levels[level], &grid.getData()->density, grid.getVoxelCount());
+  }
+
+  VolumeCache::VolumeCache(const std::filesystem::path& directory, uint64_t capacity) : files{ directory, FILE_EXTENSION, capacity }
+  {
+
+  }
+
+  uint64_t VolumeCache::getKey(const VolumeInfo& info)
+  {
+    // The combine hash already covers every parameter the volume depends on
+    return Hasher().add(GENERATOR_VERSION).add(VolumeStageHashes::compute(info).combine).get();
+  }
+
+  bool VolumeCache::load(uint64_t key, CachedVolume& volume)
+  {
+    volume = CachedVolume();
+    if (!isEnabled()) { return false; }
+
+    std::filesystem::path path = getPath(key);
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) { return false; }
+
+    MappedFile file;
+    if (!file.open(path)) { return false; }
+
+    // Validate the header before trusting any offsets
+    bool valid = file.getSize() >= PAGE_SIZE;
+    FileHeader header;
+    if (valid)
+    {
+      std::memcpy(&header, file.getData(), sizeof(FileHeader));
+      valid = header.magic == FILE_MAGIC && header.fileVersion == FILE_VERSION && header.generatorVersion == GENERATOR_VERSION
+        && header.key == key && header.fileSize == file.getSize() && header.levelCount > 0 && header.levelCount <= MAX_LEVELS;
+    }
+
+    XMINT3 size = { 0, 0, 0 };
+    if (valid)
+    {
+      size = { header.size[0], header.size[1], header.size[2] };
+      valid = fitsLevel(size, header.fileSize);
+    }
+
+    Hasher checksum;
+    for (UInt level = 0; valid && level < header.levelCount; ++level)
+    {
+      // Bounded by the file before any arithmetic on the header's values
+      uint64_t offset = header.levelOffsets[level];
+      XMINT3 levelSize = VolumeMips::getLevelSize(size, level);
+      valid = offset % PAGE_SIZE == 0 && offset >= PAGE_SIZE && offset <= header.fileSize && fitsLevel(levelSize, header.fileSize - offset);
+      uint64_t bytes = valid ? getLevelBytes(levelSize) : 0;
+
+      if (valid)
+      {
+        checksum.addBytes(file.getData() + offset, size_t(bytes));
+      }
+    }
+
+    if (!valid || checksum.get() != header.checksum)
+    {
+      file.close();
+      files.remove(key);
+      return false;
+    }
+
+    volume.size = size;
+    volume.levels.resize(header.levelCount);
+    for (UInt level = 0; level < header.levelCount; ++level)
+    {
+      volume.levels[level] = reinterpret_cast<const UInt*>(file.getData() + header.levelOffsets[level]);
+    }
+    volume.file = std::move(file);
+
+    files.touch(key);
+
+    return true;
+  }
+
+  bool VolumeCache::store(uint64_t key, const XMINT3& size, UInt levelCount, const UInt* const* levels)
+  {
+    if (!isEnabled() || levelCount == 0 || levelCount > MAX_LEVELS) { return false; }
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(FileHeader));
+    header.magic = FILE_MAGIC;
+    header.fileVersion = FILE_VERSION;
+    header.generatorVersion = GENERATOR_VERSION;
+    header.levelCount = levelCount;
+    header.key = key;
+    header.size[0] = size.x;
+    header.size[1] = size.y;
+    header.size[2] = size.z;
+
+    Hasher checksum;
+    uint64_t offset = PAGE_SIZE;
+    for (UInt level = 0; level < levelCount; ++level)
+    {
+      uint64_t bytes = getLevelBytes(VolumeMips::getLevelSize(size, level));
+      checksum.addBytes(levels[level], size_t(bytes));
+
+      header.levelOffsets[level] = offset;
+      offset = alignPage(offset + bytes);
+    }
+    header.checksum = checksum.get();
+    header.fileSize = offset;
+
+    return files.write(key, [&](std::ostream& out)
+    {
+      std::vector<char> zeros(PAGE_SIZE, 0);
+      out.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+      out.write(zeros.data(), PAGE_SIZE - sizeof(FileHeader));
+
+      for (UInt level = 0; level < levelCount; ++level)
+      {
+        uint64_t bytes = getLevelBytes(VolumeMips::getLevelSize(size, level));
+        out.write(reinterpret_cast<const char*>(levels[level]), std::streamsize(bytes));
+
+        uint64_t end = header.levelOffsets[level] + bytes;
+        out.write(zeros.data(), std::streamsize(alignPage(end) - end));
+      }
+    });
+  }
+
+  bool VolumeCache::store(uint64_t key, const VolumeGrid& grid, ThreadPool* pool)
+  {
+    const XMINT3& size = grid.getSize();
+    UInt levelCount = std::min(VolumeMips::getLevelCount(size), MAX_LEVELS);
+
+    std::vector<VolumeGrid> mips;
+    VolumeMips::buildChain(grid, mips, levelCount, pool);
+
+    std::vector<std::vector<UInt>> packed(levelCount);
+    std::vector<const UInt*> levels(levelCount);
+
+    PackedFloat::PackBatch packBatch = PackedFloat::getPackBatch(SIMD::detectLevel());
+    for (UInt level = 0; level < levelCount; ++level)
+    {
+      const VolumeGrid& source = level == 0 ? grid : mips[level - 1];
+      const VolumeElement* elements = source.getData();
+
+      packed[level].resize(source.getVoxelCount());
+      packBatch(&elements->density, packed[level].data(), source.getVoxelCount());
+      levels[level] = packed[level].data();
+    }
+
+    return store(key, size, levelCount, levels.data());
+  }
+}
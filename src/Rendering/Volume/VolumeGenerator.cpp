@@ -0,0 +1,512 @@
+#include "Rendering/Volume/VolumeGenerator.h"
+#include "Data/PackedFloat.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace Haboob
+{
+  namespace
+  {
+    inline float saturate(float value)
+    {
+      return std::min(std::max(value, .0f), 1.f);
+    }
+
+    inline float smoothstep(float minValue, float maxValue, float value)
+    {
+      float t = saturate((value - minValue) / (maxValue - minValue));
+      return t * t * (3.f - 2.f * t);
+    }
+
+    // Returns the radial distance for the logarithmic component of the haboob
+    inline float haboobUndersideRadius(const HaboobRadial& radial, float height)
+    {
+      return radial.rOffset + radial.exponentialScale * std::log(1.f + height * radial.exponentialRate);
+    }
+
+    // Returns the radial distance for the flat roof component of the haboob
+    inline float haboobRoofRadius(const HaboobRadial& radial, float height)
+    {
+      float nose = radial.noseHeight;
+      return radial.roofGradient * (height - nose) + haboobUndersideRadius(radial, nose);
+    }
+
+    // Returns the radial distance representing the leading edge of the haboob
+    inline float haboobRadius(const HaboobRadial& radial, float height)
+    {
+      float undersideValue = haboobUndersideRadius(radial, height);
+      float flatRoofValue = haboobRoofRadius(radial, height);
+
+      // Exponential easing function
+      float easing = std::max((height - radial.noseHeight) / radial.blendHeight, .0f);
+      easing = std::exp(-radial.blendRate * easing);
+
+      return Perlin::lerp(flatRoofValue, undersideValue, easing);
+    }
+
+    inline float haboobVerticalFlux(const HaboobDistribution& distribution, float height)
+    {
+      return std::pow(distribution.heightScale * (1.f + height), -distribution.heightExponent);
+    }
+
+    inline float haboobAngularFlux(const HaboobDistribution& distribution, float angle)
+    {
+      float halfRange = distribution.angleRange * .5f;
+      float linearAngle = std::abs(halfRange - angle) / halfRange;
+      return 1.f - smoothstep(.0f, 1.f, std::pow(linearAngle, distribution.anglePower));
+    }
+
+    static const float constAxisOffset = std::sqrt(2.f) * .5f;
+
+    inline float simpleBoltzmannFalloff(float x, float peakX, float falloff)
+    {
+      float xSubstitute = peakX - falloff * constAxisOffset;
+      float innerValue = (x - xSubstitute) / falloff;
+
+      return saturate(innerValue * std::exp(-innerValue * innerValue));
+    }
+
+    // Upper bound of simpleBoltzmannFalloff over a range of its inner value (peaking at sqrt(2) / 2)
+    inline float simpleBoltzmannBound(float innerLow, float innerHigh)
+    {
+      if (innerHigh <= .0f) { return .0f; }
+
+      float inner = innerHigh < constAxisOffset ? innerHigh : std::max(innerLow, constAxisOffset);
+      return saturate(inner * std::exp(-inner * inner));
+    }
+  }
+
+  VolumeGenerator::VolumeGenerator(ThreadPool* threadPool) : pool{ threadPool }, simdLevel{ SIMD::detectLevel() }, useGradientCache{ true }, useSeparable{ true }, emptyDensity{ EMPTY_DENSITY }
+  {
+  }
+
+  void VolumeGenerator::setSIMDLevel(SIMD::Level level)
+  {
+    simdLevel = std::min(level, SIMD::detectLevel());
+    noiseStage.invalidate();
+  }
+
+  void VolumeGenerator::generate(const VolumeInfo& specification, VolumeGrid& grid)
+  {
+    VolumeInfo info = specification.getSnapshot();
+    grid.resize(info.size);
+    if (!grid.getVoxelCount()) { return; }
+
+    VolumeStageHashes hashes = VolumeStageHashes::compute(info);
+
+    // fBM field, by far the most expensive stage
+    if (noiseStage.isDirty(hashes.fbm))
+    {
+      NoiseContext noise;
+      prepareNoise(info, noise);
+
+      noiseField.resize(grid.getVoxelCount());
+      forSlabs(info.size.z, [&](int zBegin, int zEnd) { generateNoiseSlab(info, noise, zBegin, zEnd); });
+      noiseStage.markBuilt(hashes.fbm);
+    }
+
+    // Shape field
+    if (shapeStage.isDirty(hashes.shape))
+    {
+      generateShape(info);
+      shapeStage.markBuilt(hashes.shape);
+    }
+
+    // Combine into the output (always, as the grid belongs to the caller)
+    forSlabs(info.size.z, [&](int zBegin, int zEnd) { combineSlab(info, grid, zBegin, zEnd); });
+  }
+
+  void VolumeGenerator::invalidate()
+  {
+    noiseStage.invalidate();
+    shapeStage.invalidate();
+  }
+
+  void VolumeGenerator::generate(const VolumeInfo& specification, BrickedVolume& volume)
+  {
+    VolumeInfo info = specification.getSnapshot();
+    static constexpr UInt BRICK_VOXELS = BrickedVolume::BRICK_VOXELS;
+
+    volume.reset(info.size);
+    if (!volume.getBrickCount()) { return; }
+
+    // Bounds come from the shape tables whether or not the dense path uses them
+    VolumeStageHashes hashes = VolumeStageHashes::compute(info);
+    if (shapeStage.isDirty(hashes.shape) || heightTerms.size() != size_t(info.size.y))
+    {
+      buildShapeTables(info);
+      shapeStage.markBuilt(hashes.shape);
+    }
+
+    std::vector<UInt> candidates;
+    classifyBricks(info, volume, candidates);
+
+    NoiseContext noise;
+    prepareNoise(info, noise);
+    NoiseKernels::fBMBatch fBMBatch = NoiseKernels::getfBMBatch(simdLevel);
+
+    // Bake every candidate into its own place in the pool
+    std::vector<UInt> pool(candidates.size() * BRICK_VOXELS);
+    std::vector<BrickedVolume::BrickRange> candidateRanges(candidates.size());
+    forSlabs(int(candidates.size()), [&](int begin, int end)
+      {
+        NoiseRow row(BrickedVolume::BRICK_SIZE);
+        for (int i = begin; i < end; ++i)
+        {
+          bakeBrick(info, noise, fBMBatch, volume, candidates[i], row, &pool[size_t(i) * BRICK_VOXELS], candidateRanges[i]);
+        }
+      });
+
+    // Compact, dropping candidates which turned out empty
+    std::vector<UInt> slots(volume.getBrickCount(), BrickedVolume::EMPTY_SLOT);
+    std::vector<BrickedVolume::BrickRange> ranges(volume.getBrickCount(), { .0f, .0f });
+    size_t occupied = 0;
+    for (size_t i = 0; i < candidates.size(); ++i)
+    {
+      if (candidateRanges[i].maxDensity <= emptyDensity) { continue; }
+
+      if (occupied != i)
+      {
+        std::copy(pool.begin() + i * BRICK_VOXELS, pool.begin() + (i + 1) * BRICK_VOXELS, pool.begin() + occupied * BRICK_VOXELS);
+      }
+
+      slots[candidates[i]] = UInt(occupied++);
+      ranges[candidates[i]] = candidateRanges[i];
+    }
+
+    pool.resize(occupied * BRICK_VOXELS); // (not shrunk, which would briefly need both pools)
+    volume.assign(std::move(slots), std::move(ranges), std::move(pool));
+  }
+
+  void VolumeGenerator::forSlabs(int depth, const std::function<void(int, int)>& job) const
+  {
+    if (!pool)
+    {
+      job(0, depth);
+      return;
+    }
+
+    // A few slabs per worker keeps the load balanced as slabs finish unevenly
+    int slabDepth = std::max(1, depth / int(pool->getThreadCount() * 4));
+    UInt slabCount = UInt((depth + slabDepth - 1) / slabDepth);
+    pool->parallelFor(slabCount, [&](UInt slab)
+      {
+        int zBegin = int(slab) * slabDepth;
+        job(zBegin, std::min(zBegin + slabDepth, depth));
+      });
+  }
+
+  void VolumeGenerator::prepareNoise(const VolumeInfo& info, NoiseContext& context) const
+  {
+    // Create the procedural environment - prioritising high precision for fixed point numbers
+    context.world.worldMax[0] = context.world.worldMax[1] = context.world.worldMax[2] = info.worldSize;
+    context.world.fractionBits = 13;
+    context.world.epsilon = 0.000001f;
+
+    // Start the parallel random number sequencer
+    TEA rng;
+    rng.delta = TEA::SALT;
+    rng.seed(info.seed.x, info.seed.y, info.seed.z, info.seed.w);
+    rng.associate(0, 0);
+
+    // Every voxel branches identical octave generators, so branch them once
+    fBM noise;
+    noise.octaves = info.octaves;
+    noise.fracGap = info.fractionalGap;
+    noise.fracIncr = info.fractionalIncrement;
+
+    float fbmScale[3] = { info.fbmScale, info.fbmScale, info.fbmScale };
+    noise.planOctaves(rng, fbmScale, context.octaves);
+    context.fbmOffset[0] = context.fbmOffset[1] = context.fbmOffset[2] = info.fbmOffset;
+
+    // Fetch the location within the texture relative to the centre, per axis
+    int size[3] = { info.size.x, info.size.y, info.size.z };
+    for (UInt axis = 0; axis < 3; ++axis)
+    {
+      context.positions[axis].resize(size[axis]);
+      for (int i = 0; i < size[axis]; ++i)
+      {
+        context.positions[axis][i] = float(i) / float(size[axis]) - .5f;
+      }
+    }
+
+    if (!useGradientCache) { return; }
+
+    // Only cache octaves which fit the budget and evaluate fewer gradients than the direct path
+    size_t voxelCount = size_t(info.size.x) * size_t(info.size.y) * size_t(info.size.z);
+    context.lattices.resize(context.octaves.size());
+    for (size_t i = 0; i < context.octaves.size(); ++i)
+    {
+      size_t corners = GradientLattice::measure(context.octaves[i], context.positions, context.fbmOffset);
+      if (corners <= GRADIENT_CACHE_BUDGET && corners < voxelCount * Perlin::CORNER_COUNT)
+      {
+        context.lattices[i].build(context.octaves[i], context.world, context.positions, context.fbmOffset, pool, simdLevel);
+      }
+    }
+  }
+
+  void VolumeGenerator::generateShape(const VolumeInfo& info)
+  {
+    heightTerms.clear();
+    planeTerms.clear();
+
+    // The shape is a product of terms over y and over (x, z), so evaluate those O(N^2) rather than per voxel
+    if (useSeparable)
+    {
+      buildShapeTables(info);
+    }
+  }
+
+  void VolumeGenerator::buildShapeTables(const VolumeInfo& info)
+  {
+    heightTerms.resize(info.size.y);
+    for (int y = 0; y < info.size.y; ++y)
+    {
+      heightTerms[y] = evaluateHeight(info, y);
+    }
+
+    planeTerms.resize(size_t(info.size.x) * size_t(info.size.z));
+    for (int z = 0; z < info.size.z; ++z)
+    {
+      for (int x = 0; x < info.size.x; ++x)
+      {
+        planeTerms[size_t(x) + size_t(info.size.x) * z] = evaluatePlane(info, x, z);
+      }
+    }
+  }
+
+  VolumeGenerator::HeightTerms VolumeGenerator::evaluateHeight(const VolumeInfo& info, int y)
+  {
+    float cylinderHeight = float(y) / float(info.size.y);
+    float normalisedHeight = cylinderHeight - .5f;
+
+    HeightTerms terms;
+    terms.leadingRadius = haboobRadius(info.radial, cylinderHeight);
+    terms.heightDensity = haboobVerticalFlux(info.distribution, cylinderHeight);
+    terms.angstromBase = std::pow(.5f - normalisedHeight, info.wackyPower);
+    return terms;
+  }
+
+  VolumeGenerator::PlaneTerms VolumeGenerator::evaluatePlane(const VolumeInfo& info, int x, int z)
+  {
+    float cylinderX = 2.f * (float(x) / float(info.size.x)) - 1.f;
+    float cylinderZ = 2.f * (float(z) / float(info.size.z)) - 1.f;
+
+    PlaneTerms terms;
+    terms.radius = std::sqrt(cylinderX * cylinderX + cylinderZ * cylinderZ);
+    float arcAngle = std::atan2(cylinderZ, -cylinderX) + 1.57079632679f;
+    terms.arcDensity = haboobAngularFlux(info.distribution, arcAngle);
+    return terms;
+  }
+
+  void VolumeGenerator::generateNoiseSlab(const VolumeInfo& info, const NoiseContext& context, int zBegin, int zEnd)
+  {
+    const XMINT3& size = info.size;
+    NoiseKernels::fBMBatch fBMBatch = NoiseKernels::getfBMBatch(simdLevel);
+
+    // Noise is evaluated a row at a time so the kernel can fill its lanes
+    NoiseRow row(size.x);
+    for (int z = zBegin; z < zEnd; ++z)
+    {
+      for (int y = 0; y < size.y; ++y)
+      {
+        evaluateNoiseRow(context, fBMBatch, 0, size.x, y, z, row, &noiseField[size_t(size.x) * (size_t(y) + size_t(size.y) * z)]);
+      }
+    }
+  }
+
+  void VolumeGenerator::evaluateNoiseRow(const NoiseContext& context, NoiseKernels::fBMBatch fBMBatch, int xBegin, int count, int y, int z, NoiseRow& row, float* rowNoise)
+  {
+    std::fill(row.y.begin(), row.y.begin() + count, context.positions[1][y]);
+    std::fill(row.z.begin(), row.z.begin() + count, context.positions[2][z]);
+    const float* rowX = context.positions[0].data() + xBegin;
+
+    if (context.lattices.empty())
+    {
+      fBMBatch(context.octaves.data(), UInt(context.octaves.size()), context.world, rowX, row.y.data(), row.z.data(), context.fbmOffset, rowNoise, UInt(count));
+      return;
+    }
+
+    // Accumulate octaves in order, matching fBM::fBMNoise
+    std::fill(rowNoise, rowNoise + count, .0f);
+    for (size_t i = 0; i < context.octaves.size(); ++i)
+    {
+      const fBMOctave& octave = context.octaves[i];
+      const GradientLattice& lattice = context.lattices[i];
+      if (lattice.isBuilt())
+      {
+        for (int x = 0; x < count; ++x)
+        {
+          rowNoise[x] += octave.coefficient * lattice.perlinNoise(UInt(xBegin + x), UInt(y), UInt(z)) * octave.weight;
+        }
+      }
+      else
+      {
+        fBMBatch(&octave, 1, context.world, rowX, row.y.data(), row.z.data(), context.fbmOffset, row.octave.data(), UInt(count));
+        for (int x = 0; x < count; ++x)
+        {
+          rowNoise[x] += row.octave[x];
+        }
+      }
+    }
+  }
+
+  void VolumeGenerator::combineSlab(const VolumeInfo& info, VolumeGrid& grid, int zBegin, int zEnd) const
+  {
+    const XMINT3& size = info.size;
+    for (int z = zBegin; z < zEnd; ++z)
+    {
+      const PlaneTerms* planeRow = useSeparable ? &planeTerms[size_t(size.x) * z] : nullptr;
+      for (int y = 0; y < size.y; ++y)
+      {
+        const float* rowNoise = &noiseField[size_t(size.x) * (size_t(y) + size_t(size.y) * z)];
+        VolumeElement* row = &grid.at(0, y, z);
+        for (int x = 0; x < size.x; ++x)
+        {
+          HeightTerms height = useSeparable ? heightTerms[y] : evaluateHeight(info, y);
+          PlaneTerms plane = useSeparable ? planeRow[x] : evaluatePlane(info, x, z);
+          row[x] = combine(info, height, plane, rowNoise[x]);
+        }
+      }
+    }
+  }
+
+  void VolumeGenerator::classifyBricks(const VolumeInfo& info, const BrickedVolume& volume, std::vector<UInt>& candidates) const
+  {
+    static constexpr int BRICK_SIZE = BrickedVolume::BRICK_SIZE;
+
+    const XMINT3& size = info.size;
+    const XMINT3& counts = volume.getBrickCounts();
+    candidates.clear();
+
+    // The shape can't be bounded without a positive falloff
+    float falloff = info.distribution.falloffScale;
+    if (!(falloff > .0f))
+    {
+      for (UInt brick = 0; brick < volume.getBrickCount(); ++brick) { candidates.push_back(brick); }
+      return;
+    }
+
+    // Furthest the fBM can move the leading edge, with every octave of perlin noise within [-1, 1]
+    fBM noise;
+    noise.octaves = info.octaves;
+    noise.fracGap = info.fractionalGap;
+    noise.fracIncr = info.fractionalIncrement;
+    float edgeShift = std::abs(info.wackyScale) * noise.maxValue();
+
+    // Height term ranges per row of bricks
+    struct RowBound
+    {
+      float maxHeightDensity;
+      float minLeadingRadius;
+      float maxLeadingRadius;
+    };
+
+    std::vector<RowBound> rows(counts.y, { .0f, std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() });
+    for (int y = 0; y < size.y; ++y)
+    {
+      RowBound& row = rows[y / BRICK_SIZE];
+      row.maxHeightDensity = std::max(row.maxHeightDensity, heightTerms[y].heightDensity);
+      row.minLeadingRadius = std::min(row.minLeadingRadius, heightTerms[y].leadingRadius);
+      row.maxLeadingRadius = std::max(row.maxLeadingRadius, heightTerms[y].leadingRadius);
+    }
+
+    // Plane term ranges per column of bricks
+    struct ColumnBound
+    {
+      float maxArcDensity;
+      float minRadius;
+      float maxRadius;
+    };
+
+    std::vector<ColumnBound> columns(size_t(counts.x) * size_t(counts.z), { .0f, std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() });
+    for (int z = 0; z < size.z; ++z)
+    {
+      for (int x = 0; x < size.x; ++x)
+      {
+        const PlaneTerms& plane = planeTerms[size_t(x) + size_t(size.x) * z];
+        ColumnBound& column = columns[size_t(x / BRICK_SIZE) + size_t(counts.x) * (z / BRICK_SIZE)];
+        column.maxArcDensity = std::max(column.maxArcDensity, plane.arcDensity);
+        column.minRadius = std::min(column.minRadius, plane.radius);
+        column.maxRadius = std::max(column.maxRadius, plane.radius);
+      }
+    }
+
+    // Margins cover rounding in the bounds themselves
+    static constexpr float innerMargin = 1e-3f;
+    static constexpr float boundMargin = 1.001f;
+    for (int bz = 0; bz < counts.z; ++bz)
+    {
+      for (int by = 0; by < counts.y; ++by)
+      {
+        const RowBound& row = rows[by];
+        for (int bx = 0; bx < counts.x; ++bx)
+        {
+          const ColumnBound& column = columns[size_t(bx) + size_t(counts.x) * bz];
+
+          // Range of simpleBoltzmannFalloff's inner value across the brick
+          float innerLow = (column.minRadius - edgeShift - (row.maxLeadingRadius - falloff * constAxisOffset)) / falloff - innerMargin;
+          float innerHigh = (column.maxRadius + edgeShift - (row.minLeadingRadius - falloff * constAxisOffset)) / falloff + innerMargin;
+
+          float bound = column.maxArcDensity * simpleBoltzmannBound(innerLow, innerHigh) * row.maxHeightDensity * boundMargin;
+          if (!(bound <= emptyDensity))
+          {
+            candidates.push_back(volume.brickIndex(bx, by, bz));
+          }
+        }
+      }
+    }
+  }
+
+  void VolumeGenerator::bakeBrick(const VolumeInfo& info, const NoiseContext& noise, NoiseKernels::fBMBatch fBMBatch, const BrickedVolume& volume, UInt brick,
+    NoiseRow& row, UInt* out, BrickedVolume::BrickRange& range) const
+  {
+    static constexpr int BRICK_SIZE = BrickedVolume::BRICK_SIZE;
+
+    const XMINT3& size = info.size;
+    const XMINT3& counts = volume.getBrickCounts();
+    int x0 = int(brick % UInt(counts.x)) * BRICK_SIZE;
+    int y0 = int((brick / UInt(counts.x)) % UInt(counts.y)) * BRICK_SIZE;
+    int z0 = int(brick / UInt(counts.x * counts.y)) * BRICK_SIZE;
+    int width = std::min(BRICK_SIZE, size.x - x0);
+
+    // Voxels past the edge of the volume stay zero
+    std::fill(out, out + BrickedVolume::BRICK_VOXELS, 0U);
+    range = { std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+
+    float rowNoise[BRICK_SIZE];
+    for (int z = 0; z < std::min(BRICK_SIZE, size.z - z0); ++z)
+    {
+      const PlaneTerms* planeRow = &planeTerms[size_t(x0) + size_t(size.x) * (z0 + z)];
+      for (int y = 0; y < std::min(BRICK_SIZE, size.y - y0); ++y)
+      {
+        evaluateNoiseRow(noise, fBMBatch, x0, width, y0 + y, z0 + z, row, rowNoise);
+
+        UInt* brickRow = out + BRICK_SIZE * (y + BRICK_SIZE * z);
+        for (int x = 0; x < width; ++x)
+        {
+          VolumeElement element = combine(info, heightTerms[y0 + y], planeRow[x], rowNoise[x]);
+          brickRow[x] = PackedFloat::packR11G11B10(element.density, element.maxDensity, element.angstromExponent);
+
+          float density = PackedFloat::fromSmallFloat<6>(brickRow[x] & 0x7FFU);
+          range.minDensity = std::min(range.minDensity, density);
+          range.maxDensity = std::max(range.maxDensity, density);
+        }
+      }
+    }
+  }
+
+  VolumeElement VolumeGenerator::combine(const VolumeInfo& info, const HeightTerms& height, const PlaneTerms& plane, float fbm)
+  {
+    // Determine where the leading edge lies
+    float radius = plane.radius + info.wackyScale * fbm; // (plus an fBM 'interesting' alteration for exotic outputs)
+    float radialDensity = simpleBoltzmannFalloff(radius, height.leadingRadius, info.distribution.falloffScale);
+
+    VolumeElement element;
+    element.density = plane.arcDensity * radialDensity * height.heightDensity;
+    element.maxDensity = element.density;
+    element.angstromExponent = height.angstromBase + info.wackyScale * fbm;
+    return element;
+  }
+}
@@ -0,0 +1,229 @@
+#include "Rendering/Volume/VolumeMips.h"
+#include "Data/SIMD.h"
+
+#include <algorithm>
+
+#ifdef HABOOB_SIMD_X86
+#include <xmmintrin.h>
+#endif
+
+namespace Haboob
+{
+  namespace VolumeMips
+  {
+    namespace
+    {
+      constexpr int ROW_CHUNK = 64; // Targets reduced per pass through the row scratch
+      constexpr UInt BLOCK_LEVELS = 4; // log2(BLOCK_SIZE)
+
+      // Rows are reduced as flat float streams
+      static_assert(sizeof(VolumeElement) == 3 * sizeof(float), "VolumeElement must be three packed floats");
+
+      // As _mm_max_ps, the second operand when either is NaN
+      inline float maxOf(float a, float b)
+      {
+        return a > b ? a : b;
+      }
+
+      // Reduces count 2x2x2 blocks along a row into out, from the four source rows (y0z0, y1z0, y0z1, y1z1) at the first block
+      // Each float is first combined across the rows, then with its neighbouring element, so the vector and scalar paths agree exactly
+      void reduceRow(const VolumeElement* const rows[4], VolumeElement* out, int count)
+      {
+        float sums[ROW_CHUNK * 6], maxima[ROW_CHUNK * 6];
+        for (int begin = 0; begin < count; begin += ROW_CHUNK)
+        {
+          int chunk = std::min(count - begin, ROW_CHUNK);
+          const float* a = &rows[0][begin * 2].density;
+          const float* b = &rows[1][begin * 2].density;
+          const float* c = &rows[2][begin * 2].density;
+          const float* d = &rows[3][begin * 2].density;
+
+          int floats = chunk * 6;
+          int i = 0;
+#ifdef HABOOB_SIMD_X86
+          for (; i + 4 <= floats; i += 4)
+          {
+            __m128 va = _mm_loadu_ps(a + i), vb = _mm_loadu_ps(b + i), vc = _mm_loadu_ps(c + i), vd = _mm_loadu_ps(d + i);
+            _mm_storeu_ps(sums + i, _mm_add_ps(_mm_add_ps(va, vb), _mm_add_ps(vc, vd)));
+            _mm_storeu_ps(maxima + i, _mm_max_ps(_mm_max_ps(va, vb), _mm_max_ps(vc, vd)));
+          }
+#endif
+          for (; i < floats; ++i)
+          {
+            sums[i] = (a[i] + b[i]) + (c[i] + d[i]);
+            maxima[i] = maxOf(maxOf(a[i], b[i]), maxOf(c[i], d[i]));
+          }
+
+          for (int x = 0; x < chunk; ++x)
+          {
+            const float* sum = sums + x * 6;
+            const float* maximum = maxima + x * 6;
+            out[begin + x] = { (sum[0] + sum[3]) * .125f, maxOf(maximum[1], maximum[4]), (sum[2] + sum[5]) * .125f };
+          }
+        }
+      }
+
+      // Reduces the target texels in [begin, end) from the source (one level finer)
+      void reduceRange(const VolumeGrid& source, VolumeGrid& target, const XMINT3& begin, const XMINT3& end)
+      {
+        const XMINT3& sourceSize = source.getSize();
+        for (int z = begin.z; z < end.z; ++z)
+        {
+          for (int y = begin.y; y < end.y; ++y)
+          {
+            // Clamped at the edges for sizes of 1
+            int y0 = std::min(y * 2, sourceSize.y - 1), y1 = std::min(y * 2 + 1, sourceSize.y - 1);
+            int z0 = std::min(z * 2, sourceSize.z - 1), z1 = std::min(z * 2 + 1, sourceSize.z - 1);
+            const VolumeElement* rows[4] = {
+              &source.at(begin.x * 2, y0, z0), &source.at(begin.x * 2, y1, z0), &source.at(begin.x * 2, y0, z1), &source.at(begin.x * 2, y1, z1) };
+
+            if (sourceSize.x == 1)
+            {
+              // A single column reduces with itself
+              VolumeElement pairs[4][2];
+              const VolumeElement* pairRows[4];
+              for (int i = 0; i < 4; ++i)
+              {
+                pairs[i][0] = pairs[i][1] = *rows[i];
+                pairRows[i] = pairs[i];
+              }
+
+              reduceRow(pairRows, &target.at(0, y, z), 1);
+            }
+            else
+            {
+              reduceRow(rows, &target.at(begin.x, y, z), end.x - begin.x);
+            }
+          }
+        }
+      }
+    }
+
+    UInt getLevelCount(const XMINT3& size)
+    {
+      int smallest = std::min(std::min(size.x, size.y), size.z);
+
+      UInt levels = 0;
+      while (smallest > 1)
+      {
+        smallest >>= 1;
+        ++levels;
+      }
+
+      return std::max(levels, 1U);
+    }
+
+    XMINT3 getLevelSize(const XMINT3& size, UInt level)
+    {
+      return { std::max(size.x >> level, 1), std::max(size.y >> level, 1), std::max(size.z >> level, 1) };
+    }
+
+    void downsample(const VolumeGrid& source, VolumeGrid& target)
+    {
+      target.resize(getLevelSize(source.getSize(), 1));
+      reduceRange(source, target, { 0, 0, 0 }, target.getSize());
+    }
+
+    void buildChain(const VolumeGrid& source, std::vector<VolumeGrid>& mips, UInt levelCount, ThreadPool* pool)
+    {
+      const XMINT3& size = source.getSize();
+      levelCount = std::max(std::min(levelCount, getLevelCount(size)), 1U);
+
+      mips.resize(levelCount - 1);
+      for (UInt level = 1; level < levelCount; ++level)
+      {
+        mips[level - 1].resize(getLevelSize(size, level));
+      }
+
+      // Blocks span whole rows so the source streams in, and every level in the chain is at least 2 texels across so no block reads outside itself
+      UInt blockLevels = std::min(levelCount - 1, BLOCK_LEVELS);
+      int blocksY = (size.y + BLOCK_SIZE - 1) / BLOCK_SIZE, blocksZ = (size.z + BLOCK_SIZE - 1) / BLOCK_SIZE;
+      auto reduceBlock = [&](UInt index)
+        {
+          int blockY = int(index % UInt(blocksY)), blockZ = int(index / UInt(blocksY));
+          for (UInt level = 1; level <= blockLevels; ++level)
+          {
+            VolumeGrid& target = mips[level - 1];
+            const XMINT3& targetSize = target.getSize();
+            XMINT3 begin = { 0, (blockY * BLOCK_SIZE) >> level, (blockZ * BLOCK_SIZE) >> level };
+            XMINT3 end = { targetSize.x, std::min(((blockY + 1) * BLOCK_SIZE) >> level, targetSize.y), std::min(((blockZ + 1) * BLOCK_SIZE) >> level, targetSize.z) };
+
+            if (begin.y < end.y && begin.z < end.z)
+            {
+              reduceRange(level == 1 ? source : mips[level - 2], target, begin, end);
+            }
+          }
+        };
+
+      UInt blockCount = UInt(blocksY * blocksZ);
+      if (pool) { pool->parallelFor(blockCount, reduceBlock); }
+      else
+      {
+        for (UInt index = 0; index < blockCount; ++index) { reduceBlock(index); }
+      }
+
+      // The remaining levels hold at most 1/4096 of the source
+      for (UInt level = blockLevels + 1; level < levelCount; ++level)
+      {
+        reduceRange(mips[level - 2], mips[level - 1], { 0, 0, 0 }, mips[level - 1].getSize());
+      }
+    }
+
+    XMINT3 getMacroCellCounts(const XMINT3& size)
+    {
+      return { (size.x + MACRO_CELL_SIZE - 1) / MACRO_CELL_SIZE, (size.y + MACRO_CELL_SIZE - 1) / MACRO_CELL_SIZE, (size.z + MACRO_CELL_SIZE - 1) / MACRO_CELL_SIZE };
+    }
+
+    void buildMacroCells(const VolumeGrid& source, const std::vector<VolumeGrid>& mips, std::vector<float>& cells, ThreadPool* pool)
+    {
+      XMINT3 counts = getMacroCellCounts(source.getSize());
+      UInt levelCount = UInt(mips.size()) + 1;
+      cells.assign(size_t(counts.x) * size_t(counts.y) * size_t(counts.z) * levelCount, .0f);
+
+      // A slice of cells at a time
+      auto buildSlice = [&](UInt cellZ)
+        {
+          for (int cellY = 0; cellY < counts.y; ++cellY)
+          {
+            for (int cellX = 0; cellX < counts.x; ++cellX)
+            {
+              const int cell[3] = { cellX, cellY, int(cellZ) };
+              float* values = cells.data() + (size_t(cellX) + size_t(counts.x) * (size_t(cellY) + size_t(counts.y) * size_t(cellZ))) * levelCount;
+              for (UInt level = 0; level < levelCount; ++level)
+              {
+                // The level's texels touching the grown cell, clamped to the level
+                const VolumeGrid& grid = level == 0 ? source : mips[level - 1];
+                const int extent[3] = { grid.getSize().x, grid.getSize().y, grid.getSize().z };
+                int begin[3], end[3];
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                  begin[axis] = std::max(cell[axis] * MACRO_CELL_SIZE - (1 << level), 0) >> level;
+                  end[axis] = std::min(((cell[axis] + 1) * MACRO_CELL_SIZE - 1 + (1 << level)) >> level, extent[axis] - 1);
+                }
+
+                float maximum = .0f;
+                for (int z = begin[2]; z <= end[2]; ++z)
+                {
+                  for (int y = begin[1]; y <= end[1]; ++y)
+                  {
+                    for (int x = begin[0]; x <= end[0]; ++x)
+                    {
+                      const VolumeElement& element = grid.at(x, y, z);
+                      maximum = std::max(maximum, std::max(element.density, element.maxDensity));
+                    }
+                  }
+                }
+                values[level] = maximum;
+              }
+            }
+          }
+        };
+
+      if (pool) { pool->parallelFor(UInt(counts.z), buildSlice); }
+      else
+      {
+        for (UInt cellZ = 0; cellZ < UInt(counts.z); ++cellZ) { buildSlice(cellZ); }
+      }
+    }
+  }
+}
@@ -0,0 +1,50 @@
+#include "Rendering/Volume/VolumeStages.h"
+
+namespace Haboob
+{
+  namespace
+  {
+    void addSize(Hasher& hasher, const VolumeInfo& info)
+    {
+      hasher.add(info.size.x).add(info.size.y).add(info.size.z);
+    }
+  }
+
+  VolumeStageHashes VolumeStageHashes::compute(const VolumeInfo& specification)
+  {
+    // Time only matters through the parameters it moves
+    VolumeInfo info = specification.getSnapshot();
+    VolumeStageHashes hashes;
+
+    {
+      Hasher hasher;
+      addSize(hasher, info);
+      hasher.add(info.seed.x).add(info.seed.y).add(info.seed.z).add(info.seed.w);
+      hasher.add(info.worldSize).add(info.octaves).add(info.fractionalGap).add(info.fractionalIncrement);
+      hasher.add(info.fbmOffset).add(info.fbmScale);
+      hashes.fbm = hasher.get();
+    }
+
+    {
+      const HaboobRadial& radial = info.radial;
+      const HaboobDistribution& distribution = info.distribution;
+
+      Hasher hasher;
+      addSize(hasher, info);
+      hasher.add(radial.roofGradient).add(radial.exponentialRate).add(radial.exponentialScale).add(radial.rOffset);
+      hasher.add(radial.noseHeight).add(radial.blendHeight).add(radial.blendRate);
+      hasher.add(distribution.heightScale).add(distribution.heightExponent).add(distribution.angleRange).add(distribution.anglePower);
+      hasher.add(info.wackyPower);
+      hashes.shape = hasher.get();
+    }
+
+    {
+      Hasher hasher;
+      hasher.add(hashes.fbm).add(hashes.shape);
+      hasher.add(info.distribution.falloffScale).add(info.wackyScale);
+      hashes.combine = hasher.get();
+    }
+
+    return hashes;
+  }
+}
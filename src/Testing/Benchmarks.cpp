@@ -0,0 +1,676 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include "Data/PackedFloatKernels.h"
+#include "Rendering/Raymarch/RayExtents.h"
+#include "Rendering/Raymarch/ReferenceMarcher.h"
+#include "Rendering/Raymarch/SpectralOptics.h"
+#include "Rendering/Volume/VolumeAnimator.h"
+#include "Rendering/Volume/VolumeCache.h"
+#include "Rendering/Volume/VolumeGenerator.h"
+#include "Rendering/Volume/VolumeMips.h"
+
+// Benchmarks are hidden from the default run, use BenchApp "[bench]"
+using namespace Haboob;
+
+namespace
+{
+  // Returns the seconds taken by the best of a few runs of a job
+  template<typename T> double bestTime(UInt runs, T job)
+  {
+    double best = 0.;
+    for (UInt i = 0; i < runs; ++i)
+    {
+      auto start = std::chrono::steady_clock::now();
+      job();
+      double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      best = i == 0 ? elapsed : std::min(best, elapsed);
+    }
+
+    return best;
+  }
+
+  // The default haboob with the screen as world space looking down +z, the volume cube filling it
+  struct MarchScene
+  {
+    MarchScene()
+    {
+      VolumeGenerator().generate(info, grid);
+
+      XMFLOAT4X4 identity = { 1.f, .0f, .0f, .0f, .0f, 1.f, .0f, .0f, .0f, .0f, 1.f, .0f, .0f, .0f, .0f, 1.f };
+      XMFLOAT4X4 pushBack = { .5f, .0f, .0f, .0f, .0f, .5f, .0f, .0f, .0f, .0f, 1.f, .0f, .0f, .0f, -.5f, 1.f };
+      camera.inverseViewProjectionMatrix = XMLoadFloat4x4(&identity);
+      light.ambient = { .96f, .92f, .14f };
+
+      marchInfo.texelDensity = float(info.size.x);
+      marchInfo.localVolumeTransform = XMLoadFloat4x4(&pushBack);
+      marchInfo.volumeSize = { 1.f, 1.f, 1.f };
+
+      optics.anisotropicForwardTerms = { .735f, .732f, .651f, .735f };
+      optics.anisotropicBackwardTerms = { -.6f, -.732f, -.651f, -.735f };
+      optics.phaseBlendWeightTerms = { .17f, .11f, .2f, .2f, };
+      optics.scatterAngstromExponent = 2.1f;
+      optics.ambientFraction = { .8f, 1.f, 1.f, 1.f, };
+      optics.absorptionAngstromExponent = 2.3f;
+      optics.powderCoefficient = .035f;
+      optics.attenuationFactor = 16.1f;
+      SpectralOptics::buildMatrices(optics);
+    }
+
+    // Rays are parallel, so the cone is a pixel across throughout
+    void coneAcrossPixels(UInt size)
+    {
+      marchInfo.pixelRadius = std::sqrt(2.f) / float(size);
+      marchInfo.pixelRadiusDelta = .0f;
+    }
+
+    void render(const ReferenceMarcher& marcher, HDRImage& image, uint64_t* sampleCount = nullptr)
+    {
+      marcher.render(camera, light, marchInfo, optics, image, sampleCount);
+    }
+
+    VolumeInfo info;
+    VolumeGrid grid;
+    CameraPack camera;
+    DirectionalLightPack light;
+    MarchVolumeDispatchInfo marchInfo;
+    BasicOptics optics;
+  };
+
+  // Over every channel of every pixel
+  double rmse(const HDRImage& reference, const HDRImage& image)
+  {
+    double squaredError = .0;
+    size_t count = size_t(reference.getWidth()) * size_t(reference.getHeight());
+    for (size_t i = 0; i < count; ++i)
+    {
+      const float* a = &reference.getData()[i].x;
+      const float* b = &image.getData()[i].x;
+      for (int channel = 0; channel < 4; ++channel) { squaredError += double(a[channel] - b[channel]) * double(a[channel] - b[channel]); }
+    }
+
+    return std::sqrt(squaredError / double(4 * count));
+  }
+}
+
+TEST_CASE("CPU volume generation scaling", "[.][bench][volume]")
+{
+  VolumeInfo info;
+  info.size = { 256, 256, 256 };
+
+  VolumeGrid grid;
+  UInt maxThreads = std::max(1U, std::thread::hardware_concurrency());
+
+  // Powers of two, finishing on every hardware thread
+  std::vector<UInt> threadCounts;
+  for (UInt threads = 1; threads < maxThreads; threads *= 2) { threadCounts.push_back(threads); }
+  threadCounts.push_back(maxThreads);
+
+  std::printf("threads,voxels,seconds,voxelsPerSecond\n");
+  for (UInt threads : threadCounts)
+  {
+    ThreadPool pool(threads);
+    VolumeGenerator generator(&pool);
+
+    double seconds = bestTime(3, [&]() { generator.invalidate(); generator.generate(info, grid); }); // Every run bakes every stage
+    std::printf("%u,%llu,%.4f,%.0f\n", threads, (unsigned long long)grid.getVoxelCount(), seconds, double(grid.getVoxelCount()) / seconds);
+  }
+}
+
+TEST_CASE("fBM kernel throughput", "[.][bench][noise]")
+{
+  VolumeInfo info;
+  info.size = { 64, 64, 64 };
+
+  ThreadPool pool(1);
+  VolumeGenerator generator(&pool);
+  generator.setGradientCache(false);
+  VolumeGrid grid;
+
+  // Single threaded so the kernels are compared directly
+  std::printf("kernel,voxels,seconds,voxelsPerSecond\n");
+  SIMD::Level supported = SIMD::detectLevel();
+  for (Byte level = SIMD::LEVEL_SCALAR; level <= supported; ++level)
+  {
+    generator.setSIMDLevel(SIMD::Level(level));
+    double seconds = bestTime(3, [&]() { generator.invalidate(); generator.generate(info, grid); }); // Every run bakes every stage
+    std::printf("%s,%llu,%.4f,%.0f\n", SIMD::getLevelName(SIMD::Level(level)), (unsigned long long)grid.getVoxelCount(), seconds, double(grid.getVoxelCount()) / seconds);
+  }
+}
+
+TEST_CASE("Gradient lattice cache speedup", "[.][bench][noise]")
+{
+  VolumeInfo info; // Default octaves = 3.1
+  VolumeGrid grid;
+
+  ThreadPool pool;
+  VolumeGenerator generator(&pool);
+
+  std::printf("size,directSeconds,cachedSeconds,speedup\n");
+  for (int size : { 128, 256, 512 })
+  {
+    info.size = { size, size, size };
+
+    generator.setGradientCache(false);
+    double direct = bestTime(1, [&]() { generator.generate(info, grid); });
+    generator.setGradientCache(true);
+    double cached = bestTime(1, [&]() { generator.generate(info, grid); });
+
+    std::printf("%d,%.4f,%.4f,%.2f\n", size, direct, cached, direct / cached);
+  }
+}
+
+TEST_CASE("Volume cache warm start", "[.][bench][cache]")
+{
+  VolumeInfo info;
+  VolumeGrid grid;
+
+  ThreadPool pool;
+  VolumeGenerator generator(&pool);
+  VolumeCache cache(std::filesystem::temp_directory_path() / "HaboobVolumeCacheBench");
+
+  std::printf("size,bakeSeconds,storeSeconds,loadSeconds\n");
+  for (int size : { 64, 128, 256 })
+  {
+    info.size = { size, size, size };
+    uint64_t key = VolumeCache::getKey(info);
+
+    // Cold start bakes every stage, a warm start maps and verifies the file
+    double bake = bestTime(1, [&]() { generator.invalidate(); generator.generate(info, grid); });
+    double store = bestTime(1, [&]() { cache.store(key, grid); });
+    CachedVolume volume;
+    double load = bestTime(3, [&]() { cache.load(key, volume); });
+
+    std::printf("%d,%.4f,%.4f,%.4f\n", size, bake, store, load);
+  }
+
+  cache.clear();
+}
+
+TEST_CASE("Bricked volume bake", "[.][bench][bricks]")
+{
+  VolumeInfo info;
+  VolumeGrid grid;
+  BrickedVolume bricked;
+
+  ThreadPool pool;
+  VolumeGenerator generator(&pool);
+
+  // The dense grid is skipped past 256^3 (12 bytes per voxel)
+  std::printf("size,denseSeconds,brickedSeconds,occupiedBricks,denseBytes,brickedBytes\n");
+  for (int size : { 128, 256, 512, 1024 })
+  {
+    info.size = { size, size, size };
+
+    double dense = .0;
+    size_t denseBytes = size_t(size) * size_t(size) * size_t(size) * sizeof(VolumeElement);
+    if (size <= 256)
+    {
+      dense = bestTime(1, [&]() { generator.invalidate(); generator.generate(info, grid); });
+      grid = VolumeGrid();
+    }
+
+    double sparse = bestTime(1, [&]() { generator.generate(info, bricked); });
+    std::printf("%d,%.4f,%.4f,%.3f,%llu,%llu\n", size, dense, sparse, double(bricked.getOccupiedCount()) / double(bricked.getBrickCount()),
+      (unsigned long long)denseBytes, (unsigned long long)bricked.getMemoryUsage());
+  }
+}
+
+TEST_CASE("R11G11B10 codec throughput", "[.][bench][packing]")
+{
+  // A 256^3 volume of plausible densities, large enough to stream from memory
+  constexpr size_t count = 256 * 256 * 256;
+  std::vector<float> rgb(count * 3), unpacked(count * 3);
+  std::vector<UInt> packed(count);
+  for (size_t i = 0; i < rgb.size(); ++i) { rgb[i] = float(i % 4093) / 1024.f; }
+
+  // Bytes are counted on both sides, floats read and texels written (or the reverse)
+  double bytes = double(count) * (3 * sizeof(float) + sizeof(UInt));
+
+  std::printf("kernel,texels,packGBPerSecond,unpackGBPerSecond\n");
+  SIMD::Level supported = SIMD::detectLevel();
+  for (Byte level = SIMD::LEVEL_SCALAR; level <= supported; ++level)
+  {
+    PackedFloat::PackBatch pack = PackedFloat::getPackBatch(SIMD::Level(level));
+    PackedFloat::UnpackBatch unpack = PackedFloat::getUnpackBatch(SIMD::Level(level));
+
+    double packSeconds = bestTime(5, [&]() { pack(rgb.data(), packed.data(), count); });
+    double unpackSeconds = bestTime(5, [&]() { unpack(packed.data(), unpacked.data(), count); });
+    std::printf("%s,%llu,%.2f,%.2f\n", SIMD::getLevelName(SIMD::Level(level)), (unsigned long long)count, bytes / packSeconds * 1e-9, bytes / unpackSeconds * 1e-9);
+  }
+}
+
+TEST_CASE("Mip chain build", "[.][bench][mips]")
+{
+  VolumeInfo info;
+  info.size = { 256, 256, 256 };
+  VolumeGrid grid;
+
+  ThreadPool pool;
+  VolumeGenerator(&pool).generate(info, grid);
+  UInt levelCount = VolumeMips::getLevelCount(info.size);
+
+  // Level by level through whole grids, against the blocked chain on one thread and on the pool
+  VolumeGrid mip, nextMip;
+  std::vector<VolumeGrid> mips;
+  double levelwise = bestTime(3, [&]()
+    {
+      VolumeMips::downsample(grid, mip);
+      for (UInt level = 2; level < levelCount; ++level)
+      {
+        VolumeMips::downsample(mip, nextMip);
+        std::swap(mip, nextMip);
+      }
+    });
+  double serial = bestTime(3, [&]() { VolumeMips::buildChain(grid, mips, levelCount); });
+  double pooled = bestTime(3, [&]() { VolumeMips::buildChain(grid, mips, levelCount, &pool); });
+
+  std::printf("threads,levels,levelwiseSeconds,chainSeconds,pooledSeconds,pooledGBPerSecond\n");
+  std::printf("%u,%u,%.4f,%.4f,%.4f,%.2f\n", pool.getThreadCount(), levelCount, levelwise, serial, pooled,
+    double(grid.getVoxelCount() * sizeof(VolumeElement)) / pooled * 1e-9);
+}
+
+TEST_CASE("Animated sequence step cost", "[.][bench][motion]")
+{
+  VolumeInfo info;
+  info.size = { 128, 128, 128 };
+
+  ThreadPool pool;
+  VolumeAnimator animator(&pool);
+  constexpr UInt frames = 16;
+
+  // Per frame cost of a fixed step sequence, against the longest the caller is blocked by a swap when overlapped
+  std::printf("frames,secondsPerFrame,longestSwapSeconds\n");
+  double sequence = bestTime(1, [&]()
+    {
+      for (UInt frame = 0; frame < frames; ++frame)
+      {
+        info.motion.time = float(frame) / 30.f;
+        animator.request(info);
+        animator.wait();
+        animator.swap();
+      }
+    });
+
+  double longestSwap = .0;
+  for (UInt frame = 0; frame < frames; ++frame)
+  {
+    info.motion.time = float(frames + frame) / 30.f;
+    animator.request(info);
+    longestSwap = std::max(longestSwap, bestTime(1, [&]() { animator.swap(); }));
+    animator.wait();
+  }
+
+  std::printf("%u,%.4f,%.6f\n", frames, sequence / double(frames), longestSwap);
+}
+
+TEST_CASE("Reference march throughput", "[.][bench][reference]")
+{
+  MarchScene scene;
+  ThreadPool pool;
+  ReferenceMarcher marcher(&pool);
+  scene.marchInfo.iterations = 52;
+
+  HDRImage image;
+  image.resize(256, 256);
+
+  // Scalar against packets of 4, 8 and 16 rays, over either volume layout
+  std::printf("threads,layout,level,spectral,seconds,raySteps/s\n");
+  for (MarchKernels::VolumeLevels::Layout layout : { MarchKernels::VolumeLevels::LAYOUT_LINEAR, MarchKernels::VolumeLevels::LAYOUT_TILED })
+  {
+    marcher.setVolume(scene.grid, layout);
+    for (Byte level = SIMD::LEVEL_SCALAR; level <= SIMD::detectLevel(); ++level)
+    {
+      marcher.setSIMDLevel(SIMD::Level(level));
+      for (UInt spectral : { 1U, 0U })
+      {
+        scene.optics.flagApplySpectral = spectral;
+        double seconds = bestTime(3, [&]() { scene.render(marcher, image); });
+        std::printf("%u,%s,%s,%u,%.4f,%.0f\n", pool.getThreadCount(), layout == MarchKernels::VolumeLevels::LAYOUT_TILED ? "tiled" : "linear",
+          SIMD::getLevelName(SIMD::Level(level)), spectral, seconds, 256. * 256. * double(scene.marchInfo.iterations) / seconds);
+      }
+    }
+  }
+}
+
+TEST_CASE("Empty space skipping error", "[.][bench][skip]")
+{
+  MarchScene scene;
+  scene.coneAcrossPixels(256);
+  ThreadPool pool;
+  ReferenceMarcher marcher(&pool);
+  marcher.setVolume(scene.grid);
+
+  // Ground truth from many steps without skipping
+  HDRImage reference, image;
+  reference.resize(256, 256);
+  image.resize(256, 256);
+  scene.marchInfo.iterations = 1024;
+  scene.render(marcher, reference);
+
+  std::printf("skip,iterations,seconds,samples/ray,rmse\n");
+  for (bool skip : { false, true })
+  {
+    marcher.getSettings().skipEmpty = skip;
+    for (UInt iterations : { 13U, 26U, 52U, 104U })
+    {
+      scene.marchInfo.iterations = iterations;
+      uint64_t samples = 0;
+      double seconds = bestTime(3, [&]() { scene.render(marcher, image, &samples); });
+      std::printf("%u,%u,%.4f,%.2f,%.6f\n", UInt(skip), iterations, seconds, double(samples) / (256. * 256.), rmse(reference, image));
+    }
+  }
+}
+
+TEST_CASE("Adaptive march convergence", "[.][bench][adaptive]")
+{
+  MarchScene scene;
+  scene.coneAcrossPixels(256);
+  ThreadPool pool;
+  ReferenceMarcher marcher(&pool);
+  marcher.setVolume(scene.grid);
+
+  HDRImage reference, image;
+  reference.resize(256, 256);
+  image.resize(256, 256);
+
+  // Adaptive rays take their steps about the uniform step of the same iteration count
+  // The denser volume is as thick as the app's 4 unit cube
+  std::printf("adaptive,attenuation,iterations,seconds,samples/ray,rmse\n");
+  for (float attenuation : { 16.1f, 64.4f })
+  {
+    // Ground truth from many uniform steps
+    scene.optics.attenuationFactor = attenuation;
+    scene.marchInfo.iterations = 1024;
+    marcher.getSettings().marchAdaptive = false;
+    scene.render(marcher, reference);
+
+    for (bool adaptive : { false, true })
+    {
+      marcher.getSettings().marchAdaptive = adaptive;
+      for (UInt iterations : { 13U, 26U, 52U, 104U })
+      {
+        scene.marchInfo.iterations = iterations;
+        uint64_t samples = 0;
+        double seconds = bestTime(3, [&]() { scene.render(marcher, image, &samples); });
+        std::printf("%u,%.1f,%u,%.4f,%.2f,%.6f\n", UInt(adaptive), attenuation, iterations, seconds, double(samples) / (256. * 256.), rmse(reference, image));
+      }
+    }
+  }
+}
+
+TEST_CASE("Progressive march convergence", "[.][bench][progressive]")
+{
+  MarchScene scene;
+  scene.coneAcrossPixels(256);
+  ThreadPool pool;
+  ReferenceMarcher marcher(&pool);
+  marcher.setVolume(scene.grid);
+
+  HDRImage reference, image, average;
+  reference.resize(256, 256);
+  image.resize(256, 256);
+  scene.marchInfo.iterations = 128;
+  scene.render(marcher, reference);
+
+  // Targets are what single frames of a quarter and half the reference's steps reach
+  const UInt targetSteps[2] = { 32, 64 };
+  double targets[2];
+  for (UInt t = 0; t < 2; ++t)
+  {
+    scene.marchInfo.iterations = targetSteps[t];
+    scene.render(marcher, image);
+    targets[t] = rmse(reference, image);
+  }
+
+  // Frame 0 has no jitter, as the fixed start it replaces
+  const UInt maxFrames = 64;
+  const UInt frameSteps[2] = { 8, 16 };
+  UInt framesToTarget[2][2] = {};
+  double msPerFrame[2];
+  std::printf("iterations,frames,msPerFrame,rmse\n");
+  for (UInt f = 0; f < 2; ++f)
+  {
+    scene.marchInfo.iterations = frameSteps[f];
+    double totalSeconds = .0;
+    for (UInt frame = 0; frame < maxFrames; ++frame)
+    {
+      marcher.getSettings().jitter = frame > 0;
+      marcher.getSettings().frame = frame;
+      totalSeconds += bestTime(1, [&]() { scene.render(marcher, image); average.accumulate(image, frame); });
+
+      double error = rmse(reference, average);
+      for (UInt t = 0; t < 2; ++t)
+      {
+        if (framesToTarget[f][t] == 0 && error <= targets[t]) { framesToTarget[f][t] = frame + 1; }
+      }
+      if ((frame & (frame + 1)) == 0) { std::printf("%u,%u,%.3f,%.6f\n", frameSteps[f], frame + 1, 1e3 * totalSeconds / double(frame + 1), error); }
+    }
+    msPerFrame[f] = 1e3 * totalSeconds / double(maxFrames);
+  }
+  marcher.getSettings().jitter = false;
+
+  // 0 frames when the target was not reached within maxFrames
+  std::printf("iterations,targetIterations,targetRMSE,framesToTarget,msToTarget\n");
+  for (UInt f = 0; f < 2; ++f)
+  {
+    for (UInt t = 0; t < 2; ++t)
+    {
+      std::printf("%u,%u,%.6f,%u,%.3f\n", frameSteps[f], targetSteps[t], targets[t], framesToTarget[f][t], double(framesToTarget[f][t]) * msPerFrame[f]);
+    }
+  }
+}
+
+TEST_CASE("Spectral transmission lookup", "[.][bench][lut]")
+{
+  MarchScene scene;
+  scene.coneAcrossPixels(256);
+
+  // The table against the analytic transmissions over its whole range, and past both ends of depth
+  SpectralOptics::TransmissionLUT lut;
+  double buildSeconds = bestTime(3, [&]() { SpectralOptics::buildTransmissionLUT(scene.optics, lut); });
+  double maxError = .0, totalError = .0;
+  size_t count = 0;
+  float result[16];
+  for (float logDepth = -24.f; logDepth < 8.f; logDepth += .0377f)
+  {
+    for (float angstrom = .0f; angstrom < lut.maxAngstrom; angstrom += .0519f)
+    {
+      lut.lookup(std::exp2(logDepth), angstrom, result);
+      for (int i = 0; i < 16; ++i)
+      {
+        float opticalDepth = std::exp2(logDepth) * std::pow(scene.optics.spectralWavelengths.m[i / 4][i % 4] / scene.optics.referenceWavelength, -angstrom);
+        double error = std::abs(double(result[i]) - (std::exp(-double(opticalDepth)) - std::exp(-double(scene.optics.powderCoefficient * opticalDepth))));
+        maxError = std::max(maxError, error);
+        totalError += error;
+        ++count;
+      }
+    }
+  }
+  std::printf("depthSize,angstromSize,buildMs,maxError,meanError\n");
+  std::printf("%u,%u,%.3f,%.6f,%.7f\n", SpectralOptics::TransmissionLUT::DEPTH_SIZE, SpectralOptics::TransmissionLUT::ANGSTROM_SIZE, 1e3 * buildSeconds,
+    maxError, totalError / double(count));
+
+  // Renders with the table against the analytic path, per kernel, with the constant light term and with a light march (two lookups per step)
+  ThreadPool pool;
+  ReferenceMarcher marcher(&pool);
+  marcher.setVolume(scene.grid);
+  scene.marchInfo.iterations = 52;
+
+  HDRImage analytic, image;
+  analytic.resize(256, 256);
+  image.resize(256, 256);
+  std::printf("level,lightIterations,analyticNsPerStep,lutNsPerStep,speedup,rmse\n");
+  for (Byte level = SIMD::LEVEL_SCALAR; level <= SIMD::detectLevel(); ++level)
+  {
+    marcher.setSIMDLevel(SIMD::Level(level));
+    for (UInt lightIterations : { 0U, 3U })
+    {
+      marcher.getSettings().lightIterations = lightIterations;
+      double seconds[2];
+      for (bool useLUT : { false, true })
+      {
+        marcher.getSettings().transmissionLUT = useLUT;
+        seconds[useLUT] = bestTime(3, [&]() { scene.render(marcher, useLUT ? image : analytic); });
+      }
+
+      double steps = 256. * 256. * double(scene.marchInfo.iterations);
+      std::printf("%s,%u,%.2f,%.2f,%.2f,%.7f\n", SIMD::getLevelName(SIMD::Level(level)), lightIterations, 1e9 * seconds[0] / steps, 1e9 * seconds[1] / steps,
+        seconds[0] / seconds[1], rmse(analytic, image));
+    }
+  }
+}
+
+TEST_CASE("Analytic ray extents against rasterising", "[.][bench][rays]")
+{
+  // The screen as world space, the cube held within the middle of it (and of depth) with scene geometry hiding a corner
+  RayExtents::View view;
+  XMFLOAT4X4 identity = { 1.f, .0f, .0f, .0f, .0f, 1.f, .0f, .0f, .0f, .0f, 1.f, .0f, .0f, .0f, .0f, 1.f };
+  view.viewProjection = view.inverseViewProjection = identity;
+  view.volumeTransform = { 1.f / .7f, .0f, .0f, .0f, .0f, 1.f / .7f, .0f, .0f, .0f, .0f, .8f, .0f, .0f, .0f, .5f, 1.f };
+  view.localTransform = { .7f, .0f, .0f, .0f, .0f, .7f, .0f, .0f, .0f, .0f, 1.25f, .0f, .0f, .0f, -.625f, 1.f };
+  view.cameraPosition[0] = view.cameraPosition[1] = .0f;
+  view.cameraPosition[2] = -10.f;
+
+  ThreadPool pool;
+  std::printf("width,height,threads,traceMs,rasteriseMs,speedup\n");
+  for (UInt size : { 256U, 1024U })
+  {
+    UInt width = size * 16 / 9, height = size;
+    std::vector<float> sceneDepth(size_t(width) * height, 1.f);
+    for (UInt y = height / 2; y < height; ++y) { std::fill_n(&sceneDepth[size_t(width) * y], width / 2, .5f); }
+
+    HDRImage traced, rasterised;
+    traced.resize(width, height);
+    rasterised.resize(width, height);
+    for (ThreadPool* threads : { (ThreadPool*)nullptr, &pool })
+    {
+      double traceSeconds = bestTime(5, [&]() { RayExtents::trace(view, sceneDepth.data(), traced, threads); });
+      double rasteriseSeconds = bestTime(5, [&]() { RayExtents::rasterise(view, sceneDepth.data(), rasterised, threads); });
+      std::printf("%u,%u,%u,%.3f,%.3f,%.2f\n", width, height, threads ? threads->getThreadCount() : 1, 1e3 * traceSeconds, 1e3 * rasteriseSeconds,
+        rasteriseSeconds / traceSeconds);
+    }
+  }
+}
+
+TEST_CASE("Compacted tile scheduling", "[.][bench][tiles]")
+{
+  MarchScene scene;
+  scene.coneAcrossPixels(256);
+  scene.marchInfo.iterations = 52;
+
+  ThreadPool pool;
+  ReferenceMarcher marcher(&pool);
+  marcher.setVolume(scene.grid);
+
+  // The cube shrunk about the middle of the screen to cover a fraction of it
+  HDRImage image;
+  image.resize(256, 256);
+  XMFLOAT4X4 pushBack;
+  XMStoreFloat4x4(&pushBack, scene.marchInfo.localVolumeTransform);
+  std::printf("coverage,activeTiles,everyTileMs,compactedMs,speedup\n");
+  for (float coverage : { 1.f, .5f, .2f, .05f })
+  {
+    XMFLOAT4X4 shrunk = pushBack;
+    shrunk.m[0][0] = shrunk.m[1][1] = pushBack.m[0][0] / std::sqrt(coverage);
+    scene.marchInfo.localVolumeTransform = XMLoadFloat4x4(&shrunk);
+
+    XMFLOAT4X4 inverseViewProjection;
+    XMStoreFloat4x4(&inverseViewProjection, scene.camera.inverseViewProjectionMatrix);
+    std::vector<UInt> tiles;
+    RayExtents::findActiveTiles(inverseViewProjection, shrunk, 256, 256, marcher.getSettings().tileSize, tiles);
+
+    double seconds[2];
+    for (bool compact : { false, true })
+    {
+      marcher.getSettings().compactTiles = compact;
+      seconds[compact] = bestTime(3, [&]() { scene.render(marcher, image); });
+    }
+    std::printf("%.2f,%zu,%.2f,%.2f,%.2f\n", coverage, tiles.size(), 1e3 * seconds[0], 1e3 * seconds[1], seconds[0] / seconds[1]);
+  }
+}
+
+TEST_CASE("Volume layout sampling locality", "[.][bench][layout]")
+{
+  VolumeInfo info;
+  VolumeGrid grid;
+  VolumeGenerator().generate(info, grid);
+  std::vector<VolumeGrid> mips;
+  VolumeMips::buildChain(grid, mips, VolumeMips::getLevelCount(grid.getSize()));
+
+  // Rays of half texel steps from the middle of the volume, in ray order
+  const UInt rayCount = 4096, steps = 64;
+  const float directions[4][3] = { { 1.f, .0f, .0f }, { .0f, 1.f, .0f }, { .0f, .0f, 1.f }, { .577f, .577f, .577f } };
+  const char* directionNames[4] = { "x", "y", "z", "oblique" };
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> distribution(.25f, .75f);
+  std::vector<float> origins(3 * rayCount);
+  for (float& origin : origins) { origin = distribution(random); }
+
+  // Lines and pages are counted from the texel addresses (a model of the misses rather than hardware counters)
+  std::printf("layout,direction,samples/s,lines/fetch,newLines/fetch,pages/fetch\n");
+  for (MarchKernels::VolumeLevels::Layout layout : { MarchKernels::VolumeLevels::LAYOUT_LINEAR, MarchKernels::VolumeLevels::LAYOUT_TILED })
+  {
+    MarchKernels::VolumeLevels levels;
+    levels.assign(grid, mips, layout);
+    float step = .5f / levels.floatSizes[0][0];
+
+    for (UInt d = 0; d < 4; ++d)
+    {
+      const float* direction = directions[d];
+      float sink = .0f;
+      double seconds = bestTime(3, [&]()
+        {
+          for (UInt ray = 0; ray < rayCount; ++ray)
+          {
+            const float* origin = &origins[3 * ray];
+            for (UInt i = 0; i < steps; ++i)
+            {
+              float t = step * float(i), result[2];
+              MarchKernels::sampleLevel(levels, 0, origin[0] + direction[0] * t, origin[1] + direction[1] * t, origin[2] + direction[2] * t, result);
+              sink += result[0];
+            }
+          }
+        });
+
+      size_t lines = 0, newLines = 0, pages = 0;
+      for (UInt ray = 0; ray < rayCount; ++ray)
+      {
+        const float* origin = &origins[3 * ray];
+        std::vector<size_t> previous;
+        for (UInt i = 0; i < steps; ++i)
+        {
+          float t = step * float(i);
+          int x = int(std::floor((origin[0] + direction[0] * t) * levels.floatSizes[0][0] - .5f));
+          int y = int(std::floor((origin[1] + direction[1] * t) * levels.floatSizes[0][1] - .5f));
+          int z = int(std::floor((origin[2] + direction[2] * t) * levels.floatSizes[0][2] - .5f));
+
+          std::vector<size_t> footprint, footprintPages;
+          for (int corner = 0; corner < 8; ++corner)
+          {
+            size_t byte = 2 * sizeof(float) * levels.texelIndex(0, x + (corner & 1), y + ((corner >> 1) & 1), z + (corner >> 2));
+            footprint.push_back(byte >> 6);
+            footprintPages.push_back(byte >> 12);
+          }
+          std::sort(footprint.begin(), footprint.end());
+          footprint.erase(std::unique(footprint.begin(), footprint.end()), footprint.end());
+          std::sort(footprintPages.begin(), footprintPages.end());
+          pages += std::unique(footprintPages.begin(), footprintPages.end()) - footprintPages.begin();
+
+          lines += footprint.size();
+          for (size_t line : footprint) { newLines += !std::binary_search(previous.begin(), previous.end(), line); }
+          previous = footprint;
+        }
+      }
+
+      double fetches = double(rayCount) * double(steps);
+      std::printf("%s,%s,%.0f,%.2f,%.2f,%.2f%s\n", layout == MarchKernels::VolumeLevels::LAYOUT_TILED ? "tiled" : "linear", directionNames[d],
+        fetches / seconds, double(lines) / fetches, double(newLines) / fetches, double(pages) / fetches, sink == -1.f ? "!" : "");
+    }
+  }
+}
@@ -0,0 +1,122 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "Data/PackedFloatKernels.h"
+
+using namespace Haboob;
+
+namespace
+{
+  constexpr size_t CHUNK = 1 << 16;
+
+  // Packs float bit patterns first, first + stride, ... below last (as r, g and b alike) with every supported kernel against the scalar path
+  void checkPacking(uint64_t first, uint64_t last, uint64_t stride)
+  {
+    std::vector<float> rgb(CHUNK * 3);
+    std::vector<UInt> expected(CHUNK), result(CHUNK);
+
+    SIMD::Level supported = SIMD::detectLevel();
+    for (uint64_t start = first; start < last; start += CHUNK * stride)
+    {
+      size_t count = 0;
+      for (uint64_t bits = start; bits < last && count < CHUNK; bits += stride, ++count)
+      {
+        rgb[count * 3] = rgb[count * 3 + 1] = rgb[count * 3 + 2] = PackedFloat::bitsFloat(UInt(bits));
+      }
+      PackedFloat::packBatchScalar(rgb.data(), expected.data(), count);
+
+      for (Byte level = SIMD::LEVEL_SSE4; level <= supported; ++level)
+      {
+        INFO(SIMD::getLevelName(SIMD::Level(level)));
+        INFO("From float bits " << start);
+        PackedFloat::getPackBatch(SIMD::Level(level))(rgb.data(), result.data(), count);
+        REQUIRE(std::memcmp(result.data(), expected.data(), count * sizeof(UInt)) == 0);
+      }
+    }
+  }
+
+  // As checkPacking, for texels
+  void checkUnpacking(uint64_t first, uint64_t last, uint64_t stride)
+  {
+    std::vector<UInt> packed(CHUNK);
+    std::vector<float> expected(CHUNK * 3), result(CHUNK * 3);
+
+    SIMD::Level supported = SIMD::detectLevel();
+    for (uint64_t start = first; start < last; start += CHUNK * stride)
+    {
+      size_t count = 0;
+      for (uint64_t bits = start; bits < last && count < CHUNK; bits += stride, ++count)
+      {
+        packed[count] = UInt(bits);
+      }
+      PackedFloat::unpackBatchScalar(packed.data(), expected.data(), count);
+
+      for (Byte level = SIMD::LEVEL_SSE4; level <= supported; ++level)
+      {
+        INFO(SIMD::getLevelName(SIMD::Level(level)));
+        INFO("From texel " << start);
+        PackedFloat::getUnpackBatch(SIMD::Level(level))(packed.data(), result.data(), count);
+        REQUIRE(std::memcmp(result.data(), expected.data(), count * 3 * sizeof(float)) == 0);
+      }
+    }
+  }
+}
+
+TEST_CASE("Vector R11G11B10 kernels match the scalar path bit for bit", "[packing]")
+{
+  SECTION("Every float around the small float range")
+  {
+    // Underflow through overflow, denormals and rounding included, then a sweep of the rest
+    checkPacking(0x33000000U, 0x47900000U, 1);
+    checkPacking(0xFF800000U, 0xFF800001U, 1);
+    checkPacking(0, 1ULL << 32, 509);
+  }
+
+  SECTION("Every code of every channel")
+  {
+    // All three channels take every code together, then mixed across channels
+    std::vector<UInt> codes;
+    for (UInt code = 0; code < 2048; ++code) { codes.push_back(code | (code << 11) | ((code & 0x3FF) << 22)); }
+    for (UInt code : codes) { checkUnpacking(code, code + 1, 1); }
+    checkUnpacking(0, 1ULL << 32, 4099);
+  }
+
+  SECTION("Every tail length against a lane width")
+  {
+    std::vector<float> rgb(17 * 3);
+    for (size_t i = 0; i < rgb.size(); ++i) { rgb[i] = float(i) * .37f; }
+
+    std::vector<UInt> expected(17);
+    PackedFloat::packBatchScalar(rgb.data(), expected.data(), 17);
+
+    SIMD::Level supported = SIMD::detectLevel();
+    for (Byte level = SIMD::LEVEL_SSE4; level <= supported; ++level)
+    {
+      INFO(SIMD::getLevelName(SIMD::Level(level)));
+      for (size_t batch : { 1, 3, 15, 17 })
+      {
+        // Nothing past the batch is touched
+        std::vector<UInt> packed(batch + 1, 0xDEADBEEFU);
+        PackedFloat::getPackBatch(SIMD::Level(level))(rgb.data(), packed.data(), batch);
+        REQUIRE(std::memcmp(packed.data(), expected.data(), batch * sizeof(UInt)) == 0);
+        REQUIRE(packed[batch] == 0xDEADBEEFU);
+
+        std::vector<float> unpacked(batch * 3 + 1, -1.f), expectedUnpacked(batch * 3);
+        PackedFloat::unpackBatchScalar(expected.data(), expectedUnpacked.data(), batch);
+        PackedFloat::getUnpackBatch(SIMD::Level(level))(expected.data(), unpacked.data(), batch);
+        REQUIRE(std::memcmp(unpacked.data(), expectedUnpacked.data(), batch * 3 * sizeof(float)) == 0);
+        REQUIRE(unpacked[batch * 3] == -1.f);
+      }
+    }
+  }
+}
+
+TEST_CASE("Vector R11G11B10 kernels match the scalar path exhaustively", "[.][packing][exhaustive]")
+{
+  // Every float bit pattern and every texel, takes minutes
+  checkPacking(0, 1ULL << 32, 1);
+  checkUnpacking(0, 1ULL << 32, 1);
+}
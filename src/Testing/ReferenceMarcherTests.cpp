@@ -0,0 +1,819 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "Procedural/BlueNoise.h"
+#include "Rendering/Raymarch/RayExtents.h"
+#include "Rendering/Raymarch/ReferenceMarcher.h"
+#include "Rendering/Raymarch/SpectralOptics.h"
+#include "Rendering/Volume/VolumeGenerator.h"
+#include "Rendering/Volume/VolumeMips.h"
+
+using namespace Haboob;
+
+namespace
+{
+  XMMATRIX translation(float x, float y, float z)
+  {
+    XMFLOAT4X4 matrix = { 1.f, .0f, .0f, .0f, .0f, 1.f, .0f, .0f, .0f, .0f, 1.f, .0f, x, y, z, 1.f };
+    return XMLoadFloat4x4(&matrix);
+  }
+
+  // Looks down +z with the screen as world space, so the cube [-.5, .5] pushed back by .5 fills the middle of the screen
+  struct FlatScene
+  {
+    FlatScene()
+    {
+      camera.inverseViewProjectionMatrix = translation(.0f, .0f, .0f);
+      marchInfo.localVolumeTransform = translation(.0f, .0f, -.5f);
+      marchInfo.volumeSize = { 1.f, 1.f, 1.f };
+      marchInfo.texelDensity = 4.f;
+      marchInfo.iterations = 8;
+      light.ambient = { .5f, .5f, .5f };
+
+      optics.anisotropicForwardTerms = { .735f, .732f, .651f, .735f };
+      optics.anisotropicBackwardTerms = { -.6f, -.732f, -.651f, -.735f };
+      optics.phaseBlendWeightTerms = { .17f, .11f, .2f, .2f, };
+      optics.scatterAngstromExponent = 2.1f;
+      optics.ambientFraction = { .8f, 1.f, 1.f, 1.f, };
+      optics.absorptionAngstromExponent = 2.3f;
+      optics.powderCoefficient = .035f;
+      optics.attenuationFactor = 1.7f;
+      SpectralOptics::buildMatrices(optics);
+    }
+
+    CameraPack camera;
+    DirectionalLightPack light;
+    MarchVolumeDispatchInfo marchInfo;
+    BasicOptics optics;
+  };
+
+  VolumeGrid uniformVolume(const XMINT3& size, float density)
+  {
+    VolumeGrid grid;
+    grid.resize(size);
+    for (size_t i = 0; i < grid.getVoxelCount(); ++i)
+    {
+      grid.getData()[i] = { density, density, 1.f };
+    }
+    return grid;
+  }
+}
+
+TEST_CASE("Reference marcher integrates as MarchVolume.cs", "[raymarch][reference]")
+{
+  FlatScene scene;
+  ReferenceMarcher marcher;
+  marcher.getSettings().applyConeTrace = false;
+
+  HDRImage image;
+  image.resize(8, 8);
+
+  SECTION("Uniform density follows the shader's Simpson sum")
+  {
+    const float density = .25f;
+    marcher.setVolume(uniformVolume({ 4, 4, 4 }, density));
+    marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, image);
+
+    // Rays which miss the cube are masked
+    const XMFLOAT4& masked = image.at(0, 0);
+    CHECK(masked.x == .0f);
+    CHECK(masked.y == .0f);
+    CHECK(masked.z == .0f);
+    CHECK(masked.w == 1.f);
+
+    // 8 steps of 1/8 through 4 texels, the first sample is on the face so half of it is border
+    // Odds (1, 3, 5, 7) = 4c, evens (0, 2, 4, 6) = 3.5c, last = c and the first term is never set
+    float integral = (density + 4.f * 4.f * density + 2.f * (3.5f * density - density)) * .125f / 3.f;
+    const XMFLOAT4& inside = image.at(3, 3);
+    CHECK(std::abs(inside.w - std::exp(-scene.optics.attenuationFactor * integral)) < 1e-6f);
+    CHECK(inside.x > .0f);
+    CHECK(inside.y > .0f);
+    CHECK(inside.z > .0f);
+
+    // Every ray through the cube sees the same volume
+    for (UInt y = 2; y < 6; ++y)
+    {
+      for (UInt x = 2; x < 6; ++x)
+      {
+        CHECK(std::abs(image.at(x, y).w - inside.w) < 1e-6f);
+      }
+    }
+  }
+
+  SECTION("Empty space neither scatters nor absorbs")
+  {
+    // Beer-Powder is 0 at no optical depth
+    marcher.setVolume(uniformVolume({ 4, 4, 4 }, .0f));
+    marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, image);
+
+    for (UInt y = 0; y < 8; ++y)
+    {
+      for (UInt x = 0; x < 8; ++x)
+      {
+        const XMFLOAT4& pixel = image.at(x, y);
+        CHECK(pixel.x == .0f);
+        CHECK(pixel.w == 1.f);
+      }
+    }
+  }
+}
+
+TEST_CASE("Reference marcher tiles match across thread pools", "[raymarch][reference]")
+{
+  FlatScene scene;
+  scene.marchInfo.iterations = 24;
+  scene.marchInfo.texelDensity = 24.f;
+
+  VolumeInfo info;
+  info.size = { 24, 24, 24 };
+  VolumeGrid grid;
+  VolumeGenerator().generate(info, grid);
+
+  HDRImage serialImage, pooledImage;
+  serialImage.resize(37, 29);
+  pooledImage.resize(37, 29);
+
+  ReferenceMarcher serial;
+  serial.getSettings().lightIterations = 4;
+  serial.getSettings().tileSize = 5;
+  serial.setVolume(grid);
+  serial.render(scene.camera, scene.light, scene.marchInfo, scene.optics, serialImage);
+
+  ThreadPool pool(3);
+  ReferenceMarcher pooled(&pool);
+  pooled.getSettings() = serial.getSettings();
+  pooled.setVolume(grid);
+  REQUIRE(pooled.getLevels().levelCount == serial.getLevels().levelCount);
+  pooled.render(scene.camera, scene.light, scene.marchInfo, scene.optics, pooledImage);
+
+  REQUIRE(std::memcmp(serialImage.getData(), pooledImage.getData(), 37 * 29 * sizeof(XMFLOAT4)) == 0);
+
+  // The haboob is lit within the cube, rays around it are masked
+  bool lit = false, clear = false;
+  for (UInt y = 0; y < 29; ++y)
+  {
+    for (UInt x = 0; x < 37; ++x)
+    {
+      const XMFLOAT4& pixel = pooledImage.at(x, y);
+      REQUIRE(std::isfinite(pixel.x));
+      REQUIRE(std::isfinite(pixel.w));
+      lit |= pixel.x > .0f && pixel.w < 1.f;
+      clear |= pixel.w == 1.f;
+    }
+  }
+  CHECK(lit);
+  CHECK(clear);
+}
+
+TEST_CASE("Compacted tiles render as every tile", "[raymarch][reference]")
+{
+  FlatScene scene;
+  scene.marchInfo.iterations = 16;
+  scene.marchInfo.texelDensity = 16.f;
+
+  VolumeInfo info;
+  info.size = { 16, 16, 16 };
+  VolumeGrid grid;
+  VolumeGenerator().generate(info, grid);
+
+  // The cube covers the middle half of the screen across, so the outer tiles have no ray through it
+  constexpr UInt width = 43, height = 30, tileSize = 4;
+  std::vector<UInt> tiles;
+  XMFLOAT4X4 inverseViewProjection, localTransform;
+  XMStoreFloat4x4(&inverseViewProjection, scene.camera.inverseViewProjectionMatrix);
+  XMStoreFloat4x4(&localTransform, scene.marchInfo.localVolumeTransform);
+  RayExtents::findActiveTiles(inverseViewProjection, localTransform, width, height, tileSize, tiles);
+  UInt tilesX = (width + tileSize - 1) / tileSize, tilesY = (height + tileSize - 1) / tileSize;
+  CHECK(tiles.size() > 0);
+  CHECK(tiles.size() < tilesX * tilesY / 2);
+  CHECK(std::is_sorted(tiles.begin(), tiles.end()));
+
+  ThreadPool pool(3);
+  ReferenceMarcher marcher(&pool);
+  marcher.getSettings().tileSize = tileSize;
+  marcher.setVolume(grid);
+
+  HDRImage everyTile, compacted;
+  everyTile.resize(width, height);
+  compacted.resize(width, height);
+  compacted.fill({ 7.f, 7.f, 7.f, 7.f }); // Nothing of a previous frame survives
+  marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, everyTile);
+  marcher.getSettings().compactTiles = true;
+  marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, compacted);
+
+  REQUIRE(std::memcmp(everyTile.getData(), compacted.getData(), width * height * sizeof(XMFLOAT4)) == 0);
+
+  // Every tile left out was masked throughout
+  for (UInt tile = 0; tile < tilesX * tilesY; ++tile)
+  {
+    if (std::binary_search(tiles.begin(), tiles.end(), tile)) { continue; }
+    UInt beginX = (tile % tilesX) * tileSize, beginY = (tile / tilesX) * tileSize;
+    for (UInt y = beginY; y < std::min(beginY + tileSize, height); ++y)
+    {
+      for (UInt x = beginX; x < std::min(beginX + tileSize, width); ++x) { CHECK(everyTile.at(x, y).w == 1.f); }
+    }
+  }
+}
+
+TEST_CASE("Packet march kernels match the scalar kernel", "[raymarch][reference]")
+{
+  FlatScene scene;
+  scene.marchInfo.iterations = 20;
+  scene.marchInfo.texelDensity = 24.f;
+
+  VolumeInfo info;
+  info.size = { 24, 24, 24 };
+  VolumeGrid grid;
+  VolumeGenerator().generate(info, grid);
+
+  // Rows of 37 leave partial packets at every width, the cube's edges mask lanes within them
+  HDRImage expected, image;
+  expected.resize(37, 29);
+  image.resize(37, 29);
+
+  ReferenceMarcher marcher;
+  marcher.setVolume(grid);
+
+  SIMD::Level supported = SIMD::detectLevel();
+  for (UInt lightIterations : { 0U, 3U })
+  {
+    for (UInt spectral : { 1U, 0U })
+    {
+      marcher.getSettings().lightIterations = lightIterations;
+      marcher.getSettings().skipEmpty = lightIterations > 0; // Both walks, without doubling the case
+      marcher.getSettings().jitter = spectral == 0; // As for progressive integration
+      scene.optics.flagApplySpectral = spectral;
+
+      marcher.setSIMDLevel(SIMD::LEVEL_SCALAR);
+      marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, expected);
+
+      for (Byte level = SIMD::LEVEL_SSE4; level <= supported; ++level)
+      {
+        INFO(SIMD::getLevelName(SIMD::Level(level)) << " light iterations " << lightIterations << " spectral " << spectral << " skip " << marcher.getSettings().skipEmpty << " jitter " << marcher.getSettings().jitter);
+        marcher.setSIMDLevel(SIMD::Level(level));
+        marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, image);
+
+        // Polynomial exp, exp2 and log2 hold the vector kernels to a tolerance rather than bit for bit
+        bool match = true;
+        for (UInt i = 0; i < 37 * 29; ++i)
+        {
+          const float* a = &expected.getData()[i].x;
+          const float* b = &image.getData()[i].x;
+          for (int channel = 0; channel < 4; ++channel)
+          {
+            match &= std::abs(a[channel] - b[channel]) <= 1e-5f + 1e-4f * std::abs(a[channel]);
+          }
+        }
+        CHECK(match);
+        CHECK(std::memcmp(&image.at(0, 0), &expected.at(0, 0), sizeof(XMFLOAT4)) == 0); // Masked
+      }
+    }
+  }
+}
+
+TEST_CASE("Tiled volume levels match the linear layout", "[raymarch][reference]")
+{
+  // Not a whole number of tiles, so every level is padded
+  VolumeInfo info;
+  info.size = { 20, 20, 20 };
+  VolumeGrid grid;
+  VolumeGenerator().generate(info, grid);
+  std::vector<VolumeGrid> mips;
+  VolumeMips::buildChain(grid, mips, VolumeMips::getLevelCount(grid.getSize()));
+
+  MarchKernels::VolumeLevels linear, tiled;
+  linear.assign(grid, mips, MarchKernels::VolumeLevels::LAYOUT_LINEAR);
+  tiled.assign(grid, mips, MarchKernels::VolumeLevels::LAYOUT_TILED);
+  REQUIRE(tiled.levelCount == linear.levelCount);
+
+  // Every texel has its own place
+  std::vector<bool> used(tiled.texels.size() / 2, false);
+  for (UInt level = 0; level < tiled.levelCount; ++level)
+  {
+    const int* size = tiled.sizes[level];
+    for (int z = 0; z < size[2]; ++z)
+    {
+      for (int y = 0; y < size[1]; ++y)
+      {
+        for (int x = 0; x < size[0]; ++x)
+        {
+          size_t index = tiled.texelIndex(level, x, y, z);
+          REQUIRE(index < used.size());
+          REQUIRE(!used[index]);
+          used[index] = true;
+
+          const float* a = linear.texels.data() + 2 * linear.texelIndex(level, x, y, z);
+          const float* b = tiled.texels.data() + 2 * index;
+          REQUIRE(a[0] == b[0]);
+          REQUIRE(a[1] == b[1]);
+        }
+      }
+    }
+  }
+
+  // Only the addressing differs, so renders are identical at every level
+  FlatScene scene;
+  scene.marchInfo.iterations = 16;
+  scene.marchInfo.texelDensity = 20.f;
+
+  HDRImage expected, image;
+  expected.resize(23, 19);
+  image.resize(23, 19);
+
+  ReferenceMarcher linearMarcher, tiledMarcher;
+  linearMarcher.getSettings().lightIterations = tiledMarcher.getSettings().lightIterations = 2;
+  linearMarcher.setVolume(grid, MarchKernels::VolumeLevels::LAYOUT_LINEAR);
+  tiledMarcher.setVolume(grid, MarchKernels::VolumeLevels::LAYOUT_TILED);
+
+  SIMD::Level supported = SIMD::detectLevel();
+  for (Byte level = SIMD::LEVEL_SCALAR; level <= supported; ++level)
+  {
+    INFO(SIMD::getLevelName(SIMD::Level(level)));
+    linearMarcher.setSIMDLevel(SIMD::Level(level));
+    tiledMarcher.setSIMDLevel(SIMD::Level(level));
+    linearMarcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, expected);
+    tiledMarcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, image);
+    CHECK(std::memcmp(expected.getData(), image.getData(), 23 * 19 * sizeof(XMFLOAT4)) == 0);
+  }
+}
+
+TEST_CASE("Empty space skipping spends the steps within occupied macro cells", "[raymarch][reference]")
+{
+  FlatScene scene;
+  scene.marchInfo.iterations = 16;
+  scene.marchInfo.texelDensity = 16.f;
+
+  HDRImage expected, image;
+  expected.resize(16, 16);
+  image.resize(16, 16);
+
+  ReferenceMarcher marcher;
+  marcher.getSettings().applyConeTrace = false;
+
+  SECTION("An occupied volume marches as without skipping")
+  {
+    marcher.setVolume(uniformVolume({ 16, 16, 16 }, .25f));
+    REQUIRE(marcher.getLevels().macroCells.size() == 8 * marcher.getLevels().levelCount);
+
+    marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, expected);
+    marcher.getSettings().skipEmpty = true;
+    marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, image);
+
+    for (UInt i = 0; i < 16 * 16; ++i)
+    {
+      const float* a = &expected.getData()[i].x;
+      const float* b = &image.getData()[i].x;
+      for (int channel = 0; channel < 4; ++channel)
+      {
+        CHECK(std::abs(a[channel] - b[channel]) <= 1e-5f + 1e-4f * std::abs(a[channel]));
+      }
+    }
+  }
+
+  SECTION("Steps within the occupied cells see more of the volume")
+  {
+    // Density only in the far quarter of the left half, so skipped rays and spans are both exercised
+    // Cells are grown by the trilinear footprint, so the far half is marched
+    scene.marchInfo.texelDensity = 32.f;
+    VolumeGrid grid = uniformVolume({ 32, 32, 32 }, .0f);
+    for (int z = 24; z < 32; ++z)
+    {
+      for (int y = 0; y < 32; ++y)
+      {
+        for (int x = 0; x < 16; ++x) { grid.at(x, y, z) = { .5f, .5f, 1.f }; }
+      }
+    }
+    marcher.setVolume(grid);
+
+    // Ground truth from many more steps
+    HDRImage truth;
+    truth.resize(16, 16);
+    scene.marchInfo.iterations = 512;
+    marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, truth);
+
+    scene.marchInfo.iterations = 16;
+    marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, expected);
+    marcher.getSettings().skipEmpty = true;
+    marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, image);
+
+    double fixedError = .0, skipError = .0;
+    for (UInt y = 4; y < 12; ++y)
+    {
+      // Rays through only empty cells are masked
+      const XMFLOAT4& empty = image.at(11, y);
+      CHECK(empty.x == .0f);
+      CHECK(empty.w == 1.f);
+
+      for (UInt x = 4; x < 8; ++x)
+      {
+        fixedError += std::abs(expected.at(x, y).w - truth.at(x, y).w);
+        skipError += std::abs(image.at(x, y).w - truth.at(x, y).w);
+      }
+    }
+    CHECK(skipError < fixedError * .5);
+  }
+}
+
+TEST_CASE("Adaptive marching integrates its own steps and stops once opaque", "[raymarch][reference]")
+{
+  FlatScene scene;
+  ReferenceMarcher marcher;
+  marcher.getSettings().applyConeTrace = false;
+  marcher.getSettings().marchAdaptive = true;
+
+  HDRImage image;
+  image.resize(8, 8);
+
+  SECTION("Uniform steps follow the trapezoid rule")
+  {
+    // Steps never shrink, so the 8 uniform steps end on the back face
+    const float density = .25f;
+    scene.marchInfo.stepOpticalDepth = 100.f;
+    scene.marchInfo.maxStepScale = 1.f;
+    marcher.setVolume(uniformVolume({ 4, 4, 4 }, density));
+
+    uint64_t samples = 0;
+    marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, image, &samples);
+    CHECK(samples == 16 * 9);
+
+    // Every other sample is on a texel centre, so the half texel of border at either face is linear between samples
+    float integral = (.5f * .5f * density + 7.f * density + .5f * .5f * density) * .125f;
+    CHECK(std::abs(image.at(3, 3).w - std::exp(-scene.optics.attenuationFactor * integral)) < 1e-6f);
+    CHECK(image.at(3, 3).x > .0f);
+  }
+
+  SECTION("Opaque rays stop early")
+  {
+    marcher.setVolume(uniformVolume({ 4, 4, 4 }, 4.f));
+
+    uint64_t throughSamples = 0, samples = 0;
+    scene.marchInfo.terminationTransmission = .0f;
+    marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, image, &throughSamples);
+    CHECK(image.at(3, 3).w < .005f);
+
+    scene.marchInfo.terminationTransmission = .005f;
+    marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, image, &samples);
+    CHECK(image.at(3, 3).w < .005f);
+    CHECK(samples < throughSamples);
+  }
+}
+
+TEST_CASE("Progressive frames average blue noise jittered ray starts", "[raymarch][reference]")
+{
+  SECTION("The tile ranks every texel once")
+  {
+    std::vector<float> tile = BlueNoise::getTile();
+    REQUIRE(tile.size() == BlueNoise::TILE_SIZE * BlueNoise::TILE_SIZE);
+
+    std::vector<float> sorted = tile;
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < sorted.size(); ++i) { CHECK(sorted[i] == (float(i) + .5f) / float(sorted.size())); }
+
+    // Neighbours differ by more than white noise's mean of 1/3, wrapping at the edges
+    double difference = .0;
+    for (UInt y = 0; y < BlueNoise::TILE_SIZE; ++y)
+    {
+      for (UInt x = 0; x < BlueNoise::TILE_SIZE; ++x) { difference += std::abs(BlueNoise::sample(x, y, 0) - BlueNoise::sample(x + 1, y, 0)); }
+    }
+    CHECK(difference / double(tile.size()) > .4);
+    CHECK(BlueNoise::sample(3, 5, 7) == BlueNoise::sample(3 + BlueNoise::TILE_SIZE, 5 + 2 * BlueNoise::TILE_SIZE, 7));
+  }
+
+  SECTION("Accumulation is a running average")
+  {
+    HDRImage average, frame;
+    frame.resize(2, 1);
+    for (UInt count = 0; count < 3; ++count)
+    {
+      frame.at(1, 0) = { float(count), 1.f, 2.f, 3.f };
+      average.accumulate(frame, count);
+    }
+    CHECK(average.at(1, 0).x == 1.f);
+    CHECK(average.at(1, 0).w == 3.f);
+    CHECK(average.at(0, 0).x == .0f);
+  }
+
+  SECTION("Jittered frames converge where a fixed start bands")
+  {
+    // A slab whose face falls between the samples of a few steps
+    FlatScene scene;
+    scene.marchInfo.texelDensity = 32.f;
+    VolumeGrid grid = uniformVolume({ 32, 32, 32 }, .0f);
+    for (int z = 21; z < 32; ++z)
+    {
+      for (int y = 0; y < 32; ++y)
+      {
+        for (int x = 0; x < 32; ++x) { grid.at(x, y, z) = { .5f, .5f, 1.f }; }
+      }
+    }
+
+    ReferenceMarcher marcher;
+    marcher.getSettings().applyConeTrace = false;
+    marcher.setVolume(grid);
+
+    HDRImage truth, fixed, frame, average;
+    truth.resize(16, 16);
+    fixed.resize(16, 16);
+    frame.resize(16, 16);
+    scene.marchInfo.iterations = 512;
+    marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, truth);
+
+    scene.marchInfo.iterations = 8;
+    marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, fixed);
+    marcher.getSettings().jitter = true;
+    for (UInt count = 0; count < 16; ++count)
+    {
+      marcher.getSettings().frame = count;
+      marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, frame);
+      average.accumulate(frame, count);
+    }
+
+    double fixedError = .0, progressiveError = .0;
+    for (UInt y = 4; y < 12; ++y)
+    {
+      for (UInt x = 4; x < 12; ++x)
+      {
+        fixedError += std::abs(fixed.at(x, y).w - truth.at(x, y).w);
+        progressiveError += std::abs(average.at(x, y).w - truth.at(x, y).w);
+      }
+    }
+    CHECK(progressiveError < fixedError * .05);
+  }
+}
+
+TEST_CASE("Spectral transmission lookups follow the analytic path", "[raymarch][reference]")
+{
+  FlatScene scene;
+  SpectralOptics::TransmissionLUT lut;
+
+  SECTION("The table holds Beer-Powder transmission of every wavelength")
+  {
+    for (UInt beer : { 1U, 0U })
+    {
+      INFO("beer " << beer);
+      scene.optics.flagApplyBeer = beer;
+      SpectralOptics::buildTransmissionLUT(scene.optics, lut);
+      REQUIRE(lut.texels.size() == size_t(SpectralOptics::TransmissionLUT::DEPTH_SIZE) * SpectralOptics::TransmissionLUT::ANGSTROM_SIZE * 16);
+
+      auto blTransmission = [beer](float opticalDepth) { return beer ? std::exp(-opticalDepth) : 1.f / (1.f + opticalDepth); };
+      float maxError = .0f, result[16];
+      for (float logDepth = -26.f; logDepth < 12.f; logDepth += .0731f)
+      {
+        for (float angstrom = .0f; angstrom < lut.maxAngstrom; angstrom += .0917f)
+        {
+          lut.lookup(std::exp2(logDepth), angstrom, result);
+          for (int i = 0; i < 16; ++i)
+          {
+            float opticalDepth = std::exp2(logDepth) * std::pow(scene.optics.spectralWavelengths.m[i / 4][i % 4] / scene.optics.referenceWavelength, -angstrom);
+            maxError = std::max(maxError, std::abs(result[i] - (blTransmission(opticalDepth) - blTransmission(scene.optics.powderCoefficient * opticalDepth))));
+          }
+        }
+      }
+      CHECK(maxError < .005f);
+
+      lut.lookup(.0f, 1.f, result);
+      CHECK(std::all_of(result, result + 16, [](float value) { return value == .0f; }));
+    }
+  }
+
+  SECTION("The table only follows the optics it reads")
+  {
+    uint64_t key = SpectralOptics::hashTransmissionLUT(scene.optics);
+    scene.optics.attenuationFactor *= 2.f;
+    scene.optics.anisotropicForwardTerms.x = .5f;
+    CHECK(SpectralOptics::hashTransmissionLUT(scene.optics) == key);
+    scene.optics.powderCoefficient = .05f;
+    CHECK(SpectralOptics::hashTransmissionLUT(scene.optics) != key);
+  }
+
+  SECTION("Renders with the table match the analytic renders on every kernel")
+  {
+    scene.marchInfo.iterations = 20;
+    scene.marchInfo.texelDensity = 24.f;
+    VolumeInfo info;
+    info.size = { 24, 24, 24 };
+    VolumeGrid grid;
+    VolumeGenerator().generate(info, grid);
+
+    HDRImage expected, scalar, image;
+    expected.resize(21, 19);
+    scalar.resize(21, 19);
+    image.resize(21, 19);
+    ReferenceMarcher marcher;
+    marcher.setVolume(grid);
+
+    SIMD::Level supported = SIMD::detectLevel();
+    for (UInt lightIterations : { 0U, 3U })
+    {
+      marcher.getSettings().lightIterations = lightIterations;
+      marcher.getSettings().transmissionLUT = false;
+      marcher.setSIMDLevel(SIMD::LEVEL_SCALAR);
+      marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, expected);
+      marcher.getSettings().transmissionLUT = true;
+      marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, scalar);
+
+      for (Byte level = SIMD::LEVEL_SCALAR; level <= supported; ++level)
+      {
+        INFO(SIMD::getLevelName(SIMD::Level(level)) << " light iterations " << lightIterations);
+        marcher.setSIMDLevel(SIMD::Level(level));
+        marcher.render(scene.camera, scene.light, scene.marchInfo, scene.optics, image);
+
+        // Against the analytic path to the table's error, against the scalar lookups to the polynomial log2
+        bool close = true, match = true;
+        for (UInt i = 0; i < 21 * 19; ++i)
+        {
+          const float* a = &expected.getData()[i].x;
+          const float* b = &scalar.getData()[i].x;
+          const float* c = &image.getData()[i].x;
+          for (int channel = 0; channel < 4; ++channel)
+          {
+            close &= std::abs(a[channel] - c[channel]) <= 2e-3f + 1e-2f * std::abs(a[channel]);
+            match &= std::abs(b[channel] - c[channel]) <= 1e-5f + 1e-4f * std::abs(b[channel]);
+          }
+        }
+        CHECK(close);
+        CHECK(match);
+      }
+    }
+  }
+}
+
+TEST_CASE("HDR images write as float DDS", "[raymarch][reference]")
+{
+  HDRImage image;
+  image.resize(3, 2);
+  image.at(2, 1) = { 1.f, 2.f, 3.f, .5f };
+
+  std::filesystem::path path = std::filesystem::temp_directory_path() / "HaboobHDRImageTest.dds";
+  REQUIRE(image.writeDDS(path));
+
+  std::ifstream in(path, std::ios::binary);
+  std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  in.close();
+  std::filesystem::remove(path);
+
+  // Magic, DDS_HEADER, DDS_HEADER_DXT10 then the pixels
+  REQUIRE(bytes.size() == 148 + 6 * sizeof(XMFLOAT4));
+  uint32_t header[37];
+  std::memcpy(header, bytes.data(), sizeof(header));
+  CHECK(header[0] == 0x20534444);
+  CHECK(header[3] == 2); // Height
+  CHECK(header[4] == 3); // Width
+  CHECK(header[21] == 0x30315844); // DX10
+  CHECK(header[32] == 2); // DXGI_FORMAT_R32G32B32A32_FLOAT
+
+  XMFLOAT4 last;
+  std::memcpy(&last, bytes.data() + 148 + 5 * sizeof(XMFLOAT4), sizeof(XMFLOAT4));
+  CHECK(last.y == 2.f);
+  CHECK(last.w == .5f);
+}
+
+namespace
+{
+  void multiply(const XMFLOAT4X4& a, const XMFLOAT4X4& b, XMFLOAT4X4& result)
+  {
+    for (int row = 0; row < 4; ++row)
+    {
+      for (int column = 0; column < 4; ++column)
+      {
+        result.m[row][column] = a.m[row][0] * b.m[0][column] + a.m[row][1] * b.m[1][column] + a.m[row][2] * b.m[2][column] + a.m[row][3] * b.m[3][column];
+      }
+    }
+  }
+
+  // Scales, pitches then yaws, then moves to position, with the inverse built alongside
+  void placement(float scale, float pitch, float yaw, const float position[3], XMFLOAT4X4& forward, XMFLOAT4X4& inverse)
+  {
+    float cp = std::cos(pitch), sp = std::sin(pitch), cy = std::cos(yaw), sy = std::sin(yaw);
+    float rotation[3][3] = { { cy, .0f, -sy }, { sp * sy, cp, sp * cy }, { cp * sy, -sp, cp * cy } };
+
+    forward = XMFLOAT4X4(scale * rotation[0][0], scale * rotation[0][1], scale * rotation[0][2], .0f,
+      scale * rotation[1][0], scale * rotation[1][1], scale * rotation[1][2], .0f,
+      scale * rotation[2][0], scale * rotation[2][1], scale * rotation[2][2], .0f,
+      position[0], position[1], position[2], 1.f);
+    for (int row = 0; row < 3; ++row)
+    {
+      for (int column = 0; column < 3; ++column) { inverse.m[row][column] = rotation[column][row] / scale; }
+      inverse.m[row][3] = .0f;
+    }
+    for (int column = 0; column < 3; ++column)
+    {
+      inverse.m[3][column] = -(position[0] * inverse.m[0][column] + position[1] * inverse.m[1][column] + position[2] * inverse.m[2][column]);
+    }
+    inverse.m[3][3] = 1.f;
+  }
+
+  // XMMatrixPerspectiveFovLH and its inverse
+  void perspective(float fov, float aspect, float nearZ, float farZ, XMFLOAT4X4& forward, XMFLOAT4X4& inverse)
+  {
+    float yScale = 1.f / std::tan(fov * .5f), xScale = yScale / aspect;
+    float range = farZ / (farZ - nearZ), offset = -nearZ * range;
+    forward = XMFLOAT4X4(xScale, .0f, .0f, .0f, .0f, yScale, .0f, .0f, .0f, .0f, range, 1.f, .0f, .0f, offset, .0f);
+    inverse = XMFLOAT4X4(1.f / xScale, .0f, .0f, .0f, .0f, 1.f / yScale, .0f, .0f, .0f, .0f, .0f, 1.f / offset, .0f, .0f, 1.f, -range / offset);
+  }
+
+  RayExtents::View extentsView(const float camera[3], float cameraYaw, float boxScale, const float box[3], UInt width, UInt height)
+  {
+    RayExtents::View view;
+    XMFLOAT4X4 cameraTransform, viewMatrix, projection, inverseProjection;
+    placement(1.f, .0f, cameraYaw, camera, cameraTransform, viewMatrix);
+    perspective(XM_PIDIV4, float(width) / float(height), .1f, 100.f, projection, inverseProjection);
+    multiply(viewMatrix, projection, view.viewProjection);
+    multiply(inverseProjection, cameraTransform, view.inverseViewProjection);
+    placement(boxScale, .4f, .7f, box, view.volumeTransform, view.localTransform);
+    std::copy(camera, camera + 3, view.cameraPosition);
+    return view;
+  }
+}
+
+TEST_CASE("Analytic ray extents match the rasterised passes", "[raymarch][extents]")
+{
+  constexpr UInt width = 160, height = 120;
+  float box[3] = { .0f, .4f, .65f };
+
+  auto compare = [&](const RayExtents::View& view, const float* sceneDepth)
+  {
+    HDRImage traced, rasterised;
+    traced.resize(width, height);
+    rasterised.resize(width, height);
+    ThreadPool pool(2);
+    RayExtents::trace(view, sceneDepth, traced, &pool);
+    RayExtents::rasterise(view, sceneDepth, rasterised);
+
+    // Coverage may only differ along the box's silhouette, where pixel centres land on an edge
+    // Screen positions are left out, the rasterised ones being the corners' NDC interpolated perspective correctly rather than each pixel's centre
+    UInt covered = 0, differing = 0;
+    float maxDepthError = .0f, maxScreenError = .0f;
+    for (UInt y = 0; y < height; ++y)
+    {
+      for (UInt x = 0; x < width; ++x)
+      {
+        const XMFLOAT4& a = traced.at(x, y);
+        const XMFLOAT4& b = rasterised.at(x, y);
+        bool aMasked = a.x < .0f || a.y < .0f, bMasked = b.x < .0f || b.y < .0f;
+        if (aMasked != bMasked) { ++differing; continue; }
+        if (aMasked) { continue; }
+
+        ++covered;
+        maxDepthError = std::max({ maxDepthError, std::abs(a.x - b.x), std::abs(a.y - b.y) });
+        float centreX = (float(x) + .5f) / float(width) * 2.f - 1.f, centreY = 1.f - (float(y) + .5f) / float(height) * 2.f;
+        maxScreenError = std::max({ maxScreenError, std::abs(a.z - centreX), std::abs(a.w - centreY) });
+      }
+    }
+
+    CHECK(covered > width * height / 20);
+    CHECK(differing <= width / 10);
+    CHECK(maxDepthError < 1e-5f);
+    CHECK(maxScreenError == .0f);
+    return covered;
+  };
+
+  SECTION("From outside")
+  {
+    float camera[3] = { -.135f, -.475f, 6.345f };
+    RayExtents::View view = extentsView(camera, XM_PI, 4.f, box, width, height);
+    compare(view, nullptr);
+
+    // Anything nearer than the box's middle hides its far half, and its near half where nearer still
+    HDRImage open;
+    open.resize(width, height);
+    RayExtents::trace(view, nullptr, open);
+    std::vector<float> sceneDepth(size_t(width) * height, 1.f);
+    for (UInt y = 0; y < height; ++y)
+    {
+      for (UInt x = width / 2; x < width; ++x)
+      {
+        const XMFLOAT4& ray = open.at(x, y);
+        if (ray.y >= .0f) { sceneDepth[x + size_t(width) * y] = y < height / 2 ? (ray.x + ray.y) * .5f : ray.x * .5f; }
+      }
+    }
+    compare(view, sceneDepth.data());
+
+    HDRImage occluded;
+    occluded.resize(width, height);
+    RayExtents::trace(view, sceneDepth.data(), occluded);
+    for (UInt y = 0; y < height; y += 7)
+    {
+      for (UInt x = width / 2; x < width; x += 7)
+      {
+        if (open.at(x, y).y < .0f) { continue; }
+        CHECK((y < height / 2 ? occluded.at(x, y).y == sceneDepth[x + size_t(width) * y] : occluded.at(x, y).x < .0f));
+      }
+    }
+  }
+
+  SECTION("From within")
+  {
+    // Every ray starts at the near plane
+    float camera[3] = { .3f, .1f, .2f };
+    RayExtents::View view = extentsView(camera, XM_PI, 4.f, box, width, height);
+    CHECK(compare(view, nullptr) == width * height);
+  }
+}
@@ -0,0 +1,141 @@
+// Headless ground truth renders with the CPU reference marcher, built as ReferenceApp only
+#ifdef HABOOB_REFERENCE_APP
+#include "Rendering/Raymarch/ReferenceMarcher.h"
+#include "Rendering/Raymarch/SpectralOptics.h"
+#include "Rendering/Volume/VolumeGenerator.h"
+
+#include <args.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+using namespace Haboob;
+int main(int argc, char* argv[])
+{
+  args::ArgumentParser parser("Render a beautiful haboob, on the CPU.", "Defaults follow the app's opening frame");
+  args::HelpFlag help(parser, "help", "Display this help menu.", { 'h', "help" });
+  args::ValueFlag<UInt> iterationsFlag(parser, "SampleCount", "The number of samples per ray", { "it" }, 52);
+  args::ValueFlag<UInt> lightIterationsFlag(parser, "LightSampleCount", "Samples toward the light per sample, 0 for no Beer Shadow Map", { "lit" }, 0);
+  args::ValueFlag<bool> skipEmptyFlag(parser, "SkipEmptySpace", "If the steps should only be spent within occupied macro cells", { "ses" }, false);
+  args::ValueFlag<bool> adaptiveFlag(parser, "AdaptiveMarch", "If steps should scale with density and rays stop once opaque", { "am" }, false);
+  args::ValueFlag<bool> transmissionLUTFlag(parser, "TransmissionLUT", "If spectral transmissions should be looked up rather than evaluated per sample", { "tlut" }, false);
+  args::ValueFlag<bool> tileListFlag(parser, "TileList", "If only the tiles with a ray through the volume should be scheduled", { "tl" }, false);
+  args::ValueFlag<UInt> framesFlag(parser, "Frames", "Blue noise jittered frames to average, 1 for a single frame from the fixed start", { "frames" }, 1);
+  args::ValueFlag<UInt> widthFlag(parser, "Width", "The output width", { "w" }, 256);
+  args::ValueFlag<UInt> heightFlag(parser, "Height", "The output height", { "h" }, 256);
+  args::ValueFlag<int> volumeSizeFlag(parser, "VolumeSize", "The volume resolution per axis", { "vs" }, 128);
+  args::ValueFlag<float> timeFlag(parser, "Time", "The haboob motion time", { "t" }, .0f);
+  args::ValueFlag<UInt> threadsFlag(parser, "Threads", "Worker threads, 0 for one per hardware thread", { "threads" }, 0);
+  args::ValueFlag<std::string> outputFlag(parser, "Output", "The output path", { "o" }, "Reference.dds");
+
+  try
+  {
+    parser.ParseCLI(argc, argv);
+  }
+  catch (args::Help&)
+  {
+    std::cout << parser;
+    return 0;
+  }
+  catch (args::ParseError& e)
+  {
+    std::cerr << e.what() << std::endl;
+    std::cerr << parser;
+    return 1;
+  }
+
+  ThreadPool pool(args::get(threadsFlag));
+  auto start = std::chrono::steady_clock::now();
+
+  // Volume
+  VolumeInfo volumeInfo;
+  volumeInfo.size = { args::get(volumeSizeFlag), args::get(volumeSizeFlag), args::get(volumeSizeFlag) };
+  volumeInfo.motion.time = args::get(timeFlag);
+  VolumeGrid grid;
+  VolumeGenerator(&pool).generate(volumeInfo, grid);
+
+  ReferenceMarcher marcher(&pool);
+  marcher.getSettings().lightIterations = args::get(lightIterationsFlag);
+  marcher.getSettings().skipEmpty = args::get(skipEmptyFlag);
+  marcher.getSettings().marchAdaptive = args::get(adaptiveFlag);
+  marcher.getSettings().transmissionLUT = args::get(transmissionLUTFlag);
+  marcher.getSettings().compactTiles = args::get(tileListFlag);
+  marcher.setVolume(grid);
+
+  // Camera (HaboobWindow::setupDefaults and adjustProjection)
+  UInt width = args::get(widthFlag), height = args::get(heightFlag);
+  float fov = XM_PIDIV4;
+  float nearZ = .1f;
+  CameraPack camera;
+  {
+    XMVECTOR position = XMVectorSet(-.135f, -.475f, 6.345f, 1.f);
+    XMMATRIX direction = XMMatrixRotationRollPitchYaw(.0f, XM_PI, .0f);
+    XMVECTOR forward = XMVector3TransformCoord(XMVectorSet(.0f, .0f, 1.f, 1.f), direction);
+    XMVECTOR up = XMVector3TransformCoord(XMVectorSet(.0f, 1.f, .0f, 1.f), direction);
+
+    camera.viewMatrix = XMMatrixLookToLH(position, forward, up);
+    camera.projectionMatrix = XMMatrixPerspectiveFovLH(fov, float(width) / float(height), nearZ, 100.f);
+    camera.inverseViewProjectionMatrix = XMMatrixInverse(nullptr, camera.viewMatrix * camera.projectionMatrix);
+  }
+
+  // Light and optics (HaboobWindow::renderBegin)
+  DirectionalLightPack light;
+  light.diffuse = { 3.96f, 3.92f, 3.14f };
+  light.ambient = { 0.96f, 0.92f, 0.14f };
+  light.direction = { -1.f, .25f, .0f, 1.f };
+
+  BasicOptics optics;
+  optics.anisotropicForwardTerms = { .735f, .732f, .651f, .735f };
+  optics.anisotropicBackwardTerms = { -.6f, -.732f, -.651f, -.735f };
+  optics.phaseBlendWeightTerms = { .17f, .11f, .2f, .2f, };
+  optics.scatterAngstromExponent = 2.1f;
+  optics.ambientFraction = { .8f, 1.f, 1.f, 1.f, };
+  optics.absorptionAngstromExponent = 2.3f;
+  optics.powderCoefficient = .035f;
+  optics.attenuationFactor = 16.1f;
+  SpectralOptics::buildMatrices(optics);
+
+  // The haboob's bounds (HaboobWindow::onStart)
+  MarchVolumeDispatchInfo marchInfo;
+  {
+    XMFLOAT3 boxScale = { 4.f, 4.f, 4.f };
+    XMMATRIX boxTransform = XMMatrixTransformation(XMVectorZero(), XMQuaternionIdentity(), XMLoadFloat3(&boxScale), XMVectorZero(),
+      XMVectorSet(.0f, .5f, .0f, .866f), XMVectorSet(.0f, .4f, .65f, 1.f));
+
+    marchInfo.iterations = args::get(iterationsFlag);
+    marchInfo.texelDensity = float(volumeInfo.size.x);
+    marchInfo.localVolumeTransform = XMMatrixInverse(nullptr, boxTransform);
+    marchInfo.volumeSize = boxScale;
+
+    float zStepRadius = std::tan(fov * .5f) * (2.f / float(height)) * std::sqrt(2.f);
+    marchInfo.pixelRadius = zStepRadius * nearZ;
+    marchInfo.pixelRadiusDelta = zStepRadius;
+  }
+
+  HDRImage image, frame;
+  image.resize(width, height);
+  frame.resize(width, height);
+  UInt frames = std::max(args::get(framesFlag), 1U);
+  marcher.getSettings().jitter = frames > 1;
+  for (UInt i = 0; i < frames; ++i)
+  {
+    marcher.getSettings().frame = i;
+    marcher.render(camera, light, marchInfo, optics, frame);
+    image.accumulate(frame, i);
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "Rendered " << width << "x" << height << " at " << marchInfo.iterations << " samples over " << frames << " frames in " << seconds << "s on "
+    << pool.getThreadCount() << " threads" << std::endl;
+
+  if (!image.writeDDS(args::get(outputFlag)))
+  {
+    std::cerr << "Could not write " << args::get(outputFlag) << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+#include <filesystem>
+#include <system_error>
+
+namespace Haboob
+{
+  // A scratch cache directory under the system's temporary one, emptied on entry and exit
+  struct ScratchCache
+  {
+    ScratchCache(const char* name) : directory{ std::filesystem::temp_directory_path() / name }
+    {
+      std::filesystem::remove_all(directory);
+    }
+
+    ~ScratchCache()
+    {
+      std::error_code error;
+      std::filesystem::remove_all(directory, error);
+    }
+
+    std::filesystem::path directory;
+  };
+}
@@ -0,0 +1,747 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "Rendering/Shaders/ShaderBlobCache.h"
+#include "Rendering/Shaders/ShaderCompileQueue.h"
+#include "Rendering/Shaders/ShaderDependencies.h"
+#include "Rendering/Shaders/ShaderIncludeStore.h"
+#include "Rendering/Shaders/ShaderPermutations.h"
+#include "ScratchCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+using namespace Haboob;
+
+namespace
+{
+  // Stands in for D3DCompileFromFile, the bytecode naming what it was compiled from
+  class StubCompiler : public ShaderCompiler
+  {
+    public:
+    bool compile(const std::wstring& path, const std::string& profile, const ShaderMacros& macros, ShaderBytecode& bytecode, std::string& errors) final
+    {
+      ++compiles;
+      if (macros.count("BROKEN"))
+      {
+        errors = "error X3000: broken";
+        return false;
+      }
+
+      std::string text = std::string(path.begin(), path.end()) + ":" + profile;
+      for (auto& it : macros)
+      {
+        text += ";" + it.first + "=" + it.second;
+      }
+      bytecode.assign(text.begin(), text.end());
+
+      return true;
+    }
+
+    UInt compiles = 0;
+  };
+
+  inline std::string toText(const ShaderBytecode& bytecode)
+  {
+    return std::string(bytecode.begin(), bytecode.end());
+  }
+
+  // The repository's shaders
+  inline std::wstring getShaderPath(const char* relativePath)
+  {
+    return (std::filesystem::path(HABOOB_SHADER_DIRECTORY) / relativePath).wstring();
+  }
+
+  // Files held in memory by path
+  ShaderDependencies::FileReader readFrom(const std::map<std::wstring, std::string>& files)
+  {
+    return [&files](const std::wstring& path, std::string& text)
+    {
+      auto fileIt = files.find(path);
+      if (fileIt == files.end()) { return false; }
+
+      text = fileIt->second;
+      return true;
+    };
+  }
+}
+
+TEST_CASE("Shader permutations are keyed by path, profile and macros", "[shaders]")
+{
+  ShaderMacros macros = { { "APPLY_BEER", "1" }, { "MARCH_STEP_COUNT", "52" } };
+  uint64_t key = ShaderPermutationCache::getKey(L"Raymarch/MarchVolume.cs", "cs_5_0", macros);
+
+  // Stable, and independent of the order macros are set in
+  ShaderMacros reordered;
+  reordered.insert({ "MARCH_STEP_COUNT", "52" });
+  reordered.insert({ "APPLY_BEER", "1" });
+  CHECK(ShaderPermutationCache::getKey(L"Raymarch/MarchVolume.cs", "cs_5_0", reordered) == key);
+
+  // Any part changing changes the key
+  CHECK(ShaderPermutationCache::getKey(L"Raymarch/ToneMap.cs", "cs_5_0", macros) != key);
+  CHECK(ShaderPermutationCache::getKey(L"Raymarch/MarchVolume.cs", "cs_5_1", macros) != key);
+
+  ShaderMacros changed = macros;
+  changed["APPLY_BEER"] = "0";
+  CHECK(ShaderPermutationCache::getKey(L"Raymarch/MarchVolume.cs", "cs_5_0", changed) != key);
+
+  ShaderMacros extra = macros;
+  extra["APPLY_HG"] = "1";
+  CHECK(ShaderPermutationCache::getKey(L"Raymarch/MarchVolume.cs", "cs_5_0", extra) != key);
+
+  // Names and values cannot run into each other
+  CHECK(ShaderPermutationCache::getKey(L"A.cs", "cs_5_0", { { "AB", "1" } }) != ShaderPermutationCache::getKey(L"A.cs", "cs_5_0", { { "A", "B1" } }));
+}
+
+TEST_CASE("Returning to a shader permutation needs no compilation", "[shaders]")
+{
+  StubCompiler compiler;
+  ShaderPermutationCache cache(&compiler);
+
+  ShaderMacros spectral = { { "APPLY_SPECTRAL", "1" } };
+  ShaderMacros plain = { { "APPLY_SPECTRAL", "0" } };
+
+  const ShaderPermutation* first = cache.get(L"MarchVolume.cs", "cs_5_0", spectral);
+  REQUIRE(first);
+  CHECK(toText(first->bytecode) == "MarchVolume.cs:cs_5_0;APPLY_SPECTRAL=1");
+  CHECK(first->key == ShaderPermutationCache::getKey(L"MarchVolume.cs", "cs_5_0", spectral));
+
+  const ShaderPermutation* second = cache.get(L"MarchVolume.cs", "cs_5_0", plain);
+  REQUIRE(second);
+  CHECK(toText(second->bytecode) == "MarchVolume.cs:cs_5_0;APPLY_SPECTRAL=0");
+  CHECK(compiler.compiles == 2);
+
+  // Flipping back is a lookup, handing out the same permutation
+  CHECK(cache.get(L"MarchVolume.cs", "cs_5_0", spectral) == first);
+  CHECK(cache.get(L"MarchVolume.cs", "cs_5_0", plain) == second);
+  CHECK(compiler.compiles == 2);
+  CHECK(cache.getCompileCount() == 2);
+  CHECK(cache.getHitCount() == 2);
+  CHECK(cache.getSize() == 2);
+
+  // The same macros for another shader or stage is its own permutation
+  CHECK(cache.get(L"MarchVolume.cs", "ps_5_0", spectral) != first);
+  CHECK(cache.get(L"ToneMap.cs", "cs_5_0", spectral) != first);
+  CHECK(compiler.compiles == 4);
+
+  // Cleared permutations are compiled again
+  cache.clear();
+  CHECK(cache.getSize() == 0);
+  REQUIRE(cache.get(L"MarchVolume.cs", "cs_5_0", spectral));
+  CHECK(compiler.compiles == 5);
+}
+
+TEST_CASE("Failed shader permutations are retried", "[shaders]")
+{
+  StubCompiler compiler;
+  ShaderPermutationCache cache(&compiler);
+
+  std::string errors;
+  CHECK_FALSE(cache.get(L"MarchVolume.cs", "cs_5_0", { { "BROKEN", "1" } }, 0, &errors));
+  CHECK(errors == "error X3000: broken");
+  CHECK_FALSE(cache.get(L"MarchVolume.cs", "cs_5_0", { { "BROKEN", "1" } }));
+  CHECK(compiler.compiles == 2);
+  CHECK(cache.getSize() == 0);
+
+  // Without a backend nothing new can be compiled
+  ShaderPermutationCache empty;
+  CHECK_FALSE(empty.get(L"MarchVolume.cs", "cs_5_0", {}));
+}
+
+TEST_CASE("Shaders only depend on the macros their include closure references", "[shaders]")
+{
+  ShaderDependencies march;
+  REQUIRE(march.scan(getShaderPath("Raymarch/MarchVolume.cs")));
+  CHECK(march.getMissing().empty());
+  CHECK_FALSE(march.isOpaque());
+
+  // Through MarchVolumeMacros.lib and RaymarchCommon.lib, to the Utility libraries beside neither
+  auto& files = march.getFiles();
+  CHECK(files.front() == std::filesystem::path(getShaderPath("Raymarch/MarchVolume.cs")).lexically_normal().wstring());
+  CHECK(std::count(files.begin(), files.end(), std::filesystem::path(getShaderPath("Utility/Globals.lib")).lexically_normal().wstring()) == 1);
+  CHECK(std::count(files.begin(), files.end(), std::filesystem::path(getShaderPath("Utility/MeshCommon.lib")).lexically_normal().wstring()) == 1);
+
+  CHECK(march.references("APPLY_SPECTRAL"));
+  CHECK(march.references("MACRO_MANAGED"));
+  CHECK(march.references("MARCH_STEP_COUNT"));
+
+  ShaderDependencies light;
+  REQUIRE(light.scan(getShaderPath("Lighting/DeferredLightPass.cs")));
+  CHECK(light.references("APPLY_SPECTRAL"));
+
+  ShaderDependencies mesh;
+  REQUIRE(mesh.scan(getShaderPath("Raster/DeferredMeshShaderP.ps")));
+  CHECK_FALSE(mesh.references("APPLY_SPECTRAL"));
+  CHECK(mesh.references("TEXTURE_GRAPH"));
+
+  ShaderDependencies tone;
+  REQUIRE(tone.scan(getShaderPath("Lighting/ToneMap.cs")));
+  CHECK(tone.getFiles().size() == 1);
+  CHECK_FALSE(tone.references("APPLY_SPECTRAL"));
+  CHECK_FALSE(tone.references("MACRO_MANAGED"));
+
+  // So flipping spectral keeps the tone map's permutation, but not the march's
+  ShaderMacros managed = { { "MACRO_MANAGED", "1" }, { "APPLY_SPECTRAL", "1" }, { "TEXTURE_GRAPH", "0" } };
+  ShaderMacros flipped = managed;
+  flipped["APPLY_SPECTRAL"] = "0";
+  CHECK(tone.filter(managed).empty());
+  CHECK(tone.filter(managed) == tone.filter(flipped));
+  CHECK(mesh.filter(managed) == mesh.filter(flipped));
+  CHECK(march.filter(managed) != march.filter(flipped));
+  CHECK(march.filter(managed).count("TEXTURE_GRAPH") == 0);
+
+  CHECK_FALSE(ShaderDependencies().scan(getShaderPath("Raymarch/Missing.cs")));
+}
+
+TEST_CASE("Every shader's includes resolve", "[shaders]")
+{
+  UInt shaders = 0;
+  for (auto& entry : std::filesystem::recursive_directory_iterator(HABOOB_SHADER_DIRECTORY))
+  {
+    std::string extension = entry.path().extension().string();
+    if (extension != ".cs" && extension != ".ps" && extension != ".vs") { continue; }
+
+    ShaderDependencies dependencies;
+    INFO(entry.path().string());
+    CHECK(dependencies.scan(entry.path().wstring()));
+    CHECK(dependencies.getMissing().empty());
+    ++shaders;
+  }
+
+  CHECK(shaders >= 20);
+}
+
+TEST_CASE("Shader includes resolve as the include handler does", "[shaders]")
+{
+  // The shader's own directory first, then the including files' from the innermost
+  std::map<std::wstring, std::string> files = {
+    { L"root/a/Shader.cs", "#include \"../b/Outer.lib\"\n#include \"Local.lib\"\nfloat f = SHADER_MACRO;" },
+    { L"root/a/Local.lib", "#define LOCAL 1" },
+    { L"root/b/Outer.lib", "  #  include \"../c/Inner.lib\"\n#include \"Local.lib\"" },
+    { L"root/b/Local.lib", "OUTER_LOCAL" },
+    { L"root/c/Inner.lib", "#include \"Beside.lib\"\n#include \"Nowhere.lib\"" },
+    { L"root/c/Beside.lib", "INNER_BESIDE" },
+  };
+
+  ShaderDependencies dependencies(readFrom(files));
+  REQUIRE(dependencies.scan(L"root/a/Shader.cs"));
+
+  std::vector<std::wstring> order = { L"root/a/Shader.cs", L"root/b/Outer.lib", L"root/c/Inner.lib", L"root/c/Beside.lib", L"root/a/Local.lib" };
+  std::vector<std::wstring> found;
+  for (auto& file : dependencies.getFiles())
+  {
+    found.push_back(std::filesystem::path(file).generic_wstring());
+  }
+  CHECK(found == order);
+
+  // Outer.lib's Local.lib is the shader's, found first
+  CHECK_FALSE(dependencies.references("OUTER_LOCAL"));
+  CHECK(dependencies.references("INNER_BESIDE"));
+  CHECK(dependencies.references("LOCAL"));
+  CHECK(dependencies.references("SHADER_MACRO"));
+  std::vector<std::string> missing = { "Nowhere.lib" };
+  CHECK(dependencies.getMissing() == missing);
+}
+
+TEST_CASE("Macro scanning skips comments, strings and numbers", "[shaders]")
+{
+  std::map<std::wstring, std::string> files = {
+    { L"Shader.cs", "// LINE_COMMENT\n/* BLOCK\n COMMENT */ float x = 1e-3f + 0xFFu + .5e+2;\nstring s = \"IN_\\\"STRING\";\n#if USED && \\\n  CONTINUED\n#endif" },
+    { L"Pasted.cs", "#define NAME(a) PREFIX_##a\nNAME(B)" },
+    { L"Computed.cs", "#include INCLUDE_FILE" },
+  };
+
+  ShaderDependencies dependencies(readFrom(files));
+  REQUIRE(dependencies.scan(L"Shader.cs"));
+  CHECK_FALSE(dependencies.isOpaque());
+  std::set<std::string> identifiers = { "float", "x", "string", "s", "USED", "CONTINUED" }; // Not directive names
+  CHECK(dependencies.getIdentifiers() == identifiers);
+
+  // Pasted or computed names could be any macro
+  REQUIRE(dependencies.scan(L"Pasted.cs"));
+  CHECK(dependencies.isOpaque());
+  CHECK(dependencies.filter({ { "ANYTHING", "1" } }).size() == 1);
+
+  REQUIRE(dependencies.scan(L"Computed.cs"));
+  CHECK(dependencies.isOpaque());
+}
+
+TEST_CASE("Shader content hashes cover every included file", "[shaders][cache]")
+{
+  std::map<std::wstring, std::string> files = {
+    { L"a/Shader.cs", "#include \"Common.lib\"\nfloat f;" },
+    { L"a/Common.lib", "float g;" },
+  };
+
+  ShaderDependencies dependencies(readFrom(files));
+  REQUIRE(dependencies.scan(L"a/Shader.cs"));
+  uint64_t hash = dependencies.getContentHash();
+  CHECK(hash != 0);
+
+  REQUIRE(dependencies.scan(L"a/Shader.cs"));
+  CHECK(dependencies.getContentHash() == hash);
+
+  // Whitespace in an include matters as much as in the shader
+  files[L"a/Common.lib"] = "float g; ";
+  REQUIRE(dependencies.scan(L"a/Shader.cs"));
+  CHECK(dependencies.getContentHash() != hash);
+}
+
+TEST_CASE("Shader blobs round trip through the disk cache", "[shaders][cache]")
+{
+  ScratchCache scratch("HaboobShaderBlobCacheTest");
+  ShaderBlobCache cache(scratch.directory);
+
+  ShaderMacros macros = { { "APPLY_SPECTRAL", "1" } };
+  uint64_t key = ShaderBlobCache::getKey(1234, "cs_5_0", macros, 5678);
+  CHECK(ShaderBlobCache::getKey(1235, "cs_5_0", macros, 5678) != key);
+  CHECK(ShaderBlobCache::getKey(1234, "ps_5_0", macros, 5678) != key);
+  CHECK(ShaderBlobCache::getKey(1234, "cs_5_0", {}, 5678) != key);
+  CHECK(ShaderBlobCache::getKey(1234, "cs_5_0", macros, 5679) != key);
+
+  ShaderBytecode bytecode = { 0x44, 0x58, 0x42, 0x43, 0, 1, 2, 3, 255 };
+  ShaderBytecode loaded;
+  CHECK_FALSE(cache.load(key, loaded));
+  REQUIRE(cache.store(key, bytecode));
+  REQUIRE(cache.load(key, loaded));
+  CHECK(loaded == bytecode);
+
+  // Only the entry remains, no staging files
+  UInt entries = 0;
+  for (auto& entry : std::filesystem::directory_iterator(scratch.directory))
+  {
+    CHECK(entry.path() == cache.getPath(key));
+    ++entries;
+  }
+  CHECK(entries == 1);
+
+  // A flipped byte fails the checksum and removes the entry
+  {
+    std::fstream file(cache.getPath(key), std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(-1, std::ios::end);
+    file.put(char(0));
+  }
+  CHECK_FALSE(cache.load(key, loaded));
+  CHECK_FALSE(std::filesystem::exists(cache.getPath(key)));
+
+  // As does a truncated one
+  REQUIRE(cache.store(key, bytecode));
+  std::filesystem::resize_file(cache.getPath(key), std::filesystem::file_size(cache.getPath(key)) - 1);
+  CHECK_FALSE(cache.load(key, loaded));
+
+  // Bounded on store, each edit's permutation pushing out the least recently loaded
+  REQUIRE(cache.store(1, bytecode));
+  uint64_t entrySize = std::filesystem::file_size(cache.getPath(1));
+  cache.setCapacity(entrySize * 2);
+  REQUIRE(cache.store(2, bytecode));
+  std::filesystem::last_write_time(cache.getPath(1), std::filesystem::last_write_time(cache.getPath(2)) - std::chrono::seconds(1));
+  REQUIRE(cache.load(1, loaded));
+  REQUIRE(cache.store(3, bytecode));
+  CHECK(std::filesystem::exists(cache.getPath(1)));
+  CHECK_FALSE(std::filesystem::exists(cache.getPath(2)));
+  CHECK(std::filesystem::exists(cache.getPath(3)));
+  CHECK(cache.getUsage() == entrySize * 2);
+
+  // Disabled without a directory
+  ShaderBlobCache disabled;
+  CHECK_FALSE(disabled.store(key, bytecode));
+  CHECK_FALSE(disabled.load(key, loaded));
+}
+
+TEST_CASE("Repeat launches load every shader permutation from disk", "[shaders][cache]")
+{
+  ScratchCache scratch("HaboobShaderLaunchTest");
+  ShaderBlobCache blobs(scratch.directory);
+  ShaderMacros macros = { { "APPLY_SPECTRAL", "1" } };
+
+  StubCompiler firstCompiler;
+  {
+    ShaderPermutationCache first(&firstCompiler);
+    first.setBlobCache(&blobs);
+    REQUIRE(first.get(L"MarchVolume.cs", "cs_5_0", macros, 1));
+    REQUIRE(first.get(L"ToneMap.cs", "cs_5_0", {}, 2));
+    CHECK(first.getCompileCount() == 2);
+    CHECK(first.getLoadCount() == 0);
+  }
+
+  // A fresh launch with the same sources compiles nothing
+  StubCompiler secondCompiler;
+  ShaderPermutationCache second(&secondCompiler);
+  second.setBlobCache(&blobs);
+  const ShaderPermutation* march = second.get(L"MarchVolume.cs", "cs_5_0", macros, 1);
+  REQUIRE(march);
+  CHECK(toText(march->bytecode) == "MarchVolume.cs:cs_5_0;APPLY_SPECTRAL=1");
+  REQUIRE(second.get(L"ToneMap.cs", "cs_5_0", {}, 2));
+  CHECK(secondCompiler.compiles == 0);
+  CHECK(second.getLoadCount() == 2);
+
+  // Edited sources, or unknown contents, compile
+  REQUIRE(second.get(L"MarchVolume.cs", "cs_5_1", macros, 3));
+  REQUIRE(second.get(L"Other.cs", "cs_5_0", {}, 0));
+  CHECK(secondCompiler.compiles == 2);
+}
+
+namespace
+{
+  // Holds every job until opened, so tests can observe work in flight
+  struct Gate
+  {
+    void pass()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      signal.wait(lock, [this]() { return open; });
+    }
+
+    void release()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        open = true;
+      }
+      signal.notify_all();
+    }
+
+    std::mutex mutex;
+    std::condition_variable signal;
+    bool open = false;
+  };
+}
+
+TEST_CASE("Shaders keep their compilation until the replacement is collected", "[shaders][async]")
+{
+  StubCompiler compiler;
+  ShaderPermutationCache cache(&compiler);
+  ThreadPool pool(2);
+  ShaderCompileQueue queue(&pool);
+  Gate gate;
+
+  int owner = 0;
+  ShaderCompileHandle handle = queue.submit(&owner, [&]()
+  {
+    gate.pass();
+    ShaderCompileResult result;
+    result.permutation = cache.get(L"MarchVolume.cs", "cs_5_0", {});
+    return result;
+  });
+
+  // Nothing to swap in while the compilation runs
+  std::map<const void*, const ShaderPermutation*> applied;
+  auto apply = [&](const void* key, const ShaderCompileResult& result) { applied[key] = result.permutation; };
+  CHECK(queue.isBusy());
+  CHECK(queue.collect(apply) == 0);
+  CHECK(applied.empty());
+
+  gate.release();
+  handle.wait();
+  CHECK(queue.collect(apply) == 1);
+  REQUIRE(applied.count(&owner));
+  REQUIRE(applied[&owner]);
+  CHECK(toText(applied[&owner]->bytecode) == "MarchVolume.cs:cs_5_0");
+  CHECK_FALSE(queue.isBusy());
+
+  // Collected once
+  CHECK(queue.collect(apply) == 0);
+}
+
+TEST_CASE("Superseded shader compilations are dropped", "[shaders][async]")
+{
+  ThreadPool pool(2);
+  ShaderCompileQueue queue(&pool);
+
+  int first = 0;
+  int second = 0;
+  auto job = [](const char* errors)
+  {
+    return [errors]()
+    {
+      ShaderCompileResult result;
+      result.errors = errors;
+      return result;
+    };
+  };
+
+  queue.submit(&first, job("old"));
+  queue.submit(&first, job("new"));
+  queue.submit(&second, job("cancelled"));
+  queue.cancel(&second);
+  CHECK(queue.getPendingCount() == 1);
+  queue.wait();
+
+  std::vector<std::string> collected;
+  CHECK(queue.collect([&](const void*, const ShaderCompileResult& result) { collected.push_back(result.errors); }) == 1);
+  REQUIRE(collected.size() == 1);
+  CHECK(collected[0] == "new");
+
+  // Throwing jobs are reported rather than lost
+  queue.submit(&first, []() -> ShaderCompileResult { throw std::runtime_error("out of memory"); });
+  queue.wait();
+  collected.clear();
+  queue.collect([&](const void*, const ShaderCompileResult& result) { collected.push_back(result.errors); });
+  REQUIRE(collected.size() == 1);
+  CHECK(collected[0] == "out of memory");
+}
+
+TEST_CASE("Shader compilations run inline without a pool", "[shaders][async]")
+{
+  ShaderCompileQueue queue;
+  bool ran = false;
+  int owner = 0;
+  queue.submit(&owner, [&]() { ran = true; return ShaderCompileResult(); });
+  CHECK(ran);
+  CHECK(queue.collect([](const void*, const ShaderCompileResult&) {}) == 1);
+}
+
+TEST_CASE("Shader compilations run in parallel", "[shaders][async]")
+{
+  constexpr UInt JOBS = 4;
+  ThreadPool pool(JOBS);
+  ShaderCompileQueue queue(&pool);
+
+  // Every job waits for all of them to start, which only finishes if they run at once
+  std::mutex mutex;
+  std::condition_variable signal;
+  UInt started = 0;
+  std::atomic<UInt> together{ 0 };
+  std::vector<int> owners(JOBS);
+  for (UInt i = 0; i < JOBS; ++i)
+  {
+    queue.submit(&owners[i], [&]()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      ++started;
+      signal.notify_all();
+      if (signal.wait_for(lock, std::chrono::seconds(10), [&]() { return started == JOBS; })) { ++together; }
+      return ShaderCompileResult();
+    });
+  }
+
+  queue.wait();
+  CHECK(together == JOBS);
+  CHECK(queue.collect([](const void*, const ShaderCompileResult&) {}) == JOBS);
+}
+
+TEST_CASE("Concurrent requests for a shader permutation compile it once", "[shaders][async]")
+{
+  // Slow enough that every request arrives while the first compiles
+  class SlowCompiler : public ShaderCompiler
+  {
+    public:
+    bool compile(const std::wstring&, const std::string&, const ShaderMacros&, ShaderBytecode& bytecode, std::string&) final
+    {
+      ++compiles;
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      bytecode.assign(4, Byte(1));
+      return true;
+    }
+
+    std::atomic<UInt> compiles{ 0 };
+  };
+
+  SlowCompiler compiler;
+  ShaderPermutationCache cache(&compiler);
+  ThreadPool pool(4);
+
+  std::vector<const ShaderPermutation*> results(8, nullptr);
+  pool.parallelFor(UInt(results.size()), [&](UInt i)
+  {
+    results[i] = cache.get(L"MarchVolume.cs", "cs_5_0", { { "APPLY_SPECTRAL", "1" } });
+  });
+
+  CHECK(compiler.compiles == 1);
+  for (auto* result : results)
+  {
+    CHECK(result);
+    CHECK(result == results[0]);
+  }
+  CHECK(cache.getHitCount() == UInt(results.size() - 1));
+}
+
+TEST_CASE("Shader sources are read once and kept in place", "[shaders][includes]")
+{
+  std::map<std::wstring, std::string> files = {
+    { L"root/Globals.lib", "cbuffer Globals {};" },
+  };
+  UInt reads = 0;
+  auto reader = readFrom(files);
+  ShaderIncludeStore store([&](const std::wstring& path, std::string& text) { ++reads; return reader(path, text); });
+
+  const ShaderIncludeFile* globals = store.get(L"root/Globals.lib");
+  REQUIRE(globals);
+  CHECK(globals->text == "cbuffer Globals {};");
+  CHECK(std::filesystem::path(globals->directory).generic_wstring() == L"root");
+
+  // The same file however it is named
+  CHECK(store.get(L"root/Globals.lib") == globals);
+  CHECK(store.get(L"root/sub/../Globals.lib") == globals);
+  CHECK(reads == 1);
+  CHECK(store.getSize() == 1);
+  CHECK(store.getHitCount() == 2);
+  CHECK(store.getMissCount() == 1);
+
+  // As are missing files, until cleared
+  CHECK_FALSE(store.get(L"root/Missing.lib"));
+  files[L"root/Missing.lib"] = "";
+  CHECK_FALSE(store.get(L"root/Missing.lib"));
+  CHECK(reads == 2);
+  CHECK(store.getHitCount() == 3);
+
+  store.clear();
+  CHECK(store.get(L"root/Missing.lib"));
+  CHECK(store.get(L"root/Globals.lib"));
+  CHECK(reads == 4);
+}
+
+TEST_CASE("Edited shader sources compile a new permutation once reloaded", "[shaders][includes]")
+{
+  std::map<std::wstring, std::string> files = {
+    { L"root/Shader.cs", "#include \"Common.lib\"\nfloat f = APPLY_SPECTRAL;" },
+    { L"root/Common.lib", "float g;" },
+  };
+  ShaderIncludeStore store(readFrom(files));
+  auto scan = [&store]()
+  {
+    // As ShaderManager scans, through the store
+    ShaderDependencies dependencies([&store](const std::wstring& path, std::string& text)
+    {
+      const ShaderIncludeFile* file = store.get(path);
+      if (!file) { return false; }
+
+      text = file->text;
+      return true;
+    });
+    REQUIRE(dependencies.scan(L"root/Shader.cs"));
+    return dependencies.getContentHash();
+  };
+
+  StubCompiler compiler;
+  ShaderPermutationCache cache(&compiler);
+  ShaderMacros macros = { { "APPLY_SPECTRAL", "1" } };
+
+  uint64_t original = scan();
+  const ShaderPermutation* first = cache.get(L"root/Shader.cs", "cs_5_0", macros, original);
+  REQUIRE(first);
+  CHECK(first->key == ShaderPermutationCache::getKey(L"root/Shader.cs", "cs_5_0", macros, original));
+
+  // Interned, so unseen until the store is cleared
+  files[L"root/Common.lib"] = "float g; float h;";
+  CHECK(scan() == original);
+  CHECK(cache.get(L"root/Shader.cs", "cs_5_0", macros, original) == first);
+  CHECK(compiler.compiles == 1);
+
+  store.clear();
+  uint64_t edited = scan();
+  CHECK(edited != original);
+  const ShaderPermutation* second = cache.get(L"root/Shader.cs", "cs_5_0", macros, edited);
+  REQUIRE(second);
+  CHECK(second != first);
+  CHECK(second->key != first->key);
+  CHECK(compiler.compiles == 2);
+
+  // Undoing the edit returns to the first permutation
+  files[L"root/Common.lib"] = "float g;";
+  store.clear();
+  CHECK(cache.get(L"root/Shader.cs", "cs_5_0", macros, scan()) == first);
+  CHECK(compiler.compiles == 2);
+}
+
+TEST_CASE("Shader includes resolve once per including context", "[shaders][includes]")
+{
+  std::map<std::wstring, std::string> files = {
+    { L"root/a/Shader.cs", "" },
+    { L"root/a/Local.lib", "shader's" },
+    { L"root/b/Outer.lib", "" },
+    { L"root/b/Local.lib", "outer's" },
+    { L"root/c/Inner.lib", "" },
+    { L"root/c/Beside.lib", "inner's" },
+    { L"root/b/Beside.lib", "outer's" },
+  };
+  ShaderIncludeStore store(readFrom(files));
+
+  const ShaderIncludeFile* shader = store.get(L"root/a/Shader.cs");
+  REQUIRE(shader);
+  std::wstring root = shader->directory;
+
+  // Against the shader's directory
+  const ShaderIncludeFile* outer = store.resolve(root, {}, "../b/Outer.lib");
+  REQUIRE(outer);
+  std::vector<const ShaderIncludeFile*> open = { outer };
+  const ShaderIncludeFile* inner = store.resolve(root, open, "../c/Inner.lib");
+  REQUIRE(inner);
+
+  // The shader's directory wins over the includer's
+  const ShaderIncludeFile* local = store.resolve(root, open, "Local.lib");
+  REQUIRE(local);
+  CHECK(local->text == "shader's");
+
+  // Then the open includes' from the innermost
+  open.push_back(inner);
+  const ShaderIncludeFile* beside = store.resolve(root, open, "Beside.lib");
+  REQUIRE(beside);
+  CHECK(beside->text == "inner's");
+  CHECK_FALSE(store.resolve(root, open, "Nowhere.lib"));
+  CHECK(store.getResolveMissCount() == 5);
+  CHECK(store.getResolveHitCount() == 0);
+
+  // Remembered, searching nothing
+  UInt misses = store.getMissCount();
+  UInt hits = store.getHitCount();
+  CHECK(store.resolve(root, open, "Beside.lib") == beside);
+  std::vector<const ShaderIncludeFile*> outerOnly = { outer };
+  CHECK(store.resolve(root, outerOnly, "Local.lib") == local);
+  CHECK_FALSE(store.resolve(root, open, "Nowhere.lib"));
+  CHECK(store.getResolveHitCount() == 3);
+  CHECK(store.getResolveMissCount() == 5);
+  CHECK(store.getMissCount() == misses);
+  CHECK(store.getHitCount() == hits);
+
+  // Another shader's directory is another context
+  const ShaderIncludeFile* outerBeside = store.resolve(outer->directory, {}, "Beside.lib");
+  REQUIRE(outerBeside);
+  CHECK(outerBeside->text == "outer's");
+}
+
+TEST_CASE("Shared shader includes are read once across every shader", "[shaders][includes]")
+{
+  std::map<std::wstring, UInt> reads;
+  ShaderIncludeStore store([&](const std::wstring& path, std::string& text)
+  {
+    ++reads[path];
+    return ShaderDependencies::readFile(path, text);
+  });
+
+  UInt shaders = 0;
+  std::set<std::wstring> closure;
+  for (auto& entry : std::filesystem::recursive_directory_iterator(HABOOB_SHADER_DIRECTORY))
+  {
+    std::string extension = entry.path().extension().string();
+    if (extension != ".cs" && extension != ".ps" && extension != ".vs") { continue; }
+
+    ShaderDependencies dependencies([&](const std::wstring& path, std::string& text)
+    {
+      const ShaderIncludeFile* file = store.get(path);
+      if (!file) { return false; }
+
+      text = file->text;
+      return true;
+    });
+    REQUIRE(dependencies.scan(entry.path().wstring()));
+    closure.insert(dependencies.getFiles().begin(), dependencies.getFiles().end());
+    ++shaders;
+  }
+
+  CHECK(shaders >= 20);
+  CHECK(store.getSize() == closure.size());
+  CHECK(store.getMissCount() == reads.size());
+  CHECK(store.getHitCount() > store.getMissCount()); // The common libraries are included by most shaders
+  for (auto& it : reads)
+  {
+    INFO(std::string(it.first.begin(), it.first.end()));
+    CHECK(it.second == 1);
+  }
+}
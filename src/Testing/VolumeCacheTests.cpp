@@ -0,0 +1,284 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#include "Data/PackedFloat.h"
+#include "Rendering/Volume/VolumeCache.h"
+#include "Rendering/Volume/VolumeGenerator.h"
+#include "Rendering/Volume/VolumeMips.h"
+#include "ScratchCache.h"
+
+using namespace Haboob;
+
+TEST_CASE("R11G11B10 packing follows the D3D rules", "[volume][cache]")
+{
+  using namespace PackedFloat;
+
+  // Exactly representable values survive
+  for (float value : { .0f, 1.f, .5f, 2.f, 64512.f, .03125f })
+  {
+    float rgb[3];
+    unpackR11G11B10(packR11G11B10(value, value, value), rgb);
+    CHECK(rgb[0] == value);
+    CHECK(rgb[1] == value);
+    CHECK(rgb[2] == value);
+  }
+
+  // Positive only, clamped to the largest finite value
+  CHECK(packR11G11B10(-1.f, .0f, .0f) == 0);
+  CHECK(packR11G11B10(1e10f, .0f, .0f) == 0x7BFU);
+  CHECK(packR11G11B10(.0f, .0f, 1e10f) == 0x3DFU << 22);
+  CHECK(packR11G11B10(std::numeric_limits<float>::infinity(), .0f, .0f) == 0x7C0U);
+  CHECK(packR11G11B10(-std::numeric_limits<float>::infinity(), .0f, .0f) == 0);
+  CHECK(packR11G11B10(std::numeric_limits<float>::quiet_NaN(), .0f, .0f) == 0x7FFU);
+
+  // Round to nearest even (1 + 1/128 is halfway between 1 and 1 + 1/64)
+  float rgb[3];
+  unpackR11G11B10(packR11G11B10(1.f + 1.f / 128.f, 1.f + 3.f / 128.f, .0f), rgb);
+  CHECK(rgb[0] == 1.f);
+  CHECK(rgb[1] == 1.f + 2.f / 64.f);
+
+  // Denormals
+  float smallest = std::ldexp(1.f, -20);
+  unpackR11G11B10(packR11G11B10(smallest, smallest * .5f, .0f), rgb);
+  CHECK(rgb[0] == smallest);
+  CHECK(rgb[1] == .0f);
+
+  // Bits shifted out of a denormal still round up past the halfway point
+  unpackR11G11B10(packR11G11B10(std::nextafter(smallest * .5f, 1.f), smallest * 1.5f, .0f), rgb);
+  CHECK(rgb[0] == smallest);
+  CHECK(rgb[1] == smallest * 2.f);
+}
+
+TEST_CASE("Volume mip levels follow the texture layout", "[volume][cache]")
+{
+  CHECK(VolumeMips::getLevelCount({ 128, 128, 128 }) == 7);
+  CHECK(VolumeMips::getLevelCount({ 64, 256, 32 }) == 5);
+  CHECK(VolumeMips::getLevelCount({ 1, 1, 1 }) == 1);
+
+  XMINT3 size = VolumeMips::getLevelSize({ 64, 16, 8 }, 4);
+  CHECK(size.x == 4);
+  CHECK(size.y == 1);
+  CHECK(size.z == 1);
+
+  VolumeGrid grid;
+  grid.resize({ 2, 2, 2 });
+  for (UInt i = 0; i < 8; ++i) { grid.getData()[i] = { float(i), float(i * 2), 1.f }; }
+
+  VolumeGrid mip;
+  VolumeMips::downsample(grid, mip);
+  REQUIRE(mip.getVoxelCount() == 1);
+  CHECK(mip.at(0, 0, 0).density == 3.5f);
+  CHECK(mip.at(0, 0, 0).maxDensity == 14.f); // The maximum, not the average
+  CHECK(mip.at(0, 0, 0).angstromExponent == 1.f);
+}
+
+TEST_CASE("Volume mip chains match repeated downsampling", "[volume][cache]")
+{
+  VolumeInfo info;
+  info.size = { 80, 36, 52 }; // Partial blocks and odd levels
+  VolumeGrid grid;
+  VolumeGenerator().generate(info, grid);
+
+  ThreadPool pool(3);
+  std::vector<VolumeGrid> mips;
+  UInt levelCount = VolumeMips::getLevelCount(info.size);
+  VolumeMips::buildChain(grid, mips, levelCount, &pool);
+  REQUIRE(mips.size() == levelCount - 1);
+
+  VolumeGrid expected = grid, next;
+  for (UInt level = 1; level < levelCount; ++level)
+  {
+    VolumeMips::downsample(expected, next);
+    std::swap(expected, next);
+
+    const VolumeGrid& mip = mips[level - 1];
+    REQUIRE(mip.getSize().x == expected.getSize().x);
+    REQUIRE(mip.getSize().y == expected.getSize().y);
+    REQUIRE(mip.getSize().z == expected.getSize().z);
+    REQUIRE(std::memcmp(mip.getData(), expected.getData(), mip.getVoxelCount() * sizeof(VolumeElement)) == 0);
+  }
+
+  // The coarsest max density bounds every full resolution density it covers
+  const VolumeGrid& coarsest = mips.back();
+  int scale = 1 << (levelCount - 1);
+  for (int z = 0; z < coarsest.getSize().z * scale; ++z)
+  {
+    for (int y = 0; y < coarsest.getSize().y * scale; ++y)
+    {
+      for (int x = 0; x < coarsest.getSize().x * scale; ++x)
+      {
+        REQUIRE(grid.at(x, y, z).density <= coarsest.at(x / scale, y / scale, z / scale).maxDensity);
+      }
+    }
+  }
+}
+
+TEST_CASE("Macro cells bound the samples around them", "[volume][cache]")
+{
+  // One dense texel near the corner of cell (1, 1, 1)
+  VolumeGrid grid;
+  grid.resize({ 32, 32, 32 });
+  std::memset(grid.getData(), 0, grid.getVoxelCount() * sizeof(VolumeElement));
+  grid.at(10, 10, 10) = { 1.f, 1.f, 1.f };
+
+  std::vector<VolumeGrid> mips;
+  UInt levelCount = VolumeMips::getLevelCount(grid.getSize());
+  VolumeMips::buildChain(grid, mips, levelCount);
+
+  std::vector<float> cells;
+  VolumeMips::buildMacroCells(grid, mips, cells);
+  XMINT3 counts = VolumeMips::getMacroCellCounts(grid.getSize());
+  REQUIRE(counts.x == 4);
+  REQUIRE(cells.size() == 64 * levelCount);
+
+  auto cell = [&](int x, int y, int z, UInt level) { return cells[(size_t(x) + 4 * (size_t(y) + 4 * size_t(z))) * levelCount + level]; };
+  for (UInt level = 0; level < levelCount; ++level) { CHECK(cell(1, 1, 1, level) == 1.f); }
+
+  // Grown by 1, 2 then 4 texels, the texel is only reached by the third
+  CHECK(cell(0, 0, 0, 0) == .0f);
+  CHECK(cell(0, 0, 0, 1) == .0f);
+  CHECK(cell(0, 0, 0, 2) == 1.f);
+
+  // Texels of level 4 cover half the volume
+  CHECK(cell(3, 3, 3, 3) == .0f);
+  CHECK(cell(3, 3, 3, 4) == 1.f);
+}
+
+TEST_CASE("Volume cache round trips baked volumes", "[volume][cache]")
+{
+  ScratchCache scratch("HaboobVolumeCacheRoundTrip");
+  VolumeCache cache(scratch.directory);
+
+  VolumeInfo info;
+  info.size = { 32, 16, 24 };
+  VolumeGrid grid;
+  VolumeGenerator().generate(info, grid);
+
+  uint64_t key = VolumeCache::getKey(info);
+  CachedVolume volume;
+  REQUIRE_FALSE(cache.load(key, volume));
+  REQUIRE(cache.store(key, grid));
+
+  // Nothing but the entry is left behind
+  for (auto& entry : std::filesystem::directory_iterator(scratch.directory))
+  {
+    CHECK(entry.path() == cache.getPath(key));
+  }
+
+  REQUIRE(cache.load(key, volume));
+  REQUIRE(volume.getLevelCount() == VolumeMips::getLevelCount(info.size));
+  REQUIRE(volume.getSize().x == info.size.x);
+
+  // Every level is page aligned within the mapping
+  for (UInt level = 0; level < volume.getLevelCount(); ++level)
+  {
+    CHECK(reinterpret_cast<uintptr_t>(volume.getLevel(level)) % VolumeCache::PAGE_SIZE == 0);
+  }
+
+  // The full resolution level matches the packed grid
+  for (size_t i = 0; i < grid.getVoxelCount(); ++i)
+  {
+    const VolumeElement& element = grid.getData()[i];
+    REQUIRE(volume.getLevel(0)[i] == PackedFloat::packR11G11B10(element.density, element.maxDensity, element.angstromExponent));
+  }
+
+  // And the next is its box filter
+  VolumeGrid mip, cachedMip;
+  VolumeMips::downsample(grid, mip);
+  volume.unpackLevel(1, cachedMip);
+  REQUIRE(cachedMip.getVoxelCount() == mip.getVoxelCount());
+  for (size_t i = 0; i < mip.getVoxelCount(); ++i)
+  {
+    // Within half a 6 bit mantissa step, or flushed below the smallest denormal
+    float expected = mip.getData()[i].density;
+    REQUIRE(std::fabs(cachedMip.getData()[i].density - expected) <= expected / 128.f + std::ldexp(1.f, -20));
+  }
+
+  SECTION("Changed parameters miss")
+  {
+    VolumeInfo changed = info;
+    changed.wackyScale += .1f;
+    CHECK(VolumeCache::getKey(changed) != key);
+    CHECK_FALSE(cache.load(VolumeCache::getKey(changed), volume));
+  }
+
+  SECTION("Corrupt entries are rejected and removed")
+  {
+    volume = CachedVolume();
+    std::filesystem::path path = cache.getPath(key);
+    {
+      std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+      file.seekp(VolumeCache::PAGE_SIZE + 5);
+      file.put(char(0x5A));
+    }
+
+    CHECK_FALSE(cache.load(key, volume));
+    CHECK_FALSE(std::filesystem::exists(path));
+  }
+
+  SECTION("Headers out of the file's bounds are rejected without reading past it")
+  {
+    volume = CachedVolume();
+    std::filesystem::path path = cache.getPath(key);
+
+    // The header's size is at byte 40 and its first level offset at 56, values that wrapped the bounds checks before
+    auto patch = [&](std::streamoff at, const void* value, size_t bytes)
+    {
+      REQUIRE(cache.store(key, grid));
+      {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(at);
+        file.write(reinterpret_cast<const char*>(value), std::streamsize(bytes));
+      }
+
+      CHECK_FALSE(cache.load(key, volume));
+      CHECK_FALSE(std::filesystem::exists(path));
+    };
+
+    int hugeSize[3] = { std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), 1 << 22 };
+    patch(40, hugeSize, sizeof(hugeSize));
+
+    uint64_t hugeOffset = ~uint64_t(VolumeCache::PAGE_SIZE - 1);
+    patch(56, &hugeOffset, sizeof(hugeOffset));
+  }
+}
+
+TEST_CASE("Volume cache evicts the least recently used entries", "[volume][cache]")
+{
+  ScratchCache scratch("HaboobVolumeCacheEviction");
+  VolumeCache cache(scratch.directory);
+
+  VolumeInfo info;
+  info.size = { 16, 16, 16 };
+  VolumeGrid grid;
+  VolumeGenerator().generate(info, grid);
+
+  // Three equally sized entries
+  uint64_t keys[3] = { 1, 2, 3 };
+  for (uint64_t key : keys) { REQUIRE(cache.store(key, grid)); }
+  uint64_t entrySize = std::filesystem::file_size(cache.getPath(keys[0]));
+  CHECK(cache.getUsage() == entrySize * 3);
+
+  // Use the oldest so the middle one is evicted first
+  std::filesystem::last_write_time(cache.getPath(keys[0]), std::filesystem::last_write_time(cache.getPath(keys[2])) + std::chrono::seconds(1));
+  std::filesystem::last_write_time(cache.getPath(keys[1]), std::filesystem::last_write_time(cache.getPath(keys[2])) - std::chrono::seconds(1));
+
+  cache.setCapacity(entrySize * 2);
+  cache.evict();
+  CHECK(std::filesystem::exists(cache.getPath(keys[0])));
+  CHECK_FALSE(std::filesystem::exists(cache.getPath(keys[1])));
+  CHECK(std::filesystem::exists(cache.getPath(keys[2])));
+
+  // A new entry always survives its own store
+  cache.setCapacity(entrySize);
+  REQUIRE(cache.store(4, grid));
+  CHECK(std::filesystem::exists(cache.getPath(4)));
+  CHECK(cache.getUsage() == entrySize);
+
+  cache.clear();
+  CHECK(cache.getUsage() == 0);
+}
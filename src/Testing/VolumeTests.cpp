@@ -0,0 +1,494 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Data/PackedFloat.h"
+#include "Rendering/Volume/VolumeAnimator.h"
+#include "Rendering/Volume/VolumeGenerator.h"
+
+using namespace Haboob;
+
+TEST_CASE("CPU volume generation is independent of threading", "[volume]")
+{
+  VolumeInfo info;
+  info.size = { 32, 24, 40 };
+
+  VolumeGrid serialGrid;
+  VolumeGenerator serial;
+  serial.generate(info, serialGrid);
+
+  ThreadPool pool(4);
+  VolumeGrid parallelGrid;
+  VolumeGenerator parallel(&pool);
+  parallel.generate(info, parallelGrid);
+
+  REQUIRE(serialGrid.getVoxelCount() == UInt(32 * 24 * 40));
+  REQUIRE(parallelGrid.getVoxelCount() == serialGrid.getVoxelCount());
+  REQUIRE(std::memcmp(serialGrid.getData(), parallelGrid.getData(), serialGrid.getVoxelCount() * sizeof(VolumeElement)) == 0);
+}
+
+TEST_CASE("CPU volume generation follows the haboob shape", "[volume]")
+{
+  VolumeInfo info;
+  info.size = { 32, 32, 32 };
+  info.wackyScale = .0f; // Remove the noise for a predictable shape
+
+  VolumeGrid grid;
+  VolumeGenerator().generate(info, grid);
+
+  float maxDensity = .0f;
+  for (UInt i = 0; i < grid.getVoxelCount(); ++i)
+  {
+    const VolumeElement& element = grid.getData()[i];
+    REQUIRE(element.density >= .0f);
+    REQUIRE(element.density == element.maxDensity);
+    maxDensity = std::max(maxDensity, element.density);
+  }
+
+  CHECK(maxDensity > .0f);
+}
+
+namespace
+{
+  // The shape as generateSlab evaluated it inline per voxel before the terms were split out, kept independent of the generator's helpers
+  struct ReferenceShape
+  {
+    float density;
+    float angstromExponent;
+  };
+
+  ReferenceShape referenceShape(const VolumeInfo& info, int x, int y, int z, float fbm)
+  {
+    const HaboobRadial& radial = info.radial;
+    const HaboobDistribution& distribution = info.distribution;
+    auto saturate = [](float value) { return std::min(std::max(value, .0f), 1.f); };
+    auto undersideRadius = [&](float height) { return radial.rOffset + radial.exponentialScale * std::log(1.f + height * radial.exponentialRate); };
+
+    float texel[3] = { float(x) / float(info.size.x), float(y) / float(info.size.y), float(z) / float(info.size.z) };
+    float cylinderCoord[3] = { 2.f * texel[0] - 1.f, texel[1], 2.f * texel[2] - 1.f };
+
+    // Leading edge, blending the flat roof into the underside
+    float height = cylinderCoord[1];
+    float underside = undersideRadius(height);
+    float roof = radial.roofGradient * (height - radial.noseHeight) + undersideRadius(radial.noseHeight);
+    float easing = std::exp(-radial.blendRate * std::max((height - radial.noseHeight) / radial.blendHeight, .0f));
+    float leadingRadius = roof + (underside - roof) * easing;
+
+    float radius = std::sqrt(cylinderCoord[0] * cylinderCoord[0] + cylinderCoord[2] * cylinderCoord[2]) + info.wackyScale * fbm;
+
+    float arcAngle = std::atan2(cylinderCoord[2], -cylinderCoord[0]) + 1.57079632679f;
+    float halfRange = distribution.angleRange * .5f;
+    float t = saturate(std::pow(std::abs(halfRange - arcAngle) / halfRange, distribution.anglePower));
+    float arcDensity = 1.f - t * t * (3.f - 2.f * t);
+
+    float falloff = distribution.falloffScale;
+    float inner = (radius - (leadingRadius - falloff * std::sqrt(2.f) * .5f)) / falloff;
+    float radialDensity = saturate(inner * std::exp(-inner * inner));
+
+    float heightDensity = std::pow(distribution.heightScale * (1.f + height), -distribution.heightExponent);
+
+    ReferenceShape shape;
+    shape.density = arcDensity * radialDensity * heightDensity;
+    shape.angstromExponent = std::pow(.5f - (float(y) / float(info.size.y) - .5f), info.wackyPower) + info.wackyScale * fbm;
+    return shape;
+  }
+
+  // Largest difference of the grid from the reference shape, with the fBM read back from the angstrom exponent when noisy
+  float referenceError(const VolumeInfo& info, const VolumeGrid& grid)
+  {
+    float maxError = .0f;
+    for (int z = 0; z < info.size.z; ++z)
+    {
+      for (int y = 0; y < info.size.y; ++y)
+      {
+        for (int x = 0; x < info.size.x; ++x)
+        {
+          const VolumeElement& element = grid.at(x, y, z);
+          float fbm = .0f;
+          if (info.wackyScale != .0f)
+          {
+            fbm = (element.angstromExponent - referenceShape(info, x, y, z, .0f).angstromExponent) / info.wackyScale;
+          }
+
+          ReferenceShape shape = referenceShape(info, x, y, z, fbm);
+          maxError = std::max(maxError, std::abs(element.density - shape.density));
+          maxError = std::max(maxError, std::abs(element.maxDensity - shape.density));
+          maxError = std::max(maxError, std::abs(element.angstromExponent - shape.angstromExponent));
+        }
+      }
+    }
+
+    return maxError;
+  }
+}
+
+TEST_CASE("Separable shape terms match per voxel evaluation", "[volume]")
+{
+  VolumeInfo info;
+  info.size = { 40, 36, 28 };
+
+  // Without the fBM every channel is the shape alone, with it the density must follow the alteration the angstrom exponent carries
+  for (float wackyScale : { .0f, info.wackyScale })
+  {
+    info.wackyScale = wackyScale;
+    for (bool separable : { false, true })
+    {
+      VolumeGenerator generator;
+      generator.setSeparable(separable);
+      VolumeGrid grid;
+      generator.generate(info, grid);
+
+      // Rounding differs between the compilers' evaluation of the same formulas, and the read back fBM
+      float maxError = referenceError(info, grid);
+      INFO("Separable " << separable << " wacky scale " << wackyScale << " largest difference " << maxError);
+      CHECK(maxError <= 1e-4f);
+    }
+  }
+
+  // Both paths agree to the generator's stated tolerance
+  VolumeGenerator generator;
+  generator.setSeparable(false);
+  VolumeGrid expected;
+  generator.generate(info, expected);
+
+  generator.setSeparable(true);
+  VolumeGrid separable;
+  generator.generate(info, separable);
+
+  float maxError = .0f;
+  for (size_t i = 0; i < expected.getVoxelCount(); ++i)
+  {
+    const VolumeElement& a = expected.getData()[i];
+    const VolumeElement& b = separable.getData()[i];
+    maxError = std::max(maxError, std::abs(a.density - b.density));
+    maxError = std::max(maxError, std::abs(a.maxDensity - b.maxDensity));
+    maxError = std::max(maxError, std::abs(a.angstromExponent - b.angstromExponent));
+  }
+
+  INFO("Largest difference " << maxError);
+  REQUIRE(maxError <= VolumeGenerator::SEPARABLE_TOLERANCE);
+}
+
+TEST_CASE("CPU volume generation only recomputes dirty stages", "[volume]")
+{
+  VolumeInfo info;
+  info.size = { 24, 16, 16 };
+
+  VolumeGenerator generator;
+  VolumeGrid grid;
+  generator.generate(info, grid);
+  REQUIRE(generator.getNoiseStage().getRunCount() == 1);
+  REQUIRE(generator.getShapeStage().getRunCount() == 1);
+
+  // Every result must match a generator starting from scratch
+  auto requireFresh = [&]()
+    {
+      VolumeGrid fresh;
+      VolumeGenerator().generate(info, fresh);
+      REQUIRE(std::memcmp(grid.getData(), fresh.getData(), fresh.getVoxelCount() * sizeof(VolumeElement)) == 0);
+    };
+
+  SECTION("Shape parameters keep the fBM field")
+  {
+    info.radial.roofGradient = -2.f;
+    generator.generate(info, grid);
+    CHECK(generator.getNoiseStage().getRunCount() == 1);
+    CHECK(generator.getShapeStage().getRunCount() == 2);
+    requireFresh();
+  }
+
+  SECTION("Combine parameters keep both fields")
+  {
+    info.wackyScale = .5f;
+    info.distribution.falloffScale = .3f;
+    generator.generate(info, grid);
+    CHECK(generator.getNoiseStage().getRunCount() == 1);
+    CHECK(generator.getShapeStage().getRunCount() == 1);
+    requireFresh();
+  }
+
+  SECTION("Noise parameters keep the shape field")
+  {
+    info.seed.w = 7;
+    generator.generate(info, grid);
+    CHECK(generator.getNoiseStage().getRunCount() == 2);
+    CHECK(generator.getShapeStage().getRunCount() == 1);
+    requireFresh();
+  }
+
+  SECTION("Resizing recomputes everything")
+  {
+    info.size = { 16, 16, 8 };
+    generator.generate(info, grid);
+    CHECK(generator.getNoiseStage().getRunCount() == 2);
+    CHECK(generator.getShapeStage().getRunCount() == 2);
+    requireFresh();
+  }
+}
+
+TEST_CASE("Volume stage hashes only follow their own parameters", "[volume]")
+{
+  VolumeInfo info;
+  VolumeStageHashes base = VolumeStageHashes::compute(info);
+  REQUIRE(VolumeStageHashes::compute(info).fbm == base.fbm);
+
+  // Padding never contributes
+  info.padding = 1234;
+  info.radial.padding = 5.f;
+  info.distribution.padding = { 1.f, 2.f, 3.f };
+  info.motion.padding = 6.f;
+  VolumeStageHashes padded = VolumeStageHashes::compute(info);
+  CHECK(padded.fbm == base.fbm);
+  CHECK(padded.shape == base.shape);
+  CHECK(padded.combine == base.combine);
+
+  info.fbmScale += .1f;
+  VolumeStageHashes noise = VolumeStageHashes::compute(info);
+  CHECK(noise.fbm != base.fbm);
+  CHECK(noise.shape == base.shape);
+  CHECK(noise.combine != base.combine);
+}
+
+TEST_CASE("Haboob motion folds into the static parameters", "[volume][motion]")
+{
+  VolumeInfo info;
+  info.size = { 24, 16, 20 };
+  VolumeStageHashes still = VolumeStageHashes::compute(info);
+
+  // Motion parameters alone change nothing until time passes
+  info.motion.fbmAdvection = .3f;
+  info.motion.frontSpeed = .1f;
+  CHECK(VolumeStageHashes::compute(info).combine == still.combine);
+
+  info.motion.time = 2.f;
+  VolumeStageHashes moved = VolumeStageHashes::compute(info);
+  CHECK(moved.fbm != still.fbm);
+  CHECK(moved.shape != still.shape);
+
+  // Generating at a time is generating the snapshot
+  VolumeInfo snapshot = info;
+  snapshot.motion.time = .0f;
+  snapshot.fbmOffset += .6f;
+  snapshot.radial.rOffset += .2f;
+  CHECK(VolumeStageHashes::compute(snapshot).combine == moved.combine);
+
+  VolumeGrid timed, fixed;
+  VolumeGenerator().generate(info, timed);
+  VolumeGenerator().generate(snapshot, fixed);
+  REQUIRE(std::memcmp(timed.getData(), fixed.getData(), fixed.getVoxelCount() * sizeof(VolumeElement)) == 0);
+
+  // The front moves outward, so the rim holds more dust later on
+  VolumeInfo later = info;
+  later.motion.time = 4.f;
+  later.motion.fbmAdvection = .0f;
+  VolumeInfo earlier = later;
+  earlier.motion.time = .0f;
+
+  VolumeGrid earlierGrid, laterGrid;
+  VolumeGenerator().generate(earlier, earlierGrid);
+  VolumeGenerator().generate(later, laterGrid);
+  double earlierTotal = .0, laterTotal = .0;
+  for (size_t i = 0; i < earlierGrid.getVoxelCount(); ++i)
+  {
+    earlierTotal += earlierGrid.getData()[i].density;
+    laterTotal += laterGrid.getData()[i].density;
+  }
+  CHECK(laterTotal != earlierTotal);
+}
+
+TEST_CASE("Volume animation double buffers background frames", "[volume][motion]")
+{
+  VolumeInfo info;
+  info.size = { 16, 16, 16 };
+
+  ThreadPool pool(2);
+  VolumeAnimator animator(&pool);
+  CHECK_FALSE(animator.swap());
+
+  auto expected = [&](float time)
+    {
+      VolumeInfo timed = info;
+      timed.motion.time = time;
+      VolumeGrid grid;
+      VolumeGenerator().generate(timed, grid);
+      return grid;
+    };
+  auto requireFront = [&](const VolumeGrid& grid)
+    {
+      REQUIRE(animator.getFront().getVoxelCount() == grid.getVoxelCount());
+      REQUIRE(std::memcmp(animator.getFront().getData(), grid.getData(), grid.getVoxelCount() * sizeof(VolumeElement)) == 0);
+    };
+
+  // A fixed step sequence
+  for (UInt frame = 1; frame <= 3; ++frame)
+  {
+    VolumeInfo next = info;
+    next.motion.time = float(frame) * .5f;
+    animator.request(next);
+    animator.wait();
+
+    REQUIRE(animator.swap());
+    CHECK(animator.getFrontTime() == next.motion.time);
+    CHECK(animator.getFrameCount() == frame);
+    requireFront(expected(next.motion.time));
+  }
+
+  SECTION("The front is kept until the next swap")
+  {
+    VolumeInfo next = info;
+    next.motion.time = 10.f;
+    animator.request(next);
+    animator.wait();
+    requireFront(expected(1.5f));
+
+    REQUIRE(animator.swap());
+    requireFront(expected(10.f));
+  }
+
+  SECTION("Requests queued behind a finished frame replace each other")
+  {
+    VolumeInfo next = info;
+    next.motion.time = 2.f;
+    animator.request(next);
+    animator.wait();
+
+    // Waits for the swap, then only the latest runs
+    next.motion.time = 3.f;
+    animator.request(next);
+    next.motion.time = 4.f;
+    animator.request(next);
+    CHECK(animator.isBusy());
+
+    REQUIRE(animator.swap());
+    CHECK(animator.getFrontTime() == 2.f);
+    animator.wait();
+    REQUIRE(animator.swap());
+    CHECK(animator.getFrontTime() == 4.f);
+    requireFront(expected(4.f));
+    CHECK_FALSE(animator.isBusy());
+  }
+}
+
+TEST_CASE("Bricked volumes match the dense volume where occupied", "[volume][bricks]")
+{
+  VolumeInfo info;
+  info.size = { 44, 36, 52 }; // Partial bricks on every axis
+
+  ThreadPool pool(3);
+  VolumeGenerator generator(&pool);
+  VolumeGrid dense;
+  generator.generate(info, dense);
+
+  BrickedVolume bricked;
+  generator.generate(info, bricked);
+
+  const XMINT3& counts = bricked.getBrickCounts();
+  REQUIRE(counts.x == 6);
+  REQUIRE(counts.y == 5);
+  REQUIRE(counts.z == 7);
+  CHECK(bricked.getOccupiedCount() > 0);
+  CHECK(bricked.getOccupiedCount() < bricked.getBrickCount()); // The shell leaves some bricks empty
+
+  for (int z = 0; z < info.size.z; ++z)
+  {
+    for (int y = 0; y < info.size.y; ++y)
+    {
+      for (int x = 0; x < info.size.x; ++x)
+      {
+        // Bricks hold the texels the GPU would
+        const VolumeElement& denseElement = dense.at(x, y, z);
+        float packed[3];
+        PackedFloat::unpackR11G11B10(PackedFloat::packR11G11B10(denseElement.density, denseElement.maxDensity, denseElement.angstromExponent), packed);
+        VolumeElement expected = { packed[0], packed[1], packed[2] };
+
+        UInt brick = bricked.brickIndex(x / BrickedVolume::BRICK_SIZE, y / BrickedVolume::BRICK_SIZE, z / BrickedVolume::BRICK_SIZE);
+        if (bricked.isOccupied(brick))
+        {
+          VolumeElement element = bricked.at(x, y, z);
+          REQUIRE(std::memcmp(&element, &expected, sizeof(VolumeElement)) == 0);
+          REQUIRE(element.density >= bricked.getRange(brick).minDensity);
+          REQUIRE(element.density <= bricked.getRange(brick).maxDensity);
+        }
+        else
+        {
+          REQUIRE(expected.density <= generator.getEmptyDensity());
+        }
+      }
+    }
+  }
+
+  SECTION("Exact zeros only")
+  {
+    generator.setEmptyDensity(.0f);
+    generator.generate(info, bricked);
+
+    VolumeGrid expanded;
+    bricked.toGrid(expanded);
+    for (size_t i = 0; i < dense.getVoxelCount(); ++i)
+    {
+      REQUIRE(expanded.getData()[i].density == PackedFloat::fromSmallFloat<6>(PackedFloat::toSmallFloat<6>(dense.getData()[i].density)));
+    }
+  }
+}
+
+TEST_CASE("Bricked ray marching skips empty bricks only", "[volume][bricks]")
+{
+  VolumeInfo info;
+  info.size = { 48, 40, 56 };
+
+  VolumeGenerator generator;
+  BrickedVolume bricked;
+  generator.generate(info, bricked);
+
+  VolumeGrid expanded;
+  bricked.toGrid(expanded);
+
+  const float extent[3] = { float(info.size.x), float(info.size.y), float(info.size.z) };
+  const float step = .37f;
+  TEA rng;
+  rng.delta = TEA::SALT;
+  rng.seed(7, 11, 13, 17);
+  rng.associate(0, 0);
+  for (UInt ray = 0; ray < 64; ++ray)
+  {
+    // From outside the volume through a random interior point
+    float target[3], origin[3], direction[3];
+    for (UInt axis = 0; axis < 3; ++axis)
+    {
+      target[axis] = (rng.getNormFloat() * .4f + .5f) * extent[axis];
+      origin[axis] = target[axis] + rng.getNormFloat() * 80.f;
+    }
+
+    float length = .0f;
+    for (UInt axis = 0; axis < 3; ++axis)
+    {
+      direction[axis] = target[axis] - origin[axis];
+      length += direction[axis] * direction[axis];
+    }
+    length = std::sqrt(length);
+    for (UInt axis = 0; axis < 3; ++axis) { direction[axis] /= length; }
+
+    // Every sample within the volume of the dense expansion
+    float expected = .0f;
+    for (UInt i = 0; i < UInt(300.f / step); ++i)
+    {
+      float t = (float(i) + .5f) * step;
+      int voxel[3];
+      bool inside = true;
+      for (UInt axis = 0; axis < 3; ++axis)
+      {
+        float position = origin[axis] + direction[axis] * t;
+        inside = inside && position >= .0f && position <= extent[axis];
+        voxel[axis] = std::min(std::max(int(std::floor(position)), 0), int(extent[axis]) - 1);
+      }
+
+      if (inside) { expected += expanded.at(voxel[0], voxel[1], voxel[2]).density; }
+    }
+    expected *= step;
+
+    float marched = bricked.integrateDensity(origin, direction, .0f, float(UInt(300.f / step)) * step, step);
+    REQUIRE(std::fabs(marched - expected) <= 1e-4f * std::max(1.f, expected));
+  }
+}
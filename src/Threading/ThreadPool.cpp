@@ -0,0 +1,93 @@
+#include "Threading/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace Haboob
+{
+  ThreadPool::ThreadPool(UInt threadCount) : stopping{ false }
+  {
+    if (!threadCount)
+    {
+      threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    workers.reserve(threadCount);
+    for (UInt i = 0; i < threadCount; ++i)
+    {
+      workers.emplace_back(&ThreadPool::work, this);
+    }
+  }
+
+  ThreadPool::~ThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(jobMutex);
+      stopping = true;
+    }
+    jobSignal.notify_all();
+
+    for (auto& worker : workers)
+    {
+      worker.join();
+    }
+  }
+
+  void ThreadPool::enqueue(const std::function<void()>& job)
+  {
+    {
+      std::lock_guard<std::mutex> lock(jobMutex);
+      jobs.push(job);
+    }
+    jobSignal.notify_one();
+  }
+
+  void ThreadPool::parallelFor(UInt count, const std::function<void(UInt)>& job)
+  {
+    if (!count) { return; }
+
+    // Each worker pulls indices until they run out, which balances uneven jobs
+    std::atomic<UInt> nextIndex{ 0 };
+    UInt runners = std::min(count, getThreadCount());
+    UInt finishedRunners = 0;
+    std::mutex finishMutex;
+    std::condition_variable finishSignal;
+
+    for (UInt i = 0; i < runners; ++i)
+    {
+      enqueue([&]()
+        {
+          for (UInt index = nextIndex++; index < count; index = nextIndex++)
+          {
+            job(index);
+          }
+
+          std::lock_guard<std::mutex> lock(finishMutex);
+          ++finishedRunners;
+          finishSignal.notify_one();
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(finishMutex);
+    finishSignal.wait(lock, [&]() { return finishedRunners == runners; });
+  }
+
+  void ThreadPool::work()
+  {
+    while (true)
+    {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(jobMutex);
+        jobSignal.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+        if (stopping && jobs.empty()) { return; }
+
+        job = std::move(jobs.front());
+        jobs.pop();
+      }
+
+      job();
+    }
+  }
+}
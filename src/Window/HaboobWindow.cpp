@@ -4,10 +4,11 @@
 #include <backends/imgui_impl_win32.h>
 
 #include "Rendering/Scene/SceneStructs.h"
+#include "Data/Hash.h"
 
 namespace Haboob
 {
-  HaboobWindow::HaboobWindow() : imgui{ nullptr }, tcyCtx{ nullptr }, fps{ .0f }
+  HaboobWindow::HaboobWindow() : haboobAnimator{ &volumePool }, imgui{ nullptr }, tcyCtx{ nullptr }, fps{ .0f }
   {
     setupDefaults();
 
@@ -19,6 +20,7 @@ namespace Haboob
 
     shaderManager.setRootDir(CURRENT_DIRECTORY + L"/..");
     shaderManager.setShaderDir(L"shaders");
+    shaderManager.setThreadPool(&shaderPool);
 
     if (exportPathFlag && exportPathFlag->HasFlag() && exportPathFlag->Matched())
     {
@@ -26,6 +28,21 @@ namespace Haboob
       exportLocation = CURRENT_DIRECTORY + L"/../" + std::wstring(exportSmallPath.begin(), exportSmallPath.end());
     }
 
+    if (volumeCacheFlag && volumeCacheFlag->HasFlag() && volumeCacheFlag->Matched())
+    {
+      std::string cacheSmallPath = volumeCacheFlag->Get();
+      volumeCache.setDirectory(CURRENT_DIRECTORY + L"/../" + std::wstring(cacheSmallPath.begin(), cacheSmallPath.end()));
+      haboobVolume.setCache(&volumeCache);
+    }
+
+    if (shaderCacheFlag && shaderCacheFlag->HasFlag() && shaderCacheFlag->Matched())
+    {
+      std::string cacheSmallPath = shaderCacheFlag->Get();
+      shaderManager.setCacheDirectory(CURRENT_DIRECTORY + L"/../" + std::wstring(cacheSmallPath.begin(), cacheSmallPath.end()));
+    }
+
+    haboobVolume.setThreadPool(&volumePool);
+
     createD3D();
     imguiStart();
 
@@ -42,7 +59,8 @@ namespace Haboob
       raymarchShader.createTextures(dev, requiredWidth, requiredHeight);
       light.create(dev, 1024, 1024);
 
-      // Initialise all shaders
+      // Initialise all shaders, compiled in parallel with the settings' macros rather than each shader's defaults
+      updateMacros();
       {
         raymarchShader.initShader(dev, &shaderManager);
         haboobVolume.initShader(dev, &shaderManager);
@@ -55,6 +73,7 @@ namespace Haboob
       scene.setCamera(&mainCamera);
 
       shaderManager.bakeMacros(dev);
+      shaderManager.waitForShaders(dev);
       
       // Generate assets
       {
@@ -67,6 +86,7 @@ namespace Haboob
 
         haboobVolume.rebuild(dev);
         haboobVolume.render(device.getContext().Get());
+        haboobVolume.collectMips(device.getContext().Get(), true); // The first frame starts complete
         raymarchShader.getMarchInfo().texelDensity = float(haboobVolume.getVolumeInfo().size.x);
       }
 
@@ -241,6 +261,12 @@ namespace Haboob
     {
       showGUI = !showGUI;
     }
+
+    // Picks up shader edits, swapped in once compiled
+    if (keys.isKeyPress('R'))
+    {
+      shaderManager.reloadSources();
+    }
   }
 
   void HaboobWindow::update(float dt)
@@ -250,50 +276,42 @@ namespace Haboob
     fps = 1.f / dt;
 
     // Mirror some shader env macros
+    updateMacros();
+
+    // If macros changed, recompile shaders! (swapped in once ready)
+    shaderManager.bakeMacros(device.getDevice().Get());
+    if (outputFrame || exitAfterFrame)
     {
-      shaderManager.setMacro("MACRO_MANAGED", "1"); // Signal program is taking control
+      shaderManager.waitForShaders(device.getDevice().Get()); // Exported frames use exactly the requested shaders
+    }
 
-      {
-        auto& marchInfo = raymarchShader.getMarchInfo();
-        shaderManager.setMacro("MARCH_STEP_COUNT", std::to_string(marchInfo.iterations));
-      }
+    // Orbit the camera on the fixed path (overwrites input!)
+    cameraOrbitStep(dt);
 
+    // Animation bakes the next time step in the background and only uploads finished frames
+    if (animateHaboob)
+    {
+      ZoneScopedN("HaboobAnimate");
+
+      auto& volumeInfo = haboobVolume.getVolumeInfo();
+      haboobVolume.rebuild(device.getDevice().Get());
+      if (haboobAnimator.swap())
       {
-        auto& opticsInfo = raymarchShader.getOpticsInfo();
-        shaderManager.setMacro("APPLY_BEER", std::to_string(opticsInfo.flagApplyBeer));
-        shaderManager.setMacro("APPLY_HG", std::to_string(opticsInfo.flagApplyHG));
-        shaderManager.setMacro("APPLY_SPECTRAL", std::to_string(opticsInfo.flagApplySpectral));
-        shaderManager.setMacro("APPLY_CONE_TRACE", std::to_string(coneTrace));
-        shaderManager.setMacro("APPLY_UPSCALE", std::to_string(upscaleTracing));
-        shaderManager.setMacro("APPLY_BSM", std::to_string(useBSM));
-        shaderManager.setMacro("APPLY_IMPROVE_BSM", std::to_string(useImprovedBSM));
-        shaderManager.setMacro("MARCH_MANUAL", std::to_string(manualMarch));
-        shaderManager.setMacro("APPLY_SHADOW", std::to_string(useShadows));
-        shaderManager.setMacro("TEXTURE_GRAPH", std::to_string(textureGraph));
-        shaderManager.setMacro("TEXTURE_NORMALS", std::to_string(textureNormals));
-        shaderManager.setMacro("TEXTURE_WHITE", std::to_string(textureWhite));
+        TracyD3D11Zone(tcyCtx, "D3DHaboobUpload");
+        haboobVolume.uploadVolume(device.getContext().Get(), haboobAnimator.getFront());
+        volumeInfo.motion.time = haboobAnimator.getFrontTime();
       }
 
+      if (!haboobAnimator.isBusy())
       {
-        shaderManager.setMacro("SHOW_DENSITY", std::to_string(showDensity));
-        shaderManager.setMacro("SHOW_ANGSTROM", std::to_string(showAngstrom));
-        shaderManager.setMacro("SHOW_SAMPLE_LEVEL", std::to_string(showSampleLevel));
-        shaderManager.setMacro("SHOW_MASK", std::to_string(showMasks));
-        shaderManager.setMacro("SHOW_RAY_TRAVEL", std::to_string(showRayTravel));
+        VolumeInfo next = volumeInfo;
+        next.motion.time += haboobTimeStep;
+        haboobAnimator.request(next);
       }
-
-      shaderManager.setMacro("SHADOW_EXPONENT", std::to_string(15.));
-      shaderManager.setMacro("SHADOW_BIAS", std::to_string(.05));
+      raymarchShader.getMarchInfo().texelDensity = float(volumeInfo.size.x);
     }
-
-    // If macros changed, recompile shaders!
-    shaderManager.bakeMacros(device.getDevice().Get());
-
-    // Orbit the camera on the fixed path (overwrites input!)
-    cameraOrbitStep(dt);
-
     // Re-render the haboob on demand
-    if (renderHaboob)
+    else if (renderHaboob)
     {
       TracyD3D11Zone(tcyCtx, "D3DHaboobRender");
       ZoneScopedN("HaboobRender");
@@ -303,12 +321,96 @@ namespace Haboob
       raymarchShader.getMarchInfo().texelDensity = float(haboobVolume.getVolumeInfo().size.x);
     }
 
+    // Mips follow the last render once its readback arrives (exported frames wait for them)
+    haboobVolume.collectMips(device.getContext().Get(), outputFrame || exitAfterFrame);
+
     raymarchShader.getBox()->setVisible(showBoundingBoxes);
     raymarchShader.setShouldUpscale(upscaleTracing);
 
     raymarchShader.setCameraBuffer(scene.getCameraBuffer());
     raymarchShader.setLightSource(&light);
     raymarchShader.setTarget(&gbuffer.getLitColourTarget());
+
+    // Progressive frames accumulate while the view, light, volume and march permutation hold (the permutation in use, swapped in after the toggles change)
+    {
+      XMFLOAT4X4 view, projection;
+      XMStoreFloat4x4(&view, mainCamera.getView());
+      XMStoreFloat4x4(&projection, mainCamera.getProjection());
+      const auto& lightPack = light.getLightData();
+
+      Hasher viewKey;
+      viewKey.addBytes(&view, sizeof(XMFLOAT4X4)).addBytes(&projection, sizeof(XMFLOAT4X4));
+      viewKey.addBytes(&lightPack.diffuse, sizeof(XMFLOAT3)).addBytes(&lightPack.ambient, sizeof(XMFLOAT3)).addBytes(&lightPack.direction, sizeof(XMFLOAT4));
+      viewKey.add(VolumeStageHashes::compute(haboobVolume.getVolumeInfo()).combine).add(shaderManager.getSwapGeneration());
+      for (bool toggle : { renderScene, coneTrace, upscaleTracing, manualMarch, skipEmptySpace, adaptiveMarch, transmissionLUT, analyticRays, useBSM, useImprovedBSM, useShadows })
+      {
+        viewKey.add(toggle);
+      }
+      raymarchShader.setProgressive(progressiveMarch, viewKey.get());
+    }
+    raymarchShader.setTransmissionLUT(transmissionLUT);
+    raymarchShader.setAnalyticRays(analyticRays);
+    raymarchShader.setTileList(tileList);
+    raymarchShader.setShowMasks(showMasks);
+
+    // The Beer Shadow Map holds while the light, the volume and the permutation it is marched with do
+    {
+      XMFLOAT4X4 lightProjection;
+      XMStoreFloat4x4(&lightProjection, light.getCamera().getProjection());
+      const auto& lightPack = light.getLightData();
+
+      Hasher shadowKey;
+      shadowKey.addBytes(&lightPack.diffuse, sizeof(XMFLOAT3)).addBytes(&lightPack.ambient, sizeof(XMFLOAT3)).addBytes(&lightPack.specular, sizeof(XMFLOAT3));
+      shadowKey.addBytes(&lightPack.direction, sizeof(XMFLOAT4)).addBytes(&light.getRenderPosition(), sizeof(XMFLOAT3)).addBytes(&lightProjection, sizeof(XMFLOAT4X4));
+      shadowKey.add(haboobVolume.getVersion()).add(shaderManager.getSwapGeneration());
+      for (bool toggle : { coneTrace, upscaleTracing, manualMarch, skipEmptySpace, adaptiveMarch, analyticRays, useImprovedBSM })
+      {
+        shadowKey.add(toggle);
+      }
+      raymarchShader.setSoftShadowKey(shadowKey.get());
+    }
+  }
+
+  void HaboobWindow::updateMacros()
+  {
+    shaderManager.setMacro("MACRO_MANAGED", "1"); // Signal program is taking control
+
+    {
+      auto& marchInfo = raymarchShader.getMarchInfo();
+      shaderManager.setMacro("MARCH_STEP_COUNT", std::to_string(marchInfo.iterations));
+    }
+
+    {
+      auto& opticsInfo = raymarchShader.getOpticsInfo();
+      shaderManager.setMacro("APPLY_BEER", std::to_string(opticsInfo.flagApplyBeer));
+      shaderManager.setMacro("APPLY_HG", std::to_string(opticsInfo.flagApplyHG));
+      shaderManager.setMacro("APPLY_SPECTRAL", std::to_string(opticsInfo.flagApplySpectral));
+      shaderManager.setMacro("APPLY_CONE_TRACE", std::to_string(coneTrace));
+      shaderManager.setMacro("APPLY_UPSCALE", std::to_string(upscaleTracing));
+      shaderManager.setMacro("APPLY_BSM", std::to_string(useBSM));
+      shaderManager.setMacro("APPLY_IMPROVE_BSM", std::to_string(useImprovedBSM));
+      shaderManager.setMacro("MARCH_MANUAL", std::to_string(manualMarch));
+      shaderManager.setMacro("APPLY_EMPTY_SKIP", std::to_string(skipEmptySpace));
+      shaderManager.setMacro("MARCH_ADAPTIVE", std::to_string(adaptiveMarch));
+      shaderManager.setMacro("APPLY_PROGRESSIVE", std::to_string(progressiveMarch));
+      shaderManager.setMacro("APPLY_TRANSMISSION_LUT", std::to_string(transmissionLUT));
+      shaderManager.setMacro("APPLY_TILE_LIST", std::to_string(tileList));
+      shaderManager.setMacro("APPLY_SHADOW", std::to_string(useShadows));
+      shaderManager.setMacro("TEXTURE_GRAPH", std::to_string(textureGraph));
+      shaderManager.setMacro("TEXTURE_NORMALS", std::to_string(textureNormals));
+      shaderManager.setMacro("TEXTURE_WHITE", std::to_string(textureWhite));
+    }
+
+    {
+      shaderManager.setMacro("SHOW_DENSITY", std::to_string(showDensity));
+      shaderManager.setMacro("SHOW_ANGSTROM", std::to_string(showAngstrom));
+      shaderManager.setMacro("SHOW_SAMPLE_LEVEL", std::to_string(showSampleLevel));
+      shaderManager.setMacro("SHOW_MASK", std::to_string(showMasks));
+      shaderManager.setMacro("SHOW_RAY_TRAVEL", std::to_string(showRayTravel));
+    }
+
+    shaderManager.setMacro("SHADOW_EXPONENT", std::to_string(15.));
+    shaderManager.setMacro("SHADOW_BIAS", std::to_string(.05));
   }
 
   void HaboobWindow::createD3D()
@@ -390,13 +492,17 @@ namespace Haboob
       TracyD3D11Zone(tcyCtx, "D3DBSM");
       ZoneScopedN("BeerShadowMap");
 
-      // Initial raymarch optimisation passes
-      raymarchShader.optimiseRays(device, scene.getMeshRenderer(), gbuffer, XMLoadFloat3(&light.getRenderPosition()));
+      // Only when the light, the volume or the march changed, the ray target is rebuilt by the main march either way
+      if (raymarchShader.isSoftShadowMapStale())
+      {
+        // Initial raymarch optimisation passes
+        raymarchShader.optimiseRays(device, scene.getMeshRenderer(), gbuffer, XMLoadFloat3(&light.getRenderPosition()), light.getLightPerspectiveBuffer().Get());
 
-      // Raymarch!
-      raymarchShader.bindSoftShadowMap(context, haboobVolume.getShaderView());
-      raymarchShader.render(context);
-      raymarchShader.unbindSoftShadowMap(context);
+        // Raymarch!
+        raymarchShader.bindSoftShadowMap(context, haboobVolume.getShaderView());
+        raymarchShader.generateSoftShadowMap(context);
+        raymarchShader.unbindSoftShadowMap(context);
+      }
     }
 
     // Full pass
@@ -445,7 +551,7 @@ namespace Haboob
       raymarchShader.optimiseRays(device, scene.getMeshRenderer(), gbuffer, XMLoadFloat3(&mainCamera.getPosition()));
 
       // Raymarch!
-      raymarchShader.bindShader(context, haboobVolume.getShaderView());
+      raymarchShader.bindShader(context, haboobVolume.getShaderView(), haboobVolume.getMacroCellView());
       raymarchShader.render(context);
       raymarchShader.unbindShader(context);
     }
@@ -617,10 +723,18 @@ namespace Haboob
     showAngstrom = false;
     showSampleLevel = false;
     renderHaboob = false;
+    animateHaboob = false;
+    haboobTimeStep = 1.f / 30.f;
     renderScene = true;
     coneTrace = true;
     upscaleTracing = true;
     manualMarch = false;
+    skipEmptySpace = false;
+    adaptiveMarch = false;
+    progressiveMarch = false;
+    transmissionLUT = false;
+    analyticRays = false;
+    tileList = false;
     showBoundingBoxes = false;
     showMasks = false;
     showRayTravel = false;
@@ -691,6 +805,12 @@ namespace Haboob
       exportPathFlag = new args::ValueFlag<std::string>(*testGroup->getArgGroup(), "Output", "The output path", { "o" });
       testGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Symbolic, exportPathFlag)));
 
+      volumeCacheFlag = new args::ValueFlag<std::string>(*testGroup->getArgGroup(), "VolumeCache", "The baked volume cache directory", { "vc" });
+      testGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Symbolic, volumeCacheFlag)));
+
+      shaderCacheFlag = new args::ValueFlag<std::string>(*testGroup->getArgGroup(), "ShaderCache", "The compiled shader cache directory", { "sc" });
+      testGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Symbolic, shaderCacheFlag)));
+
       // Await the external profiler before continuing
       testGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Symbolic, new args::ActionFlag(*testGroup->getArgGroup(), "AwaitProfiler", "The application should pause until the profiler connects", { "ap" }, [=]()
         {
@@ -801,6 +921,8 @@ namespace Haboob
         ->setName("Render Scene"));
       renderToggleGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Bool, nullptr, &renderHaboob))
         ->setName("Render Haboob"));
+      renderToggleGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Bool, nullptr, &animateHaboob))
+        ->setName("Animate Haboob"));
       renderToggleGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Bool,
         new args::ValueFlag<bool>(*renderToggleGroup->getArgGroup(), "ShowBoundingBoxes", "If the renderer should display all bounding boxes", { "sbb" }),
         &showBoundingBoxes))
@@ -932,6 +1054,24 @@ namespace Haboob
           ->setName("Haboob Dist. Angle Power")
           ->setGUISettings(.01f, -10.f, 10.f));
       }
+
+      {
+        auto haboobMotionGroup = (new EnvironmentGroup(new args::Group(argRoot, "HaboobMotion")))->setName("HaboobMotion");
+        haboobGroup->addChildGroup(haboobMotionGroup);
+
+        haboobMotionGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Float, nullptr, &volumeInfo.motion.time))
+          ->setName("Haboob Time")
+          ->setGUISettings(.01f, .0f, 1000.f));
+        haboobMotionGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Float, nullptr, &volumeInfo.motion.fbmAdvection))
+          ->setName("Haboob FBM Advection")
+          ->setGUISettings(.01f, -10.f, 10.f));
+        haboobMotionGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Float, nullptr, &volumeInfo.motion.frontSpeed))
+          ->setName("Haboob Front Speed")
+          ->setGUISettings(.01f, -10.f, 10.f));
+        haboobMotionGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Float, nullptr, &haboobTimeStep))
+          ->setName("Haboob Time Step")
+          ->setGUISettings(.001f, .0f, 1.f));
+      }
     }
 
     {
@@ -952,6 +1092,42 @@ namespace Haboob
         ->setGUISettings(1.f, 0, 100));
       raymarchGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Bool, nullptr, &manualMarch))
         ->setName("Use manual step"));
+      raymarchGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Bool,
+        new args::ValueFlag<bool>(*raymarchGroup->getArgGroup(), "SkipEmptySpace", "If the steps should only be spent within occupied macro cells", { "ses" }),
+        &skipEmptySpace))
+        ->setName("Skip empty space"));
+      raymarchGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Bool,
+        new args::ValueFlag<bool>(*raymarchGroup->getArgGroup(), "AdaptiveMarch", "If steps should scale with density and rays stop once opaque", { "am" }),
+        &adaptiveMarch))
+        ->setName("Adaptive march"));
+      raymarchGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Bool,
+        new args::ValueFlag<bool>(*raymarchGroup->getArgGroup(), "ProgressiveMarch", "If jittered frames should accumulate while the view holds", { "pm" }),
+        &progressiveMarch))
+        ->setName("Progressive march"));
+      raymarchGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Bool,
+        new args::ValueFlag<bool>(*raymarchGroup->getArgGroup(), "TransmissionLUT", "If spectral transmissions should be looked up rather than evaluated per sample", { "tlut" }),
+        &transmissionLUT))
+        ->setName("Transmission LUT"));
+      raymarchGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Bool,
+        new args::ValueFlag<bool>(*raymarchGroup->getArgGroup(), "AnalyticRays", "If ray extents should be intersected with the volume's box rather than rasterised", { "ar" }),
+        &analyticRays))
+        ->setName("Analytic rays"));
+      raymarchGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Bool,
+        new args::ValueFlag<bool>(*raymarchGroup->getArgGroup(), "TileList", "If the march should only be dispatched over tiles with an unmasked ray", { "tl" }),
+        &tileList))
+        ->setName("Tile list"));
+      raymarchGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Float, nullptr, &marchInfo.stepOpticalDepth))
+        ->setName("Adaptive step optical depth")
+        ->setGUISettings(.01f, .0f, 4.f));
+      raymarchGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Float, nullptr, &marchInfo.terminationTransmission))
+        ->setName("Termination transmission")
+        ->setGUISettings(.001f, .0f, 1.f));
+      raymarchGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Float, nullptr, &marchInfo.minStepScale))
+        ->setName("Adaptive min step scale")
+        ->setGUISettings(.01f, .0f, 1.f));
+      raymarchGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Float, nullptr, &marchInfo.maxStepScale))
+        ->setName("Adaptive max step scale")
+        ->setGUISettings(.1f, 1.f, 16.f));
       raymarchGroup->addVariable((new EnvironmentVariable(EnvironmentVariable::Type::Float, nullptr, &marchInfo.pixelRadius))
         ->setName("Pixel radius")
         ->setGUISettings(.0001f, .0f, 1.f));